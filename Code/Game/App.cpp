@@ -7,11 +7,13 @@
 #include "Engine/Develop/DevConsole.hpp"
 #include "Engine/Core/Time.hpp"
 #include "Engine/Develop/DebugRenderer.hpp"
-#include "Engine/Develop/UnitTest.hpp"
 #include "Engine/Develop/Log.hpp"
+#include "Game/AsyncLog.hpp"
 #include "Engine/UI/UISystem.hpp"
-#include "Engine/Develop/Profile.hpp"
+#include "Game/TraceCapture.hpp"
 #include "Engine/Core/Job.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Game/GameEvents.hpp"
 #include <filesystem>
 
 #include "Engine/Script/Py3.hpp"
@@ -44,26 +46,41 @@ App::~App()
 }
 
 //////////////////////////////////////////////////////////////////////////
-void App::Startup()
+static void _KeepOldLog(const char* name)
 {
-	if (!std::filesystem::exists("logs")) {
-		std::filesystem::create_directory("logs");
-	}
-	if (std::filesystem::exists("logs/default.log")) {
-		std::string newname = "logs/default";
+	const std::string path = Stringf("logs/%s.log", name);
+	if (std::filesystem::exists(path)) {
+		std::string newname = Stringf("logs/%s", name);
 		for (int i = 1; i > 0; ++i) {
-			std::string sname = Stringf("logs/default%d.log", i);
+			std::string sname = Stringf("logs/%s%d.log", name, i);
 			if (!std::filesystem::exists(sname)) {
 				newname = sname;
 				break;
 			}
 		}
-		std::filesystem::rename("logs/default.log", newname);
+		std::filesystem::rename(path, newname);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void App::Startup()
+{
+	if (!std::filesystem::exists("logs")) {
+		std::filesystem::create_directory("logs");
 	}
-	LogStart("logs/default.log");
+	_KeepOldLog("default");
+	_KeepOldLog("engine");
+	// game code logs through AsyncLog, the engine's own messages go to their own file
+	AsyncLogStart("logs/default.log");
+	trace_set_thread_name("main");
+	LogStart("logs/engine.log");
 
 	g_theJobSystem = new JobSystem();
 	g_theJobSystem->Startup();
+	// game side parallel work, the main thread is its thread 0
+	g_theTasks = new TaskScheduler();
+	g_theTasks->startup();
+	g_theEvents = new EventDispatcher();
 
 	g_theInput = new InputSystem();
 	const IntVec2 windowRes(g_theWindow->GetClientResolution());
@@ -77,8 +94,6 @@ void App::Startup()
 	g_theUI = new UISystem();
 	g_theUI->Startup(g_theWindow, g_theRenderer);
 
-	::RunUnitTest(ALL_UNIT_TEST, UNIT_TEST_LEVEL);
-
 	m_theGame = new Game();
 	m_theGame->Startup();
 
@@ -120,6 +135,14 @@ void App::Shutdown()
 		g_theAudio = nullptr;
 	}
 
+	delete g_theEvents;
+	g_theEvents = nullptr;
+	if (g_theTasks) {
+		g_theTasks->shutdown();
+		delete g_theTasks;
+		g_theTasks = nullptr;
+	}
+
 	g_theJobSystem->Shutdown();
 
 	while (!g_theJobSystem->IsFinished())
@@ -127,13 +150,18 @@ void App::Shutdown()
 		std::this_thread::yield();
 	}
 
+	AsyncLogStop();
 	LogStop();
 
 }
 //////////////////////////////////////////////////////////////////////////
 void App::RunFrame()
 {
-	PROFILE_SCOPE(__FUNCTION__);
+	if (trace_frame() && m_flagQuitAfterTrace) {
+		m_flagQuit = true;
+		return;
+	}
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
 
 	static double lastFrameTime = GetCurrentTimeSeconds();
 	g_theWindow->BeginFrame();
@@ -260,20 +288,4 @@ bool App::HandleChar(char charCode)
 		m_theGame->DoChar(charCode);
 	}
 	return true;
-}
-
-UNIT_TEST(shouldNeverFailTest, "general", 10)
-{
-	return (0 == 0);
-}
-
-UNIT_TEST(anotherCoolTest, "general", 5)
-{
-	return (1 + 1 == 2);
-}
-
-UNIT_TEST(binary_file_test, "general", 10)
-{
-	//LoadFileToBuffer();
-	return true;
 }
\ No newline at end of file
@@ -24,6 +24,8 @@ public:
 	bool HandleMouseButtonUp();
 	bool HandleMouseWheel(int delta);
 	bool HandleChar(char charCode);
+	// quits once the running trace capture is written
+	void QuitAfterTrace() { m_flagQuitAfterTrace = true; }
 
 private:
 
@@ -33,6 +35,7 @@ private:
 	bool m_flagQuit = false;
 	bool m_flagPaused = false;
 	bool m_flagSlow = false;
+	bool m_flagQuitAfterTrace = false;
 
 };
 
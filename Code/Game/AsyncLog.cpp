@@ -0,0 +1,416 @@
+#include "Game/AsyncLog.hpp"
+#include "Game/TraceCapture.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE has to be a power of two");
+constexpr size_t FILTER_TABLE_SIZE = MAX_LOG_FILTERS * 2;
+constexpr size_t FILTER_WORDS = MAX_LOG_FILTERS / 64;
+// fills the rest of the ring when a record would wrap
+constexpr unsigned short PADDING_FILTER = 0xffff;
+// how long the writer sleeps when there is nothing to do
+constexpr auto WRITER_IDLE = std::chrono::milliseconds(2);
+
+namespace {
+struct record_header
+{
+	unsigned int m_size; // with the header, rounded up to a header
+	unsigned short m_filter;
+	unsigned short m_length;
+	int64_t m_ticks;
+};
+static_assert(sizeof(record_header) == 16, "records are laid out in header sized steps");
+
+// one producer thread at a time, the writer is the only consumer
+struct log_ring
+{
+	alignas(64) std::atomic<size_t> m_head{0};
+	alignas(64) std::atomic<size_t> m_tail{0};
+	std::atomic<bool> m_in_use{false};
+	log_ring* m_next = nullptr; // set before the ring is published, never changes after
+	alignas(16) unsigned char m_data[LOG_RING_SIZE];
+};
+
+struct filter_slot
+{
+	std::atomic<const char*> m_name{nullptr}; // published after m_id
+	log_filter_id m_id = 0;
+};
+
+struct pending_message
+{
+	int64_t m_ticks;
+	unsigned short m_filter;
+	unsigned short m_length;
+	const char* m_text;
+};
+
+struct log_ring_owner
+{
+	~log_ring_owner();
+};
+}
+
+static filter_slot s_filter_table[FILTER_TABLE_SIZE];
+static const char* s_filter_names[MAX_LOG_FILTERS] = {};
+static std::mutex s_filters_lock;
+static log_filter_id s_num_filters = 0;
+static std::atomic<uint64_t> s_enabled[FILTER_WORDS] = {};
+static std::atomic<bool> s_enable_new{true};
+static std::atomic<size_t> s_written[MAX_LOG_FILTERS] = {};
+
+static std::mutex s_rings_lock;
+static std::atomic<log_ring*> s_rings{nullptr};
+static thread_local log_ring* s_ring = nullptr;
+static thread_local bool s_ring_gone = false;
+
+static std::atomic<bool> s_running{false};
+static std::atomic<bool> s_quit{false};
+static std::atomic<size_t> s_flush_requested{0};
+static std::atomic<size_t> s_flush_done{0};
+static std::mutex s_writer_lock;
+static std::condition_variable s_writer_wake;
+static std::condition_variable s_flushed;
+static std::thread s_writer;
+static FILE* s_file = nullptr;
+static int64_t s_start_ticks = 0;
+
+static int64_t _get_ticks()
+{
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+static uint32_t _hash_filter(const char* filter)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (const char* c = filter; *c != '\0'; ++c) {
+		hash = (hash ^ (unsigned char)*c) * 16777619u;
+	}
+	return hash;
+}
+
+static void _set_enabled(log_filter_id id, bool enabled)
+{
+	const uint64_t bit = (uint64_t)1 << (id % 64);
+	if (enabled) {
+		s_enabled[id / 64].fetch_or(bit);
+	} else {
+		s_enabled[id / 64].fetch_and(~bit);
+	}
+}
+
+log_filter_id GetLogFilterId(const char* filter)
+{
+	const uint32_t hash = _hash_filter(filter);
+	for (size_t probe = 0; probe < FILTER_TABLE_SIZE; ++probe) {
+		filter_slot& slot = s_filter_table[(hash + probe) % FILTER_TABLE_SIZE];
+		const char* name = slot.m_name.load(std::memory_order_acquire);
+		if (name == nullptr) {
+			break;
+		}
+		if (strcmp(name, filter) == 0) {
+			return slot.m_id;
+		}
+	}
+
+	// first time, or it went in while we probed
+	std::lock_guard<std::mutex> lock(s_filters_lock);
+	for (size_t probe = 0; probe < FILTER_TABLE_SIZE; ++probe) {
+		filter_slot& slot = s_filter_table[(hash + probe) % FILTER_TABLE_SIZE];
+		const char* name = slot.m_name.load(std::memory_order_acquire);
+		if (name != nullptr) {
+			if (strcmp(name, filter) == 0) {
+				return slot.m_id;
+			}
+			continue;
+		}
+		if (s_num_filters == MAX_LOG_FILTERS) {
+			// every id is taken, the rest share the last one
+			return MAX_LOG_FILTERS - 1;
+		}
+		const size_t length = strlen(filter);
+		char* copy = new char[length + 1];
+		memcpy(copy, filter, length + 1);
+		slot.m_id = s_num_filters++;
+		s_filter_names[slot.m_id] = copy;
+		_set_enabled(slot.m_id, s_enable_new.load());
+		slot.m_name.store(copy, std::memory_order_release);
+		return slot.m_id;
+	}
+	return MAX_LOG_FILTERS - 1;
+}
+
+const char* GetLogFilterName(log_filter_id id)
+{
+	std::lock_guard<std::mutex> lock(s_filters_lock);
+	return id < s_num_filters ? s_filter_names[id] : "?";
+}
+
+bool IsLogFilterEnabled(log_filter_id filter)
+{
+	return (s_enabled[filter / 64].load(std::memory_order_relaxed) >> (filter % 64) & 1) != 0;
+}
+
+void AsyncLogFilterEnable(const std::string& filter)
+{
+	_set_enabled(GetLogFilterId(filter.c_str()), true);
+}
+
+void AsyncLogFilterDisable(const std::string& filter)
+{
+	_set_enabled(GetLogFilterId(filter.c_str()), false);
+}
+
+void AsyncLogFilterEnableAll()
+{
+	std::lock_guard<std::mutex> lock(s_filters_lock);
+	s_enable_new.store(true);
+	for (auto& word : s_enabled) {
+		word.store(~(uint64_t)0);
+	}
+}
+
+void AsyncLogFilterDisableAll()
+{
+	std::lock_guard<std::mutex> lock(s_filters_lock);
+	s_enable_new.store(false);
+	for (auto& word : s_enabled) {
+		word.store(0);
+	}
+}
+
+size_t GetNumLogMessagesWritten(log_filter_id filter)
+{
+	return s_written[filter].load();
+}
+
+////////////////////////////////
+static log_ring* _get_ring()
+{
+	if (s_ring != nullptr || s_ring_gone) {
+		return s_ring;
+	}
+	{
+		// a ring left by a thread that exited may still hold messages, they go out in order
+		std::lock_guard<std::mutex> lock(s_rings_lock);
+		log_ring* claimed = s_rings.load();
+		while (claimed != nullptr && claimed->m_in_use.load()) {
+			claimed = claimed->m_next;
+		}
+		if (claimed == nullptr) {
+			claimed = new log_ring();
+			claimed->m_next = s_rings.load();
+			s_rings.store(claimed);
+		}
+		claimed->m_in_use.store(true);
+		s_ring = claimed;
+	}
+	// gives the ring back when the thread exits
+	static thread_local log_ring_owner s_owner;
+	(void)s_owner;
+	return s_ring;
+}
+
+log_ring_owner::~log_ring_owner()
+{
+	std::lock_guard<std::mutex> lock(s_rings_lock);
+	s_ring->m_in_use.store(false);
+	s_ring = nullptr;
+	s_ring_gone = true;
+}
+
+static void _push(log_ring* ring, log_filter_id filter, const char* text, size_t length)
+{
+	const size_t size = (sizeof(record_header) + length + sizeof(record_header) - 1) / sizeof(record_header) * sizeof(record_header);
+	size_t head = ring->m_head.load(std::memory_order_relaxed);
+	const size_t position = head & (LOG_RING_SIZE - 1);
+	const size_t contiguous = LOG_RING_SIZE - position;
+	const size_t needed = contiguous < size ? contiguous + size : size;
+	while (LOG_RING_SIZE - (head - ring->m_tail.load(std::memory_order_acquire)) < needed) {
+		if (!s_running.load(std::memory_order_relaxed)) {
+			return;
+		}
+		s_writer_wake.notify_one();
+		std::this_thread::yield();
+	}
+
+	record_header header;
+	if (contiguous < size) {
+		header = record_header{ (unsigned int)contiguous, PADDING_FILTER, 0, 0 };
+		memcpy(ring->m_data + position, &header, sizeof(header));
+		head += contiguous;
+	}
+	unsigned char* at = ring->m_data + (head & (LOG_RING_SIZE - 1));
+	header = record_header{ (unsigned int)size, (unsigned short)filter, (unsigned short)length, _get_ticks() };
+	memcpy(at, &header, sizeof(header));
+	memcpy(at + sizeof(header), text, length);
+	ring->m_head.store(head + size, std::memory_order_release);
+
+	if (head + size - ring->m_tail.load(std::memory_order_relaxed) > LOG_RING_SIZE / 2) {
+		s_writer_wake.notify_one();
+	}
+}
+
+static void _log_v(log_filter_id filter, const char* format, va_list args)
+{
+	if (!s_running.load(std::memory_order_acquire) || !IsLogFilterEnabled(filter)) {
+		return;
+	}
+	// a thread already past its thread_local destructors has no ring, its messages are dropped
+	log_ring* ring = _get_ring();
+	if (ring == nullptr) {
+		return;
+	}
+	char text[MAX_LOG_MESSAGE];
+	const int length = vsnprintf(text, sizeof(text), format, args);
+	if (length < 0) {
+		return;
+	}
+	_push(ring, filter, text, std::min((size_t)length, sizeof(text) - 1));
+}
+
+void AsyncLog(log_filter_id filter, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	_log_v(filter, format, args);
+	va_end(args);
+}
+
+void AsyncLog(const char* filter, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	_log_v(GetLogFilterId(filter), format, args);
+	va_end(args);
+}
+
+////////////////////////////////
+static void _run_writer()
+{
+	std::vector<pending_message> batch;
+	std::vector<std::pair<log_ring*, size_t>> drained; // ring, its new tail
+	std::string out;
+	trace_set_thread_name("log writer");
+	for (;;) {
+		// everything pushed before this flush request was made is visible to the drain below
+		const size_t flush_ticket = s_flush_requested.load(std::memory_order_acquire);
+		const bool quit = s_quit.load(std::memory_order_acquire);
+
+		batch.clear();
+		drained.clear();
+		for (log_ring* ring = s_rings.load(std::memory_order_acquire); ring != nullptr; ring = ring->m_next) {
+			size_t tail = ring->m_tail.load(std::memory_order_relaxed);
+			const size_t head = ring->m_head.load(std::memory_order_acquire);
+			if (tail == head) {
+				continue;
+			}
+			while (tail != head) {
+				const unsigned char* at = ring->m_data + (tail & (LOG_RING_SIZE - 1));
+				record_header header;
+				memcpy(&header, at, sizeof(header));
+				if (header.m_filter != PADDING_FILTER) {
+					batch.push_back(pending_message{ header.m_ticks, header.m_filter, header.m_length, (const char*)at + sizeof(header) });
+				}
+				tail += header.m_size;
+			}
+			drained.emplace_back(ring, tail);
+		}
+
+		if (!batch.empty()) {
+			TRACE_SCOPE("AsyncLog write batch");
+			std::stable_sort(batch.begin(), batch.end(), [](const pending_message& a, const pending_message& b) { return a.m_ticks < b.m_ticks; });
+			out.clear();
+			// an id is interned before the message using it is pushed, so its name is set
+			char prefix[MAX_LOG_MESSAGE];
+			for (const pending_message& each : batch) {
+				const double seconds = (double)(each.m_ticks - s_start_ticks) * std::chrono::steady_clock::period::num / std::chrono::steady_clock::period::den;
+				const int length = snprintf(prefix, sizeof(prefix), "%10.4f [%s] ", seconds, s_filter_names[each.m_filter]);
+				out.append(prefix, std::min((size_t)std::max(length, 0), sizeof(prefix) - 1));
+				out.append(each.m_text, each.m_length);
+				out += '\n';
+				s_written[each.m_filter].fetch_add(1, std::memory_order_relaxed);
+			}
+			if (s_file != nullptr) {
+				fwrite(out.data(), 1, out.size(), s_file);
+			}
+		}
+		// the records are copied out, the producers may have the space back
+		for (auto& [ring, tail] : drained) {
+			ring->m_tail.store(tail, std::memory_order_release);
+		}
+
+		if (flush_ticket != s_flush_done.load(std::memory_order_relaxed)) {
+			if (s_file != nullptr) {
+				fflush(s_file);
+			}
+			{
+				std::lock_guard<std::mutex> lock(s_writer_lock);
+				s_flush_done.store(flush_ticket, std::memory_order_release);
+			}
+			s_flushed.notify_all();
+		}
+		if (quit && batch.empty()) {
+			break;
+		}
+		if (batch.empty()) {
+			std::unique_lock<std::mutex> lock(s_writer_lock);
+			s_writer_wake.wait_for(lock, WRITER_IDLE, [] {
+				return s_quit.load() || s_flush_requested.load() != s_flush_done.load();
+			});
+		}
+	}
+}
+
+void AsyncLogStart(const char* path)
+{
+	if (s_running.load()) {
+		return;
+	}
+	s_file = std::fopen(path, "wb");
+	s_start_ticks = _get_ticks();
+	s_quit.store(false);
+	s_running.store(true);
+	s_writer = std::thread(_run_writer);
+}
+
+void AsyncLogStop()
+{
+	if (!s_running.load()) {
+		return;
+	}
+	s_running.store(false);
+	{
+		std::lock_guard<std::mutex> lock(s_writer_lock);
+		s_quit.store(true);
+	}
+	s_writer_wake.notify_one();
+	s_flushed.notify_all();
+	s_writer.join();
+	if (s_file != nullptr) {
+		fclose(s_file);
+		s_file = nullptr;
+	}
+}
+
+void AsyncLogFlush()
+{
+	if (!s_running.load()) {
+		return;
+	}
+	std::unique_lock<std::mutex> lock(s_writer_lock);
+	const size_t ticket = s_flush_requested.fetch_add(1) + 1;
+	s_writer_wake.notify_one();
+	s_flushed.wait(lock, [ticket] { return s_flush_done.load() >= ticket || s_quit.load(); });
+}
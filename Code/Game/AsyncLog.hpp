@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Log pipeline for hot threads. The caller formats into its own thread's ring buffer, one
+// producer and one consumer so no locks, and a writer thread drains every ring in batches into
+// the log file. Filters are interned into small ids and checked against an atomic bitmask, a
+// string filter costs one hash and one compare on top of that.
+// Messages are written in timestamp order within a batch. Nothing is dropped while the log is
+// running: a caller whose ring is full waits for the writer. Before AsyncLogStart and after
+// AsyncLogStop messages are dropped
+
+using log_filter_id = unsigned int;
+constexpr log_filter_id MAX_LOG_FILTERS = 256;
+constexpr size_t MAX_LOG_MESSAGE = 1024; // longer ones are cut
+constexpr size_t LOG_RING_SIZE = 64 * 1024; // per thread
+
+void AsyncLogStart(const char* path);
+// writes everything still queued first
+void AsyncLogStop();
+
+// the same id for the same name for the life of the process
+log_filter_id GetLogFilterId(const char* filter);
+const char* GetLogFilterName(log_filter_id id);
+
+void AsyncLog(log_filter_id filter, const char* format, ...);
+void AsyncLog(const char* filter, const char* format, ...);
+// returns once every message logged before the call, by any thread that synchronized with this
+// one, is in the file
+void AsyncLogFlush();
+
+bool IsLogFilterEnabled(log_filter_id filter);
+void AsyncLogFilterEnable(const std::string& filter);
+void AsyncLogFilterDisable(const std::string& filter);
+// also what filters seen for the first time start as
+void AsyncLogFilterEnableAll();
+void AsyncLogFilterDisableAll();
+
+// messages of a filter written so far
+size_t GetNumLogMessagesWritten(log_filter_id filter);
@@ -6,13 +6,31 @@
 //////////////////////////////////////////////////////////////////////////
 Entity::Entity(Game *theGame)
 	:m_theGame(theGame)
+	,m_ownsEntity(true)
 {
+	m_id = GetStore().Create(Vec2::ZERO);
+}
+
+Entity::Entity(Game *theGame, EntityId id)
+	:m_theGame(theGame)
+	,m_id(id)
+{
+}
+
+Entity::~Entity()
+{
+	// the store collects it with the rest of the frame's garbage
+	if (m_ownsEntity) {
+		MarkGarbage();
+	}
 }
 
 void Entity::Update(float deltaSeconds)
 {
-	m_velocity += m_acceleration * deltaSeconds;
-	m_position += m_velocity * deltaSeconds;
+	const size_t slot = GetSlot();
+	if (slot != EntityStore::INVALID_SLOT) {
+		GetStore().UpdateSlot(slot, deltaSeconds);
+	}
 }
 
 void Entity::Render() const
@@ -21,51 +39,162 @@ void Entity::Render() const
 	//_game->getRenderer()->DrawVertexArray(_numVert, _vert);
 }
 
+EntityStore& Entity::GetStore() const
+{
+	return m_theGame->GetEntityStore();
+}
+
+size_t Entity::GetSlot() const
+{
+	if (m_theGame == nullptr) {
+		return EntityStore::INVALID_SLOT;
+	}
+	return GetStore().GetSlot(m_id);
+}
+
+bool Entity::IsDead() const
+{
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return true;
+	}
+	return (GetStore().m_flags[slot] & EntityStore::FLAG_DEAD) != 0;
+}
+
+bool Entity::IsGarbage() const
+{
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return true;
+	}
+	return (GetStore().m_flags[slot] & EntityStore::FLAG_GARBAGE) != 0;
+}
+
 bool Entity::IsOffScreen() const
 {
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return true;
+	}
 	float screenW, screenH;
 	m_theGame->GetScreenSize(&screenW, &screenH);
-	
-	return
-		FloatGt(m_position.x, m_radiusCosmetic + screenW)
-		|| FloatGt(m_position.y, m_radiusCosmetic + screenH)
-		|| FloatLt(m_position.x, -m_radiusCosmetic)
-		|| FloatLt(m_position.y, -m_radiusCosmetic);//not exactly
+	return GetStore().IsOffScreen(slot, screenW, screenH);
+}
+
+Vec2 Entity::GetPosition() const
+{
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return Vec2::ZERO;
+	}
+	return Vec2(GetStore().m_positionX[slot], GetStore().m_positionY[slot]);
+}
+
+float Entity::GetRadiusPhysics() const
+{
+	const size_t slot = GetSlot();
+	return slot == EntityStore::INVALID_SLOT ? 0.f : GetStore().m_radiusPhysics[slot];
+}
+
+float Entity::GetRadiusCosmetic() const
+{
+	const size_t slot = GetSlot();
+	return slot == EntityStore::INVALID_SLOT ? 0.f : GetStore().m_radiusCosmetic[slot];
+}
+
+const Vec2 Entity::GetVelocity() const
+{
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return Vec2::ZERO;
+	}
+	return Vec2(GetStore().m_velocityX[slot], GetStore().m_velocityY[slot]);
+}
 
+const Vec2 Entity::GetAcceleration() const
+{
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return Vec2::ZERO;
+	}
+	return Vec2(GetStore().m_accelerationX[slot], GetStore().m_accelerationY[slot]);
+}
+
+float Entity::GetOrientationDegrees() const
+{
+	const size_t slot = GetSlot();
+	return slot == EntityStore::INVALID_SLOT ? 0.f : GetStore().m_orientationDegrees[slot];
+}
+
+float Entity::GetAngularVelocity() const
+{
+	const size_t slot = GetSlot();
+	return slot == EntityStore::INVALID_SLOT ? 0.f : GetStore().m_angularVelocity[slot];
+}
+
+float Entity::GetAngularAcceleration() const
+{
+	const size_t slot = GetSlot();
+	return slot == EntityStore::INVALID_SLOT ? 0.f : GetStore().m_angularAcceleration[slot];
 }
 
 void Entity::MarkGarbage()
 {
-	m_flagGarbage = true;
-	m_flagDead = true;
+	if (m_theGame != nullptr) {
+		GetStore().MarkGarbage(m_id);
+	}
 }
 
 void Entity::SetPosition(const Vec2 &position)
 {
-	m_position = position;
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return;
+	}
+	GetStore().m_positionX[slot] = position.x;
+	GetStore().m_positionY[slot] = position.y;
 }
 
 void Entity::SetVelocity(const Vec2 &velocity)
 {
-	m_velocity = velocity;
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return;
+	}
+	GetStore().m_velocityX[slot] = velocity.x;
+	GetStore().m_velocityY[slot] = velocity.y;
 }
 
 void Entity::SetAcceleration(const Vec2 &acceleraion)
 {
-	m_acceleration = acceleraion;
+	const size_t slot = GetSlot();
+	if (slot == EntityStore::INVALID_SLOT) {
+		return;
+	}
+	GetStore().m_accelerationX[slot] = acceleraion.x;
+	GetStore().m_accelerationY[slot] = acceleraion.y;
 }
 
 void Entity::SetOrientationDegrees(float orientationDegrees)
 {
-	m_orientationDegrees = orientationDegrees;
+	const size_t slot = GetSlot();
+	if (slot != EntityStore::INVALID_SLOT) {
+		GetStore().m_orientationDegrees[slot] = orientationDegrees;
+	}
 }
 
 void Entity::SetAngularVelocity(float angularVelocity)
 {
-	m_angularVelocity = angularVelocity;
+	const size_t slot = GetSlot();
+	if (slot != EntityStore::INVALID_SLOT) {
+		GetStore().m_angularVelocity[slot] = angularVelocity;
+	}
 }
 
 void Entity::SetAngularAcceleration(float angularAcceleration)
 {
-	m_angularAcceleration = angularAcceleration;
+	const size_t slot = GetSlot();
+	if (slot != EntityStore::INVALID_SLOT) {
+		GetStore().m_angularAcceleration[slot] = angularAcceleration;
+	}
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "Game/GameCommon.hpp"
+#include "Game/EntityStore.hpp"
 #include "Engine/Core/Vertex_PCU.hpp"
 
 class Game;
@@ -12,26 +13,38 @@ enum EntityTypes
 	NumEntityTypes
 };
 
+//////////////////////////////////////////////////////////////////////////
+// Thin handle to an entity living in the game's EntityStore.
+// The store integrates every entity in bulk; Update here only steps this one.
+// A default constructed Entity is not attached to any store and counts as dead.
+// Entity(theGame) creates the entity and marks it garbage again when the handle is deleted;
+// Entity(theGame, id) only looks at one the store already has. Once the entity is collected
+// the getters return zeros and the setters do nothing
 class Entity
 {
 public:
 	Entity() = default;
 	Entity(Game *theGame);
+	Entity(Game *theGame, EntityId id);
+	Entity(const Entity&) = delete;
+	Entity& operator=(const Entity&) = delete;
+	virtual ~Entity();
 
 	virtual void Update(float deltaSeconds);
 	virtual void Render() const;
 
-	bool IsDead() const { return m_flagDead; }
-	bool IsGarbage() const { return m_flagGarbage; }
+	EntityId GetId() const { return m_id; }
+	bool IsDead() const;
+	bool IsGarbage() const;
 	bool IsOffScreen() const;
-	Vec2 GetPosition() const { return m_position; }
-	float GetRadiusPhysics() const { return m_radiusPhysics; }
-	float GetRadiusCosmetic() const { return m_radiusCosmetic; }
-	const Vec2 GetVelocity() const { return m_velocity; }
-	const Vec2 GetAcceleration() const { return m_acceleration; }
-	float GetOrientationDegrees() const { return m_orientationDegrees; }
-	float GetAngularVelocity() const { return m_angularVelocity; }
-	float GetAngularAcceleration() const { return m_angularAcceleration; }
+	Vec2 GetPosition() const;
+	float GetRadiusPhysics() const;
+	float GetRadiusCosmetic() const;
+	const Vec2 GetVelocity() const;
+	const Vec2 GetAcceleration() const;
+	float GetOrientationDegrees() const;
+	float GetAngularVelocity() const;
+	float GetAngularAcceleration() const;
 
 	void MarkGarbage();
 
@@ -43,18 +56,12 @@ public:
 	void SetAngularAcceleration(float angularAcceleration);
 
 protected:
-	Game * m_theGame = nullptr;
-
-	Vec2 m_position;
-	Vec2 m_velocity;
-	Vec2 m_acceleration;
-	float m_orientationDegrees = 0.f;
-	float m_angularVelocity = 0.f;
-	float m_angularAcceleration = 0.f;
-
-	float m_radiusPhysics = 0.f;
-	float m_radiusCosmetic = 0.f;
+	EntityStore& GetStore() const;
+	// EntityStore::INVALID_SLOT when detached or collected
+	size_t GetSlot() const;
 
-	bool m_flagDead = false;
-	bool m_flagGarbage = false;
-};
\ No newline at end of file
+protected:
+	Game * m_theGame = nullptr;
+	EntityId m_id;
+	bool m_ownsEntity = false;
+};
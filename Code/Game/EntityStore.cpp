@@ -0,0 +1,225 @@
+#include "Game/EntityStore.hpp"
+#include "Game/TraceCapture.hpp"
+#include "Game/TaskScheduler.hpp"
+#include <algorithm>
+#include <xmmintrin.h>
+
+//////////////////////////////////////////////////////////////////////////
+EntityId EntityStore::Create(const Vec2& position, float radiusPhysics, float radiusCosmetic)
+{
+	EntityId id;
+	if (m_freeIds.empty()) {
+		id.m_index = (unsigned int)m_slotOfId.size();
+		m_slotOfId.push_back(0);
+		m_generationOfId.push_back(0);
+	} else {
+		id.m_index = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	id.m_generation = m_generationOfId[id.m_index];
+	m_slotOfId[id.m_index] = (unsigned int)m_positionX.size();
+	m_idOfSlot.push_back(id.m_index);
+
+	m_positionX.push_back(position.x);
+	m_positionY.push_back(position.y);
+	m_velocityX.push_back(0.f);
+	m_velocityY.push_back(0.f);
+	m_accelerationX.push_back(0.f);
+	m_accelerationY.push_back(0.f);
+	m_orientationDegrees.push_back(0.f);
+	m_angularVelocity.push_back(0.f);
+	m_angularAcceleration.push_back(0.f);
+	m_radiusPhysics.push_back(radiusPhysics);
+	m_radiusCosmetic.push_back(radiusCosmetic);
+	m_flags.push_back(0);
+	return id;
+}
+
+bool EntityStore::IsAlive(EntityId id) const
+{
+	return id.IsValid() && id.m_index < m_generationOfId.size() && m_generationOfId[id.m_index] == id.m_generation;
+}
+
+void EntityStore::MarkGarbage(EntityId id)
+{
+	if (!IsAlive(id)) {
+		return;
+	}
+	unsigned char& flags = m_flags[GetSlot(id)];
+	if (!(flags & FLAG_GARBAGE)) {
+		++m_numGarbage;
+	}
+	flags |= FLAG_DEAD | FLAG_GARBAGE;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void EntityStore::Update(float deltaSeconds, size_t numThreads)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	const size_t count = GetCount();
+	numThreads = std::max((size_t)1, std::min(numThreads, count / PARALLEL_MIN_ENTITIES));
+	if (numThreads == 1) {
+		_IntegrateRange(0, count, deltaSeconds);
+		return;
+	}
+	// split in blocks of 4 so only the last chunk has a scalar tail
+	const size_t numBlocks = (count + 3) / 4;
+	const size_t grain = std::max(PARALLEL_MIN_ENTITIES / 16, numBlocks / (numThreads * TaskScheduler::CHUNKS_PER_THREAD));
+	parallel_for(0, numBlocks, grain, [this, count, deltaSeconds](size_t begin, size_t end) {
+		_IntegrateRange(begin * 4, std::min(end * 4, count), deltaSeconds);
+	});
+}
+
+void EntityStore::UpdateScalar(float deltaSeconds)
+{
+	for (size_t slot = 0; slot < GetCount(); ++slot) {
+		UpdateSlot(slot, deltaSeconds);
+	}
+}
+
+void EntityStore::UpdateSlot(size_t slot, float deltaSeconds)
+{
+	m_velocityX[slot] += m_accelerationX[slot] * deltaSeconds;
+	m_velocityY[slot] += m_accelerationY[slot] * deltaSeconds;
+	m_positionX[slot] += m_velocityX[slot] * deltaSeconds;
+	m_positionY[slot] += m_velocityY[slot] * deltaSeconds;
+	m_angularVelocity[slot] += m_angularAcceleration[slot] * deltaSeconds;
+	m_orientationDegrees[slot] += m_angularVelocity[slot] * deltaSeconds;
+}
+
+void EntityStore::GetMoves(float deltaSeconds, std::vector<disc_move>& moves) const
+{
+	moves.resize(GetCount());
+	for (size_t slot = 0; slot < GetCount(); ++slot) {
+		disc_move& move = moves[slot];
+		move.m_start = Vec2(m_positionX[slot], m_positionY[slot]);
+		move.m_move = Vec2(m_velocityX[slot] + m_accelerationX[slot] * deltaSeconds,
+			m_velocityY[slot] + m_accelerationY[slot] * deltaSeconds) * deltaSeconds;
+		move.m_radius = m_radiusPhysics[slot];
+	}
+}
+
+void EntityStore::_IntegrateRange(size_t begin, size_t end, float deltaSeconds)
+{
+	TRACE_SCOPE(__FUNCTION__);
+	float* posX = m_positionX.data();
+	float* posY = m_positionY.data();
+	float* velX = m_velocityX.data();
+	float* velY = m_velocityY.data();
+	const float* accX = m_accelerationX.data();
+	const float* accY = m_accelerationY.data();
+	float* orientation = m_orientationDegrees.data();
+	float* angularVel = m_angularVelocity.data();
+	const float* angularAcc = m_angularAcceleration.data();
+
+	const __m128 dt = _mm_set1_ps(deltaSeconds);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		const __m128 vx = _mm_add_ps(_mm_loadu_ps(velX + i), _mm_mul_ps(_mm_loadu_ps(accX + i), dt));
+		const __m128 vy = _mm_add_ps(_mm_loadu_ps(velY + i), _mm_mul_ps(_mm_loadu_ps(accY + i), dt));
+		const __m128 av = _mm_add_ps(_mm_loadu_ps(angularVel + i), _mm_mul_ps(_mm_loadu_ps(angularAcc + i), dt));
+		_mm_storeu_ps(velX + i, vx);
+		_mm_storeu_ps(velY + i, vy);
+		_mm_storeu_ps(angularVel + i, av);
+		_mm_storeu_ps(posX + i, _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(vx, dt)));
+		_mm_storeu_ps(posY + i, _mm_add_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(vy, dt)));
+		_mm_storeu_ps(orientation + i, _mm_add_ps(_mm_loadu_ps(orientation + i), _mm_mul_ps(av, dt)));
+	}
+	for (; i < end; ++i) {
+		UpdateSlot(i, deltaSeconds);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool EntityStore::IsOffScreen(size_t slot, float screenWidth, float screenHeight) const
+{
+	const float r = m_radiusCosmetic[slot];
+	return m_positionX[slot] > r + screenWidth || m_positionY[slot] > r + screenHeight
+		|| m_positionX[slot] < -r || m_positionY[slot] < -r;
+}
+
+size_t EntityStore::MarkOffScreenGarbage(float screenWidth, float screenHeight)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	const size_t count = GetCount();
+	const __m128 width = _mm_set1_ps(screenWidth);
+	const __m128 height = _mm_set1_ps(screenHeight);
+	const __m128 zero = _mm_setzero_ps();
+	size_t numMarked = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 r = _mm_loadu_ps(m_radiusCosmetic.data() + i);
+		const __m128 x = _mm_loadu_ps(m_positionX.data() + i);
+		const __m128 y = _mm_loadu_ps(m_positionY.data() + i);
+		const __m128 negR = _mm_sub_ps(zero, r);
+		const __m128 off = _mm_or_ps(
+			_mm_or_ps(_mm_cmpgt_ps(x, _mm_add_ps(r, width)), _mm_cmpgt_ps(y, _mm_add_ps(r, height))),
+			_mm_or_ps(_mm_cmplt_ps(x, negR), _mm_cmplt_ps(y, negR)));
+		const int mask = _mm_movemask_ps(off);
+		if (mask == 0) {
+			continue;
+		}
+		for (int k = 0; k < 4; ++k) {
+			if ((mask & (1 << k)) && !(m_flags[i + k] & FLAG_GARBAGE)) {
+				m_flags[i + k] |= FLAG_DEAD | FLAG_GARBAGE;
+				++numMarked;
+			}
+		}
+	}
+	for (; i < count; ++i) {
+		if (!(m_flags[i] & FLAG_GARBAGE) && IsOffScreen(i, screenWidth, screenHeight)) {
+			m_flags[i] |= FLAG_DEAD | FLAG_GARBAGE;
+			++numMarked;
+		}
+	}
+	m_numGarbage += numMarked;
+	return numMarked;
+}
+
+size_t EntityStore::CollectGarbage()
+{
+	if (m_numGarbage == 0) {
+		return 0;
+	}
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	std::vector<float>* columns[] = {
+		&m_positionX, &m_positionY, &m_velocityX, &m_velocityY, &m_accelerationX, &m_accelerationY,
+		&m_orientationDegrees, &m_angularVelocity, &m_angularAcceleration, &m_radiusPhysics, &m_radiusCosmetic,
+	};
+	EventDispatcher* events = g_theEvents != nullptr && g_theEvents->has_subscribers(ENTITY_COLLECTED_EVENT) ? g_theEvents : nullptr;
+	size_t count = GetCount();
+	size_t slot = 0;
+	while (slot < count) {
+		if (!(m_flags[slot] & FLAG_GARBAGE)) {
+			++slot;
+			continue;
+		}
+		const unsigned int deadId = m_idOfSlot[slot];
+		if (events != nullptr) {
+			EntityCollectedEvent collected;
+			collected.m_id.m_index = deadId;
+			collected.m_id.m_generation = m_generationOfId[deadId];
+			collected.m_position = Vec2(m_positionX[slot], m_positionY[slot]);
+			events->trigger(ENTITY_COLLECTED_EVENT, collected);
+		}
+		++m_generationOfId[deadId];
+		m_freeIds.push_back(deadId);
+		--count;
+		if (slot != count) {
+			for (std::vector<float>* column : columns) {
+				(*column)[slot] = (*column)[count];
+			}
+			m_flags[slot] = m_flags[count];
+			m_idOfSlot[slot] = m_idOfSlot[count];
+			m_slotOfId[m_idOfSlot[slot]] = (unsigned int)slot;
+		}
+	}
+	const size_t numRemoved = GetCount() - count;
+	for (std::vector<float>* column : columns) {
+		column->resize(count);
+	}
+	m_flags.resize(count);
+	m_idOfSlot.resize(count);
+	m_numGarbage = 0;
+	return numRemoved;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "Game/GameCommon.hpp"
+#include "Engine/Math/Vec2.hpp"
+#include "Game/ZoneGeometry.hpp"
+#include "Game/GameEvents.hpp"
+#include <vector>
+
+struct EntityId
+{
+	static constexpr unsigned int INVALID_INDEX = 0xFFFFFFFFu;
+	unsigned int m_index = INVALID_INDEX;
+	unsigned int m_generation = 0;
+
+	bool IsValid() const { return m_index != INVALID_INDEX; }
+};
+
+// sent through g_theEvents by CollectGarbage for every entity it removes, mid compaction, so
+// handlers must not touch the store
+constexpr event_id ENTITY_COLLECTED_EVENT = EVENT_ID("entity-collected");
+struct EntityCollectedEvent
+{
+	EntityId m_id;
+	Vec2 m_position;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Structure-of-arrays storage for moving entities, integrated four at a time with SSE.
+// Slots stay dense: collecting garbage moves the last entity into the freed slot,
+// so outside code holds an EntityId and goes through the id -> slot table.
+class EntityStore
+{
+public:
+	static constexpr unsigned char FLAG_DEAD = 1u;
+	static constexpr unsigned char FLAG_GARBAGE = 2u;
+	// below this many entities per thread the split costs more than it saves
+	static constexpr size_t PARALLEL_MIN_ENTITIES = 16 * 1024;
+	static constexpr size_t INVALID_SLOT = ~(size_t)0;
+public:
+	EntityId Create(const Vec2& position, float radiusPhysics = 0.f, float radiusCosmetic = 0.f);
+	bool IsAlive(EntityId id) const;
+	// INVALID_SLOT for an id that was never created or is already collected
+	size_t GetSlot(EntityId id) const { return IsAlive(id) ? m_slotOfId[id.m_index] : INVALID_SLOT; }
+	size_t GetCount() const { return m_positionX.size(); }
+	// does nothing for an id that is not alive
+	void MarkGarbage(EntityId id);
+
+	void Update(float deltaSeconds, size_t numThreads = 1);
+	void UpdateScalar(float deltaSeconds);
+	void UpdateSlot(size_t slot, float deltaSeconds);
+	bool IsOffScreen(size_t slot, float screenWidth, float screenHeight) const;
+	// IsOffScreen for every entity in one pass, off screen ones become garbage
+	size_t MarkOffScreenGarbage(float screenWidth, float screenHeight);
+	// the move Update would make this frame, as a disc of the physics radius per slot
+	void GetMoves(float deltaSeconds, std::vector<disc_move>& moves) const;
+	// compacts every garbage entity away in one pass, returns how many were removed.
+	// Sends ENTITY_COLLECTED_EVENT for each when anything listens
+	size_t CollectGarbage();
+
+public:
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_velocityX;
+	std::vector<float> m_velocityY;
+	std::vector<float> m_accelerationX;
+	std::vector<float> m_accelerationY;
+	std::vector<float> m_orientationDegrees;
+	std::vector<float> m_angularVelocity;
+	std::vector<float> m_angularAcceleration;
+	std::vector<float> m_radiusPhysics;
+	std::vector<float> m_radiusCosmetic;
+	std::vector<unsigned char> m_flags;
+	std::vector<unsigned int> m_idOfSlot;
+
+private:
+	void _IntegrateRange(size_t begin, size_t end, float deltaSeconds);
+
+private:
+	std::vector<unsigned int> m_slotOfId;
+	std::vector<unsigned int> m_generationOfId;
+	std::vector<unsigned int> m_freeIds;
+	size_t m_numGarbage = 0;
+};
@@ -0,0 +1,72 @@
+#include "Game/GameTest.hpp"
+#include "Game/EntityStore.hpp"
+#include <cmath>
+
+GAME_TEST(entityStoreSimdMatchesScalar, "entity", 5)
+{
+	// 4k + 3 so the SIMD path also runs its scalar tail
+	EntityStore simd;
+	EntityStore scalar;
+	for (int i = 0; i < 4099; ++i) {
+		const float f = (float)i;
+		for (EntityStore* store : {&simd, &scalar}) {
+			store->Create(Vec2(f * 0.01f, -f * 0.02f), 0.1f, 0.1f);
+			store->m_velocityX.back() = std::sin(f);
+			store->m_accelerationY.back() = std::cos(f);
+			store->m_angularAcceleration.back() = f * 0.5f;
+		}
+	}
+	for (int frame = 0; frame < 10; ++frame) {
+		simd.Update(1.f / 60.f, 1);
+		scalar.UpdateScalar(1.f / 60.f);
+	}
+	for (size_t i = 0; i < simd.GetCount(); ++i) {
+		if (std::fabs(simd.m_positionX[i] - scalar.m_positionX[i]) > 1e-5f
+			|| std::fabs(simd.m_positionY[i] - scalar.m_positionY[i]) > 1e-5f
+			|| std::fabs(simd.m_orientationDegrees[i] - scalar.m_orientationDegrees[i]) > 1e-3f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+GAME_TEST(entityStoreGarbageKeepsIds, "entity", 5)
+{
+	EntityStore store;
+	std::vector<EntityId> ids;
+	for (int i = 0; i < 100; ++i) {
+		ids.push_back(store.Create(Vec2((float)i, 0.f)));
+	}
+	// everything past x = 49 is off a 50 wide screen
+	if (store.MarkOffScreenGarbage(49.f, 10.f) != 50 || store.CollectGarbage() != 50) {
+		return false;
+	}
+	for (int i = 0; i < 100; ++i) {
+		const bool alive = store.IsAlive(ids[i]);
+		if (alive != (i < 50)) {
+			return false;
+		}
+		if (alive && store.m_positionX[store.GetSlot(ids[i])] != (float)i) {
+			return false;
+		}
+	}
+	// a recycled index must not revive an old id
+	const EntityId fresh = store.Create(Vec2::ZERO);
+	return store.IsAlive(fresh) && !store.IsAlive(ids[99]) && store.GetCount() == 51;
+}
+
+GAME_TEST(entityStoreIgnoresStaleIds, "entity", 5)
+{
+	EntityStore store;
+	const EntityId id = store.Create(Vec2::ZERO);
+	const EntityId other = store.Create(Vec2::ZERO);
+	store.MarkGarbage(id);
+	store.CollectGarbage();
+	// marking a collected id again must not count it as fresh garbage
+	store.MarkGarbage(id);
+	store.MarkGarbage(EntityId());
+	return store.GetSlot(id) == EntityStore::INVALID_SLOT
+		&& store.GetSlot(EntityId()) == EntityStore::INVALID_SLOT
+		&& store.GetSlot(other) == 0
+		&& store.CollectGarbage() == 0 && store.GetCount() == 1;
+}
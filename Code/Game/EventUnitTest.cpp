@@ -0,0 +1,64 @@
+#include "Game/GameTest.hpp"
+#include "Game/GameEvents.hpp"
+#include "Game/EntityStore.hpp"
+#include <vector>
+
+static_assert(EVENT_ID("entity-collected") == get_event_id(std::string_view("entity-collected")), "hashed at compile time");
+static_assert(EVENT_ID("a") != EVENT_ID("b"), "distinct names");
+
+namespace {
+struct event_recorder
+{
+	std::vector<int> m_calls;
+	void on_collected(const EntityCollectedEvent& payload) { m_calls.push_back(100 + (int)payload.m_id.m_index); }
+};
+}
+
+static void _record_int(void* user, const int& payload)
+{
+	((event_recorder*)user)->m_calls.push_back(payload);
+}
+
+static void _record_and_unsubscribe(void* user, const int& payload)
+{
+	((event_recorder*)user)->m_calls.push_back(-payload);
+	g_theEvents->unsubscribe<int>(EVENT_ID("test-int"), _record_int, user);
+	g_theEvents->subscribe<int>(EVENT_ID("test-int"), _record_int, user);
+}
+
+GAME_TEST(eventsTypedDispatch, "events", 1)
+{
+	EventDispatcher events;
+	event_recorder recorder;
+	events.subscribe<int>(EVENT_ID("test-int"), _record_int, &recorder);
+	events.subscribe<&event_recorder::on_collected>(EVENT_ID("test-int"), &recorder);
+	events.subscribe<int>(EVENT_ID("test-other"), _record_int, &recorder);
+	// only the subscribers of the id taking that payload
+	EntityCollectedEvent collected;
+	collected.m_id.m_index = 5;
+	if (events.trigger(EVENT_ID("test-int"), 7) != 1 || events.trigger(get_event_id("test-int"), collected) != 1
+		|| events.trigger(EVENT_ID("test-none"), 1) != 0) {
+		return false;
+	}
+	events.unsubscribe<&event_recorder::on_collected>(EVENT_ID("test-int"), &recorder);
+	events.trigger(EVENT_ID("test-int"), collected);
+	events.unsubscribe_all(&recorder);
+	events.trigger(EVENT_ID("test-int"), 9);
+	return recorder.m_calls == std::vector<int>{7, 105} && events.get_num_subscribers() == 0;
+}
+
+GAME_TEST_SERIAL(eventsSubscribeWhileTriggering, "events", 1)
+{
+	EventDispatcher* saved = g_theEvents;
+	EventDispatcher events;
+	g_theEvents = &events;
+	event_recorder recorder;
+	events.subscribe<int>(EVENT_ID("test-int"), _record_and_unsubscribe, &recorder);
+	events.subscribe<int>(EVENT_ID("test-int"), _record_int, &recorder);
+	// the handler drops the second subscriber before it runs and adds it back for the next trigger
+	events.trigger(EVENT_ID("test-int"), 1);
+	events.unsubscribe<int>(EVENT_ID("test-int"), _record_and_unsubscribe, &recorder);
+	events.trigger(EVENT_ID("test-int"), 2);
+	g_theEvents = saved;
+	return recorder.m_calls == std::vector<int>{-1, 2} && events.get_num_subscribers() == 1;
+}
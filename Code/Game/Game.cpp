@@ -21,9 +21,16 @@
 #include "Engine/Renderer/GPUMesh.hpp"
 #include "Engine/Renderer/Shader.hpp"
 #include "Game/Entity.hpp"
+#include "Game/RVSBenchmark.hpp"
 #include "Engine/Develop/Log.hpp"
+#include "Game/AsyncLog.hpp"
 #include "Engine/UI/UISystem.hpp"
 #include "Engine/Develop/Profile.hpp"
+#include "Game/TraceCapture.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Game/GameEvents.hpp"
+#include "Game/GameTest.hpp"
+#include "Engine/Develop/UnitTest.hpp"
 #include "ThirdParty/imgui/imgui.h"
 //////////////////////////////////////////////////////////////////////////
 //Delete these globals
@@ -58,7 +65,7 @@ static int top = 0;
 static bool _alloc_cmd(NamedStrings& param)
 {
 	if (top < 10) {
-		sth[top] = new Entity();
+		sth[top] = new Entity(g_game);
 		++top;
 	}
 	return true;
@@ -72,9 +79,12 @@ static bool _free_cmd(NamedStrings& param)
 	return true;
 }
 #include "Engine/Develop/Memory.hpp"
+#include "Game/MonotonicArena.hpp"
+#include "Game/ThreadCachedAlloc.hpp"
 static bool _logmem_cmd(NamedStrings& param)
 {
-	LogLiveAllocations();
+	log_live_allocations();
+	MonotonicArena::log_arenas();
 	return true;
 }
 
@@ -82,18 +92,20 @@ static bool _Log_cmd(NamedStrings& param)
 {
 	std::string filter = param.GetString("filter", "default");
 	std::string msg = param.GetString("msg", "nothing");
-	Log(filter.c_str(), msg.c_str());
+	AsyncLog(filter.c_str(), msg.c_str());
 	return true;
 }
 
 static bool _Log_Filter_EnableAll(NamedStrings& param)
 {
 	LogFilterEnableAll();
+	AsyncLogFilterEnableAll();
 	return true;
 }
 static bool _Log_Filter_DisableAll(NamedStrings& param)
 {
 	LogFilterDisableAll();
+	AsyncLogFilterDisableAll();
 	return true;
 }
 
@@ -103,16 +115,18 @@ static bool _Log_Filter_Enable(NamedStrings& param)
 	bool enable = param.GetBool("off", true);
 	if (enable) {
 		LogFilterEnable(filter);
+		AsyncLogFilterEnable(filter);
 	} else {
 		LogFilterDisable(filter);
+		AsyncLogFilterDisable(filter);
 	}
 	return true;
 }
 
 static bool _Log_Flush(NamedStrings& param)
 {
-	Log("debug", "This message was logged.");
-	LogFlush();
+	AsyncLog("debug", "This message was logged.");
+	AsyncLogFlush();
 
 	// put breakpoint here, open log file and make sure above line was written; 
 	int i = 0;
@@ -120,6 +134,46 @@ static bool _Log_Flush(NamedStrings& param)
 	return true;
 }
 
+static bool _Trace_cmd(NamedStrings& param)
+{
+	const int frames = param.GetInt("frames", 60);
+	const std::string path = param.GetString("path", "logs/trace.json");
+	if (!start_trace_capture(frames, path)) {
+		AsyncLog("Game", "trace: a capture is already running");
+		return false;
+	}
+	return true;
+}
+
+// event name=<event>: triggers the hashed event with the console arguments as its payload
+static bool _Event_cmd(NamedStrings& param)
+{
+	const std::string name = param.GetString("name", "");
+	if (name.empty() || g_theEvents == nullptr) {
+		return false;
+	}
+	const NamedStrings& args = param;
+	if (g_theEvents->trigger(get_event_id(name), args) == 0) {
+		AsyncLog("Game", "event: nothing takes console arguments for %s", name.c_str());
+	}
+	return true;
+}
+static bool _Run_Tests_cmd(NamedStrings& param)
+{
+	const std::string category = param.GetString("category", "");
+	const int level = param.GetInt("level", UNIT_TEST_LEVEL);
+	const int threads = param.GetInt("threads", 0);
+	const std::string json = param.GetString("json", "");
+	// the engine's own tests first, they are not in the game registry
+	::RunUnitTest(category.empty() ? ALL_UNIT_TEST : category.c_str(), level);
+	const game_test_run run = run_game_tests(category.c_str(), level, threads > 0 ? (size_t)threads : 0);
+	log_game_test_results(run);
+	if (!json.empty() && !write_game_test_results(json.c_str(), run)) {
+		AsyncLog("Game", "run_tests: cannot write %s", json.c_str());
+	}
+	return run.m_num_failed == 0;
+}
+
 static bool _Profile_Report(NamedStrings& param)
 {
 	int frameReveredN = param.GetInt("f", 0);
@@ -189,12 +243,16 @@ void Game::Startup()
 
 	g_Event->SubscribeEventCallback("report", _Profile_Report);
 	g_Event->SubscribeEventCallback("flat_report", _Profile_Report_Flat);
+	g_Event->SubscribeEventCallback("trace", _Trace_cmd);
+	g_Event->SubscribeEventCallback("event", _Event_cmd);
+	g_Event->SubscribeEventCallback("run_tests", _Run_Tests_cmd);
+	register_rvs_benchmarks();
 	
 
 	m_rvsGame = new RVSGame();
 	m_rvsGame->Startup(m_num_zone);
 	
-	Log("Game", "Game start");
+	AsyncLog("Game", "Game start");
 }
 
 void Game::BeginFrame()
@@ -228,6 +286,8 @@ void Game::Update(float deltaSeconds)
 	}
 
 	m_rvsGame->Update(deltaSeconds);
+	m_entityStore.Update(deltaSeconds, get_num_task_threads());
+	m_entityStore.CollectGarbage();
 	
 	UpdateUI();
 	
@@ -235,7 +295,7 @@ void Game::Update(float deltaSeconds)
 
 void Game::Render() const
 {
-	PROFILE_SCOPE(__FUNCTION__);
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
 
 	RenderTargetView* renderTarget = g_theRenderer->GetFrameColorTarget();
 	m_mainCamera->SetRenderTarget(renderTarget);
@@ -255,7 +315,8 @@ void Game::Render() const
 	g_theRenderer->BindConstantBuffer(CONSTANT_SLOT_FRAME, g_frameBuffer);
 	g_theRenderer->BindTextureViewWithSampler(0, nullptr);
 
-	m_rvsGame->Render();
+	const float pixel_size = (m_scene_ortho.Max.x - m_scene_ortho.Min.x) / (float)g_theWindow->GetClientResolution().x;
+	m_rvsGame->Render(m_scene_ortho, pixel_size);
 	
 	//ConstantBuffer* model = g_theRenderer->GetModelBuffer();
 	//g_theRenderer->BindConstantBuffer(CONSTANT_SLOT_MODEL, model);
@@ -272,7 +333,7 @@ void Game::UpdateUI()
 
 void Game::_RenderDebugInfo(bool afterRender) const
 {
-	PROFILE_SCOPE(__FUNCTION__);
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
 	if (afterRender) {
 		//g_theRenderer->BindShader()
 		DebugRenderer::Render(m_mainCamera);
@@ -289,10 +350,12 @@ void Game::EndFrame()
 	}
 	g_theRenderer->EndFrame();
 	g_theConsole->EndFrame();
+	m_rvsGame->EndFrame();
 }
 
 void Game::Shutdown()
 {
+	unregister_rvs_benchmarks();
 	m_rvsGame->Shutdown();
 	delete m_rvsGame;
 	g_theWindow->UnlockMouse();
@@ -376,15 +439,24 @@ void Game::DoKeyDown(unsigned char keyCode)
 		if (m_num_zone < 1) {
 			m_num_zone = 1;
 		}
+		m_rvsGame->Shutdown();
 		delete m_rvsGame;
 		m_rvsGame = new RVSGame();
 		m_rvsGame->Startup(m_num_zone);
 	} else if (keyCode == KEY_W) {
 		m_rvsGame->m_use_quad = !m_rvsGame->m_use_quad;
+	} else if (keyCode == 'V') {
+		m_rvsGame->m_show_visited_only = !m_rvsGame->m_show_visited_only;
+	} else if (keyCode == 'F') {
+		m_rvsGame->m_show_visibility = !m_rvsGame->m_show_visibility;
+	} else if (keyCode == 'A') {
+		m_rvsGame->set_animate(!m_rvsGame->m_animate);
 	} else if (keyCode == 'R') {
 		m_rvsGame->m_set_rotation = true;
 	} else if (keyCode == 'S') {
 		m_rvsGame->m_set_scale = true;
+	} else if (keyCode == 'C') {
+		m_rvsGame->snap_on();
 	}
 
 }
@@ -395,6 +467,8 @@ void Game::DoKeyRelease(unsigned char keyCode)
 		m_rvsGame->m_set_rotation = false;
 	} else if (keyCode == 'S') {
 		m_rvsGame->m_set_scale = false;
+	} else if (keyCode == 'C') {
+		m_rvsGame->snap_off();
 	}
 }
 
@@ -9,6 +9,7 @@
 #include "Engine/Core/Vertex_PCUNT.hpp"
 #include "Game/GameCommon.hpp"
 #include "Game/RVSGame.hpp"
+#include "Game/EntityStore.hpp"
 extern RenderContext* g_theRenderer;
 extern InputSystem* g_theInput;
 extern AudioSystem* g_theAudio;
@@ -44,6 +45,7 @@ public:
 	const AudioSystem* getAudioSystem() const { return g_theAudio; }
 	void ToScreenShot(const std::string& path) { m_shotPath = path; m_screenshot = true; }
 	RNG* getRNG() { return m_rng; }
+	EntityStore& GetEntityStore() { return m_entityStore; }
 	Vec2 get_mouse_in_world() const;
 	
 	//IO
@@ -80,6 +82,7 @@ private:
 	float ui_floatbuf = 0;
 
 
+	EntityStore m_entityStore;
 	RVSGame* m_rvsGame = nullptr;
 	bool m_report_mouse = false;
 //DEBUG
@@ -0,0 +1,84 @@
+#include "Game/GameEvents.hpp"
+#include <algorithm>
+
+EventDispatcher* g_theEvents = nullptr;
+
+size_t EventDispatcher::_find(event_id id) const
+{
+	auto first = std::lower_bound(m_subscribers.begin(), m_subscribers.end(), id,
+		[](const subscriber& each, event_id value) { return each.m_id < value; });
+	return (size_t)(first - m_subscribers.begin());
+}
+
+void EventDispatcher::_add(const subscriber& each)
+{
+	if (m_trigger_depth > 0) {
+		m_added.push_back(each);
+		return;
+	}
+	// after the ones already there, so they run in subscription order
+	auto last = std::upper_bound(m_subscribers.begin(), m_subscribers.end(), each.m_id,
+		[](event_id value, const subscriber& other) { return value < other.m_id; });
+	m_subscribers.insert(last, each);
+}
+
+void EventDispatcher::_remove(event_id id, const void* payload_type, any_handler fn, void* user)
+{
+	auto matches = [=](const subscriber& each) {
+		return each.m_id == id && each.m_payload_type == payload_type && each.m_fn == fn && each.m_user == user;
+	};
+	// not yet added
+	m_added.erase(std::remove_if(m_added.begin(), m_added.end(), matches), m_added.end());
+	for (size_t i = _find(id); i < m_subscribers.size() && m_subscribers[i].m_id == id; ++i) {
+		if (!matches(m_subscribers[i])) {
+			continue;
+		}
+		if (m_trigger_depth > 0) {
+			m_subscribers[i].m_fn = nullptr;
+			m_has_removed = true;
+		} else {
+			m_subscribers.erase(m_subscribers.begin() + i);
+		}
+		return;
+	}
+}
+
+void EventDispatcher::unsubscribe_all(void* user)
+{
+	m_added.erase(std::remove_if(m_added.begin(), m_added.end(),
+		[user](const subscriber& each) { return each.m_user == user; }), m_added.end());
+	if (m_trigger_depth > 0) {
+		for (subscriber& each : m_subscribers) {
+			if (each.m_user == user) {
+				each.m_fn = nullptr;
+				m_has_removed = true;
+			}
+		}
+		return;
+	}
+	m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+		[user](const subscriber& each) { return each.m_user == user; }), m_subscribers.end());
+}
+
+bool EventDispatcher::has_subscribers(event_id id) const
+{
+	for (size_t i = _find(id); i < m_subscribers.size() && m_subscribers[i].m_id == id; ++i) {
+		if (m_subscribers[i].m_fn != nullptr) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void EventDispatcher::_end_trigger()
+{
+	if (m_has_removed) {
+		m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+			[](const subscriber& each) { return each.m_fn == nullptr; }), m_subscribers.end());
+		m_has_removed = false;
+	}
+	for (const subscriber& each : m_added) {
+		_add(each);
+	}
+	m_added.clear();
+}
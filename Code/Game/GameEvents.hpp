@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Game events named by a 32 bit FNV-1a hash of their name, with typed payloads passed by
+// reference. Triggering looks the id up in one sorted array and calls plain function pointers,
+// no strings, maps or allocations on the way. Console commands stay on g_Event; the "event"
+// command forwards to here with the same hash of the name the console typed.
+
+using event_id = uint32_t;
+
+constexpr event_id get_event_id(std::string_view name)
+{
+	uint32_t hash = 2166136261u;
+	for (char c : name) {
+		hash ^= (unsigned char)c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// hashed at compile time even where the expression would not have to be
+#define EVENT_ID(name) (std::integral_constant<event_id, get_event_id(name)>::value)
+
+// for events that carry nothing
+struct no_event_payload {};
+
+class EventDispatcher;
+extern EventDispatcher* g_theEvents;
+
+// Main thread only. Subscribing or unsubscribing from inside a handler is fine: new subscribers
+// are first called by the next trigger, removed ones are not called again
+class EventDispatcher
+{
+public:
+	template<typename Payload>
+	using handler = void (*)(void* user, const Payload& payload);
+
+	template<typename Payload>
+	void subscribe(event_id id, handler<Payload> fn, void* user=nullptr);
+	// subscribe<&Class::on_event>(id, object) for void Class::on_event(const Payload&)
+	template<auto Method, typename Class>
+	void subscribe(event_id id, Class* object);
+	template<typename Payload>
+	void unsubscribe(event_id id, handler<Payload> fn, void* user=nullptr);
+	template<auto Method, typename Class>
+	void unsubscribe(event_id id, Class* object);
+	// everything subscribed with user, for objects going away
+	void unsubscribe_all(void* user);
+
+	bool has_subscribers(event_id id) const;
+	// calls the subscribers of id that take a Payload, in the order they subscribed. Returns
+	// how many were called
+	template<typename Payload>
+	size_t trigger(event_id id, const Payload& payload);
+	size_t trigger(event_id id) { return trigger(id, no_event_payload()); }
+
+	size_t get_num_subscribers() const { return m_subscribers.size(); }
+
+private:
+	using any_handler = void (*)();
+	struct subscriber
+	{
+		event_id m_id;
+		const void* m_payload_type;
+		any_handler m_fn; // null once unsubscribed during a trigger
+		void* m_user;
+	};
+
+	template<typename Payload>
+	static const void* _get_payload_type()
+	{
+		static const char tag = 0;
+		return &tag;
+	}
+	template<typename Payload, typename Class, void (Class::*Method)(const Payload&)>
+	static void _call_method(void* user, const Payload& payload)
+	{
+		(static_cast<Class*>(user)->*Method)(payload);
+	}
+	template<typename Class, typename Payload>
+	static Payload _get_method_payload(void (Class::*)(const Payload&));
+
+	void _add(const subscriber& each);
+	void _remove(event_id id, const void* payload_type, any_handler fn, void* user);
+	// first subscriber of id
+	size_t _find(event_id id) const;
+	void _end_trigger();
+
+private:
+	std::vector<subscriber> m_subscribers; // sorted by id, in subscription order within one
+	std::vector<subscriber> m_added; // while triggering
+	int m_trigger_depth = 0;
+	bool m_has_removed = false;
+};
+
+//////////////////////////////////////////////////////////////////////////
+template<typename Payload>
+void EventDispatcher::subscribe(event_id id, handler<Payload> fn, void* user)
+{
+	_add(subscriber{ id, _get_payload_type<Payload>(), reinterpret_cast<any_handler>(fn), user });
+}
+
+template<auto Method, typename Class>
+void EventDispatcher::subscribe(event_id id, Class* object)
+{
+	using payload_type = decltype(_get_method_payload(Method));
+	subscribe<payload_type>(id, &_call_method<payload_type, Class, Method>, object);
+}
+
+template<typename Payload>
+void EventDispatcher::unsubscribe(event_id id, handler<Payload> fn, void* user)
+{
+	_remove(id, _get_payload_type<Payload>(), reinterpret_cast<any_handler>(fn), user);
+}
+
+template<auto Method, typename Class>
+void EventDispatcher::unsubscribe(event_id id, Class* object)
+{
+	using payload_type = decltype(_get_method_payload(Method));
+	unsubscribe<payload_type>(id, &_call_method<payload_type, Class, Method>, object);
+}
+
+template<typename Payload>
+size_t EventDispatcher::trigger(event_id id, const Payload& payload)
+{
+	const void* payload_type = _get_payload_type<Payload>();
+	size_t num_called = 0;
+	++m_trigger_depth;
+	// by index, a handler may unsubscribe; additions wait in m_added until the end
+	for (size_t i = _find(id); i < m_subscribers.size() && m_subscribers[i].m_id == id; ++i) {
+		const subscriber& each = m_subscribers[i];
+		if (each.m_fn == nullptr || each.m_payload_type != payload_type) {
+			continue;
+		}
+		reinterpret_cast<handler<Payload>>(each.m_fn)(each.m_user, payload);
+		++num_called;
+	}
+	if (--m_trigger_depth == 0 && (m_has_removed || !m_added.empty())) {
+		_end_trigger();
+	}
+	return num_called;
+}
@@ -0,0 +1,158 @@
+#include "Game/GameTest.hpp"
+#include "Game/AsyncLog.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// pushed to the front at static init, before any allocator or container is safe to use
+static game_test* s_tests = nullptr;
+
+game_test::game_test(const char* name, const char* category, int level, bool serial, bool (*fn)())
+	: m_name(name), m_category(category), m_level(level), m_serial(serial), m_fn(fn)
+{
+	m_next = s_tests;
+	s_tests = this;
+}
+
+static double _get_seconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// set while this thread runs a test, so a wait inside it does not start another
+static thread_local bool s_in_test = false;
+
+static void _run_test(game_test_result& result)
+{
+	const double begin = _get_seconds();
+	s_in_test = true;
+	try {
+		result.m_passed = result.m_test->m_fn();
+	} catch (...) {
+		// the rest still runs
+		result.m_passed = false;
+	}
+	s_in_test = false;
+	result.m_seconds = _get_seconds() - begin;
+}
+
+game_test_run run_game_tests(const char* category, int max_level, size_t num_threads)
+{
+	game_test_run run;
+	const double begin = _get_seconds();
+	for (const game_test* each = s_tests; each != nullptr; each = each->m_next) {
+		if (each->m_level <= max_level && (category[0] == '\0' || strcmp(category, each->m_category) == 0)) {
+			run.m_results.push_back(game_test_result{ each, false, 0.0 });
+		}
+	}
+	// registered back to front
+	std::reverse(run.m_results.begin(), run.m_results.end());
+
+	std::vector<size_t> parallel;
+	for (size_t i = 0; i < run.m_results.size(); ++i) {
+		if (!run.m_results[i].m_test->m_serial) {
+			parallel.push_back(i);
+		}
+	}
+	// each worker takes the next test until none are left, so one long category does not hold
+	// up the rest
+	if (num_threads == 0) {
+		num_threads = get_num_task_threads();
+	}
+	num_threads = std::min(num_threads, parallel.size());
+	std::atomic<size_t> next_test = 0;
+	run_on_workers(num_threads, [&run, &parallel, &next_test](size_t worker) {
+		// a thread waiting inside a test, or one a test started, would hold that test up while it
+		// ran others; it leaves them to the rest. The calling thread always works the list to the end
+		const bool outside = g_theTasks != nullptr && g_theTasks->get_thread_index() < 0;
+		if (worker != 0 && (s_in_test || outside)) {
+			return;
+		}
+		for (size_t t = next_test++; t < parallel.size(); t = next_test++) {
+			_run_test(run.m_results[parallel[t]]);
+		}
+	});
+
+	for (game_test_result& result : run.m_results) {
+		if (result.m_test->m_serial) {
+			_run_test(result);
+		}
+	}
+	run.m_num_failed = (size_t)std::count_if(run.m_results.begin(), run.m_results.end(),
+		[](const game_test_result& result) { return !result.m_passed; });
+	run.m_seconds = _get_seconds() - begin;
+	return run;
+}
+
+static void _write_json_string(FILE* fp, const char* text)
+{
+	fputc('"', fp);
+	for (const char* c = text; *c != '\0'; ++c) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', fp);
+		}
+		fputc(*c, fp);
+	}
+	fputc('"', fp);
+}
+
+void write_game_test_results(FILE* fp, const game_test_run& run)
+{
+	fprintf(fp, "{\"passed\":%u,\"failed\":%u,\"seconds\":%.6f,\"tests\":[",
+		(unsigned int)(run.m_results.size() - run.m_num_failed), (unsigned int)run.m_num_failed, run.m_seconds);
+	for (size_t i = 0; i < run.m_results.size(); ++i) {
+		const game_test_result& result = run.m_results[i];
+		fputs(i == 0 ? "\n" : ",\n", fp);
+		fputs("{\"name\":", fp);
+		_write_json_string(fp, result.m_test->m_name);
+		fputs(",\"category\":", fp);
+		_write_json_string(fp, result.m_test->m_category);
+		fprintf(fp, ",\"level\":%d,\"serial\":%s,\"passed\":%s,\"seconds\":%.6f}", result.m_test->m_level,
+			result.m_test->m_serial ? "true" : "false", result.m_passed ? "true" : "false", result.m_seconds);
+	}
+	fputs("\n]}\n", fp);
+}
+
+bool write_game_test_results(const char* path, const game_test_run& run)
+{
+	FILE* fp = std::fopen(path, "wb");
+	if (fp == nullptr) {
+		return false;
+	}
+	write_game_test_results(fp, run);
+	fclose(fp);
+	return true;
+}
+
+void log_game_test_results(const game_test_run& run)
+{
+	for (const game_test_result& result : run.m_results) {
+		if (!result.m_passed) {
+			AsyncLog("test", "FAILED %s [%s] %.3fs", result.m_test->m_name, result.m_test->m_category, result.m_seconds);
+		}
+	}
+	AsyncLog("test", "%u of %u tests passed in %.3fs", (unsigned int)(run.m_results.size() - run.m_num_failed),
+		(unsigned int)run.m_results.size(), run.m_seconds);
+	AsyncLogFlush();
+}
+
+// the runner's own sanity checks
+GAME_TEST(shouldNeverFailTest, "general", 10)
+{
+	return (0 == 0);
+}
+
+GAME_TEST(anotherCoolTest, "general", 5)
+{
+	return (1 + 1 == 2);
+}
+
+GAME_TEST(binary_file_test, "general", 10)
+{
+	//LoadFileToBuffer();
+	return true;
+}
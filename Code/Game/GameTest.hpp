@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdio>
+#include <vector>
+
+// The game's unit tests. They register themselves at static init and run only when asked: from
+// the run_tests console command, the "run_tests" command line, or the headless RVsTests runner.
+// Tests are handed one at a time to the task workers and the calling thread, so they may run in
+// any order and alongside tests of any category; GAME_TEST_SERIAL ones touch process wide state
+// (allocation counts, log filters, the trace capture, globals) and run alone on the calling
+// thread afterwards.
+// A test returns true when it passes and joins every thread it starts before it returns
+
+struct game_test
+{
+	const char* m_name;
+	const char* m_category;
+	int m_level; // runs when the requested level is at least this
+	bool m_serial;
+	bool (*m_fn)();
+	game_test* m_next = nullptr;
+
+	game_test(const char* name, const char* category, int level, bool serial, bool (*fn)());
+};
+
+#define GAME_TEST_(name, category, level, serial) \
+	static bool name(); \
+	static game_test _game_test_##name(#name, category, level, serial, name); \
+	static bool name()
+#define GAME_TEST(name, category, level) GAME_TEST_(name, category, level, false)
+#define GAME_TEST_SERIAL(name, category, level) GAME_TEST_(name, category, level, true)
+
+struct game_test_result
+{
+	const game_test* m_test;
+	bool m_passed;
+	double m_seconds;
+};
+
+struct game_test_run
+{
+	std::vector<game_test_result> m_results; // in registration order
+	size_t m_num_failed = 0;
+	double m_seconds = 0.0;
+};
+
+// category "" runs every category. At most num_threads tests run at once, 0 for every task
+// thread; without a TaskScheduler they all run on the calling thread
+game_test_run run_game_tests(const char* category, int max_level, size_t num_threads=0);
+// one JSON object with the totals and every test's name, category, result and time
+void write_game_test_results(FILE* fp, const game_test_run& run);
+bool write_game_test_results(const char* path, const game_test_run& run);
+// failures one per line, then the totals
+void log_game_test_results(const game_test_run& run);
@@ -0,0 +1,281 @@
+#include "Game/LocalIpc.hpp"
+#include <cstring>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN		// Always #define this before #including <windows.h>
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include <mutex>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+const LocalSocket::handle LocalSocket::INVALID_HANDLE = (LocalSocket::handle)INVALID_SOCKET;
+
+static void _startup_winsock()
+{
+	static std::once_flag s_once;
+	std::call_once(s_once, []() {
+		WSADATA data;
+		WSAStartup(MAKEWORD(2, 2), &data);
+	});
+}
+static void _close_socket(LocalSocket::handle socket) { closesocket((SOCKET)socket); }
+static void _remove_file(const char* path) { DeleteFileA(path); }
+#else
+const LocalSocket::handle LocalSocket::INVALID_HANDLE = -1;
+
+static void _startup_winsock() {}
+static void _close_socket(LocalSocket::handle socket) { ::close(socket); }
+static void _remove_file(const char* path) { unlink(path); }
+#endif
+
+static bool _get_address(const char* path, sockaddr_un& address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return false;
+	}
+	strcpy(address.sun_path, path);
+	return true;
+}
+
+bool LocalSocket::listen(const char* path, int backlog)
+{
+	_startup_winsock();
+	sockaddr_un address;
+	if (is_open() || !_get_address(path, address)) {
+		return false;
+	}
+	m_handle = (handle)::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_handle == INVALID_HANDLE) {
+		return false;
+	}
+	_remove_file(path);
+	if (::bind(m_handle, (const sockaddr*)&address, sizeof(address)) != 0 || ::listen(m_handle, backlog) != 0) {
+		close();
+		return false;
+	}
+	m_listen_path = path;
+	return true;
+}
+
+bool LocalSocket::accept(LocalSocket& client)
+{
+	while (true) {
+		const handle accepted = (handle)::accept(m_handle, nullptr, nullptr);
+		if (accepted != INVALID_HANDLE) {
+			client.close();
+			client.m_handle = accepted;
+			return true;
+		}
+#if !defined(_WIN32)
+		if (errno == EINTR) {
+			continue;
+		}
+#endif
+		return false;
+	}
+}
+
+bool LocalSocket::connect(const char* path)
+{
+	_startup_winsock();
+	sockaddr_un address;
+	if (is_open() || !_get_address(path, address)) {
+		return false;
+	}
+	m_handle = (handle)::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_handle == INVALID_HANDLE) {
+		return false;
+	}
+	if (::connect(m_handle, (const sockaddr*)&address, sizeof(address)) != 0) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool LocalSocket::send_all(const void* data, size_t bytes)
+{
+	const char* at = (const char*)data;
+	while (bytes > 0) {
+		// a big send can return early, send the rest
+		const int chunk = bytes > (1u << 30) ? (1 << 30) : (int)bytes;
+#if defined(_WIN32)
+		const int sent = ::send(m_handle, at, chunk, 0);
+#else
+		const ssize_t sent = ::send(m_handle, at, (size_t)chunk, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+#endif
+		if (sent <= 0) {
+			return false;
+		}
+		at += sent;
+		bytes -= (size_t)sent;
+	}
+	return true;
+}
+
+bool LocalSocket::receive_all(void* data, size_t bytes)
+{
+	char* at = (char*)data;
+	while (bytes > 0) {
+		const int chunk = bytes > (1u << 30) ? (1 << 30) : (int)bytes;
+#if defined(_WIN32)
+		const int received = ::recv(m_handle, at, chunk, 0);
+#else
+		const ssize_t received = ::recv(m_handle, at, (size_t)chunk, 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+#endif
+		if (received <= 0) {
+			return false;
+		}
+		at += received;
+		bytes -= (size_t)received;
+	}
+	return true;
+}
+
+void LocalSocket::shutdown()
+{
+	if (is_open()) {
+#if defined(_WIN32)
+		::shutdown(m_handle, SD_BOTH);
+#else
+		::shutdown(m_handle, SHUT_RDWR);
+#endif
+	}
+}
+
+void LocalSocket::close()
+{
+	if (!is_open()) {
+		return;
+	}
+	_close_socket(m_handle);
+	m_handle = INVALID_HANDLE;
+	if (!m_listen_path.empty()) {
+		_remove_file(m_listen_path.c_str());
+		m_listen_path.clear();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+#if defined(_WIN32)
+static void* _map(const char* name, size_t bytes, bool create, void*& mapping)
+{
+	const std::string global_name = std::string("Local\\") + name;
+	if (create) {
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			(DWORD)((unsigned long long)bytes >> 32), (DWORD)bytes, global_name.c_str());
+		if (mapping != nullptr && GetLastError() == ERROR_ALREADY_EXISTS) {
+			CloseHandle(mapping);
+			mapping = nullptr;
+		}
+	} else {
+		mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, global_name.c_str());
+	}
+	if (mapping == nullptr) {
+		return nullptr;
+	}
+	void* data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	return data;
+}
+#else
+static void* _map(const char* name, size_t bytes, bool create)
+{
+	const std::string global_name = std::string("/") + name;
+	const int fd = shm_open(global_name.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat info;
+	bool ok = create ? ftruncate(fd, (off_t)bytes) == 0 : fstat(fd, &info) == 0 && (size_t)info.st_size >= bytes;
+	void* data = ok ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if (data == MAP_FAILED) {
+		if (create) {
+			shm_unlink(global_name.c_str());
+		}
+		return nullptr;
+	}
+	return data;
+}
+#endif
+
+bool SharedMemory::create(const char* name, size_t bytes)
+{
+	if (m_data != nullptr || bytes == 0) {
+		return false;
+	}
+#if defined(_WIN32)
+	m_data = (unsigned char*)_map(name, bytes, true, m_mapping);
+#else
+	m_data = (unsigned char*)_map(name, bytes, true);
+#endif
+	if (m_data == nullptr) {
+		return false;
+	}
+	m_size = bytes;
+	m_name = name;
+	m_created = true;
+	return true;
+}
+
+bool SharedMemory::open(const char* name, size_t bytes)
+{
+	if (m_data != nullptr || bytes == 0) {
+		return false;
+	}
+#if defined(_WIN32)
+	m_data = (unsigned char*)_map(name, bytes, false, m_mapping);
+#else
+	m_data = (unsigned char*)_map(name, bytes, false);
+#endif
+	if (m_data == nullptr) {
+		return false;
+	}
+	m_size = bytes;
+	m_name = name;
+	m_created = false;
+	return true;
+}
+
+void SharedMemory::close()
+{
+	if (m_data == nullptr) {
+		return;
+	}
+#if defined(_WIN32)
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	m_mapping = nullptr;
+#else
+	munmap(m_data, m_size);
+	if (m_created) {
+		shm_unlink((std::string("/") + m_name).c_str());
+	}
+#endif
+	m_data = nullptr;
+	m_size = 0;
+	m_created = false;
+	m_name.clear();
+}
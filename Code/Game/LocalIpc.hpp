@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Plumbing between processes on one machine: Unix domain stream sockets (AF_UNIX, on Windows 10
+// and later too) and named shared memory. Everything blocks; shutdown() is the one call meant for
+// another thread, to wake whoever is blocked in accept or receive
+
+class LocalSocket
+{
+public:
+#if defined(_WIN32)
+	using handle = uintptr_t; // SOCKET
+#else
+	using handle = int;
+#endif
+	static const handle INVALID_HANDLE;
+public:
+	LocalSocket() = default;
+	~LocalSocket() { close(); }
+	LocalSocket(const LocalSocket&) = delete;
+	LocalSocket& operator=(const LocalSocket&) = delete;
+
+	// replaces a socket file left at path by a process that did not close it
+	bool listen(const char* path, int backlog=16);
+	bool accept(LocalSocket& client);
+	bool connect(const char* path);
+	// false once the other side is gone
+	bool send_all(const void* data, size_t bytes);
+	bool receive_all(void* data, size_t bytes);
+	void shutdown();
+	// removes the socket file when listening
+	void close();
+	bool is_open() const { return m_handle != INVALID_HANDLE; }
+
+private:
+	handle m_handle = INVALID_HANDLE;
+	std::string m_listen_path;
+};
+
+// One named block mapped into every process that opens it. The creator removes the name on close,
+// the memory lives until the last process unmaps it
+class SharedMemory
+{
+public:
+	SharedMemory() = default;
+	~SharedMemory() { close(); }
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+
+	// name is a plain identifier, no slashes; fails if it exists
+	bool create(const char* name, size_t bytes);
+	bool open(const char* name, size_t bytes);
+	void close();
+	unsigned char* get_data() const { return m_data; }
+	size_t get_size() const { return m_size; }
+
+private:
+	unsigned char* m_data = nullptr;
+	size_t m_size = 0;
+	std::string m_name;
+	bool m_created = false;
+#if defined(_WIN32)
+	void* m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,48 @@
+#include "Game/LockFreeQueue.hpp"
+
+static std::atomic<bool> s_queue_thread_slots[MAX_QUEUE_THREADS] = {};
+
+namespace {
+struct queue_thread_slot
+{
+	int m_slot = -1;
+
+	queue_thread_slot()
+	{
+		// spins if every slot is taken, MAX_QUEUE_THREADS is well above any thread count we run
+		for (;;) {
+			for (int i = 0; i < MAX_QUEUE_THREADS; ++i) {
+				bool expected = false;
+				if (s_queue_thread_slots[i].compare_exchange_strong(expected, true)) {
+					m_slot = i;
+					return;
+				}
+			}
+			std::this_thread::yield();
+		}
+	}
+	~queue_thread_slot()
+	{
+		s_queue_thread_slots[m_slot].store(false);
+	}
+};
+}
+
+int get_queue_thread_slot()
+{
+	static thread_local queue_thread_slot s_slot;
+	return s_slot.m_slot;
+}
+
+const char* get_queue_kind_name(eQueueKind kind)
+{
+	switch (kind) {
+	case QUEUE_LOCKED:
+		return "locked";
+	case QUEUE_RING:
+		return "ring";
+	case QUEUE_SEGMENTED:
+		return "segmented";
+	}
+	return "?";
+}
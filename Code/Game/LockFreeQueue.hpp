@@ -0,0 +1,393 @@
+#pragma once
+#include "Engine/Core/AsyncQueue.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// Lock-free stand-ins for AsyncQueue with the same Push/Pop. T has to be default constructible
+// and copyable, pointers and small handles are what these are for
+
+// threads that can use SegmentedQueues at the same time
+constexpr int MAX_QUEUE_THREADS = 256;
+// this thread's hazard slot, the same one in every SegmentedQueue. Claimed the first time a
+// thread asks and given back when it exits
+int get_queue_thread_slot();
+
+// Bounded multi-producer multi-consumer ring. Every cell carries a sequence number that says
+// whose turn it is, so producers and consumers only contend on their own counter.
+// Capacity is rounded up to a power of two
+template<typename T>
+class RingQueue
+{
+public:
+	static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+public:
+	explicit RingQueue(size_t capacity=DEFAULT_CAPACITY);
+	RingQueue(const RingQueue&) = delete;
+	RingQueue& operator=(const RingQueue&) = delete;
+
+	// false when full
+	bool TryPush(const T& value);
+	// yields while full
+	void Push(const T& value);
+	bool Pop(T* out);
+	size_t GetCapacity() const { return m_mask + 1; }
+
+private:
+	struct cell
+	{
+		std::atomic<size_t> m_sequence;
+		T m_value;
+	};
+
+private:
+	std::unique_ptr<cell[]> m_cells;
+	size_t m_mask = 0;
+	alignas(64) std::atomic<size_t> m_enqueue{0};
+	alignas(64) std::atomic<size_t> m_dequeue{0};
+};
+
+// Unbounded multi-producer multi-consumer queue: a linked list of fixed segments, each filled
+// and drained once. Producers claim a slot with one fetch_add, consumers with one CAS. A consumer
+// that claims a slot its producer has not written yet waits ABANDON_SPINS yields, then marks the
+// slot abandoned and takes the next one; that producer sees the mark and pushes again, so a
+// descheduled producer holds up nobody. A drained segment is retired and freed once no thread's
+// hazard slot points at it
+template<typename T>
+class SegmentedQueue
+{
+public:
+	static constexpr size_t SEGMENT_SIZE = 1024;
+	static constexpr int ABANDON_SPINS = 64;
+public:
+	SegmentedQueue();
+	~SegmentedQueue();
+	SegmentedQueue(const SegmentedQueue&) = delete;
+	SegmentedQueue& operator=(const SegmentedQueue&) = delete;
+
+	void Push(const T& value);
+	bool Pop(T* out);
+
+private:
+	struct segment
+	{
+		std::atomic<size_t> m_enqueue{0}; // next slot to claim, runs past SEGMENT_SIZE once full
+		std::atomic<size_t> m_dequeue{0};
+		std::atomic<segment*> m_next{nullptr};
+		segment* m_next_retired = nullptr;
+		std::atomic<unsigned char> m_ready[SEGMENT_SIZE] = {}; // SLOT_ state, written by the producer
+		T m_values[SEGMENT_SIZE];
+	};
+
+	enum : unsigned char
+	{
+		SLOT_EMPTY,
+		SLOT_READY,
+		SLOT_ABANDONED, // its consumer gave up waiting, the producer pushes again
+	};
+
+	segment* _protect(std::atomic<segment*>& from, int slot);
+	void _retire(segment* seg);
+
+private:
+	alignas(64) std::atomic<segment*> m_head;
+	alignas(64) std::atomic<segment*> m_tail;
+	std::atomic<segment*> m_retired{nullptr}; // push-only stack, taken whole by the scan
+	std::atomic<segment*> m_hazards[MAX_QUEUE_THREADS] = {};
+};
+
+enum eQueueKind : unsigned char
+{
+	QUEUE_LOCKED, // AsyncQueue
+	QUEUE_RING,
+	QUEUE_SEGMENTED,
+};
+
+// Picks the implementation per instance, e.g. to compare them on the same workload
+template<typename T>
+class ConcurrentQueue
+{
+public:
+	explicit ConcurrentQueue(eQueueKind kind=QUEUE_SEGMENTED, size_t ring_capacity=RingQueue<T>::DEFAULT_CAPACITY);
+	void Push(const T& value);
+	bool Pop(T* out);
+	eQueueKind GetKind() const { return m_kind; }
+
+private:
+	eQueueKind m_kind;
+	std::unique_ptr<AsyncQueue<T>> m_locked;
+	std::unique_ptr<RingQueue<T>> m_ring;
+	std::unique_ptr<SegmentedQueue<T>> m_segmented;
+};
+
+const char* get_queue_kind_name(eQueueKind kind);
+
+////////////////////////////////
+template<typename T>
+RingQueue<T>::RingQueue(size_t capacity)
+{
+	size_t size = 2;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	m_cells = std::make_unique<cell[]>(size);
+	for (size_t i = 0; i < size; ++i) {
+		m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+	}
+	m_mask = size - 1;
+}
+
+template<typename T>
+bool RingQueue<T>::TryPush(const T& value)
+{
+	size_t position = m_enqueue.load(std::memory_order_relaxed);
+	for (;;) {
+		cell& c = m_cells[position & m_mask];
+		const size_t sequence = c.m_sequence.load(std::memory_order_acquire);
+		const intptr_t lag = (intptr_t)sequence - (intptr_t)position;
+		if (lag == 0) {
+			if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				c.m_value = value;
+				c.m_sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (lag < 0) {
+			// the consumer a lap behind has not taken this cell yet
+			return false;
+		} else {
+			position = m_enqueue.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template<typename T>
+void RingQueue<T>::Push(const T& value)
+{
+	while (!TryPush(value)) {
+		std::this_thread::yield();
+	}
+}
+
+template<typename T>
+bool RingQueue<T>::Pop(T* out)
+{
+	size_t position = m_dequeue.load(std::memory_order_relaxed);
+	for (;;) {
+		cell& c = m_cells[position & m_mask];
+		const size_t sequence = c.m_sequence.load(std::memory_order_acquire);
+		const intptr_t lag = (intptr_t)sequence - (intptr_t)(position + 1);
+		if (lag == 0) {
+			if (m_dequeue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				*out = c.m_value;
+				c.m_sequence.store(position + m_mask + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (lag < 0) {
+			return false;
+		} else {
+			position = m_dequeue.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+////////////////////////////////
+template<typename T>
+SegmentedQueue<T>::SegmentedQueue()
+{
+	segment* first = new segment();
+	m_head.store(first);
+	m_tail.store(first);
+}
+
+template<typename T>
+SegmentedQueue<T>::~SegmentedQueue()
+{
+	// nobody else is using the queue by now
+	for (segment* seg = m_head.load(); seg != nullptr;) {
+		segment* next = seg->m_next.load();
+		delete seg;
+		seg = next;
+	}
+	for (segment* seg = m_retired.load(); seg != nullptr;) {
+		segment* next = seg->m_next_retired;
+		delete seg;
+		seg = next;
+	}
+}
+
+template<typename T>
+typename SegmentedQueue<T>::segment* SegmentedQueue<T>::_protect(std::atomic<segment*>& from, int slot)
+{
+	// once the slot holds it and it is still reachable, a scan cannot miss the slot
+	segment* seg = from.load();
+	for (;;) {
+		m_hazards[slot].store(seg);
+		segment* again = from.load();
+		if (again == seg) {
+			return seg;
+		}
+		seg = again;
+	}
+}
+
+template<typename T>
+void SegmentedQueue<T>::_retire(segment* seg)
+{
+	segment* head = m_retired.load();
+	do {
+		seg->m_next_retired = head;
+	} while (!m_retired.compare_exchange_weak(head, seg));
+
+	// free what no hazard points at, push the rest back for a later scan
+	segment* list = m_retired.exchange(nullptr);
+	segment* hazards[MAX_QUEUE_THREADS];
+	int num_hazards = 0;
+	for (int i = 0; i < MAX_QUEUE_THREADS; ++i) {
+		segment* each = m_hazards[i].load();
+		if (each != nullptr) {
+			hazards[num_hazards++] = each;
+		}
+	}
+	while (list != nullptr) {
+		segment* next = list->m_next_retired;
+		if (std::find(hazards, hazards + num_hazards, list) == hazards + num_hazards) {
+			delete list;
+		} else {
+			head = m_retired.load();
+			do {
+				list->m_next_retired = head;
+			} while (!m_retired.compare_exchange_weak(head, list));
+		}
+		list = next;
+	}
+}
+
+template<typename T>
+void SegmentedQueue<T>::Push(const T& value)
+{
+	const int slot = get_queue_thread_slot();
+	for (;;) {
+		segment* seg = _protect(m_tail, slot);
+		const size_t i = seg->m_enqueue.fetch_add(1);
+		if (i < SEGMENT_SIZE) {
+			seg->m_values[i] = value;
+			unsigned char empty = SLOT_EMPTY;
+			if (seg->m_ready[i].compare_exchange_strong(empty, SLOT_READY, std::memory_order_release,
+				std::memory_order_relaxed)) {
+				m_hazards[slot].store(nullptr);
+				return;
+			}
+			// a consumer gave up on this slot while we were writing it
+			continue;
+		}
+		segment* next = seg->m_next.load();
+		if (next == nullptr) {
+			// the new segment goes in with the value already in its first slot
+			segment* fresh = new segment();
+			fresh->m_enqueue.store(1, std::memory_order_relaxed);
+			fresh->m_values[0] = value;
+			fresh->m_ready[0].store(SLOT_READY, std::memory_order_relaxed);
+			if (seg->m_next.compare_exchange_strong(next, fresh)) {
+				m_tail.compare_exchange_strong(seg, fresh);
+				m_hazards[slot].store(nullptr);
+				return;
+			}
+			delete fresh;
+		}
+		m_tail.compare_exchange_strong(seg, next);
+	}
+}
+
+template<typename T>
+bool SegmentedQueue<T>::Pop(T* out)
+{
+	const int slot = get_queue_thread_slot();
+	for (;;) {
+		segment* seg = _protect(m_head, slot);
+		size_t position = seg->m_dequeue.load();
+		for (;;) {
+			const size_t filled = std::min(seg->m_enqueue.load(), SEGMENT_SIZE);
+			if (position >= filled) {
+				break;
+			}
+			if (seg->m_dequeue.compare_exchange_weak(position, position + 1)) {
+				// the slot is claimed, its producer may still be writing it
+				std::atomic<unsigned char>& ready = seg->m_ready[position];
+				for (int spin = 0; spin < ABANDON_SPINS && ready.load(std::memory_order_acquire) == SLOT_EMPTY; ++spin) {
+					std::this_thread::yield();
+				}
+				unsigned char state = SLOT_EMPTY;
+				if (ready.compare_exchange_strong(state, SLOT_ABANDONED, std::memory_order_acquire)) {
+					++position;
+					continue;
+				}
+				*out = seg->m_values[position];
+				m_hazards[slot].store(nullptr);
+				return true;
+			}
+		}
+		segment* next = seg->m_next.load();
+		if (position < SEGMENT_SIZE || next == nullptr) {
+			m_hazards[slot].store(nullptr);
+			return false;
+		}
+		// drained: whoever moves the head past it retires it, after the tail is past it too
+		segment* expected = seg;
+		if (m_head.compare_exchange_strong(expected, next)) {
+			expected = seg;
+			m_tail.compare_exchange_strong(expected, next);
+			m_hazards[slot].store(nullptr);
+			_retire(seg);
+		}
+	}
+}
+
+////////////////////////////////
+template<typename T>
+ConcurrentQueue<T>::ConcurrentQueue(eQueueKind kind, size_t ring_capacity)
+	: m_kind(kind)
+{
+	switch (kind) {
+	case QUEUE_LOCKED:
+		m_locked = std::make_unique<AsyncQueue<T>>();
+		break;
+	case QUEUE_RING:
+		m_ring = std::make_unique<RingQueue<T>>(ring_capacity);
+		break;
+	case QUEUE_SEGMENTED:
+		m_segmented = std::make_unique<SegmentedQueue<T>>();
+		break;
+	}
+}
+
+template<typename T>
+void ConcurrentQueue<T>::Push(const T& value)
+{
+	switch (m_kind) {
+	case QUEUE_LOCKED:
+		m_locked->Push(value);
+		break;
+	case QUEUE_RING:
+		m_ring->Push(value);
+		break;
+	case QUEUE_SEGMENTED:
+		m_segmented->Push(value);
+		break;
+	}
+}
+
+template<typename T>
+bool ConcurrentQueue<T>::Pop(T* out)
+{
+	switch (m_kind) {
+	case QUEUE_LOCKED:
+		return m_locked->Pop(out);
+	case QUEUE_RING:
+		return m_ring->Pop(out);
+	case QUEUE_SEGMENTED:
+		return m_segmented->Pop(out);
+	}
+	return false;
+}
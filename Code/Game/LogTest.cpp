@@ -1,6 +1,13 @@
-#include "Engine/Develop/UnitTest.hpp"
+#include "Game/GameTest.hpp"
 #include "Engine/Develop/Log.hpp"
 #include "Engine/Develop/Profile.hpp"
+#include "Game/AsyncLog.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
 #define LOG_MESSAGES_PER_THREAD_TEST   (512)
 
 static void LogTest()
@@ -20,14 +27,127 @@ static void LogTest()
 	}
 }
 
-UNIT_TEST(LogThreadTest, "System", 0)
+GAME_TEST_SERIAL(LogThreadTest, "System", 0)
 {
 	// leave one thread free (main thread)
-	unsigned int core_count = std::thread::hardware_concurrency() - 2;
+	unsigned int core_count = std::max(std::thread::hardware_concurrency(), 3u) - 2;
 	LogFilterDisableAll();
+	std::vector<std::thread> threads;
 	for (unsigned i = 0; i < core_count; ++i) {
-		std::thread test_thread(LogTest);
-		test_thread.detach();
+		threads.emplace_back(LogTest);
+	}
+	for (auto& each : threads) {
+		each.join();
+	}
+	return true;
+}
+
+static void AsyncLogTest()
+{
+	std::thread::id this_id = std::this_thread::get_id();
+	size_t hash_id = std::hash<std::thread::id>{}(this_id);
+	char const* format = "Thread[%I64u]: Printing Message %u";
+
+	for (unsigned int i = 0; i < LOG_MESSAGES_PER_THREAD_TEST; ++i) {
+		if (rand() % 2) {
+			AsyncLogFilterEnable("debug");
+		} else {
+			AsyncLogFilterDisable("debug");
+		}
+		AsyncLog("debug", format, hash_id, i);
+	}
+}
+
+// the same pattern through AsyncLog
+GAME_TEST_SERIAL(AsyncLogThreadTest, "System", 0)
+{
+	unsigned int core_count = std::max(std::thread::hardware_concurrency(), 3u) - 2;
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < core_count; ++i) {
+		threads.emplace_back(AsyncLogTest);
+	}
+	for (auto& each : threads) {
+		each.join();
 	}
 	return true;
-}
\ No newline at end of file
+}
+
+// everything logged before AsyncLogFlush is written when it returns, nothing of a disabled filter is
+GAME_TEST_SERIAL(asyncLogFlushBarrier, "System", 1)
+{
+	constexpr unsigned int num_threads = 4;
+	const log_filter_id filter = GetLogFilterId("logtest_flush");
+	AsyncLogFilterEnable("logtest_flush");
+	const size_t before = GetNumLogMessagesWritten(filter);
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < num_threads; ++t) {
+		threads.emplace_back([filter, t]() {
+			for (unsigned int i = 0; i < LOG_MESSAGES_PER_THREAD_TEST; ++i) {
+				AsyncLog(filter, "flush test thread %u message %u", t, i);
+			}
+		});
+	}
+	for (auto& each : threads) {
+		each.join();
+	}
+	AsyncLogFlush();
+	bool ok = GetNumLogMessagesWritten(filter) - before == num_threads * LOG_MESSAGES_PER_THREAD_TEST;
+
+	AsyncLogFilterDisable("logtest_flush");
+	AsyncLog(filter, "filtered out");
+	AsyncLogFlush();
+	ok = ok && GetNumLogMessagesWritten(filter) - before == num_threads * LOG_MESSAGES_PER_THREAD_TEST;
+	return ok;
+}
+
+// a one frame capture sees every scope its threads opened, nested ones included
+GAME_TEST_SERIAL(traceCaptureThreads, "System", 1)
+{
+	constexpr unsigned int num_threads = 3;
+	constexpr unsigned int num_scopes = 100;
+	if (!start_trace_capture(1, "logs/trace_unittest.json")) {
+		return false;
+	}
+	trace_frame();
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < num_threads; ++t) {
+		threads.emplace_back([]() {
+			trace_set_thread_name("trace test");
+			for (unsigned int i = 0; i < num_scopes; ++i) {
+				TRACE_SCOPE("trace test outer");
+				TRACE_SCOPE("trace test inner");
+			}
+		});
+	}
+	for (auto& each : threads) {
+		each.join();
+	}
+	return trace_frame()
+		&& count_trace_events("trace test outer") == num_threads * num_scopes
+		&& count_trace_events("trace test inner") == num_threads * num_scopes;
+}
+
+// counters land in the capture like any other event and are written as "C" events
+GAME_TEST_SERIAL(traceCaptureCounters, "System", 1)
+{
+	if (!start_trace_capture(1, "logs/trace_counter_unittest.json")) {
+		return false;
+	}
+	trace_counter("trace test counter", 1);
+	trace_frame();
+	for (unsigned int i = 0; i < 10; ++i) {
+		trace_counter("trace test counter", i);
+	}
+	if (!trace_frame() || count_trace_events("trace test counter") != 10) {
+		return false;
+	}
+	FILE* fp = std::fopen("logs/trace_counter_unittest.json", "rb");
+	if (fp == nullptr) {
+		return false;
+	}
+	std::string text(64 * 1024, '\0');
+	text.resize(fread(&text[0], 1, text.size(), fp));
+	fclose(fp);
+	return text.find("{\"ph\":\"C\"") != std::string::npos
+		&& text.find("\"args\":{\"value\":9},\"name\":\"trace test counter\"") != std::string::npos;
+}
@@ -5,6 +5,7 @@
 #include "Engine/Core/EngineCommon.hpp"
 #include "Engine/Core/NamedStrings.hpp"
 #include "Game/App.hpp"
+#include "Game/TraceCapture.hpp"
 #include "Engine/Event/EventSystem.hpp"
 #include "Engine/UI/UISystem.hpp"
 #include "ThirdParty/imgui/imgui.h"
@@ -132,10 +133,19 @@ void Shutdown()
 //-----------------------------------------------------------------------------------------------
 int WINAPI WinMain(HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR commandLineString, int)
 {
-	UNUSED(commandLineString);
 	UNUSED(applicationInstanceHandle);
 	Startup();
 
+	// "trace=N" captures the first N frames into logs/trace.json and quits, for headless runs
+	const char* trace = strstr(commandLineString, "trace=");
+	if (trace != nullptr && start_trace_capture(atoi(trace + 6), "logs/trace.json")) {
+		g_theApp->QuitAfterTrace();
+	}
+	// "run_tests" runs every test once before the first frame, the same as the console command
+	if (strstr(commandLineString, "run_tests") != nullptr) {
+		g_Event->Trigger("run_tests");
+	}
+
 	// Program main loop; keep running frames until it's time to quit
 	while (!g_theApp->IsQuitting())
 	{
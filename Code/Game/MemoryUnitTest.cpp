@@ -1,17 +1,21 @@
 #include "Engine/Core/EngineCommon.hpp"
-#include "Engine/Develop/UnitTest.hpp"
+#include "Game/GameTest.hpp"
 #include "Engine/Core/AsyncQueue.hpp"
+#include "Game/LockFreeQueue.hpp"
+#include "Game/ThreadCachedAlloc.hpp"
 #include "Game/EngineBuildPreferences.hpp"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <thread>
+#include <vector>
 
 #include "Engine/Develop/Memory.hpp"
-#include "Engine/Develop/Profile.hpp"
+#include "Game/TraceCapture.hpp"
 
 using uint = unsigned int;
 using byte = unsigned char;
 #define MEM_TRACKING_UNIT_TEST
-#if defined(MEM_TRACKING) && defined(MEM_TRACKING_UNIT_TEST)
 #define MEMTEST_ITER_PER_THREAD 1'000'000
 #define MEMTEST_ALLOC_BYTE_SIZE 128
 
@@ -19,12 +23,13 @@ bool RandomCoinFlip() {
 	return (rand() % 2) != 0;
 }
 
-static void AllocTest(AsyncQueue<void*>& mem_queue, std::atomic<uint>& running_count)
+template<typename Queue, void* (*Alloc)(size_t)=TrackedAlloc, void (*Free)(void*)=TrackedFree>
+static void AllocTest(Queue& mem_queue)
 {
 	for (uint i = 0; i < MEMTEST_ITER_PER_THREAD; ++i) {
 		// (Random01() > .5f) or however your random functions look
 		if (RandomCoinFlip()) {
-			byte* ptr = (byte*)TrackedAlloc(MEMTEST_ALLOC_BYTE_SIZE);
+			byte* ptr = (byte*)Alloc(MEMTEST_ALLOC_BYTE_SIZE);
 
 			// just doing this to slow it down
 			// (and later, to confirm memory didn't get currupted)
@@ -37,42 +42,36 @@ static void AllocTest(AsyncQueue<void*>& mem_queue, std::atomic<uint>& running_c
 		else {
 			void* ptr;
 			if (mem_queue.Pop(&ptr)) {
-				TrackedFree(ptr);
+				Free(ptr);
 			}
 		}
 	}
-
-	// we're done; 
-	--running_count;
 }
 
+#if defined(MEM_TRACKING) && defined(MEM_TRACKING_UNIT_TEST)
+
 // This test will only work if memory tracking is enabled
 // otherwise the memory tracking just return 0;
 
-UNIT_TEST(memoryTest, "memory", 1)
+GAME_TEST_SERIAL(memoryTest, "memory", 1)
 {
 	// unittest assumes 
-	size_t pre_allocations = GetLiveAllocationCount();
+	size_t pre_allocations = get_live_allocation_count();
 
 	{
-		PROFILE_SCOPE("A02 Test");
+		PROFILE_TRACE_SCOPE("A02 Test");
 		// scope so queue goes out of scope and we
 		// get those allocations back; 
 		AsyncQueue<void*> mem_queue;
 		uint core_count = std::thread::hardware_concurrency();
-		std::atomic<uint> live_count = core_count;
 
 		// wpin up that many threads; 
+		std::vector<std::thread> threads;
 		for (uint i = 0; i < core_count; ++i) {
-			std::thread test_thread(AllocTest, std::ref(mem_queue), std::ref(live_count));
-			test_thread.detach();
+			threads.emplace_back(AllocTest<AsyncQueue<void*>>, std::ref(mem_queue));
 		}
-
-		while (live_count.load() > 0) {
-			// "ms" is a C++ custom literal equivalent 
-			// for std::chrono::milliseconds(100)
-			// https://en.cppreference.com/w/cpp/chrono/operator%22%22ms
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		for (auto& each : threads) {
+			each.join();
 		}
 
 		void* ptr;
@@ -82,10 +81,246 @@ UNIT_TEST(memoryTest, "memory", 1)
 	}
 
 	// check we're back to where we started; 
-	size_t post_allocations = GetLiveAllocationCount();
+	size_t post_allocations = get_live_allocation_count();
 
 	// if done right, allocations at the start
 	// should be allocations at the end; 
 	return (pre_allocations == post_allocations);
 }
+
+// the same hammering through the lock-free queues
+GAME_TEST_SERIAL(memoryTestLockFreeQueues, "memory", 1)
+{
+	size_t pre_allocations = get_live_allocation_count();
+	for (eQueueKind kind : {QUEUE_RING, QUEUE_SEGMENTED}) {
+		ConcurrentQueue<void*> mem_queue(kind);
+		uint core_count = std::thread::hardware_concurrency();
+		std::vector<std::thread> threads;
+		for (uint i = 0; i < core_count; ++i) {
+			threads.emplace_back(AllocTest<ConcurrentQueue<void*>>, std::ref(mem_queue));
+		}
+		for (auto& each : threads) {
+			each.join();
+		}
+		void* ptr;
+		while (mem_queue.Pop(&ptr)) {
+			TrackedFree(ptr);
+		}
+	}
+	return (pre_allocations == get_live_allocation_count());
+}
 #endif
+
+// the same hammering through the thread caches, which count for themselves so this holds
+// without MEM_TRACKING too. Sampled often enough that blocks get freed on other threads
+// than the one holding their sample
+GAME_TEST_SERIAL(memoryTestThreadCached, "memory", 1)
+{
+	const size_t pre_allocations = get_cached_live_allocation_count();
+	const size_t pre_samples = get_num_live_samples();
+	const unsigned int sample_rate = get_alloc_sample_rate();
+	set_alloc_sample_rate(7);
+	{
+		ConcurrentQueue<void*> mem_queue(QUEUE_SEGMENTED);
+		uint core_count = std::thread::hardware_concurrency();
+		std::vector<std::thread> threads;
+		for (uint i = 0; i < core_count; ++i) {
+			threads.emplace_back(AllocTest<ConcurrentQueue<void*>, cached_alloc, cached_free>, std::ref(mem_queue));
+		}
+		for (auto& each : threads) {
+			each.join();
+		}
+		void* ptr;
+		while (mem_queue.Pop(&ptr)) {
+			cached_free(ptr);
+		}
+	}
+	set_alloc_sample_rate(sample_rate);
+	return pre_allocations == get_cached_live_allocation_count() && pre_samples == get_num_live_samples();
+}
+
+// sizes on both sides of every class boundary and past the largest class keep their bytes
+GAME_TEST_SERIAL(threadCachedSizes, "memory", 5)
+{
+	const size_t pre_allocations = get_cached_live_allocation_count();
+	const size_t pre_bytes = get_cached_live_bytes();
+	std::vector<std::pair<byte*, size_t>> blocks;
+	size_t total = 0;
+	for (size_t size = 1; size <= CACHED_ALLOC_MAX_SIZE * 2; size += 15) {
+		byte* ptr = (byte*)cached_alloc(size);
+		std::fill(ptr, ptr + size, (byte)size);
+		blocks.emplace_back(ptr, size);
+		total += size;
+	}
+	bool ok = get_cached_live_allocation_count() == pre_allocations + blocks.size()
+		&& get_cached_live_bytes() == pre_bytes + total;
+	for (auto& [ptr, size] : blocks) {
+		ok = ok && std::all_of(ptr, ptr + size, [size = size](byte b) { return b == (byte)size; });
+		cached_free(ptr);
+	}
+	return ok && get_cached_live_allocation_count() == pre_allocations && get_cached_live_bytes() == pre_bytes;
+}
+
+// a thread carving fresh slabs counts its blocks, not the slabs, and its slabs are freed once it
+// exits with every block back. The largest class, which nothing else here uses
+GAME_TEST_SERIAL(threadCachedSlabsFreedAtExit, "memory", 5)
+{
+	constexpr size_t NUM_BLOCKS = 1000;
+	const size_t pre_slabs = get_num_cached_slabs();
+	const size_t pre_live = get_live_allocation_count();
+	bool counted = false;
+	size_t num_made_slabs = 0;
+	std::thread worker([&]() {
+		std::vector<void*> blocks;
+		for (size_t i = 0; i < NUM_BLOCKS; ++i) {
+			blocks.push_back(cached_alloc(CACHED_ALLOC_MAX_SIZE));
+		}
+		counted = get_live_allocation_count() == pre_live + NUM_BLOCKS;
+		num_made_slabs = get_num_cached_slabs() - pre_slabs;
+		for (void* each : blocks) {
+			cached_free(each);
+		}
+	});
+	worker.join();
+	return counted && num_made_slabs > 0 && get_num_cached_slabs() <= pre_slabs
+		&& get_live_allocation_count() == pre_live;
+}
+
+// samples taken on one thread and dropped on another meet up when a report drains the rings
+GAME_TEST_SERIAL(threadCachedSamplesAcrossThreads, "memory", 5)
+{
+	constexpr size_t NUM_BLOCKS = 300; // more than one ring holds
+	const size_t pre_samples = get_num_live_samples();
+	const unsigned int sample_rate = get_alloc_sample_rate();
+	set_alloc_sample_rate(1);
+	std::vector<void*> blocks;
+	std::thread worker([&blocks]() {
+		for (size_t i = 0; i < NUM_BLOCKS; ++i) {
+			blocks.push_back(cached_alloc(64));
+		}
+	});
+	worker.join();
+	set_alloc_sample_rate(sample_rate);
+	const bool all_live = get_num_live_samples() == pre_samples + NUM_BLOCKS;
+	for (void* each : blocks) {
+		cached_free(each);
+	}
+	return all_live && get_num_live_samples() == pre_samples;
+}
+
+#define QUEUETEST_ITER_PER_THREAD 200'000
+
+// every value pushed comes out exactly once, whichever thread pops it
+GAME_TEST(queueHandoffChecksum, "memory", 1)
+{
+	for (eQueueKind kind : {QUEUE_LOCKED, QUEUE_RING, QUEUE_SEGMENTED}) {
+		// the ring holds every push: a Pop misses values still being written, so with every thread
+		// in Push a smaller ring could stay full for good. queueRingFullProducers covers a full ring
+		const uint core_count = std::max(std::thread::hardware_concurrency(), 2u);
+		ConcurrentQueue<size_t> queue(kind, core_count * QUEUETEST_ITER_PER_THREAD / 2);
+		std::atomic<unsigned long long> popped_sum = 0;
+		std::atomic<size_t> num_popped = 0;
+		std::vector<std::thread> threads;
+		for (uint t = 0; t < core_count; ++t) {
+			threads.emplace_back([&queue, &popped_sum, &num_popped, t]() {
+				unsigned long long sum = 0;
+				size_t count = 0;
+				for (size_t i = 0; i < QUEUETEST_ITER_PER_THREAD; ++i) {
+					if (((i + t) & 1) != 0) {
+						queue.Push(t * QUEUETEST_ITER_PER_THREAD + i + 1);
+					} else {
+						size_t value;
+						if (queue.Pop(&value)) {
+							sum += value;
+							++count;
+						}
+					}
+				}
+				popped_sum += sum;
+				num_popped += count;
+			});
+		}
+		for (auto& each : threads) {
+			each.join();
+		}
+		size_t value;
+		while (queue.Pop(&value)) {
+			popped_sum += value;
+			++num_popped;
+		}
+		unsigned long long pushed_sum = 0;
+		size_t num_pushed = 0;
+		for (uint t = 0; t < core_count; ++t) {
+			for (size_t i = 0; i < QUEUETEST_ITER_PER_THREAD; ++i) {
+				if (((i + t) & 1) != 0) {
+					pushed_sum += t * QUEUETEST_ITER_PER_THREAD + i + 1;
+					++num_pushed;
+				}
+			}
+		}
+		if (popped_sum != pushed_sum || num_popped != num_pushed) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// producers outrun one slow consumer on a tiny ring: a full ring refuses TryPush, and each
+// producer's items come out in the order it pushed them, none lost or doubled
+GAME_TEST(queueRingFullProducers, "memory", 1)
+{
+	RingQueue<size_t> ring(8);
+	size_t value;
+	for (size_t i = 0; i < ring.GetCapacity(); ++i) {
+		if (!ring.TryPush(i)) {
+			return false;
+		}
+	}
+	if (ring.TryPush(0) || !ring.Pop(&value) || value != 0 || !ring.TryPush(0)) {
+		return false;
+	}
+	while (ring.Pop(&value)) {
+	}
+
+	constexpr size_t NUM_PRODUCERS = 4;
+	constexpr size_t ITEMS_PER_PRODUCER = 20'000;
+	std::atomic<size_t> num_refused = 0;
+	std::vector<std::thread> producers;
+	for (size_t t = 0; t < NUM_PRODUCERS; ++t) {
+		producers.emplace_back([&ring, &num_refused, t]() {
+			size_t refused = 0;
+			for (size_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+				// producer in the high bits, sequence in the low ones
+				while (!ring.TryPush((t << 32) | i)) {
+					++refused;
+					std::this_thread::yield();
+				}
+			}
+			num_refused += refused;
+		});
+	}
+	size_t next[NUM_PRODUCERS] = {};
+	size_t num_received = 0;
+	bool in_order = true;
+	while (num_received < NUM_PRODUCERS * ITEMS_PER_PRODUCER) {
+		if (!ring.Pop(&value)) {
+			std::this_thread::yield();
+			continue;
+		}
+		const size_t producer = value >> 32;
+		in_order = in_order && producer < NUM_PRODUCERS && (value & 0xFFFFFFFFu) == next[producer];
+		if (producer < NUM_PRODUCERS) {
+			++next[producer];
+		}
+		++num_received;
+		// slow enough that the producers keep the ring full
+		if ((num_received & 63) == 0) {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+	for (auto& each : producers) {
+		each.join();
+	}
+	return in_order && num_refused > 0 && !ring.Pop(&value)
+		&& std::all_of(next, next + NUM_PRODUCERS, [](size_t n) { return n == ITEMS_PER_PRODUCER; });
+}
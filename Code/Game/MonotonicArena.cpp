@@ -0,0 +1,124 @@
+#include "Game/MonotonicArena.hpp"
+#include "Game/EngineBuildPreferences.hpp"
+#include "Engine/Develop/Memory.hpp"
+#include "Game/AsyncLog.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+static std::mutex s_arenas_lock;
+static std::vector<MonotonicArena*>* s_arenas = nullptr;
+
+static constexpr size_t _get_header_size()
+{
+	constexpr size_t align = alignof(std::max_align_t);
+	return (sizeof(void*) * 3 + align - 1) / align * align;
+}
+
+MonotonicArena::MonotonicArena(const char* name, size_t block_size)
+	: m_name(name)
+	, m_block_size(block_size)
+{
+	std::lock_guard<std::mutex> lock(s_arenas_lock);
+	if (s_arenas == nullptr) {
+		s_arenas = new std::vector<MonotonicArena*>();
+	}
+	s_arenas->push_back(this);
+}
+
+MonotonicArena::~MonotonicArena()
+{
+	_free_blocks();
+	std::lock_guard<std::mutex> lock(s_arenas_lock);
+	s_arenas->erase(std::find(s_arenas->begin(), s_arenas->end(), this));
+	if (s_arenas->empty()) {
+		delete s_arenas;
+		s_arenas = nullptr;
+	}
+}
+
+static unsigned char* _try_alloc_from(unsigned char* data, size_t size, size_t& offset, size_t byte_size, size_t alignment)
+{
+	const uintptr_t begin = (uintptr_t)(data + offset);
+	const uintptr_t aligned = (begin + alignment - 1) / alignment * alignment;
+	const size_t end = (size_t)(aligned - (uintptr_t)data) + byte_size;
+	if (end > size) {
+		return nullptr;
+	}
+	offset = end;
+	return (unsigned char*)aligned;
+}
+
+void* MonotonicArena::alloc(size_t byte_size, size_t alignment)
+{
+	unsigned char* r = nullptr;
+	size_t used_before = 0;
+	if (m_head) {
+		used_before = m_head->m_offset;
+		r = _try_alloc_from((unsigned char*)m_head + _get_header_size(), m_head->m_size, m_head->m_offset, byte_size, alignment);
+	}
+	if (r == nullptr) {
+		_add_block(byte_size + alignment);
+		used_before = 0;
+		r = _try_alloc_from((unsigned char*)m_head + _get_header_size(), m_head->m_size, m_head->m_offset, byte_size, alignment);
+	}
+	m_used_bytes += m_head->m_offset - used_before;
+	m_peak_bytes = std::max(m_peak_bytes, m_used_bytes);
+	return r;
+}
+
+void MonotonicArena::reset()
+{
+	if (m_num_blocks > 1) {
+		// this round spilled over, keep one block big enough for all of it next time
+		const size_t total = m_reserved_bytes;
+		_free_blocks();
+		_add_block(total);
+	}
+	if (m_head) {
+		m_head->m_offset = 0;
+	}
+	m_used_bytes = 0;
+}
+
+void MonotonicArena::log_arenas()
+{
+	std::lock_guard<std::mutex> lock(s_arenas_lock);
+	if (s_arenas == nullptr) {
+		return;
+	}
+	size_t total = 0;
+	for (MonotonicArena* each : *s_arenas) {
+		AsyncLog("memory", "arena %-24s used %10u B, peak %10u B, reserved %10u B in %u block(s)",
+			each->m_name, (unsigned int)each->m_used_bytes, (unsigned int)each->m_peak_bytes,
+			(unsigned int)each->m_reserved_bytes, (unsigned int)each->m_num_blocks);
+		total += each->m_reserved_bytes;
+	}
+	AsyncLog("memory", "%u arena(s) reserving %u B", (unsigned int)s_arenas->size(), (unsigned int)total);
+}
+
+MonotonicArena::arena_block* MonotonicArena::_add_block(size_t min_size)
+{
+	const size_t size = std::max(min_size, m_block_size);
+	arena_block* block = (arena_block*)TrackedAlloc(_get_header_size() + size);
+	block->m_next = m_head;
+	block->m_size = size;
+	block->m_offset = 0;
+	m_head = block;
+	++m_num_blocks;
+	m_reserved_bytes += size;
+	return block;
+}
+
+void MonotonicArena::_free_blocks()
+{
+	while (m_head) {
+		arena_block* next = m_head->m_next;
+		TrackedFree(m_head);
+		m_head = next;
+	}
+	m_num_blocks = 0;
+	m_reserved_bytes = 0;
+	m_used_bytes = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+
+// Bump allocator over TrackedAlloc'd blocks. Nothing is freed individually: reset()
+// drops every allocation at once and keeps the memory for the next use, folding the
+// blocks into a single one so a steady-state user does no heap operations at all.
+// Every live arena shows up in log_arenas(), which the "logmem" command prints.
+class MonotonicArena
+{
+public:
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+public:
+	explicit MonotonicArena(const char* name, size_t block_size = DEFAULT_BLOCK_SIZE);
+	~MonotonicArena();
+	MonotonicArena(const MonotonicArena&) = delete;
+	MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+	void* alloc(size_t byte_size, size_t alignment = alignof(std::max_align_t));
+	template<typename T>
+	T* alloc_array(size_t count) { return static_cast<T*>(alloc(sizeof(T) * count, alignof(T))); }
+	void reset();
+
+	const char* get_name() const { return m_name; }
+	size_t get_used_bytes() const { return m_used_bytes; }
+	size_t get_reserved_bytes() const { return m_reserved_bytes; }
+	size_t get_peak_bytes() const { return m_peak_bytes; }
+	size_t get_num_blocks() const { return m_num_blocks; }
+
+	static void log_arenas();
+
+private:
+	struct arena_block
+	{
+		arena_block* m_next = nullptr;
+		size_t m_size = 0; // usable bytes after the header
+		size_t m_offset = 0;
+	};
+	arena_block* _add_block(size_t min_size);
+	void _free_blocks();
+
+private:
+	const char* m_name = nullptr;
+	size_t m_block_size = DEFAULT_BLOCK_SIZE;
+	arena_block* m_head = nullptr; // block currently allocated from, older ones follow
+	size_t m_num_blocks = 0;
+	size_t m_used_bytes = 0;
+	size_t m_reserved_bytes = 0;
+	size_t m_peak_bytes = 0;
+};
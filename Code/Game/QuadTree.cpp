@@ -0,0 +1,797 @@
+#include "Game/RVSGame.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Game/TraceCapture.hpp"
+#include "Engine/Core/RNG.hpp"
+#include "Engine/Core/Vertex_PCU.hpp"
+#include "Engine/Core/VertexUtils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+// A subtree handed to a worker. It is built into the worker's scratch arena with the
+// subtree root at index 0, then merged into the flat layout in task order.
+struct quad_build_task
+{
+	int m_node = 0; // slot of the subtree root in the final layout
+	size_t m_depth = 0;
+	AABB2 m_box;
+	const unsigned int* m_items = nullptr; // zone indices overlapping the subtree root
+	unsigned int m_num_items = 0;
+	quad_node* m_nodes = nullptr;
+	const unsigned int** m_leaf_items = nullptr; // per node, where its leaf zone list lives
+	unsigned int m_num_nodes = 0;
+	unsigned int m_num_zones = 0;
+};
+
+struct quad_build_scene
+{
+	Zone* m_zones = nullptr;
+	const AABB2* m_bounds = nullptr;
+};
+
+// nodes in a full subtree from depth down to last_depth: 1 + 4 + ... + 4^(last_depth - depth)
+static constexpr unsigned int _get_max_nodes(size_t depth, size_t last_depth)
+{
+	unsigned int r = 0;
+	unsigned int level = 1;
+	for (size_t d = depth; d <= last_depth; ++d) {
+		r += level;
+		level *= 4;
+	}
+	return r;
+}
+
+static void _get_sub_boxes(const AABB2& box, AABB2 out[4])
+{
+	const Vec2 center = box.GetCenter();
+	// <<  <>  ><  >>
+	// 0   1    2   3
+	// III II  IV   I
+	out[0] = AABB2{box.Min, center};
+	out[1] = AABB2{box.Min.x, center.y, center.x, box.Max.y};
+	out[2] = AABB2{center.x, box.Min.y, box.Max.x, center.y};
+	out[3] = AABB2{center, box.Max};
+}
+
+// Classifies every item once into a mask, then copies into exactly sized child lists
+static void _split_items(MonotonicArena& arena, const quad_build_scene& scene,
+	const unsigned int* items, unsigned int num_items, const AABB2& box,
+	const unsigned int* out[4], unsigned int out_count[4])
+{
+	const Vec2 center = box.GetCenter();
+	AABB2 sub_boxes[4];
+	_get_sub_boxes(box, sub_boxes);
+	unsigned char* masks = arena.alloc_array<unsigned char>(num_items);
+	unsigned int counts[4] = {0, 0, 0, 0};
+	for (unsigned int k = 0; k < num_items; ++k) {
+		const AABB2& b = scene.m_bounds[items[k]];
+		const bool candidate[4] = {
+			b.Min.x <= center.x && b.Min.y <= center.y,
+			b.Min.x <= center.x && b.Max.y >= center.y,
+			b.Max.x >= center.x && b.Min.y <= center.y,
+			b.Max.x >= center.x && b.Max.y >= center.y,
+		};
+		const int num_candidates = candidate[0] + candidate[1] + candidate[2] + candidate[3];
+		unsigned char mask = 0;
+		for (unsigned int i = 0; i < 4; ++i) {
+			if (!candidate[i]) {
+				continue;
+			}
+			// bounds touching only one quadrant cannot miss it, skip the polygon test
+			if (num_candidates == 1 || scene.m_zones[items[k]].m_poly.is_overlapping_box(sub_boxes[i])) {
+				mask |= (unsigned char)(1u << i);
+				++counts[i];
+			}
+		}
+		masks[k] = mask;
+	}
+	unsigned int* lists[4];
+	for (unsigned int i = 0; i < 4; ++i) {
+		lists[i] = arena.alloc_array<unsigned int>(counts[i]);
+		out[i] = lists[i];
+		out_count[i] = 0;
+	}
+	for (unsigned int k = 0; k < num_items; ++k) {
+		for (unsigned int i = 0; i < 4; ++i) {
+			if (masks[k] & (1u << i)) {
+				lists[i][out_count[i]++] = items[k];
+			}
+		}
+	}
+}
+
+static int _add_sub_nodes(quad_node* nodes, unsigned int& num_nodes, int node)
+{
+	AABB2 sub_boxes[4];
+	_get_sub_boxes(nodes[node].m_box, sub_boxes);
+	const int first = (int)num_nodes;
+	nodes[node].m_sub = first;
+	for (unsigned int i = 0; i < 4; ++i) {
+		nodes[num_nodes] = quad_node();
+		nodes[num_nodes].m_box = sub_boxes[i];
+		++num_nodes;
+	}
+	return first;
+}
+
+static void _build_subtree(MonotonicArena& arena, const quad_build_scene& scene, quad_build_task& task,
+	int node, const unsigned int* items, unsigned int num_items, size_t depth)
+{
+	if (num_items <= QUAD_ZONE_LIMIT || depth >= QuadTree::MAX_DEPTH) {
+		// the list already lives in scratch, it is copied out when merging
+		task.m_nodes[node].m_first_zone = task.m_num_zones;
+		task.m_nodes[node].m_num_zones = num_items;
+		task.m_leaf_items[node] = items;
+		task.m_num_zones += num_items;
+		return;
+	}
+	const unsigned int* sub_items[4];
+	unsigned int sub_count[4];
+	_split_items(arena, scene, items, num_items, task.m_nodes[node].m_box, sub_items, sub_count);
+	const int first = _add_sub_nodes(task.m_nodes, task.m_num_nodes, node);
+	for (int i = 0; i < 4; ++i) {
+		_build_subtree(arena, scene, task, first + i, sub_items[i], sub_count[i], depth + 1);
+	}
+}
+
+// Splits the top of the tree on the calling thread. The set of tasks only depends on
+// the zones, never on the thread count, so the merged tree is always the same.
+static void _split_top(MonotonicArena& arena, const quad_build_scene& scene, quad_node* nodes, unsigned int& num_nodes,
+	int node, const unsigned int* items, unsigned int num_items, size_t depth,
+	quad_build_task* tasks, unsigned int& num_tasks)
+{
+	if (num_items < QuadTree::PARALLEL_MIN_ZONES || depth >= QuadTree::PARALLEL_SPLIT_DEPTH) {
+		quad_build_task& task = tasks[num_tasks++];
+		task = quad_build_task();
+		task.m_node = node;
+		task.m_depth = depth;
+		task.m_box = nodes[node].m_box;
+		task.m_items = items;
+		task.m_num_items = num_items;
+		return;
+	}
+	const unsigned int* sub_items[4];
+	unsigned int sub_count[4];
+	_split_items(arena, scene, items, num_items, nodes[node].m_box, sub_items, sub_count);
+	const int first = _add_sub_nodes(nodes, num_nodes, node);
+	for (int i = 0; i < 4; ++i) {
+		_split_top(arena, scene, nodes, num_nodes, first + i, sub_items[i], sub_count[i], depth + 1, tasks, num_tasks);
+	}
+}
+
+size_t quad_build_scratch::get_memory_bytes() const
+{
+	size_t r = 0;
+	for (auto& each : m_arenas) {
+		r += each->get_reserved_bytes();
+	}
+	return r;
+}
+
+void QuadTree::build_tree(std::vector<Zone>& zones, size_t num_threads)
+{
+	quad_build_scratch scratch;
+	build_tree(zones, scratch, num_threads);
+}
+
+void QuadTree::build_tree(std::vector<Zone>& zones, quad_build_scratch& build_scratch, size_t num_threads)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	constexpr unsigned int max_top_nodes = _get_max_nodes(0, PARALLEL_SPLIT_DEPTH);
+	constexpr unsigned int max_tasks = _get_max_nodes(PARALLEL_SPLIT_DEPTH, PARALLEL_SPLIT_DEPTH);
+
+	if (num_threads == 0) {
+		num_threads = get_num_task_threads();
+	}
+	num_threads = std::min(num_threads, (size_t)max_tasks);
+	std::vector<std::unique_ptr<MonotonicArena>>& arenas = build_scratch.m_arenas;
+	while (arenas.size() < num_threads) {
+		arenas.emplace_back(std::make_unique<MonotonicArena>("quadtree scratch", 1024 * 1024));
+	}
+	MonotonicArena& main_scratch = *arenas[0];
+	m_arena.reset();
+
+	// zone bounds outlive the build, queries test them before touching polygons
+	m_zone_base = zones.data();
+	m_num_zones = (unsigned int)zones.size();
+	m_zone_bounds = m_arena.alloc_array<AABB2>(zones.size());
+	unsigned int* items = main_scratch.alloc_array<unsigned int>(zones.size());
+	for (unsigned int i = 0; i < m_num_zones; ++i) {
+		m_zone_bounds[i] = get_points_bounds(zones[i].m_poly.m_points);
+		items[i] = i;
+	}
+	quad_build_scene scene;
+	scene.m_zones = zones.data();
+	scene.m_bounds = m_zone_bounds;
+
+	quad_node* top_nodes = main_scratch.alloc_array<quad_node>(max_top_nodes);
+	unsigned int num_top_nodes = 1;
+	top_nodes[0] = quad_node();
+	top_nodes[0].m_box = m_box;
+	quad_build_task* tasks = main_scratch.alloc_array<quad_build_task>(max_tasks);
+	unsigned int num_tasks = 0;
+	_split_top(main_scratch, scene, top_nodes, num_top_nodes, 0, items, (unsigned int)zones.size(), 0, tasks, num_tasks);
+
+	const size_t num_workers = std::min(num_threads, (size_t)num_tasks);
+	std::atomic<unsigned int> next_task = 0;
+	auto run_tasks = [&arenas, &scene, tasks, num_tasks, &next_task](size_t worker) {
+		TRACE_SCOPE("QuadTree::build_subtrees");
+		MonotonicArena& scratch = *arenas[worker];
+		for (unsigned int i = next_task++; i < num_tasks; i = next_task++) {
+			quad_build_task& task = tasks[i];
+			const unsigned int max_nodes = _get_max_nodes(task.m_depth, MAX_DEPTH);
+			task.m_nodes = scratch.alloc_array<quad_node>(max_nodes);
+			task.m_leaf_items = scratch.alloc_array<const unsigned int*>(max_nodes);
+			task.m_nodes[0] = quad_node();
+			task.m_nodes[0].m_box = task.m_box;
+			task.m_num_nodes = 1;
+			_build_subtree(scratch, scene, task, 0, task.m_items, task.m_num_items, task.m_depth);
+		}
+	};
+	run_on_workers(num_workers, run_tasks);
+
+	// the final layout is sized exactly from the tasks
+	m_num_nodes = num_top_nodes;
+	m_num_leaf_zones = 0;
+	for (unsigned int t = 0; t < num_tasks; ++t) {
+		m_num_nodes += tasks[t].m_num_nodes - 1;
+		m_num_leaf_zones += tasks[t].m_num_zones;
+	}
+	m_nodes = m_arena.alloc_array<quad_node>(m_num_nodes);
+	m_leaf_zones = m_arena.alloc_array<Zone*>(m_num_leaf_zones);
+	std::copy(top_nodes, top_nodes + num_top_nodes, m_nodes);
+
+	unsigned int num_nodes = num_top_nodes;
+	unsigned int num_leaf_zones = 0;
+	for (unsigned int t = 0; t < num_tasks; ++t) {
+		const quad_build_task& task = tasks[t];
+		// local node i > 0 goes to node_base + i, the local root replaces its slot
+		const int node_base = (int)num_nodes - 1;
+		for (unsigned int i = 0; i < task.m_num_nodes; ++i) {
+			quad_node node = task.m_nodes[i];
+			if (node.m_sub >= 0) {
+				node.m_sub += node_base;
+			} else {
+				std::transform(task.m_leaf_items[i], task.m_leaf_items[i] + node.m_num_zones,
+					m_leaf_zones + num_leaf_zones + node.m_first_zone,
+					[&scene](unsigned int zone) { return scene.m_zones + zone; });
+			}
+			node.m_first_zone += num_leaf_zones;
+			if (i == 0) {
+				m_nodes[task.m_node] = node;
+			} else {
+				m_nodes[num_nodes++] = node;
+			}
+		}
+		num_leaf_zones += task.m_num_zones;
+	}
+	for (auto& each : arenas) {
+		each->reset();
+	}
+	if (++m_version == 0) {
+		m_version = 1;
+	}
+	reset_tree_flag();
+}
+
+size_t QuadTree::get_memory_bytes() const
+{
+	return m_arena.get_reserved_bytes();
+}
+
+void QuadTree::add_debug_vertices(std::vector<Vertex_PCU>& verts, bool visited_only) const
+{
+	// children always come after their parent, so this draws top-down
+	for (unsigned int n = 0; n < m_num_nodes; ++n) {
+		if (visited_only && !m_visited[n]) {
+			continue;
+		}
+		const AABB2& box = m_nodes[n].m_box;
+		Vec2 tl = box.GetTopLeft();
+		Vec2 bl = box.GetBottomLeft();
+		Vec2 br = box.GetBottomRight();
+		Vec2 tr = box.GetTopRight();
+		AddVerticesOfLine2D(verts, tl, tr, 0.005f, Rgba::GRAY);
+		AddVerticesOfLine2D(verts, tr, br, 0.005f, Rgba::GRAY);
+		AddVerticesOfLine2D(verts, br, bl, 0.005f, Rgba::GRAY);
+		AddVerticesOfLine2D(verts, bl, tl, 0.005f, Rgba::GRAY);
+		if (m_checked[n]) {
+			AddVerticesOfAABB2D(verts, box, Rgba(0,.5f,0,0.3f));
+		}
+	}
+}
+
+ConvexImpactResult QuadTree::raycast_by(const Ray2& ray, bool set_flag)
+{
+	if (set_flag) {
+		return _raycast(ray, &m_visited, &m_checked);
+	}
+	return _raycast(ray, nullptr, nullptr);
+}
+
+ConvexImpactResult QuadTree::_raycast(const Ray2& ray, std::vector<bool>* visited, std::vector<bool>* checked) const
+{
+	ConvexImpactResult result;
+	if (m_num_nodes == 0) {
+		return result;
+	}
+	int stack[4 * (MAX_DEPTH + 1)];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const int n = stack[--top];
+		const quad_node& node = m_nodes[n];
+		if (ray.RaycastToAABB2(node.m_box) < 0) {
+			continue;
+		}
+		if (visited != nullptr) {
+			(*visited)[n] = true;
+		}
+		if (node.m_sub >= 0) {
+			for (int i = 3; i >= 0; --i) {
+				stack[top++] = node.m_sub + i;
+			}
+			continue;
+		}
+		for (unsigned int i = 0; i < node.m_num_zones; ++i) {
+			ConvexImpactResult zoner = m_leaf_zones[node.m_first_zone + i]->m_hull.raycast_by(ray);
+			if (zoner.hit && zoner.k < result.k) {
+				result = zoner;
+			}
+		}
+		//for debug
+		if (checked != nullptr) {
+			(*checked)[n] = true;
+		}
+	}
+	return result;
+}
+
+ConvexImpactResult QuadTree::raycast_cached(const Vec2& start, const Vec2& end, ray_query_cache& cache, bool set_flag)
+{
+	++m_cache_stats.m_queries;
+	const bool same_tree = cache.m_version != 0 && cache.m_version == m_version;
+	if (same_tree && start.x == cache.m_start.x && start.y == cache.m_start.y && end.x == cache.m_end.x && end.y == cache.m_end.y) {
+		++m_cache_stats.m_skipped;
+		m_cache_stats.m_nodes_saved += (unsigned int)cache.m_visited.size();
+		if (set_flag) {
+			for (int n : cache.m_visited) {
+				m_visited[n] = true;
+			}
+			for (int n : cache.m_checked) {
+				m_checked[n] = true;
+			}
+		}
+		return cache.m_result;
+	}
+
+	const Ray2 ray = Ray2::FromPoint(start, end);
+	ConvexImpactResult result;
+	int result_leaf = -1;
+	const int seed_leaf = same_tree ? cache.m_leaf : -1;
+	if (seed_leaf >= 0) {
+		++m_cache_stats.m_seeded;
+		const quad_node& node = m_nodes[seed_leaf];
+		for (unsigned int i = 0; i < node.m_num_zones; ++i) {
+			ConvexImpactResult zoner = m_leaf_zones[node.m_first_zone + i]->m_hull.raycast_by(ray);
+			if (zoner.hit && zoner.k < result.k) {
+				result = zoner;
+				result_leaf = seed_leaf;
+			}
+		}
+	}
+
+	cache.m_visited.clear();
+	cache.m_checked.clear();
+	int stack[4 * (MAX_DEPTH + 1)];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const int n = stack[--top];
+		const quad_node& node = m_nodes[n];
+		const float entry = get_ray_box_entry(ray, start, node.m_box);
+		// a box entered past the closest hit so far cannot hold a closer one
+		if (entry < 0 || (result.hit && entry > result.k)) {
+			continue;
+		}
+		cache.m_visited.push_back(n);
+		if (node.m_sub >= 0) {
+			for (int i = 3; i >= 0; --i) {
+				stack[top++] = node.m_sub + i;
+			}
+			continue;
+		}
+		cache.m_checked.push_back(n);
+		if (n == seed_leaf) {
+			continue;
+		}
+		for (unsigned int i = 0; i < node.m_num_zones; ++i) {
+			ConvexImpactResult zoner = m_leaf_zones[node.m_first_zone + i]->m_hull.raycast_by(ray);
+			if (zoner.hit && zoner.k < result.k) {
+				result = zoner;
+				result_leaf = n;
+			}
+		}
+	}
+	if (seed_leaf >= 0 && result_leaf == seed_leaf) {
+		++m_cache_stats.m_seed_kept;
+	}
+	m_cache_stats.m_nodes_visited += (unsigned int)cache.m_visited.size();
+	if (set_flag) {
+		for (int n : cache.m_visited) {
+			m_visited[n] = true;
+		}
+		for (int n : cache.m_checked) {
+			m_checked[n] = true;
+		}
+	}
+	cache.m_start = start;
+	cache.m_end = end;
+	cache.m_version = m_version;
+	cache.m_leaf = result_leaf;
+	cache.m_result = result;
+	return result;
+}
+
+void QuadTree::reset_tree_flag()
+{
+	m_checked.assign(m_num_nodes, false);
+	m_visited.assign(m_num_nodes, false);
+}
+
+void zone_query_marks::begin(size_t num_zones)
+{
+	if (m_stamps.size() < num_zones) {
+		m_stamps.resize(num_zones, 0);
+	}
+	if (++m_current == 0) {
+		// wrapped around, old stamps could collide with the new ones
+		std::fill(m_stamps.begin(), m_stamps.end(), 0);
+		m_current = 1;
+	}
+}
+
+void QuadTree::query_box(const AABB2& box, zone_query_marks& marks, std::vector<unsigned int>& out) const
+{
+	if (m_num_nodes == 0) {
+		return;
+	}
+	marks.begin(m_num_zones);
+	int stack[4 * (MAX_DEPTH + 1)];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const quad_node& node = m_nodes[stack[--top]];
+		if (!is_overlapping(node.m_box, box)) {
+			continue;
+		}
+		if (node.m_sub >= 0) {
+			for (int i = 3; i >= 0; --i) {
+				stack[top++] = node.m_sub + i;
+			}
+			continue;
+		}
+		// zones in a leaf overlap it, so a leaf inside the box needs no bounds test
+		const bool leaf_inside = is_inside(node.m_box, box);
+		for (unsigned int i = 0; i < node.m_num_zones; ++i) {
+			const unsigned int zone = (unsigned int)(m_leaf_zones[node.m_first_zone + i] - m_zone_base);
+			if (!marks.mark(zone)) {
+				continue;
+			}
+			if (leaf_inside || is_overlapping(m_zone_bounds[zone], box)) {
+				out.push_back(zone);
+			}
+		}
+	}
+}
+
+void QuadTree::gather_visible(const AABB2& view, float pixel_size, zone_query_marks& marks, zone_visible_set& out) const
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	out.m_outlined.clear();
+	out.m_points.clear();
+	query_box(view, marks, out.m_outlined);
+	const float min_size = ZONE_LOD_POINT_PIXELS * pixel_size;
+	size_t num_outlined = 0;
+	for (unsigned int zone : out.m_outlined) {
+		const AABB2& b = m_zone_bounds[zone];
+		if (b.Max.x - b.Min.x < min_size && b.Max.y - b.Min.y < min_size) {
+			out.m_points.push_back(zone);
+		} else {
+			out.m_outlined[num_outlined++] = zone;
+		}
+	}
+	out.m_outlined.resize(num_outlined);
+}
+
+// t is never negative, so its float bits order like unsigned ints and the zone breaks ties
+static unsigned long long _get_sweep_key(float t, unsigned int zone)
+{
+	unsigned int bits;
+	memcpy(&bits, &t, sizeof(bits));
+	return ((unsigned long long)bits << 32) | zone;
+}
+
+static void _fill_sweep_result(const Zone* zones, const disc_move& move, unsigned long long key, disc_cast_result& result)
+{
+	result = disc_cast_result();
+	result.m_position = move.m_start + move.m_move;
+	if (key == ~0ull) {
+		return;
+	}
+	result.m_zone = (unsigned int)(key & 0xFFFFFFFFu);
+	disc_sweep_hit hit;
+	sweep_disc_vs_poly(zones[result.m_zone].m_poly.m_points, move.m_start, move.m_move, move.m_radius, hit);
+	result.m_hit = true;
+	result.m_t = hit.t;
+	result.m_normal = hit.normal;
+	result.m_position = move.m_start + move.m_move * hit.t;
+}
+
+disc_cast_result QuadTree::sweep_disc(const disc_move& move, zone_query_marks& marks) const
+{
+	std::vector<unsigned int> candidates;
+	query_box(get_swept_disc_bounds(move.m_start, move.m_move, move.m_radius), marks, candidates);
+	unsigned long long best = ~0ull;
+	for (unsigned int zone : candidates) {
+		disc_sweep_hit hit;
+		if (sweep_disc_vs_poly(m_zone_base[zone].m_poly.m_points, move.m_start, move.m_move, move.m_radius, hit)) {
+			best = std::min(best, _get_sweep_key(hit.t, zone));
+		}
+	}
+	disc_cast_result result;
+	_fill_sweep_result(m_zone_base, move, best, result);
+	return result;
+}
+
+void QuadTree::sweep_discs(const disc_move* moves, size_t num_moves, disc_cast_result* results,
+	disc_sweep_scratch& scratch, size_t num_threads) const
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	if (m_num_nodes == 0) {
+		for (size_t i = 0; i < num_moves; ++i) {
+			_fill_sweep_result(m_zone_base, moves[i], ~0ull, results[i]);
+		}
+		return;
+	}
+	if (scratch.m_best_capacity < num_moves) {
+		scratch.m_best = std::make_unique<std::atomic<unsigned long long>[]>(num_moves);
+		scratch.m_best_capacity = num_moves;
+	}
+	std::atomic<unsigned long long>* best = scratch.m_best.get();
+
+	// walk the tree once per move, only recording which leaves it touches
+	scratch.m_bounds.resize(num_moves);
+	scratch.m_pair_leaves.clear();
+	scratch.m_pair_moves.clear();
+	for (unsigned int m = 0; m < (unsigned int)num_moves; ++m) {
+		const AABB2 bounds = get_swept_disc_bounds(moves[m].m_start, moves[m].m_move, moves[m].m_radius);
+		scratch.m_bounds[m] = bounds;
+		best[m].store(~0ull, std::memory_order_relaxed);
+		int stack[4 * (MAX_DEPTH + 1)];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const int n = stack[--top];
+			const quad_node& node = m_nodes[n];
+			if (!is_overlapping(node.m_box, bounds)) {
+				continue;
+			}
+			if (node.m_sub >= 0) {
+				for (int i = 3; i >= 0; --i) {
+					stack[top++] = node.m_sub + i;
+				}
+			} else if (node.m_num_zones > 0) {
+				scratch.m_pair_leaves.push_back((unsigned int)n);
+				scratch.m_pair_moves.push_back(m);
+			}
+		}
+	}
+
+	// counting sort the pairs so every leaf sees its moves together
+	scratch.m_leaf_first.assign(m_num_nodes + 1, 0);
+	for (unsigned int leaf : scratch.m_pair_leaves) {
+		++scratch.m_leaf_first[leaf + 1];
+	}
+	scratch.m_leaves.clear();
+	for (unsigned int n = 0; n < m_num_nodes; ++n) {
+		if (scratch.m_leaf_first[n + 1] > 0) {
+			scratch.m_leaves.push_back(n);
+		}
+		scratch.m_leaf_first[n + 1] += scratch.m_leaf_first[n];
+	}
+	scratch.m_moves.resize(scratch.m_pair_moves.size());
+	for (size_t p = 0; p < scratch.m_pair_moves.size(); ++p) {
+		scratch.m_moves[scratch.m_leaf_first[scratch.m_pair_leaves[p]]++] = scratch.m_pair_moves[p];
+	}
+	// filling advanced every start to the next leaf's start, shift them back
+	for (unsigned int n = m_num_nodes; n > 0; --n) {
+		scratch.m_leaf_first[n] = scratch.m_leaf_first[n - 1];
+	}
+	scratch.m_leaf_first[0] = 0;
+
+	const unsigned int num_leaves = (unsigned int)scratch.m_leaves.size();
+	std::atomic<unsigned int> next_leaf = 0;
+	auto run_leaves = [this, moves, best, &scratch, num_leaves, &next_leaf](size_t) {
+		TRACE_SCOPE("QuadTree::sweep_leaves");
+		for (unsigned int l = next_leaf++; l < num_leaves; l = next_leaf++) {
+			const unsigned int n = scratch.m_leaves[l];
+			const quad_node& node = m_nodes[n];
+			for (unsigned int p = scratch.m_leaf_first[n]; p < scratch.m_leaf_first[n + 1]; ++p) {
+				const unsigned int m = scratch.m_moves[p];
+				const disc_move& move = moves[m];
+				std::atomic<unsigned long long>& slot = best[m];
+				for (unsigned int i = 0; i < node.m_num_zones; ++i) {
+					const unsigned int zone = (unsigned int)(m_leaf_zones[node.m_first_zone + i] - m_zone_base);
+					if (!is_overlapping(m_zone_bounds[zone], scratch.m_bounds[m])) {
+						continue;
+					}
+					disc_sweep_hit hit;
+					if (!sweep_disc_vs_poly(m_zone_base[zone].m_poly.m_points, move.m_start, move.m_move, move.m_radius, hit)) {
+						continue;
+					}
+					// a zone in several leaves may be tested twice, min keeps that harmless
+					const unsigned long long key = _get_sweep_key(hit.t, zone);
+					unsigned long long current = slot.load(std::memory_order_relaxed);
+					while (key < current && !slot.compare_exchange_weak(current, key, std::memory_order_relaxed)) {
+					}
+				}
+			}
+		}
+	};
+	if (num_threads == 0) {
+		num_threads = get_num_task_threads();
+	}
+	if (num_moves < PARALLEL_MIN_MOVES) {
+		num_threads = 1;
+	}
+	num_threads = std::min(num_threads, (size_t)std::max(1u, num_leaves));
+	run_on_workers(num_threads, run_leaves);
+
+	for (size_t m = 0; m < num_moves; ++m) {
+		_fill_sweep_result(m_zone_base, moves[m], best[m].load(std::memory_order_relaxed), results[m]);
+	}
+}
+
+static bool _is_closer(const zone_distance& a, const zone_distance& b)
+{
+	return a.m_distance < b.m_distance || (a.m_distance == b.m_distance && a.m_zone < b.m_zone);
+}
+
+void QuadTree::find_nearest(const Vec2& point, size_t k, float max_distance, zone_nearest_scratch& scratch,
+	std::vector<zone_distance>& out) const
+{
+	out.clear();
+	if (m_num_nodes == 0 || k == 0) {
+		return;
+	}
+	scratch.m_marks.begin(m_num_zones);
+	auto& heap = scratch.m_nodes;
+	const auto further = [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; };
+	heap.clear();
+	heap.emplace_back(get_box_distance(m_nodes[0].m_box, point), 0);
+	// out is a max-heap on _is_closer until the end, its front is the k-th best so far
+	float bound = max_distance;
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), further);
+		const auto [distance, n] = heap.back();
+		heap.pop_back();
+		if (distance > bound) {
+			// everything left in the heap is at least this far
+			break;
+		}
+		const quad_node& node = m_nodes[n];
+		if (node.m_sub >= 0) {
+			for (int i = 0; i < 4; ++i) {
+				const float d = get_box_distance(m_nodes[node.m_sub + i].m_box, point);
+				if (d <= bound) {
+					heap.emplace_back(d, node.m_sub + i);
+					std::push_heap(heap.begin(), heap.end(), further);
+				}
+			}
+			continue;
+		}
+		for (unsigned int i = 0; i < node.m_num_zones; ++i) {
+			const unsigned int zone = (unsigned int)(m_leaf_zones[node.m_first_zone + i] - m_zone_base);
+			// the bound only shrinks, so a zone skipped here would be skipped in its other leaves too
+			if (!scratch.m_marks.mark(zone) || get_box_distance(m_zone_bounds[zone], point) > bound) {
+				continue;
+			}
+			zone_distance found;
+			found.m_zone = zone;
+			found.m_distance = get_poly_distance(m_zone_base[zone].m_poly.m_points, point, found.m_closest);
+			if (found.m_distance > bound || (out.size() == k && !_is_closer(found, out.front()))) {
+				continue;
+			}
+			out.push_back(found);
+			std::push_heap(out.begin(), out.end(), _is_closer);
+			if (out.size() > k) {
+				std::pop_heap(out.begin(), out.end(), _is_closer);
+				out.pop_back();
+			}
+			if (out.size() == k) {
+				bound = std::min(bound, out.front().m_distance);
+			}
+		}
+	}
+	std::sort_heap(out.begin(), out.end(), _is_closer);
+}
+
+void QuadTree::find_nearest_batch(const Vec2* points, size_t num_points, size_t k, float max_distance,
+	zone_distance* out, size_t num_threads) const
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	if (num_threads == 0) {
+		num_threads = get_num_task_threads();
+	}
+	if (num_points < PARALLEL_MIN_POINTS) {
+		num_threads = 1;
+	}
+	// contiguous chunks, so nearby points given in order stay on one thread's cache; they are
+	// only cut finer when other threads run out of work
+	const size_t grain = std::max(num_points / (num_threads * TaskScheduler::CHUNKS_PER_THREAD), (size_t)16);
+	auto run_chunk = [this, points, k, max_distance, out](size_t begin, size_t end) {
+		TRACE_SCOPE("QuadTree::find_nearest_chunk");
+		zone_nearest_scratch scratch;
+		std::vector<zone_distance> found;
+		found.reserve(k + 1);
+		for (size_t p = begin; p < end; ++p) {
+			find_nearest(points[p], k, max_distance, scratch, found);
+			std::copy(found.begin(), found.end(), out + p * k);
+			std::fill(out + p * k + found.size(), out + (p + 1) * k, zone_distance());
+		}
+	};
+	if (num_threads == 1) {
+		run_chunk(0, num_points);
+		return;
+	}
+	parallel_for(0, num_points, grain, run_chunk);
+}
+
+void generate_random_zones(std::vector<Zone>& zones, size_t num_zones, float radius_min, float radius_max)
+{
+	zones.reserve(zones.size() + num_zones);
+	for (size_t i = 0; i < num_zones; ++i) {
+		Zone zone;
+		zone.m_poly = ConvexPoly::GetRandomPoly(g_rng.GetFloatInRange(radius_min, radius_max));
+		zone.m_position = Vec2 {g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1)};
+		zone.m_poly.move_by(zone.m_position);
+		zone.m_hull = ConvexHull2(zone.m_poly);
+		zones.emplace_back(zone);
+	}
+}
+
+void generate_random_animations(std::vector<zone_animation>& animations, size_t num_zones, size_t num_moving)
+{
+	animations.assign(num_zones, zone_animation());
+	for (size_t i = 0; i < std::min(num_zones, num_moving); ++i) {
+		zone_animation& each = animations[i];
+		each.m_velocity = Vec2(g_rng.GetFloatInRange(-0.2f, 0.2f), g_rng.GetFloatInRange(-0.2f, 0.2f));
+		each.m_spin = g_rng.GetFloatInRange(-90.f, 90.f);
+		each.m_pulse = g_rng.GetFloatInRange(0.f, 0.2f);
+		each.m_pulse_period = g_rng.GetFloatInRange(0.5f, 2.f);
+	}
+}
+
+void animate_zones(std::vector<Zone>& zones, std::vector<zone_animation>& animations, float delta_seconds)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	for (size_t i = 0; i < zones.size(); ++i) {
+		zone_animation& anim = animations[i];
+		if (anim.m_velocity.x == 0.f && anim.m_velocity.y == 0.f && anim.m_spin == 0.f && anim.m_pulse == 0.f) {
+			continue;
+		}
+		Zone& zone = zones[i];
+		if ((zone.m_position.x < -1.f && anim.m_velocity.x < 0.f) || (zone.m_position.x > 1.f && anim.m_velocity.x > 0.f)) {
+			anim.m_velocity.x = -anim.m_velocity.x;
+		}
+		if ((zone.m_position.y < -1.f && anim.m_velocity.y < 0.f) || (zone.m_position.y > 1.f && anim.m_velocity.y > 0.f)) {
+			anim.m_velocity.y = -anim.m_velocity.y;
+		}
+		anim.m_time += delta_seconds;
+		const bool growing = fmodf(anim.m_time, anim.m_pulse_period) < anim.m_pulse_period * 0.5f;
+		const float scale_by = anim.m_pulse * delta_seconds * (growing ? 1.f : -1.f);
+		zone.transform(anim.m_velocity * delta_seconds, anim.m_spin * delta_seconds, scale_by);
+	}
+}
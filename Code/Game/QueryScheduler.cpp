@@ -0,0 +1,129 @@
+#include "Game/QueryScheduler.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+#include <atomic>
+#include "Game/TaskScheduler.hpp"
+#include <cmath>
+
+void query_latency_histogram::add(double seconds)
+{
+	const double micro = std::max(seconds * 1e6, 1.0);
+	const int bucket = std::min((int)std::log2(micro), NUM_BUCKETS - 1);
+	++m_buckets[bucket];
+	++m_count;
+}
+
+double query_latency_histogram::get_percentile(float fraction) const
+{
+	if (m_count == 0) {
+		return 0.0;
+	}
+	const unsigned int wanted = (unsigned int)std::ceil(fraction * (float)m_count);
+	unsigned int sum = 0;
+	for (int i = 0; i < NUM_BUCKETS; ++i) {
+		sum += m_buckets[i];
+		if (sum >= wanted) {
+			return std::ldexp(1.0, i + 1) * 1e-6;
+		}
+	}
+	return std::ldexp(1.0, NUM_BUCKETS) * 1e-6;
+}
+
+void query_latency_histogram::reset()
+{
+	*this = query_latency_histogram();
+}
+
+void QueryScheduler::submit(scheduled_query_fn fn, void* user, unsigned int index, int priority, unsigned int deadline_frames)
+{
+	pending_query query;
+	query.m_fn = fn;
+	query.m_user = user;
+	query.m_index = index;
+	query.m_priority = priority;
+	query.m_deadline = m_frame + deadline_frames;
+	query.m_sequence = m_sequence++;
+	query.m_submit_frame = m_frame;
+	query.m_submit_time = GetCurrentTimeSeconds();
+	m_pending.push_back(query);
+}
+
+const query_frame_stats& QueryScheduler::run_frame(double budget_seconds, size_t num_threads)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	const double begin = GetCurrentTimeSeconds();
+	const double end_time = begin + budget_seconds;
+	const unsigned int frame = m_frame;
+	m_last_frame = query_frame_stats();
+
+	// due ones first, then higher priority, then older
+	std::sort(m_pending.begin(), m_pending.end(), [frame](const pending_query& a, const pending_query& b) {
+		const bool a_due = a.m_deadline <= frame;
+		const bool b_due = b.m_deadline <= frame;
+		if (a_due != b_due) {
+			return a_due;
+		}
+		if (a.m_priority != b.m_priority) {
+			return a.m_priority > b.m_priority;
+		}
+		return a.m_sequence < b.m_sequence;
+	});
+	const unsigned int num_pending = (unsigned int)m_pending.size();
+	unsigned int num_due = 0;
+	while (num_due < num_pending && m_pending[num_due].m_deadline <= frame) {
+		++num_due;
+	}
+
+	m_done.assign(num_pending, 0);
+	std::atomic<unsigned int> next = 0;
+	std::atomic<unsigned int> num_forced = 0;
+	auto run_queries = [this, num_pending, num_due, end_time, &next, &num_forced](size_t) {
+		TRACE_SCOPE("QueryScheduler::run_queries");
+		bool out_of_time = false;
+		unsigned int since_clock = CLOCK_STRIDE - 1; // check right away, due queries may have used the budget
+		for (unsigned int i = next++; i < num_pending; i = next++) {
+			if (i >= num_due) {
+				if (!out_of_time && ++since_clock >= CLOCK_STRIDE) {
+					since_clock = 0;
+					out_of_time = GetCurrentTimeSeconds() >= end_time;
+				}
+				if (out_of_time) {
+					break;
+				}
+			} else if (GetCurrentTimeSeconds() >= end_time) {
+				++num_forced;
+			}
+			const pending_query& query = m_pending[i];
+			query.m_fn(query.m_user, query.m_index);
+			m_done[i] = 1;
+		}
+	};
+	run_on_workers(num_pending > CLOCK_STRIDE ? std::min(num_threads, get_num_task_threads()) : 1, run_queries);
+
+	// latencies are stamped on the main thread, after the workers are done
+	const double now = GetCurrentTimeSeconds();
+	m_carried.clear();
+	for (unsigned int i = 0; i < num_pending; ++i) {
+		const pending_query& query = m_pending[i];
+		if (m_done[i]) {
+			m_latency.add(now - query.m_submit_time);
+			++m_frames_waited[std::min(frame - query.m_submit_frame, MAX_FRAMES_WAITED - 1)];
+			++m_last_frame.m_run;
+		} else {
+			m_carried.push_back(query);
+		}
+	}
+	std::swap(m_pending, m_carried);
+	m_last_frame.m_forced = num_forced;
+	m_last_frame.m_carried = (unsigned int)m_pending.size();
+	m_last_frame.m_seconds = now - begin;
+	++m_frame;
+	return m_last_frame;
+}
+
+void QueryScheduler::reset_latency()
+{
+	m_latency.reset();
+	std::fill(m_frames_waited, m_frames_waited + MAX_FRAMES_WAITED, 0u);
+}
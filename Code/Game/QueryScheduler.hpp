@@ -0,0 +1,73 @@
+#pragma once
+#include "Engine/Core/EngineCommon.hpp"
+#include <vector>
+
+// run one query, index is whatever the submitter passed along
+typedef void (*scheduled_query_fn)(void* user, unsigned int index);
+
+// Latency from submit to completion in power of two microsecond buckets
+struct query_latency_histogram
+{
+	static constexpr int NUM_BUCKETS = 24; // the last one also takes everything slower
+	unsigned int m_buckets[NUM_BUCKETS] = {};
+	unsigned int m_count = 0;
+
+	void add(double seconds);
+	// upper edge of the bucket holding the given fraction, in seconds
+	double get_percentile(float fraction) const;
+	void reset();
+};
+
+struct query_frame_stats
+{
+	unsigned int m_run = 0;
+	unsigned int m_forced = 0; // ran past the budget because their deadline was this frame
+	unsigned int m_carried = 0; // left for the next frame
+	double m_seconds = 0.0;
+};
+
+// Runs queued queries inside a per-frame time budget. Queries whose deadline has come run
+// no matter what, then the rest by priority and age until the budget is spent; whatever is
+// left waits for the next frame. Submitting and run_frame are main thread only.
+class QueryScheduler
+{
+public:
+	// the clock is read once per this many queries
+	static constexpr unsigned int CLOCK_STRIDE = 16;
+	static constexpr unsigned int MAX_FRAMES_WAITED = 16;
+public:
+	// deadline_frames = 0 means it has to run in the next run_frame
+	void submit(scheduled_query_fn fn, void* user, unsigned int index, int priority, unsigned int deadline_frames);
+	// num_threads > 1 also runs queries on scheduler tasks, so their functions must be thread safe
+	const query_frame_stats& run_frame(double budget_seconds, size_t num_threads = 1);
+	size_t get_num_pending() const { return m_pending.size(); }
+	const query_frame_stats& get_last_frame() const { return m_last_frame; }
+	// since the last reset_latency
+	const query_latency_histogram& get_latency() const { return m_latency; }
+	// completed queries by whole frames waited, the last entry also takes every longer wait
+	const unsigned int* get_frames_waited() const { return m_frames_waited; }
+	void reset_latency();
+
+private:
+	struct pending_query
+	{
+		scheduled_query_fn m_fn;
+		void* m_user;
+		unsigned int m_index;
+		int m_priority;
+		unsigned int m_deadline; // frame number
+		unsigned int m_sequence; // submit order, the tie breaker
+		unsigned int m_submit_frame;
+		double m_submit_time;
+	};
+
+private:
+	std::vector<pending_query> m_pending;
+	std::vector<pending_query> m_carried;
+	std::vector<unsigned char> m_done;
+	unsigned int m_frame = 0;
+	unsigned int m_sequence = 0;
+	query_frame_stats m_last_frame;
+	query_latency_histogram m_latency; // seconds from submit to completion
+	unsigned int m_frames_waited[MAX_FRAMES_WAITED] = {};
+};
@@ -0,0 +1,1060 @@
+#include "Game/RVSBenchmark.hpp"
+#include "Game/RVSGame.hpp"
+#include "Game/EntityStore.hpp"
+#include "Game/ZoneVisibility.hpp"
+#include "Game/ZoneAsyncQueries.hpp"
+#include "Game/ZoneScene.hpp"
+#include "Game/ZoneCorpus.hpp"
+#include "Game/LockFreeQueue.hpp"
+#include "Game/ThreadCachedAlloc.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Game/GameEvents.hpp"
+#include "Engine/Core/RNG.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/Develop/Log.hpp"
+#include "Game/AsyncLog.hpp"
+#include "Engine/Develop/Memory.hpp"
+#include "Engine/Event/EventSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <thread>
+
+// a seeded corpus scene, corpus=<family> seed=<n>; every family keeps the density of its 20k
+// scene no matter how many zones are asked for
+static void _generate_bench_zones(NamedStrings& param, std::vector<Zone>& zones, size_t num_zones)
+{
+	zone_corpus_family family = ZONE_CORPUS_UNIFORM;
+	const std::string name = param.GetString("corpus", "uniform");
+	if (!find_zone_corpus_family(name, family)) {
+		AsyncLog("bench", "no corpus family %s, using uniform", name.c_str());
+	}
+	generate_zone_corpus(family, (uint32_t)param.GetInt("seed", 1), num_zones, zones);
+}
+
+// uniform in [min,max], from the corpus seed so a run can be repeated
+static void _generate_bench_points(NamedStrings& param, std::vector<Vec2>& points, float min, float max)
+{
+	const size_t num_points = points.size();
+	generate_point_workload((uint32_t)param.GetInt("seed", 1), {}, num_points, 0.f, points);
+	for (Vec2& each : points) {
+		each = Vec2(min, min) + (each + Vec2(1.f, 1.f)) * (0.5f * (max - min));
+	}
+}
+
+static bool _bench_qt_build(NamedStrings& param)
+{
+	const size_t num_threads = (size_t)param.GetInt("threads", 0);
+	const size_t counts[] = {10'000, 100'000, 1'000'000};
+	for (size_t count : counts) {
+		std::vector<Zone> zones;
+		_generate_bench_zones(param, zones, count);
+
+		QuadTree serial(AABB2(-1,-1,1,1));
+		const double serial_begin = GetCurrentTimeSeconds();
+		serial.build_tree(zones, 1);
+		const double serial_time = GetCurrentTimeSeconds() - serial_begin;
+
+		QuadTree parallel(AABB2(-1,-1,1,1));
+		quad_build_scratch scratch;
+		const double parallel_begin = GetCurrentTimeSeconds();
+		parallel.build_tree(zones, scratch, num_threads);
+		const double parallel_time = GetCurrentTimeSeconds() - parallel_begin;
+
+		const double rebuild_begin = GetCurrentTimeSeconds();
+		parallel.build_tree(zones, scratch, num_threads);
+		const double rebuild_time = GetCurrentTimeSeconds() - rebuild_begin;
+
+		AsyncLog("bench", "quadtree build %7u zones: serial %8.3fms, parallel(%u) %8.3fms, rebuild %8.3fms, %u nodes, %u KB + %u KB scratch",
+			(unsigned int)count, serial_time * 1000.0, (unsigned int)num_threads, parallel_time * 1000.0,
+			rebuild_time * 1000.0, parallel.m_num_nodes, (unsigned int)(parallel.get_memory_bytes() / 1024),
+			(unsigned int)(scratch.get_memory_bytes() / 1024));
+	}
+	AsyncLogFlush();
+	return true;
+}
+
+// visible set extraction for shrinking views over one scene, no renderer involved
+static bool _bench_visible(NamedStrings& param)
+{
+	const size_t count = (size_t)param.GetInt("zones", 100'000);
+	const int resolution = param.GetInt("resolution", 1350);
+	constexpr int num_iterations = 20;
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, count);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+
+	zone_query_marks marks;
+	zone_visible_set visible;
+	for (float half_size = 1.f; half_size >= 0.06f; half_size *= 0.25f) {
+		const AABB2 view(-half_size, -half_size, half_size, half_size);
+		const float pixel_size = 2.f * half_size / (float)resolution;
+		const double begin = GetCurrentTimeSeconds();
+		for (int i = 0; i < num_iterations; ++i) {
+			tree.gather_visible(view, pixel_size, marks, visible);
+		}
+		const double time = (GetCurrentTimeSeconds() - begin) / num_iterations;
+		AsyncLog("bench", "visible set %7u zones, view %5.3f: %8.3fms, %7u outlined, %7u points",
+			(unsigned int)count, 2.f * half_size, time * 1000.0,
+			(unsigned int)visible.m_outlined.size(), (unsigned int)visible.m_points.size());
+	}
+	AsyncLogFlush();
+	return true;
+}
+
+// what Entity looked like before the store: one heap object per entity, virtual update
+class _LegacyEntity
+{
+public:
+	virtual ~_LegacyEntity() = default;
+	virtual void Update(float deltaSeconds)
+	{
+		m_velocity += m_acceleration * deltaSeconds;
+		m_position += m_velocity * deltaSeconds;
+	}
+	Vec2 m_position;
+	Vec2 m_velocity;
+	Vec2 m_acceleration;
+	float m_orientationDegrees = 0.f;
+	float m_angularVelocity = 0.f;
+	float m_angularAcceleration = 0.f;
+	float m_radiusPhysics = 0.f;
+	float m_radiusCosmetic = 0.f;
+	bool m_flagDead = false;
+	bool m_flagGarbage = false;
+};
+
+static bool _bench_entities(NamedStrings& param)
+{
+	const size_t num_threads = (size_t)param.GetInt("threads", (int)get_num_task_threads());
+	constexpr int num_frames = 100;
+	constexpr float dt = 1.f / 60.f;
+	const size_t counts[] = {1'000, 100'000};
+	for (size_t count : counts) {
+		std::vector<_LegacyEntity*> legacy;
+		EntityStore store;
+		for (size_t i = 0; i < count; ++i) {
+			const Vec2 position(g_rng.GetFloatInRange(-1, 1), g_rng.GetFloatInRange(-1, 1));
+			const Vec2 acceleration(g_rng.GetFloatInRange(-1, 1), g_rng.GetFloatInRange(-1, 1));
+			_LegacyEntity* entity = new _LegacyEntity();
+			entity->m_position = position;
+			entity->m_acceleration = acceleration;
+			legacy.push_back(entity);
+			store.Create(position);
+			store.m_accelerationX.back() = acceleration.x;
+			store.m_accelerationY.back() = acceleration.y;
+			store.m_angularAcceleration.back() = g_rng.GetFloatInRange(-10, 10);
+		}
+
+		double begin = GetCurrentTimeSeconds();
+		for (int f = 0; f < num_frames; ++f) {
+			for (_LegacyEntity* each : legacy) {
+				each->Update(dt);
+			}
+		}
+		const double legacy_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+
+		begin = GetCurrentTimeSeconds();
+		for (int f = 0; f < num_frames; ++f) {
+			store.UpdateScalar(dt);
+		}
+		const double scalar_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+
+		begin = GetCurrentTimeSeconds();
+		for (int f = 0; f < num_frames; ++f) {
+			store.Update(dt, 1);
+		}
+		const double simd_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+
+		begin = GetCurrentTimeSeconds();
+		for (int f = 0; f < num_frames; ++f) {
+			store.Update(dt, num_threads);
+		}
+		const double parallel_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+
+		AsyncLog("bench", "entity update %6u: virtual %7.3fms, soa scalar %7.3fms, soa simd %7.3fms, soa simd x%u %7.3fms",
+			(unsigned int)count, legacy_time * 1000.0, scalar_time * 1000.0, simd_time * 1000.0,
+			(unsigned int)num_threads, parallel_time * 1000.0);
+		for (_LegacyEntity* each : legacy) {
+			delete each;
+		}
+	}
+	AsyncLogFlush();
+	return true;
+}
+
+// one frame of agent moves against a 20k zone scene: a query per agent vs the batched walk
+static bool _bench_sweep(NamedStrings& param)
+{
+	const size_t num_threads = (size_t)param.GetInt("threads", (int)get_num_task_threads());
+	const size_t num_agents = (size_t)param.GetInt("agents", 100'000);
+	constexpr int num_frames = 10;
+	constexpr float dt = 1.f / 60.f;
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, 20480);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+
+	EntityStore store;
+	for (size_t i = 0; i < num_agents; ++i) {
+		store.Create(Vec2(g_rng.GetFloatInRange(-1, 1), g_rng.GetFloatInRange(-1, 1)), g_rng.GetFloatInRange(0.002f, 0.01f));
+		store.m_velocityX.back() = g_rng.GetFloatInRange(-0.5f, 0.5f);
+		store.m_velocityY.back() = g_rng.GetFloatInRange(-0.5f, 0.5f);
+	}
+	std::vector<disc_move> moves;
+	store.GetMoves(dt, moves);
+	std::vector<disc_cast_result> results(moves.size());
+
+	zone_query_marks marks;
+	double begin = GetCurrentTimeSeconds();
+	for (int f = 0; f < num_frames; ++f) {
+		for (size_t m = 0; m < moves.size(); ++m) {
+			results[m] = tree.sweep_disc(moves[m], marks);
+		}
+	}
+	const double single_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+
+	disc_sweep_scratch scratch;
+	begin = GetCurrentTimeSeconds();
+	for (int f = 0; f < num_frames; ++f) {
+		tree.sweep_discs(moves.data(), moves.size(), results.data(), scratch, 1);
+	}
+	const double batch_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+
+	begin = GetCurrentTimeSeconds();
+	for (int f = 0; f < num_frames; ++f) {
+		tree.sweep_discs(moves.data(), moves.size(), results.data(), scratch, num_threads);
+	}
+	const double parallel_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+
+	size_t num_hits = 0;
+	for (auto& each : results) {
+		num_hits += each.m_hit ? 1 : 0;
+	}
+	AsyncLog("bench", "disc sweep %6u agents: per query %7.3fms, batched %7.3fms, batched x%u %7.3fms, %u hits",
+		(unsigned int)num_agents, single_time * 1000.0, batch_time * 1000.0,
+		(unsigned int)num_threads, parallel_time * 1000.0, (unsigned int)num_hits);
+	AsyncLogFlush();
+	return true;
+}
+
+// per-frame index maintenance with moving zones: BVH refit vs rebuilding an index every frame
+static bool _bench_refit(NamedStrings& param)
+{
+	const size_t count = (size_t)param.GetInt("zones", 20480);
+	const size_t num_moving = (size_t)param.GetInt("moving", 4096);
+	constexpr int num_frames = 120;
+	constexpr float dt = 1.f / 60.f;
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, count);
+	std::vector<zone_animation> animations;
+	generate_random_animations(animations, zones.size(), num_moving);
+
+	ZoneBVH bvh;
+	bvh.build(zones);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	double update_time = 0.0;
+	double bvh_build_time = 0.0;
+	double qt_build_time = 0.0;
+	int num_results[3] = {};
+	for (int f = 0; f < num_frames; ++f) {
+		animate_zones(zones, animations, dt);
+
+		double begin = GetCurrentTimeSeconds();
+		++num_results[bvh.update(zones)];
+		update_time += GetCurrentTimeSeconds() - begin;
+
+		ZoneBVH fresh;
+		begin = GetCurrentTimeSeconds();
+		fresh.build(zones);
+		bvh_build_time += GetCurrentTimeSeconds() - begin;
+
+		begin = GetCurrentTimeSeconds();
+		tree.build_tree(zones);
+		qt_build_time += GetCurrentTimeSeconds() - begin;
+	}
+	AsyncLog("bench", "bvh %6u zones, %6u moving: update %7.3fms/frame (%d refit, %d rebalanced, %d rebuilt), "
+		"bvh build %7.3fms, quadtree build %7.3fms, cost %.2f (built %.2f)",
+		(unsigned int)count, (unsigned int)std::min(num_moving, count), update_time * 1000.0 / num_frames,
+		num_results[ZoneBVH::BVH_REFITTED], num_results[ZoneBVH::BVH_REBALANCED], num_results[ZoneBVH::BVH_REBUILT],
+		bvh_build_time * 1000.0 / num_frames, qt_build_time * 1000.0 / num_frames, bvh.get_cost(), bvh.get_built_cost());
+	AsyncLogFlush();
+	return true;
+}
+
+// zone-vs-zone overlap over a 20k scene: build, pairs, SAT, and the incremental update with movers
+static bool _bench_overlap(NamedStrings& param)
+{
+	const size_t count = (size_t)param.GetInt("zones", 20480);
+	const size_t num_moving = (size_t)param.GetInt("moving", 4096);
+	constexpr int num_frames = 60;
+	constexpr float dt = 1.f / 60.f;
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, count);
+	std::vector<zone_animation> animations;
+	generate_random_animations(animations, zones.size(), num_moving);
+	std::vector<unsigned int> moved(std::min(num_moving, count));
+	for (unsigned int i = 0; i < (unsigned int)moved.size(); ++i) {
+		moved[i] = i;
+	}
+
+	ZoneSweepAndPrune sap;
+	double begin = GetCurrentTimeSeconds();
+	sap.build(zones);
+	const double build_time = GetCurrentTimeSeconds() - begin;
+
+	std::vector<zone_pair> candidates;
+	std::vector<zone_pair> overlapping;
+	begin = GetCurrentTimeSeconds();
+	sap.find_pairs(candidates);
+	const double pairs_time = GetCurrentTimeSeconds() - begin;
+	begin = GetCurrentTimeSeconds();
+	filter_overlapping_pairs(zones, candidates, overlapping);
+	const double sat_time = GetCurrentTimeSeconds() - begin;
+
+	// the quadratic baseline on bounds alone
+	begin = GetCurrentTimeSeconds();
+	size_t num_brute = 0;
+	for (unsigned int i = 0; i < (unsigned int)zones.size(); ++i) {
+		for (unsigned int j = i + 1; j < (unsigned int)zones.size(); ++j) {
+			num_brute += is_overlapping(sap.get_zone_bounds(i), sap.get_zone_bounds(j)) ? 1 : 0;
+		}
+	}
+	const double brute_time = GetCurrentTimeSeconds() - begin;
+
+	double update_time = 0.0;
+	size_t num_swaps = 0;
+	for (int f = 0; f < num_frames; ++f) {
+		animate_zones(zones, animations, dt);
+		begin = GetCurrentTimeSeconds();
+		sap.update(zones, moved.data(), moved.size());
+		update_time += GetCurrentTimeSeconds() - begin;
+		num_swaps += sap.get_last_num_swaps();
+	}
+
+	AsyncLog("bench", "overlap %6u zones: sap build %7.3fms, pairs %7.3fms (%u), sat %7.3fms (%u), brute force bounds %8.3fms (%u)",
+		(unsigned int)count, build_time * 1000.0, pairs_time * 1000.0, (unsigned int)candidates.size(),
+		sat_time * 1000.0, (unsigned int)overlapping.size(), brute_time * 1000.0, (unsigned int)num_brute);
+	AsyncLog("bench", "overlap %6u moving: update %7.3fms/frame, %u swaps/frame",
+		(unsigned int)moved.size(), update_time * 1000.0 / num_frames, (unsigned int)(num_swaps / num_frames));
+	AsyncLogFlush();
+	return true;
+}
+
+// k nearest zones around random points, best-first vs a linear scan
+static bool _bench_nearest(NamedStrings& param)
+{
+	const size_t count = (size_t)param.GetInt("zones", 20480);
+	const size_t num_points = (size_t)param.GetInt("points", 100'000);
+	const size_t k = (size_t)param.GetInt("k", 4);
+	const size_t num_threads = (size_t)param.GetInt("threads", 0);
+	constexpr size_t num_brute_points = 1000;
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, count);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+	std::vector<Vec2> points(num_points);
+	_generate_bench_points(param, points, -1, 1);
+
+	zone_nearest_scratch scratch;
+	std::vector<zone_distance> found;
+	double begin = GetCurrentTimeSeconds();
+	for (const Vec2& point : points) {
+		tree.find_nearest(point, k, 1e30f, scratch, found);
+	}
+	const double single_time = GetCurrentTimeSeconds() - begin;
+
+	std::vector<zone_distance> batch(num_points * k);
+	begin = GetCurrentTimeSeconds();
+	tree.find_nearest_batch(points.data(), num_points, k, 1e30f, batch.data(), num_threads);
+	const double batch_time = GetCurrentTimeSeconds() - begin;
+
+	// linear scan over a slice of the points, scaled up
+	const size_t num_brute = std::min(num_brute_points, num_points);
+	begin = GetCurrentTimeSeconds();
+	float checksum = 0.f;
+	for (size_t p = 0; p < num_brute; ++p) {
+		float best = 1e30f;
+		for (auto& each : zones) {
+			Vec2 closest;
+			best = std::min(best, get_poly_distance(each.m_poly.m_points, points[p], closest));
+		}
+		checksum += best;
+	}
+	const double brute_time = (GetCurrentTimeSeconds() - begin) * (double)num_points / (double)std::max((size_t)1, num_brute);
+
+	AsyncLog("bench", "nearest k=%u, %6u zones, %6u points: best-first %8.3fms, batched %8.3fms, linear scan ~%9.3fms (%g)",
+		(unsigned int)k, (unsigned int)count, (unsigned int)num_points, single_time * 1000.0, batch_time * 1000.0,
+		brute_time * 1000.0, checksum);
+	AsyncLogFlush();
+	return true;
+}
+
+// what an eye sees: one visibility sweep vs a fan of QuadTree raycasts
+static bool _bench_visibility(NamedStrings& param)
+{
+	const size_t count = (size_t)param.GetInt("zones", 20480);
+	const int num_rays = param.GetInt("rays", 360);
+	const int num_eyes = param.GetInt("eyes", 1000);
+	const float radius = 0.2f;
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, count);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+	std::vector<Vec2> eyes(num_eyes);
+	_generate_bench_points(param, eyes, -0.8f, 0.8f);
+
+	visibility_scratch scratch;
+	std::vector<Vec2> outline;
+	size_t num_vertices = 0;
+	double begin = GetCurrentTimeSeconds();
+	for (const Vec2& eye : eyes) {
+		compute_visibility(tree, eye, radius, scratch, outline);
+		num_vertices += outline.size();
+	}
+	const double sweep_time = GetCurrentTimeSeconds() - begin;
+
+	size_t num_hits = 0;
+	begin = GetCurrentTimeSeconds();
+	for (const Vec2& eye : eyes) {
+		for (int r = 0; r < num_rays; ++r) {
+			const float angle = 6.2831853f * (float)r / (float)num_rays;
+			const Vec2 end = eye + Vec2(cosf(angle), sinf(angle)) * radius;
+			num_hits += tree.raycast_by(Ray2::FromPoint(eye, end)).hit ? 1 : 0;
+		}
+	}
+	const double fan_time = GetCurrentTimeSeconds() - begin;
+
+	AsyncLog("bench", "visibility %6u zones, %u eyes: sweep %8.3fms (%u vertices avg), %d ray fan %8.3fms (%u hits)",
+		(unsigned int)count, (unsigned int)num_eyes, sweep_time * 1000.0, (unsigned int)(num_vertices / std::max(1, num_eyes)),
+		num_rays, fan_time * 1000.0, (unsigned int)num_hits);
+	AsyncLogFlush();
+	return true;
+}
+
+struct _bench_ray_batch
+{
+	QuadTree* m_tree;
+	std::vector<Vec2> m_points; // start and end per query
+};
+
+static void _bench_run_ray(void* user, unsigned int index)
+{
+	_bench_ray_batch* batch = (_bench_ray_batch*)user;
+	(void)batch->m_tree->raycast_by(Ray2::FromPoint(batch->m_points[index * 2], batch->m_points[index * 2 + 1]));
+}
+
+// a steady stream of mixed priority raycasts through the 1ms frame budget
+static bool _bench_scheduler(NamedStrings& param)
+{
+	const size_t num_threads = (size_t)param.GetInt("threads", (int)get_num_task_threads());
+	const unsigned int per_frame = (unsigned int)param.GetInt("rays", 20'000);
+	constexpr int num_frames = 60;
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, 20480);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+	_bench_ray_batch batch;
+	batch.m_tree = &tree;
+	generate_ray_workload((uint32_t)param.GetInt("seed", 1), per_frame, 0.f, batch.m_points);
+
+	const size_t thread_counts[2] = {1, num_threads};
+	for (size_t threads : thread_counts) {
+		QueryScheduler scheduler;
+		unsigned int num_run = 0;
+		unsigned int num_forced = 0;
+		for (int f = 0; f < num_frames; ++f) {
+			// a few urgent ones, the rest is background work with a loose deadline
+			for (unsigned int i = 0; i < per_frame; ++i) {
+				const bool urgent = i % 64 == 0;
+				scheduler.submit(_bench_run_ray, &batch, i, urgent ? 1 : 0, urgent ? 0 : 10);
+			}
+			const query_frame_stats& stats = scheduler.run_frame(0.001, threads);
+			num_run += stats.m_run;
+			num_forced += stats.m_forced;
+		}
+		const query_latency_histogram& latency = scheduler.get_latency();
+		AsyncLog("bench", "scheduler x%u: %6u rays/frame of %u submitted, %u forced, %u left, latency p50 %.3fms p90 %.3fms p99 %.3fms",
+			(unsigned int)threads, num_run / num_frames, per_frame, num_forced, (unsigned int)scheduler.get_num_pending(),
+			latency.get_percentile(0.5f) * 1000.0, latency.get_percentile(0.9f) * 1000.0, latency.get_percentile(0.99f) * 1000.0);
+	}
+	AsyncLogFlush();
+	return true;
+}
+
+// raycasts next to other update work, here visibility sweeps: cast on the game thread first
+// vs submitted to the async workers and collected once the work is done
+static bool _bench_async(NamedStrings& param)
+{
+	const size_t num_workers = (size_t)param.GetInt("threads", 0);
+	const int per_frame = param.GetInt("rays", 20'000);
+	const int num_eyes = param.GetInt("eyes", 200);
+	constexpr int num_frames = 30;
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, 20480);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+	std::vector<Vec2> points;
+	generate_ray_workload((uint32_t)param.GetInt("seed", 1), (size_t)per_frame, 0.f, points);
+	visibility_scratch scratch;
+	std::vector<Vec2> outline;
+	size_t num_vertices = 0;
+	auto other_work = [&]() {
+		for (int e = 0; e < num_eyes; ++e) {
+			compute_visibility(tree, points[e], 0.2f, scratch, outline);
+			num_vertices += outline.size();
+		}
+	};
+
+	size_t num_hits = 0;
+	double begin = GetCurrentTimeSeconds();
+	for (int f = 0; f < num_frames; ++f) {
+		for (int i = 0; i < per_frame; ++i) {
+			num_hits += tree.raycast_by(Ray2::FromPoint(points[i * 2], points[i * 2 + 1])).hit ? 1 : 0;
+		}
+		other_work();
+	}
+	const double sync_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+
+	ZoneScene scene;
+	scene.reset(zones);
+	scene.publish();
+	ZoneAsyncQueries queries;
+	queries.startup(scene, num_workers);
+	std::vector<async_query_handle> handles(per_frame);
+	size_t num_async_hits = 0;
+	double wait_time = 0.0;
+	begin = GetCurrentTimeSeconds();
+	for (int f = 0; f < num_frames; ++f) {
+		for (int i = 0; i < per_frame; ++i) {
+			handles[i] = queries.submit_raycast(points[i * 2], points[i * 2 + 1]);
+		}
+		other_work();
+		const double wait_begin = GetCurrentTimeSeconds();
+		do {
+			queries.begin_frame();
+		} while (queries.get_num_in_flight() > 0);
+		wait_time += GetCurrentTimeSeconds() - wait_begin;
+		for (const async_query_handle& handle : handles) {
+			ConvexImpactResult result;
+			num_async_hits += queries.get_raycast(handle, result) && result.hit ? 1 : 0;
+			queries.release(handle);
+		}
+	}
+	const double async_time = (GetCurrentTimeSeconds() - begin) / num_frames;
+	queries.shutdown();
+
+	AsyncLog("bench", "async %d rays + %d visibility sweeps per frame: game thread %8.3fms, async %8.3fms (%.3fms waiting), hits %u/%u (%u)",
+		per_frame, num_eyes, sync_time * 1000.0, async_time * 1000.0, wait_time * 1000.0 / num_frames,
+		(unsigned int)(num_async_hits / num_frames), (unsigned int)(num_hits / num_frames), (unsigned int)num_vertices);
+	AsyncLogFlush();
+	return true;
+}
+
+// publishing scene versions: a whole rebuild vs single zone edits, and reader raycasts
+// with and without a writer publishing next to them
+static bool _bench_scene(NamedStrings& param)
+{
+	const size_t count = (size_t)param.GetInt("zones", 20480);
+	const int num_edits = param.GetInt("edits", 200);
+	const int num_readers = std::min(param.GetInt("readers", 3), (int)ZoneScene::MAX_READERS);
+	std::vector<Zone> zones;
+	_generate_bench_zones(param, zones, count);
+	ZoneScene scene;
+	double begin = GetCurrentTimeSeconds();
+	scene.reset(zones);
+	scene.publish();
+	const double reset_time = GetCurrentTimeSeconds() - begin;
+
+	std::atomic<bool> stop = false;
+	std::atomic<bool> writing = false;
+	std::atomic<unsigned int> num_reads[2] = {}; // while idle, while writing
+	auto read = [&]() {
+		const int reader = scene.register_reader();
+		unsigned int random = 0x9E3779B9u * (unsigned int)(reader + 1);
+		auto next_float = [&random]() {
+			random = random * 1664525u + 1013904223u;
+			return (float)(random >> 8) / (float)(1u << 24) * 2.f - 1.f;
+		};
+		while (!stop) {
+			zone_scene_pin version(scene, reader);
+			(void)version->raycast_by(Ray2::FromPoint(Vec2(next_float(), next_float()), Vec2(next_float(), next_float())));
+			++num_reads[writing ? 1 : 0];
+		}
+		scene.unregister_reader(reader);
+	};
+	std::vector<std::thread> readers;
+	for (int i = 0; i < num_readers; ++i) {
+		readers.emplace_back(read);
+	}
+	begin = GetCurrentTimeSeconds();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	const double idle_time = GetCurrentTimeSeconds() - begin;
+
+	writing = true;
+	size_t num_held = 0;
+	begin = GetCurrentTimeSeconds();
+	for (int e = 0; e < num_edits; ++e) {
+		const unsigned int index = (unsigned int)e * 7919u % (unsigned int)count;
+		zones[index].transform(Vec2::ZERO, 10.f, 0.f);
+		scene.set_zone(index, zones[index]);
+		scene.publish();
+		num_held += scene.reclaim();
+	}
+	const double edit_time = GetCurrentTimeSeconds() - begin;
+	stop = true;
+	for (auto& each : readers) {
+		each.join();
+	}
+
+	AsyncLog("bench", "scene %6u zones: reset %8.3fms, one zone edit %8.3fms, %.1f versions held; %d readers %8.0f rays/s idle, %8.0f rays/s while editing",
+		(unsigned int)count, reset_time * 1000.0, edit_time * 1000.0 / num_edits, (double)num_held / num_edits, num_readers,
+		num_reads[0] / idle_time, num_reads[1] / edit_time);
+	AsyncLogFlush();
+	return true;
+}
+
+// push/pop pairs from 1..threads= threads on each queue kind. Every 64th op is timed on its own
+// for the latency percentiles
+static bool _bench_queue(NamedStrings& param)
+{
+	const int max_threads = std::max(param.GetInt("threads", (int)std::thread::hardware_concurrency()), 1);
+	const size_t ops_per_thread = (size_t)param.GetInt("ops", 1'000'000);
+	constexpr size_t sample_every = 64;
+	std::vector<int> thread_counts;
+	for (int n = 1; n < max_threads; n *= 2) {
+		thread_counts.push_back(n);
+	}
+	thread_counts.push_back(max_threads);
+	for (int num_threads : thread_counts) {
+		for (eQueueKind kind : {QUEUE_LOCKED, QUEUE_RING, QUEUE_SEGMENTED}) {
+			ConcurrentQueue<void*> queue(kind);
+			std::vector<std::vector<float>> samples(num_threads); // nanoseconds
+			std::atomic<int> num_waiting = num_threads;
+			auto run = [&](int t) {
+				std::vector<float>& mine = samples[t];
+				mine.reserve(ops_per_thread / sample_every + 1);
+				--num_waiting;
+				while (num_waiting > 0) {
+					std::this_thread::yield();
+				}
+				void* value = nullptr;
+				for (size_t i = 0; i < ops_per_thread; ++i) {
+					const bool push = ((i + t) & 1) != 0;
+					if (i % sample_every == 0) {
+						const auto begin = std::chrono::high_resolution_clock::now();
+						push ? queue.Push(&mine) : (void)queue.Pop(&value);
+						mine.push_back(std::chrono::duration<float, std::nano>(std::chrono::high_resolution_clock::now() - begin).count());
+					} else if (push) {
+						queue.Push(&mine);
+					} else {
+						queue.Pop(&value);
+					}
+				}
+			};
+			const double begin = GetCurrentTimeSeconds();
+			std::vector<std::thread> threads;
+			for (int t = 1; t < num_threads; ++t) {
+				threads.emplace_back(run, t);
+			}
+			run(0);
+			for (auto& each : threads) {
+				each.join();
+			}
+			const double seconds = GetCurrentTimeSeconds() - begin;
+
+			std::vector<float> all;
+			for (auto& each : samples) {
+				all.insert(all.end(), each.begin(), each.end());
+			}
+			std::sort(all.begin(), all.end());
+			auto percentile = [&all](double fraction) { return all.empty() ? 0.f : all[std::min(all.size() - 1, (size_t)(fraction * all.size()))]; };
+			AsyncLog("bench", "queue %-9s x%2d: %7.2f Mops/s, latency p50 %6.0fns p99 %7.0fns p99.9 %8.0fns",
+				get_queue_kind_name(kind), num_threads, (double)(ops_per_thread * num_threads) / seconds * 1e-6,
+				percentile(0.5), percentile(0.99), percentile(0.999));
+		}
+	}
+	AsyncLogFlush();
+	return true;
+}
+
+// every thread keeps a window of live blocks and replaces one per op, so frees land on blocks
+// allocated a while back, the way real owners free them
+static bool _bench_alloc(NamedStrings& param)
+{
+	const int max_threads = std::max(param.GetInt("threads", (int)std::thread::hardware_concurrency()), 1);
+	const size_t ops_per_thread = (size_t)param.GetInt("ops", 1'000'000);
+	const size_t byte_size = (size_t)std::max(param.GetInt("size", 128), 1);
+	constexpr size_t window = 256;
+	std::vector<int> thread_counts;
+	for (int n = 1; n < max_threads; n *= 2) {
+		thread_counts.push_back(n);
+	}
+	thread_counts.push_back(max_threads);
+
+	struct allocator
+	{
+		const char* m_name;
+		void* (*m_alloc)(size_t);
+		void (*m_free)(void*);
+		unsigned int m_sample_rate;
+	};
+	const allocator allocators[] = {
+		{ "tracked", TrackedAlloc, TrackedFree, 0 },
+		{ "cached", cached_alloc, cached_free, 0 },
+		{ "cached+sampled", cached_alloc, cached_free, DEFAULT_ALLOC_SAMPLE_RATE },
+		{ "cached+every", cached_alloc, cached_free, 1 },
+	};
+	const unsigned int sample_rate = get_alloc_sample_rate();
+	for (int num_threads : thread_counts) {
+		for (const allocator& each : allocators) {
+			set_alloc_sample_rate(each.m_sample_rate);
+			std::atomic<int> num_waiting = num_threads;
+			auto run = [&]() {
+				std::vector<void*> live(window, nullptr);
+				--num_waiting;
+				while (num_waiting > 0) {
+					std::this_thread::yield();
+				}
+				for (size_t i = 0; i < ops_per_thread; ++i) {
+					void*& slot = live[i % window];
+					if (slot != nullptr) {
+						each.m_free(slot);
+					}
+					slot = each.m_alloc(byte_size);
+				}
+				for (void* ptr : live) {
+					each.m_free(ptr);
+				}
+			};
+			const double begin = GetCurrentTimeSeconds();
+			std::vector<std::thread> threads;
+			for (int t = 1; t < num_threads; ++t) {
+				threads.emplace_back(run);
+			}
+			run();
+			for (auto& thread : threads) {
+				thread.join();
+			}
+			const double seconds = GetCurrentTimeSeconds() - begin;
+			AsyncLog("bench", "alloc %-14s x%2d %5uB: %7.2f Mpairs/s, %6.1fns per pair per thread",
+				each.m_name, num_threads, (unsigned int)byte_size, (double)(ops_per_thread * num_threads) / seconds * 1e-6,
+				seconds * 1e9 / (double)ops_per_thread);
+		}
+	}
+	set_alloc_sample_rate(sample_rate);
+	AsyncLogFlush();
+	return true;
+}
+
+// caller side cost of a message and how fast the file keeps up, engine Log against AsyncLog
+static bool _bench_log(NamedStrings& param)
+{
+	const int max_threads = std::max(param.GetInt("threads", (int)std::thread::hardware_concurrency()), 1);
+	const size_t messages_per_thread = (size_t)param.GetInt("messages", 100'000);
+	constexpr size_t sample_every = 64;
+	std::vector<int> thread_counts;
+	for (int n = 1; n < max_threads; n *= 2) {
+		thread_counts.push_back(n);
+	}
+	thread_counts.push_back(max_threads);
+
+	enum log_kind { LOG_ENGINE, LOG_ASYNC_STRING, LOG_ASYNC_ID, LOG_ASYNC_FILTERED };
+	const char* const kind_names[] = { "engine", "async", "async id", "async off" };
+	const log_filter_id filter = GetLogFilterId("bench_log");
+	LogFilterEnable("bench_log");
+	for (int num_threads : thread_counts) {
+		for (log_kind kind : { LOG_ENGINE, LOG_ASYNC_STRING, LOG_ASYNC_ID, LOG_ASYNC_FILTERED }) {
+			if (kind == LOG_ASYNC_FILTERED) {
+				AsyncLogFilterDisable("bench_log");
+			} else {
+				AsyncLogFilterEnable("bench_log");
+			}
+			std::vector<std::vector<float>> samples(num_threads); // nanoseconds
+			std::atomic<int> num_waiting = num_threads;
+			auto run = [&](int t) {
+				std::vector<float>& mine = samples[t];
+				mine.reserve(messages_per_thread / sample_every + 1);
+				--num_waiting;
+				while (num_waiting > 0) {
+					std::this_thread::yield();
+				}
+				for (size_t i = 0; i < messages_per_thread; ++i) {
+					const auto begin = std::chrono::high_resolution_clock::now();
+					switch (kind) {
+					case LOG_ENGINE:
+						Log("bench_log", "thread %d message %u of %u", t, (unsigned int)i, (unsigned int)messages_per_thread);
+						break;
+					case LOG_ASYNC_STRING:
+						AsyncLog("bench_log", "thread %d message %u of %u", t, (unsigned int)i, (unsigned int)messages_per_thread);
+						break;
+					case LOG_ASYNC_ID:
+					case LOG_ASYNC_FILTERED:
+						AsyncLog(filter, "thread %d message %u of %u", t, (unsigned int)i, (unsigned int)messages_per_thread);
+						break;
+					}
+					if (i % sample_every == 0) {
+						mine.push_back(std::chrono::duration<float, std::nano>(std::chrono::high_resolution_clock::now() - begin).count());
+					}
+				}
+			};
+			const double begin = GetCurrentTimeSeconds();
+			std::vector<std::thread> threads;
+			for (int t = 1; t < num_threads; ++t) {
+				threads.emplace_back(run, t);
+			}
+			run(0);
+			for (auto& each : threads) {
+				each.join();
+			}
+			const double caller_seconds = GetCurrentTimeSeconds() - begin;
+			kind == LOG_ENGINE ? LogFlush() : AsyncLogFlush();
+			const double seconds = GetCurrentTimeSeconds() - begin;
+
+			std::vector<float> all;
+			for (auto& each : samples) {
+				all.insert(all.end(), each.begin(), each.end());
+			}
+			std::sort(all.begin(), all.end());
+			auto percentile = [&all](double fraction) { return all.empty() ? 0.f : all[std::min(all.size() - 1, (size_t)(fraction * all.size()))]; };
+			const double num_messages = (double)(messages_per_thread * num_threads);
+			AsyncLog("bench", "log %-9s x%2d: %8.0f msgs/s to the caller, %8.0f msgs/s flushed, latency p50 %6.0fns p99 %7.0fns p99.9 %8.0fns",
+				kind_names[kind], num_threads, num_messages / caller_seconds, num_messages / seconds,
+				percentile(0.5), percentile(0.99), percentile(0.999));
+		}
+	}
+	AsyncLogFilterEnable("bench_log");
+	AsyncLogFlush();
+	return true;
+}
+
+// scheduler overhead: empty tasks, a fine grained loop against one std::thread per chunk,
+// and a chain of continuations
+static bool _bench_tasks(NamedStrings& param)
+{
+	if (g_theTasks == nullptr) {
+		return false;
+	}
+	const size_t num_tasks = (size_t)param.GetInt("tasks", 200'000);
+	const size_t num_items = (size_t)param.GetInt("items", 1'000'000);
+	const size_t num_links = (size_t)param.GetInt("links", 10'000);
+	constexpr int num_iterations = 20;
+	const size_t num_threads = g_theTasks->get_num_threads();
+	const size_t steals_before = g_theTasks->get_num_steals();
+
+	std::atomic<size_t> num_ran = 0;
+	task_counter counter;
+	double begin = GetCurrentTimeSeconds();
+	for (size_t i = 0; i < num_tasks; ++i) {
+		g_theTasks->run(&counter, [&num_ran]() { num_ran.fetch_add(1, std::memory_order_relaxed); });
+	}
+	g_theTasks->wait(counter);
+	const double main_time = GetCurrentTimeSeconds() - begin;
+	// every thread spawns its share, so the tasks start out spread over the deques
+	constexpr size_t num_spawners = 64;
+	begin = GetCurrentTimeSeconds();
+	for (size_t s = 0; s < num_spawners; ++s) {
+		g_theTasks->run(&counter, [&num_ran, &counter, num_tasks]() {
+			for (size_t i = 0; i < num_tasks / num_spawners; ++i) {
+				g_theTasks->run(&counter, [&num_ran]() { num_ran.fetch_add(1, std::memory_order_relaxed); });
+			}
+		});
+	}
+	g_theTasks->wait(counter);
+	const double spread_time = GetCurrentTimeSeconds() - begin;
+	AsyncLog("bench", "tasks %7u empty: %8.0f tasks/s spawned from the main thread, %8.0f tasks/s spawned by %u tasks",
+		(unsigned int)num_tasks, (double)num_tasks / main_time, (double)(num_tasks / num_spawners * num_spawners) / spread_time,
+		(unsigned int)num_spawners);
+
+	std::vector<float> values(num_items);
+	for (size_t i = 0; i < num_items; ++i) {
+		values[i] = (float)i;
+	}
+	auto work = [&values](size_t first, size_t end) {
+		for (size_t i = first; i < end; ++i) {
+			values[i] = std::sqrt(values[i] * 1.0001f + 1.f);
+		}
+	};
+	begin = GetCurrentTimeSeconds();
+	for (int it = 0; it < num_iterations; ++it) {
+		work(0, num_items);
+	}
+	const double serial_time = (GetCurrentTimeSeconds() - begin) / num_iterations;
+	begin = GetCurrentTimeSeconds();
+	for (int it = 0; it < num_iterations; ++it) {
+		const size_t chunk = (num_items + num_threads - 1) / num_threads;
+		std::vector<std::thread> threads;
+		for (size_t t = 1; t < num_threads; ++t) {
+			threads.emplace_back(work, t * chunk, std::min(num_items, (t + 1) * chunk));
+		}
+		work(0, std::min(num_items, chunk));
+		for (auto& each : threads) {
+			each.join();
+		}
+	}
+	const double thread_time = (GetCurrentTimeSeconds() - begin) / num_iterations;
+	AsyncLog("bench", "loop %7u items x%2u: serial %8.3fms, std::thread chunks %8.3fms",
+		(unsigned int)num_items, (unsigned int)num_threads, serial_time * 1000.0, thread_time * 1000.0);
+	for (size_t grain : {(size_t)0, (size_t)4096, (size_t)256, (size_t)16}) {
+		begin = GetCurrentTimeSeconds();
+		for (int it = 0; it < num_iterations; ++it) {
+			g_theTasks->parallel_for(0, num_items, grain, work);
+		}
+		const double time = (GetCurrentTimeSeconds() - begin) / num_iterations;
+		AsyncLog("bench", "loop %7u items x%2u: parallel_for grain %5u %8.3fms",
+			(unsigned int)num_items, (unsigned int)num_threads, (unsigned int)grain, time * 1000.0);
+	}
+
+	// each link runs once the one before it finished
+	std::unique_ptr<task_counter[]> links = std::make_unique<task_counter[]>(num_links);
+	begin = GetCurrentTimeSeconds();
+	g_theTasks->run(&links[0], [&num_ran]() { ++num_ran; });
+	for (size_t i = 1; i < num_links; ++i) {
+		g_theTasks->run_after(links[i - 1], &links[i], [&num_ran]() { ++num_ran; });
+	}
+	g_theTasks->wait(links[num_links - 1]);
+	const double chain_time = GetCurrentTimeSeconds() - begin;
+	for (size_t i = 0; i < num_links; ++i) {
+		g_theTasks->wait(links[i]);
+	}
+	AsyncLog("bench", "chain %7u continuations: %8.3fus per link; %u steals in all",
+		(unsigned int)num_links, chain_time * 1e6 / (double)num_links, (unsigned int)(g_theTasks->get_num_steals() - steals_before));
+	AsyncLogFlush();
+	return true;
+}
+
+static size_t s_bench_event_calls = 0;
+
+static bool _bench_event_string(NamedStrings&)
+{
+	++s_bench_event_calls;
+	return false;
+}
+
+static void _bench_event_typed(void* user, const EntityCollectedEvent& payload)
+{
+	*(size_t*)user += payload.m_id.m_index != EntityId::INVALID_INDEX ? 1 : 0;
+}
+
+// per trigger cost of a string named g_Event against hashed ids with a typed payload, with
+// the dispatcher holding a few hundred other subscriptions
+static bool _bench_events(NamedStrings& param)
+{
+	if (g_theEvents == nullptr) {
+		return false;
+	}
+	const int num_triggers = param.GetInt("triggers", 1'000'000);
+	constexpr int num_other_events = 512;
+	size_t num_calls = 0;
+	for (int i = 0; i < num_other_events; ++i) {
+		g_theEvents->subscribe<EntityCollectedEvent>(get_event_id("bench_other_" + std::to_string(i)), _bench_event_typed, &num_calls);
+	}
+
+	NamedStrings args;
+	g_Event->SubscribeEventCallback("bench_event", _bench_event_string);
+	double begin = GetCurrentTimeSeconds();
+	for (int i = 0; i < num_triggers; ++i) {
+		g_Event->Trigger("bench_event", args);
+	}
+	const double string_time = GetCurrentTimeSeconds() - begin;
+	g_Event->UnsubscribeEventCallback("bench_event", _bench_event_string);
+
+	EntityCollectedEvent payload;
+	payload.m_id.m_index = 1;
+	const std::string name = "bench_event";
+	double hashed_time[2] = {};
+	double runtime_time[2] = {};
+	const int subscriber_counts[2] = {1, 8};
+	for (int c = 0; c < 2; ++c) {
+		while ((int)g_theEvents->get_num_subscribers() < num_other_events + subscriber_counts[c]) {
+			g_theEvents->subscribe<EntityCollectedEvent>(EVENT_ID("bench_event"), _bench_event_typed, &num_calls);
+		}
+		begin = GetCurrentTimeSeconds();
+		for (int i = 0; i < num_triggers; ++i) {
+			g_theEvents->trigger(EVENT_ID("bench_event"), payload);
+		}
+		hashed_time[c] = GetCurrentTimeSeconds() - begin;
+		// a name only known at run time, as the console has it
+		begin = GetCurrentTimeSeconds();
+		for (int i = 0; i < num_triggers; ++i) {
+			g_theEvents->trigger(get_event_id(name), payload);
+		}
+		runtime_time[c] = GetCurrentTimeSeconds() - begin;
+	}
+	g_theEvents->unsubscribe_all(&num_calls);
+
+	AsyncLog("bench", "events x%d: g_Event string %7.1fns; hashed id %6.1fns, %6.1fns with 8 subscribers; run time hash %6.1fns, %6.1fns with 8 (%u + %u calls)",
+		num_triggers, string_time * 1e9 / num_triggers, hashed_time[0] * 1e9 / num_triggers, hashed_time[1] * 1e9 / num_triggers,
+		runtime_time[0] * 1e9 / num_triggers, runtime_time[1] * 1e9 / num_triggers,
+		(unsigned int)s_bench_event_calls, (unsigned int)num_calls);
+	s_bench_event_calls = 0;
+	AsyncLogFlush();
+	return true;
+}
+
+// writes a seeded scene and its ray and point workloads as files for runs outside the game,
+// family=<name> or all
+static bool _bench_corpus(NamedStrings& param)
+{
+	const std::string name = param.GetString("family", "all");
+	const std::string dir = param.GetString("dir", "Data/Corpus");
+	const uint32_t seed = (uint32_t)param.GetInt("seed", 1);
+	const size_t num_zones = (size_t)param.GetInt("zones", 0);
+	const size_t num_rays = (size_t)param.GetInt("rays", 100'000);
+	const size_t num_points = (size_t)param.GetInt("points", 100'000);
+	std::error_code error;
+	std::filesystem::create_directories(dir, error);
+	for (int i = 0; i < NUM_ZONE_CORPUS_FAMILIES; ++i) {
+		const zone_corpus_family family = (zone_corpus_family)i;
+		if (name == "all" || name == get_zone_corpus_name(family)) {
+			save_zone_corpus(dir, family, seed, num_zones, num_rays, num_points);
+		}
+	}
+	AsyncLogFlush();
+	return true;
+}
+
+void register_rvs_benchmarks()
+{
+	g_Event->SubscribeEventCallback("bench_qt_build", _bench_qt_build);
+	g_Event->SubscribeEventCallback("bench_visible", _bench_visible);
+	g_Event->SubscribeEventCallback("bench_entities", _bench_entities);
+	g_Event->SubscribeEventCallback("bench_sweep", _bench_sweep);
+	g_Event->SubscribeEventCallback("bench_refit", _bench_refit);
+	g_Event->SubscribeEventCallback("bench_overlap", _bench_overlap);
+	g_Event->SubscribeEventCallback("bench_nearest", _bench_nearest);
+	g_Event->SubscribeEventCallback("bench_visibility", _bench_visibility);
+	g_Event->SubscribeEventCallback("bench_scheduler", _bench_scheduler);
+	g_Event->SubscribeEventCallback("bench_async", _bench_async);
+	g_Event->SubscribeEventCallback("bench_scene", _bench_scene);
+	g_Event->SubscribeEventCallback("bench_queue", _bench_queue);
+	g_Event->SubscribeEventCallback("bench_alloc", _bench_alloc);
+	g_Event->SubscribeEventCallback("bench_log", _bench_log);
+	g_Event->SubscribeEventCallback("bench_tasks", _bench_tasks);
+	g_Event->SubscribeEventCallback("bench_events", _bench_events);
+	g_Event->SubscribeEventCallback("bench_corpus", _bench_corpus);
+}
+
+void unregister_rvs_benchmarks()
+{
+	g_Event->UnsubscribeEventCallback("bench_qt_build", _bench_qt_build);
+	g_Event->UnsubscribeEventCallback("bench_visible", _bench_visible);
+	g_Event->UnsubscribeEventCallback("bench_entities", _bench_entities);
+	g_Event->UnsubscribeEventCallback("bench_sweep", _bench_sweep);
+	g_Event->UnsubscribeEventCallback("bench_refit", _bench_refit);
+	g_Event->UnsubscribeEventCallback("bench_overlap", _bench_overlap);
+	g_Event->UnsubscribeEventCallback("bench_nearest", _bench_nearest);
+	g_Event->UnsubscribeEventCallback("bench_visibility", _bench_visibility);
+	g_Event->UnsubscribeEventCallback("bench_scheduler", _bench_scheduler);
+	g_Event->UnsubscribeEventCallback("bench_async", _bench_async);
+	g_Event->UnsubscribeEventCallback("bench_scene", _bench_scene);
+	g_Event->UnsubscribeEventCallback("bench_queue", _bench_queue);
+	g_Event->UnsubscribeEventCallback("bench_alloc", _bench_alloc);
+	g_Event->UnsubscribeEventCallback("bench_log", _bench_log);
+	g_Event->UnsubscribeEventCallback("bench_tasks", _bench_tasks);
+	g_Event->UnsubscribeEventCallback("bench_events", _bench_events);
+	g_Event->UnsubscribeEventCallback("bench_corpus", _bench_corpus);
+}
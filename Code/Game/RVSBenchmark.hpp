@@ -0,0 +1,6 @@
+#pragma once
+
+// Console commands that time the zone index and queries, results go to the "bench" log filter.
+// Scenes come from the seeded corpus, corpus=<family> seed=<n>; bench_corpus writes it to files
+void register_rvs_benchmarks();
+void unregister_rvs_benchmarks();
@@ -1,107 +1,37 @@
 #include "Game/RVSGame.hpp"
+#include "Game/ZoneVisibility.hpp"
+#include "Game/ZoneAsyncQueries.hpp"
+#include "Game/ZoneScene.hpp"
+#include "Game/ZoneScripting.hpp"
 #include "Engine/Core/RNG.hpp"
 #include "Engine/Core/Vertex_PCU.hpp"
 #include "Engine/Core/VertexUtils.hpp"
 #include "Engine/Renderer/RenderContext.hpp"
+#include "Engine/Renderer/GPUMesh.hpp"
 #include "Engine/Develop/DebugRenderer.hpp"
 //#include "Engine/Core/WindowContext.hpp"
 #include "Game/Game.hpp"
 #include "Engine/Core/Time.hpp"
 #include "Engine/Event/EventSystem.hpp"
-
-QuadTree::~QuadTree()
-{
-	delete m_sub[0];
-	delete m_sub[1];
-	delete m_sub[2];
-	delete m_sub[3];
-}
-
-void QuadTree::build_tree(size_t depth)
-{
-	if (m_zones.size() <= QUAD_ZONE_LIMIT || depth >= MAX_DEPTH)
-		return;
-	const Vec2 center = m_box.GetCenter();
-	// <<  <>  ><  >>
-	// 0   1    2   3
-	// III II  IV   I
-	m_sub[0] = new QuadTree(AABB2{m_box.Min, center});
-	m_sub[1] = new QuadTree(AABB2{m_box.Min.x, center.y, center.x, m_box.Max.y});
-	m_sub[2] = new QuadTree(AABB2{center.x, m_box.Min.y, m_box.Max.x, center.y});
-	m_sub[3] = new QuadTree(AABB2{center, m_box.Max});
-
-	for(auto& each : m_zones) {
-		for (size_t i = 0; i < 4; ++i) {
-			if (each->m_poly.is_overlapping_box(m_sub[i]->m_box)) {
-				m_sub[i]->m_zones.emplace_back(each);
-			}
-		}
-	}
-	for (size_t i = 0; i < 4; ++i) {
-		m_sub[i]->build_tree(depth + 1);
-	}
-}
-
-void QuadTree::display() const
+#include "Game/TraceCapture.hpp"
+#include "Game/AsyncLog.hpp"
+#include "Game/TaskScheduler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+void QuadTree::display(bool visited_only) const
 {
-	std::vector<Vertex_PCU> vert;
-	Vec2 tl = m_box.GetTopLeft();
-	Vec2 bl = m_box.GetBottomLeft();
-	Vec2 br = m_box.GetBottomRight();
-	Vec2 tr = m_box.GetTopRight();
-	const Rgba& color = m_checked ? Rgba(0,.5f,0,0.3f) : Rgba::TRANSPARENT_BLACK;
-	AddVerticesOfLine2D(vert, tl, tr, 0.005f, Rgba::GRAY);
-	AddVerticesOfLine2D(vert, tr, br, 0.005f, Rgba::GRAY);
-	AddVerticesOfLine2D(vert, br, bl, 0.005f, Rgba::GRAY);
-	AddVerticesOfLine2D(vert, bl, tl, 0.005f, Rgba::GRAY);
-	AddVerticesOfAABB2D(vert, m_box, color);
-	g_theRenderer->DrawVertexArray(vert.size(), vert);
-	
-	if (m_sub[0]) {
-		for (size_t i = 0; i < 4; ++i) {
-			m_sub[i]->display();
-		}
-	}
-	
-}
-
-ConvexImpactResult QuadTree::raycast_by(const Ray2& ray, bool set_flag)
-{
-	ConvexImpactResult result;
-	const float hit = ray.RaycastToAABB2(m_box);
-	if (hit >= 0) {
-		if (m_sub[0]){
-			for (size_t i = 0; i < 4; ++i) {
-				ConvexImpactResult subr = m_sub[i]->raycast_by(ray, set_flag);
-				if (subr.hit && subr.k < result.k) {
-					result = subr;
-				}
-			}
-		} else {
-			for (auto& each : m_zones) {
-				ConvexImpactResult zoner = each->m_hull.raycast_by(ray);
-				if (zoner.hit && zoner.k < result.k) {
-					result = zoner;
-				}
-			}
-			//for debug
-			if (set_flag) {
-				m_checked = true;
-			}
-		}
-	}
-	return result;
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	m_debug_verts.clear();
+	add_debug_vertices(m_debug_verts, visited_only);
+	g_theRenderer->DrawVertexArray(m_debug_verts.size(), m_debug_verts);
 }
 
-void QuadTree::reset_tree_flag()
-{
-	m_checked = false;
-	if (m_sub[0]) {
-		for (size_t i = 0; i < 4; ++i) {
-				m_sub[i]->reset_tree_flag();
-		}
-	}
-}
+// out of line, the unique_ptr members hold types RVSGame.hpp only declares
+RVSGame::RVSGame() = default;
 
 RVSGame::~RVSGame()
 {
@@ -112,30 +42,42 @@ void RVSGame::Startup(size_t numPolys)
 {
 	constexpr float radius_min = 0.05f;
 	constexpr float radius_max = 0.1f;
-	for (size_t i = 0; i< numPolys;++i) {
-		m_zones.emplace_back(Zone());
-		auto& zone = m_zones[i];
-		zone.m_poly = ConvexPoly::GetRandomPoly(g_rng.GetFloatInRange(radius_min, radius_max));
-		zone.m_position = Vec2 {g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1)};
-		zone.m_poly.move_by(zone.m_position);
-		zone.m_hull = ConvexHull2(zone.m_poly);
-	}
+	generate_random_zones(m_zones, numPolys, radius_min, radius_max);
 
 	g_Event->SubscribeEventCallback("ghcs-load", this, &RVSGame::load_ghcs);
 	g_Event->SubscribeEventCallback("ghcs-save", this, &RVSGame::save_ghcs);
+	g_Event->SubscribeEventCallback("zone-overlaps", this, &RVSGame::log_zone_overlaps);
 
 	_update_quad_tree();
+	m_outline_mesh.rebuild(m_zones);
+	_upload_outline_mesh();
+	m_scene = std::make_unique<ZoneScene>(m_qt->m_box);
+	m_scene->reset(m_zones);
+	m_scene->publish();
+	m_async_queries = std::make_unique<ZoneAsyncQueries>();
+	m_async_queries->startup(*m_scene);
+	zone_scripting_startup(*m_scene);
+}
+
+void RVSGame::_upload_outline_mesh()
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	if (m_outline_gpu == nullptr) {
+		m_outline_gpu = std::make_unique<GPUMesh>(g_theRenderer);
+	}
+	const std::vector<Vertex_PCU>& outline = m_outline_mesh.get_vertices();
+	m_outline_gpu->CopyVertexArray(outline.data(), (unsigned int)outline.size());
+	m_outline_gpu->SetDrawCall(false, (unsigned int)outline.size());
+	m_outline_gpu_stale = false;
 }
 
 void RVSGame::_update_quad_tree()
 {
 
-	delete m_qt;
-	m_qt = new QuadTree(AABB2(-1,-1,1,1));
-	for(auto& each:m_zones) {
-		m_qt->m_zones.emplace_back(&each);
+	if (m_qt == nullptr) {
+		m_qt = new QuadTree(AABB2(-1,-1,1,1));
 	}
-	m_qt->build_tree();
+	m_qt->build_tree(m_zones, m_qt_scratch);
 }
 
 Zone* RVSGame::get_first_zone_include(const Vec2& position)
@@ -151,30 +93,101 @@ Zone* RVSGame::get_first_zone_include(const Vec2& position)
 void RVSGame::BeginFrame()
 {
 	m_qt->reset_tree_flag();
+	m_async_queries->begin_frame();
+}
+
+void RVSGame::_run_background_ray(void* user, unsigned int index)
+{
+	RVSGame* game = (RVSGame*)user;
+	const background_ray& ray = game->m_background_rays[index];
+	game->raycast_to_all(Ray2::FromPoint(ray.m_start, ray.m_end));
+}
+
+void RVSGame::_submit_background_rays()
+{
+	m_background_rays.resize(BACKGROUND_RAY_SLOTS);
+	// keep about two frames of work queued. Equal priorities run oldest first, so the pending
+	// rays are always the latest ones submitted and the ring never overwrites a queued slot
+	const size_t wanted = std::max((size_t)256, (size_t)m_scheduler.get_last_frame().m_run * 2);
+	const size_t pending = m_scheduler.get_num_pending();
+	const size_t count = std::min(wanted > pending ? wanted - pending : 0, BACKGROUND_RAY_SLOTS - pending);
+	for (size_t i = 0; i < count; ++i) {
+		const unsigned int slot = m_next_background_ray++ % BACKGROUND_RAY_SLOTS;
+		background_ray& ray = m_background_rays[slot];
+		ray.m_start = Vec2(g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1));
+		ray.m_end = Vec2(g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1));
+		m_scheduler.submit(_run_background_ray, this, slot, 0, BACKGROUND_DEADLINE_FRAMES);
+	}
+}
+
+void RVSGame::set_animate(bool animate)
+{
+	m_animate = animate;
+	if (m_animate) {
+		m_bvh.build(m_zones);
+	} else {
+		_update_quad_tree();
+	}
 }
 
 void RVSGame::Update(float deltaSeconds)
 {
-	//invisible raycast for 1ms
-	double max_time = GetCurrentTimeSeconds();
-	Vec2 start, end;
-	max_time += 0.001;
-	size_t count = 0;
-	while(GetCurrentTimeSeconds() < max_time) {
-		start.x = g_rng.GetFloatInRange(-1,1);
-		start.y = g_rng.GetFloatInRange(-1,1);
-		end.x = g_rng.GetFloatInRange(-1,1);
-		end.y = g_rng.GetFloatInRange(-1,1);
-		raycast_to_all(Ray2::FromPoint(start, end));
-		++count;
+	if (m_animate) {
+		if (m_animations.size() != m_zones.size()) {
+			generate_random_animations(m_animations, m_zones.size(), m_zones.size());
+		}
+		animate_zones(m_zones, m_animations, deltaSeconds);
+		m_bvh.update(m_zones);
+		m_outline_mesh.rebuild(m_zones);
+		m_outline_gpu_stale = true;
+		m_scene_stale = true;
+	}
+	if (m_outline_mesh.update(m_zones) > 0 || m_outline_gpu_stale) {
+		_upload_outline_mesh();
+	}
+
+	// invisible background raycasts, as many as fit the 1ms budget
+	_submit_background_rays();
+	const query_frame_stats& ran = m_scheduler.run_frame(BACKGROUND_BUDGET_SECONDS);
+	const query_latency_histogram& latency = m_scheduler.get_latency();
+	DebugRenderer::Log(Stringf("%6u ray in 1ms, %u carried, latency p50 %.3fms p99 %.3fms", ran.m_run, ran.m_carried,
+		latency.get_percentile(0.5f) * 1000.0, latency.get_percentile(0.99f) * 1000.0), 0, Rgba::RED);
+	m_visibility_outline.clear();
+	if (m_show_visibility && !m_animate) {
+		if (!m_visibility_scratch) {
+			m_visibility_scratch = std::make_unique<visibility_scratch>();
+		}
+		compute_visibility(*m_qt, m_mouse_start, VISIBILITY_RADIUS, *m_visibility_scratch, m_visibility_outline);
+	}
+	if (m_async_queries->get_raycast(m_mouse_async_ray, m_mouse_async_impact)) {
+		m_async_queries->release(m_mouse_async_ray);
+		m_mouse_async_ray = async_query_handle();
+	}
+	if (m_raycast_on && !m_mouse_async_ray.is_valid()) {
+		m_mouse_async_ray = m_async_queries->submit_raycast(m_mouse_start, m_mouse_end);
+	}
+	if (m_raycast_on) {
+		DebugRenderer::Log(Stringf("async ray %s k %g, snapshot %u, %u in flight", m_mouse_async_impact.hit ? "hit" : "miss",
+			m_mouse_async_impact.k, m_scene->get_latest()->m_number, (unsigned int)m_async_queries->get_num_in_flight()),
+			0, Rgba::BLACK);
 	}
-	DebugRenderer::Log(Stringf("%6u ray in 1ms", count), 0, Rgba::RED);
 	m_impact = ConvexImpactResult();
 	if(m_raycast_on) {
 		Ray2 ray = Ray2::FromPoint(m_mouse_start, m_mouse_end);
 		ConvexImpactResult impact;
-		if (m_use_quad) {
-				m_impact = m_qt->raycast_by(ray, true);
+		if (m_animate) {
+			m_impact = m_bvh.raycast_by(ray);
+		} else if (m_use_quad) {
+			// dragging recasts the same line every frame
+			m_impact = m_qt->raycast_cached(m_mouse_start, m_mouse_end, m_mouse_ray_cache, true);
+			const ray_cache_stats& stats = m_qt->m_cache_stats;
+			DebugRenderer::Log(Stringf("ray cache %u/%u skipped, %u/%u seeds kept, %u nodes walked, %u saved",
+				stats.m_skipped, stats.m_queries, stats.m_seed_kept, stats.m_seeded, stats.m_nodes_visited, stats.m_nodes_saved),
+				0, Rgba::BLACK);
+			trace_counter("ray cache skipped", stats.m_skipped);
+			trace_counter("ray cache seeds kept", stats.m_seed_kept);
+			trace_counter("ray cache nodes walked", stats.m_nodes_visited);
+			trace_counter("ray cache nodes saved", stats.m_nodes_saved);
 		} else {
 			for (auto& each : m_zones) {
 				impact = each.m_hull.raycast_by(ray);
@@ -187,18 +200,33 @@ void RVSGame::Update(float deltaSeconds)
 	}
 }
 
-void RVSGame::Render() const
+void RVSGame::Render(const AABB2& view, float pixel_size) const
 {
-	std::vector<Vertex_PCU> verts;
-	for (auto each:m_zones) {
-		auto& poly = each.m_poly;
-		auto& position = each.m_position;
-		for (size_t i = 1; i < poly.m_points.size(); ++ i) {
-			AddVerticesOfLine2D(verts, poly.m_points[i - 1], poly.m_points[i], 0.003f, Rgba::TEAL);
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	if (m_animate) {
+		m_bvh.gather_visible(view, pixel_size, m_visible);
+	} else {
+		m_qt->gather_visible(view, pixel_size, m_render_marks, m_visible);
+	}
+	if (m_visible.m_points.empty() && m_visible.m_outlined.size() == m_zones.size()) {
+		// everything is on screen at full detail, the mesh already on the GPU is exactly that
+		g_theRenderer->DrawMesh(m_outline_gpu.get());
+	} else {
+		const std::vector<Vertex_PCU>& outline = m_outline_mesh.get_vertices();
+		m_visible_verts.clear();
+		for (unsigned int zone : m_visible.m_outlined) {
+			const size_t first = m_outline_mesh.get_first_vertex(zone);
+			m_visible_verts.insert(m_visible_verts.end(), outline.begin() + first,
+				outline.begin() + first + m_outline_mesh.get_num_vertices(zone));
+		}
+		const Vec2 half_pixel = Vec2(pixel_size, pixel_size) * 0.5f;
+		for (unsigned int zone : m_visible.m_points) {
+			const Vec2 center = (m_animate ? m_bvh.get_zone_bounds(zone) : m_qt->m_zone_bounds[zone]).GetCenter();
+			AddVerticesOfAABB2D(m_visible_verts, AABB2(center - half_pixel, center + half_pixel), Rgba::TEAL);
 		}
-		AddVerticesOfLine2D(verts, poly.m_points[poly.m_points.size() - 1], poly.m_points[0], 0.003f, Rgba::TEAL);
+		g_theRenderer->DrawVertexArray(m_visible_verts.size(), m_visible_verts);
 	}
-	g_theRenderer->DrawVertexArray(verts.size(), verts);
+	std::vector<Vertex_PCU> verts;
 
 
 	/*verts.clear();
@@ -222,8 +250,16 @@ void RVSGame::Render() const
 	g_theRenderer->DrawVertexArray(verts.size(), verts);
 	*/
 
-	if (m_use_quad) {
-		m_qt->display();
+	if (m_use_quad && !m_animate) {
+		m_qt->display(m_show_visited_only);
+	}
+
+	if (!m_visibility_outline.empty()) {
+		verts.clear();
+		for (size_t i = 0, j = m_visibility_outline.size() - 1; i < m_visibility_outline.size(); j = i++) {
+			AddVerticesOfLine2D(verts, m_visibility_outline[j], m_visibility_outline[i], 0.002f, Rgba::LIME);
+		}
+		g_theRenderer->DrawVertexArray(verts.size(), verts);
 	}
 	
 	if (m_raycast_on) {
@@ -254,25 +290,55 @@ void RVSGame::Render() const
 
 void RVSGame::EndFrame()
 {
+	// while animating, the version the workers and scripts read may be a frame behind
+	const bool scripts_read = take_zone_script_reads();
+	if (m_scene_stale && (scripts_read || m_async_queries->get_num_in_flight() > 0)) {
+		m_scene->reset(m_zones);
+		m_scene_stale = false;
+	}
+	m_scene->publish();
 }
 
 void RVSGame::Shutdown()
 {
+	zone_scripting_shutdown();
+	m_async_queries->shutdown();
 	g_Event->UnsubscribeEventCallback("ghcs-load", this, &RVSGame::load_ghcs);
 	g_Event->UnsubscribeEventCallback("ghcs-save", this, &RVSGame::save_ghcs);
+	g_Event->UnsubscribeEventCallback("zone-overlaps", this, &RVSGame::log_zone_overlaps);
 }
 
 void RVSGame::mouse_down(const Vec2& mouse_pos)
 {
-	m_mouse_start = mouse_pos;
+	m_mouse_start = get_snapped(mouse_pos);
 }
 
 void RVSGame::mouse_up(const Vec2& mouse_pos)
 {
-	m_mouse_end = mouse_pos;
+	m_mouse_end = get_snapped(mouse_pos);
 	m_raycast_on = true;
 }
 
+void RVSGame::snap_on()
+{
+	m_snap = true;
+}
+
+void RVSGame::snap_off()
+{
+	m_snap = false;
+}
+
+Vec2 RVSGame::get_snapped(const Vec2& position) const
+{
+	// the QuadTree is stale while zones animate
+	if (!m_snap || m_animate) {
+		return position;
+	}
+	m_qt->find_nearest(position, 1, SNAP_DISTANCE, m_snap_scratch, m_snap_found);
+	return m_snap_found.empty() ? position : m_snap_found[0].m_closest;
+}
+
 void RVSGame::wheel_up(const Vec2& mouse_pos)
 {
 	if (!m_set_rotation && !m_set_scale) {
@@ -286,6 +352,8 @@ void RVSGame::wheel_up(const Vec2& mouse_pos)
 		if (m_set_rotation) {
 			overlapped_zone->rotate(10.f, mouse_pos);
 		}
+		m_outline_mesh.mark_dirty(overlapped_zone - m_zones.data());
+		m_scene->set_zone((unsigned int)(overlapped_zone - m_zones.data()), *overlapped_zone);
 		_update_quad_tree();
 	}
 }
@@ -303,6 +371,8 @@ void RVSGame::wheel_down(const Vec2& mouse_pos)
 		if (m_set_rotation) {
 			overlapped_zone->rotate(-10.f, mouse_pos);
 		}
+		m_outline_mesh.mark_dirty(overlapped_zone - m_zones.data());
+		m_scene->set_zone((unsigned int)(overlapped_zone - m_zones.data()), *overlapped_zone);
 		_update_quad_tree();
 	}
 }
@@ -312,65 +382,47 @@ void RVSGame::wheel_down(const Vec2& mouse_pos)
 extern Game* g_game;
 bool RVSGame::load_ghcs(NamedStrings& param)
 {
-	constexpr int buffer_size = 10485760;
 	std::string path = param.GetString("path", "Data/Test.ghcs");
-	byte* buffer = new byte[buffer_size];
-	LoadFileToBuffer(buffer, buffer_size, path.c_str());
-	buffer_reader reader(buffer, buffer_size);
-	ghcs_header header = parse_ghcs_header(reader);
-	if (header.is_big_endian) {
-		reader.m_reverse = true;
-	}
-
-	char fcc[4];
-	while (true) {
-		if (!reader.next_n_byte((byte*)fcc, 4)){
-			break;
-		}
-		if (fcc[1] == 'T') {
-			//toc
-			break;
-		}
-		if (fcc[1] == 'C') {
-			byte type = reader.next_basic<byte>();
-			byte endi = reader.next_basic<byte>();
-			uint32 size = reader.next_basic<uint32>();
-			if (type == ghcs_ConvexPolysChunk) {
-				std::vector<Zone> new_zones;
-				m_zones = parse_convex_poly_chunk(reader);
-				//m_zones = new_zones;
-				_update_quad_tree();
-				g_game->m_num_zone = m_zones.size();
-			} else {
-				reader.m_ptr += size;
-			}
-		}
+	if (!load_ghcs_zones(path, m_zones)) {
+		return true;
 	}
-
-
+	_update_quad_tree();
+	m_scene->reset(m_zones);
+	m_outline_mesh.rebuild(m_zones);
+	m_outline_gpu_stale = true;
+	g_game->m_num_zone = m_zones.size();
 	return true;
 }
 
 bool RVSGame::save_ghcs(NamedStrings& param)
 {
 	std::string path = param.GetString("path", "Data/Test.ghcs");
-	buffer_writer writer;
-	ghcs_header h;
-	h.is_big_endian = false;
-	h.major_version  = 1;
-	h.minor_version = 0;
-	h.toc_offset = 0;
-	write_ghcs_header(writer, &h);
-	write_convex_poly_chunk(writer, m_zones);
-	FILE* fp;
-	fopen_s(&fp, path.c_str(), "wb");
-	fwrite(writer.m_bytes.data(), 1, writer.m_bytes.size(), fp);
-	fclose(fp);
+	save_ghcs_zones(path, m_zones);
+	return true;
+}
+
+bool RVSGame::log_zone_overlaps(NamedStrings& param)
+{
+	const int max_listed = param.GetInt("max", 16);
+	m_sap.update(m_zones);
+	m_candidate_pairs.clear();
+	m_sap.find_pairs(m_candidate_pairs);
+	m_overlapping_pairs.clear();
+	filter_overlapping_pairs(m_zones, m_candidate_pairs, m_overlapping_pairs);
+	AsyncLog("Game", "%u zones: %u overlapping pairs out of %u candidates", (unsigned int)m_zones.size(),
+		(unsigned int)m_overlapping_pairs.size(), (unsigned int)m_candidate_pairs.size());
+	for (int i = 0; i < max_listed && i < (int)m_overlapping_pairs.size(); ++i) {
+		AsyncLog("Game", "  zone %u overlaps zone %u", m_overlapping_pairs[i].m_a, m_overlapping_pairs[i].m_b);
+	}
 	return true;
 }
 
 void RVSGame::raycast_to_all(const Ray2& ray)
 {
+	if (m_animate) {
+		(void)(m_bvh.raycast_by(ray));
+		return;
+	}
 	if (!m_use_quad) {
 		for (auto& each : m_zones) {
 			(void)(each.m_hull.raycast_by(ray));
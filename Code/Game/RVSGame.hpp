@@ -2,6 +2,16 @@
 #include "Engine/Math/Convex.hpp"
 #include "Engine/Core/EngineCommon.hpp"
 #include "Engine/Math/AABB2.hpp"
+#include "Engine/Core/Vertex_PCU.hpp"
+#include "Game/MonotonicArena.hpp"
+#include "Game/ZoneOutlineMesh.hpp"
+#include "Game/ZoneGeometry.hpp"
+#include "Game/ZoneBVH.hpp"
+#include "Game/ZoneBroadphase.hpp"
+#include "Game/QueryScheduler.hpp"
+#include "Game/ZoneAsyncQueries.hpp"
+#include <atomic>
+#include <memory>
 
 class Zone
 {
@@ -21,38 +31,218 @@ public:
 		m_hull = ConvexHull2(m_poly);
 		m_position = center;
 	}
+	// one animation step about the zone's own position, the hull is rebuilt once
+	void transform(const Vec2& offset, float angle, float scale_by)
+	{
+		m_poly.move_by(offset);
+		m_position += offset;
+		if (angle != 0.f) {
+			m_poly.rotate(angle, m_position, m_position);
+		}
+		if (scale_by != 0.f) {
+			m_poly.scale(scale_by, m_position, m_position);
+		}
+		m_hull = ConvexHull2(m_poly);
+	}
+};
+
+// per-frame motion of a zone, see animate_zones
+struct zone_animation
+{
+	Vec2 m_velocity; // bounces off the [-1,1] scene box
+	float m_spin = 0.f; // degrees per second
+	float m_pulse = 0.f; // scale_by per second, flips sign every half period
+	float m_pulse_period = 1.f;
+	float m_time = 0.f;
 };
 
 constexpr size_t QUAD_ZONE_LIMIT = 2;
 
+struct quad_node
+{
+	AABB2 m_box;
+	int m_sub = -1; // index of the first of 4 contiguous children, -1 for a leaf
+	unsigned int m_first_zone = 0; // into QuadTree::m_leaf_zones
+	unsigned int m_num_zones = 0;
+};
+
+// Per-caller dedupe for queries, a zone can sit in several leaves.
+// Stamping avoids clearing a flag per zone before every query
+struct zone_query_marks
+{
+	std::vector<unsigned int> m_stamps;
+	unsigned int m_current = 0;
+
+	void begin(size_t num_zones);
+	bool mark(unsigned int zone) // true the first time a zone is seen in this query
+	{
+		if (m_stamps[zone] == m_current) {
+			return false;
+		}
+		m_stamps[zone] = m_current;
+		return true;
+	}
+};
+
+// zones smaller than this many pixels on both axes are drawn as a dot
+constexpr float ZONE_LOD_POINT_PIXELS = 1.f;
+
+struct zone_visible_set
+{
+	std::vector<unsigned int> m_outlined; // zone indices drawn at full detail
+	std::vector<unsigned int> m_points; // zone indices collapsed to a dot
+};
+
+// Kept by the caller of QuadTree::sweep_discs so a frame's batch does not allocate
+struct disc_sweep_scratch
+{
+	std::vector<AABB2> m_bounds; // per move
+	std::vector<unsigned int> m_pair_leaves; // (leaf, move) pairs from the walk
+	std::vector<unsigned int> m_pair_moves;
+	std::vector<unsigned int> m_leaf_first; // per node, into m_moves
+	std::vector<unsigned int> m_moves; // move indices grouped by leaf
+	std::vector<unsigned int> m_leaves; // leaves touched by at least one move
+	std::unique_ptr<std::atomic<unsigned long long>[]> m_best; // per move, t bits then zone
+	size_t m_best_capacity = 0;
+};
+
+// Per query handle state for QuadTree::raycast_cached, e.g. one per agent sight line
+struct ray_query_cache
+{
+	Vec2 m_start;
+	Vec2 m_end;
+	unsigned int m_version = 0; // QuadTree::m_version the result belongs to, 0 when empty
+	int m_leaf = -1; // leaf that held the closest hit
+	ConvexImpactResult m_result;
+	std::vector<int> m_visited; // the last traversal, replayed into the debug flags when skipped
+	std::vector<int> m_checked;
+};
+
+struct ray_cache_stats
+{
+	unsigned int m_queries = 0;
+	unsigned int m_skipped = 0; // same ray on the same tree, answered from the cache
+	unsigned int m_seeded = 0; // started from the last hit leaf
+	unsigned int m_seed_kept = 0; // and that leaf still held the closest hit
+	unsigned int m_nodes_visited = 0;
+	unsigned int m_nodes_saved = 0; // nodes the skipped queries did not walk again
+};
+
+struct zone_distance
+{
+	unsigned int m_zone = 0xFFFFFFFFu; // stays invalid when fewer than k zones were in range
+	float m_distance = 0.f; // 0 when the point is inside the zone
+	Vec2 m_closest; // closest point on the zone
+};
+
+// Kept by the caller of QuadTree::find_nearest, one per thread
+struct zone_nearest_scratch
+{
+	zone_query_marks m_marks;
+	std::vector<std::pair<float, int>> m_nodes; // min-heap of nodes by box distance
+};
+
+// One arena per QuadTree build worker. Kept by whoever rebuilds trees and passed to build_tree,
+// so a built tree holds only its own arrays
+struct quad_build_scratch
+{
+	std::vector<std::unique_ptr<MonotonicArena>> m_arenas;
+
+	size_t get_memory_bytes() const;
+};
+
 class QuadTree
 {
 public:
 	static constexpr size_t MAX_DEPTH = 5;
+	// a node with at least this many zones hands its subtree to a worker
+	static constexpr size_t PARALLEL_MIN_ZONES = 1024;
+	// nodes above this depth are split on the calling thread, deeper ones are built by workers
+	static constexpr size_t PARALLEL_SPLIT_DEPTH = 3;
+	// fewer moves than this are swept on the calling thread
+	static constexpr size_t PARALLEL_MIN_MOVES = 256;
+	// and fewer points than this are searched on it
+	static constexpr size_t PARALLEL_MIN_POINTS = 256;
 public:
 	QuadTree() = default;
 	QuadTree(const AABB2& box) : m_box(box) {}
-	~QuadTree();
-	void build_tree(size_t depth=0);
-	void display() const;
+	// num_threads == 0 means every TaskScheduler thread; the tree is identical for any thread count.
+	// Rebuilding an existing tree with the same scratch reuses both, so only the first build touches the heap
+	void build_tree(std::vector<Zone>& zones, quad_build_scratch& scratch, size_t num_threads=0);
+	// with scratch freed again before it returns
+	void build_tree(std::vector<Zone>& zones, size_t num_threads=0);
+	// one draw for the whole tree; visited_only keeps the nodes the last flagged query entered
+	void display(bool visited_only=false) const;
+	void add_debug_vertices(std::vector<Vertex_PCU>& verts, bool visited_only=false) const;
 	ConvexImpactResult raycast_by(const Ray2& ray, bool set_flag=false);
+	// for readers sharing a tree across threads, never touches the debug flags
+	ConvexImpactResult raycast_by(const Ray2& ray) const { return _raycast(ray, nullptr, nullptr); }
+	// raycast_by for a ray that changes little between calls. An unchanged ray on an unchanged
+	// tree returns the cached result, otherwise the last hit leaf is tested first so its k prunes the walk
+	ConvexImpactResult raycast_cached(const Vec2& start, const Vec2& end, ray_query_cache& cache, bool set_flag=false);
 	
 	void reset_tree_flag();
+	// indices of zones whose bounds overlap box, each reported once
+	void query_box(const AABB2& box, zone_query_marks& marks, std::vector<unsigned int>& out) const;
+	// zones overlapping view, split by whether they are bigger than a pixel
+	void gather_visible(const AABB2& view, float pixel_size, zone_query_marks& marks, zone_visible_set& out) const;
+	// first zone the disc touches; ties on t go to the lower zone index
+	disc_cast_result sweep_disc(const disc_move& move, zone_query_marks& marks) const;
+	// every move in one walk: moves are bucketed into the leaves they touch, then each leaf
+	// tests its zones against its bucket. Gives the same results as sweep_disc for any thread count
+	void sweep_discs(const disc_move* moves, size_t num_moves, disc_cast_result* results,
+		disc_sweep_scratch& scratch, size_t num_threads=0) const;
+	// k closest zones within max_distance, nearest first and ties to the lower zone index.
+	// Nodes are visited best-first and skipped once they are further than the k-th zone found
+	void find_nearest(const Vec2& point, size_t k, float max_distance, zone_nearest_scratch& scratch,
+		std::vector<zone_distance>& out) const;
+	// find_nearest for every point, k slots per point in out
+	void find_nearest_batch(const Vec2* points, size_t num_points, size_t k, float max_distance,
+		zone_distance* out, size_t num_threads=0) const;
+	bool is_leaf(int node) const { return m_nodes[node].m_sub < 0; }
+	// bytes held by the tree's arrays
+	size_t get_memory_bytes() const;
 	
 	AABB2 m_box;
-	QuadTree* m_sub[4] {nullptr, nullptr, nullptr, nullptr};
-	std::vector<Zone*>	m_zones;
-	bool m_checked = false;
+	Zone* m_zone_base = nullptr; // the zone array the tree was built from
+	unsigned int m_num_zones = 0;
+	AABB2* m_zone_bounds = nullptr; // per zone
+	quad_node* m_nodes = nullptr; // m_nodes[0] is the root
+	unsigned int m_num_nodes = 0;
+	Zone** m_leaf_zones = nullptr;
+	unsigned int m_num_leaf_zones = 0;
+	std::vector<bool> m_checked; // leaves whose zones the flagged query tested
+	std::vector<bool> m_visited; // every node the flagged query entered
+	unsigned int m_version = 0; // bumped by every build, ray caches compare it
+	ray_cache_stats m_cache_stats; // main thread only, reset by the owner
+
+private:
+	// the walk both raycast_by share, marking visited and checked nodes when they are given
+	ConvexImpactResult _raycast(const Ray2& ray, std::vector<bool>* visited, std::vector<bool>* checked) const;
+
+private:
+	MonotonicArena m_arena{"quadtree"};
+	mutable std::vector<Vertex_PCU> m_debug_verts;
 };
 
+void generate_random_zones(std::vector<Zone>& zones, size_t num_zones, float radius_min, float radius_max);
+// the first num_moving zones get a random animation, the rest stay still
+void generate_random_animations(std::vector<zone_animation>& animations, size_t num_zones, size_t num_moving);
+void animate_zones(std::vector<Zone>& zones, std::vector<zone_animation>& animations, float delta_seconds);
+
+struct visibility_scratch;
+class ZoneScene;
+class GPUMesh;
+
 class RVSGame
 {
 public:
+	RVSGame();
 	~RVSGame();
 	void Startup(size_t numPolys=10);
 	void BeginFrame();
 	void Update(float deltaSeconds);
-	void Render() const;
+	void Render(const AABB2& view, float pixel_size) const;
 
 	void EndFrame();
 	void Shutdown();
@@ -67,10 +257,19 @@ public:
 	
 	bool load_ghcs(NamedStrings& param);
 	bool save_ghcs(NamedStrings& param);
+	// logs every pair of overlapping zones, max= caps how many are listed
+	bool log_zone_overlaps(NamedStrings& param);
 
 	void raycast_to_all(const Ray2& ray);
 	void _update_quad_tree();
+	void _upload_outline_mesh();
+	// animated zones are indexed by m_bvh, the QuadTree is rebuilt when they stop
+	void set_animate(bool animate);
+	static void _run_background_ray(void* user, unsigned int index);
+	void _submit_background_rays();
 	Zone* get_first_zone_include(const Vec2& position);
+	// the closest point on a zone within SNAP_DISTANCE, position itself when there is none
+	Vec2 get_snapped(const Vec2& position) const;
 
 
 public:
@@ -79,10 +278,54 @@ public:
 	Vec2 m_mouse_end;
 	bool m_raycast_on = false;
 	ConvexImpactResult m_impact;
+	ray_query_cache m_mouse_ray_cache;
+	// m_zones published for readers on other threads, edits show up at EndFrame
+	std::unique_ptr<ZoneScene> m_scene;
+	bool m_scene_stale = false; // every zone changed, republished whole once someone reads
+	// the mouse line cast again on the async workers, read back a frame later.
+	// Declared after m_scene, its workers have to stop first
+	std::unique_ptr<ZoneAsyncQueries> m_async_queries;
+	async_query_handle m_mouse_async_ray;
+	ConvexImpactResult m_mouse_async_impact;
 	QuadTree*	m_qt = nullptr;
+	quad_build_scratch m_qt_scratch;
 	bool m_use_quad = false;
+	bool m_show_visited_only = false;
+	bool m_animate = false;
+	std::vector<zone_animation> m_animations;
+	ZoneBVH m_bvh;
+	ZoneSweepAndPrune m_sap;
+	std::vector<zone_pair> m_candidate_pairs;
+	std::vector<zone_pair> m_overlapping_pairs;
+	ZoneOutlineMesh m_outline_mesh;
+	// m_outline_mesh on the GPU, copied again only when update() or a rebuild changed it
+	std::unique_ptr<GPUMesh> m_outline_gpu;
+	bool m_outline_gpu_stale = true;
+	mutable zone_query_marks m_render_marks;
+	mutable zone_visible_set m_visible;
+	mutable std::vector<Vertex_PCU> m_visible_verts;
 
 	bool m_set_rotation = false;
 	bool m_set_scale = false;
+	// low priority raycasts that only get whatever is left of this much time per frame
+	static constexpr double BACKGROUND_BUDGET_SECONDS = 0.001;
+	static constexpr unsigned int BACKGROUND_DEADLINE_FRAMES = 30;
+	static constexpr size_t BACKGROUND_RAY_SLOTS = 64 * 1024;
+	struct background_ray
+	{
+		Vec2 m_start;
+		Vec2 m_end;
+	};
+	QueryScheduler m_scheduler;
+	std::vector<background_ray> m_background_rays; // ring, indexed by the submitted query
+	unsigned int m_next_background_ray = 0;
+	bool m_show_visibility = false;
+	static constexpr float VISIBILITY_RADIUS = 0.5f;
+	std::unique_ptr<visibility_scratch> m_visibility_scratch;
+	std::vector<Vec2> m_visibility_outline; // what the line start sees
+	bool m_snap = false;
+	static constexpr float SNAP_DISTANCE = 0.05f;
+	mutable zone_nearest_scratch m_snap_scratch;
+	mutable std::vector<zone_distance> m_snap_found;
 };
 
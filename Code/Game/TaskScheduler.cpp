@@ -0,0 +1,312 @@
+#include "Game/TaskScheduler.hpp"
+#include "Game/TraceCapture.hpp"
+#include <chrono>
+#include <cstdio>
+
+TaskScheduler* g_theTasks = nullptr;
+
+// idle workers poll this many times before they sleep
+constexpr int IDLE_SPINS = 64;
+// a missed wake up costs at most this long
+constexpr std::chrono::milliseconds IDLE_SLEEP(1);
+
+// a counter's continuations after they were handed out, what comes later runs right away
+static task s_closed;
+static task* const CLOSED_CONTINUATIONS = &s_closed;
+
+static thread_local const TaskScheduler* s_thread_scheduler = nullptr;
+static thread_local int s_thread_index = -1;
+static thread_local uint32_t s_steal_seed = 0;
+
+static uint32_t _next_random()
+{
+	// xorshift, only picks victims
+	uint32_t x = s_steal_seed != 0 ? s_steal_seed : (uint32_t)(uintptr_t)&s_steal_seed | 1u;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	s_steal_seed = x;
+	return x;
+}
+
+////////////////////////////////
+bool TaskScheduler::task_deque::push(task* t)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const int64_t top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= (int64_t)DEQUE_CAPACITY) {
+		return false;
+	}
+	m_tasks[bottom & (DEQUE_CAPACITY - 1)].store(t, std::memory_order_relaxed);
+	m_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+task* TaskScheduler::task_deque::pop()
+{
+	// seq_cst orders taking the bottom against a thief reading it after taking the top
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom);
+	int64_t top = m_top.load();
+	if (top > bottom) {
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	task* t = m_tasks[bottom & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (top == bottom) {
+		// the last one, a thief may be after it too
+		if (!m_top.compare_exchange_strong(top, top + 1)) {
+			t = nullptr;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return t;
+}
+
+task* TaskScheduler::task_deque::steal()
+{
+	int64_t top = m_top.load();
+	const int64_t bottom = m_bottom.load();
+	if (top >= bottom) {
+		return nullptr;
+	}
+	task* t = m_tasks[top & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1)) {
+		return nullptr;
+	}
+	return t;
+}
+
+bool TaskScheduler::task_deque::is_empty() const
+{
+	return m_top.load() >= m_bottom.load();
+}
+
+////////////////////////////////
+TaskScheduler::~TaskScheduler()
+{
+	shutdown();
+}
+
+void TaskScheduler::startup(size_t num_workers)
+{
+	if (!m_deques.empty()) {
+		return;
+	}
+	if (num_workers == 0) {
+		num_workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	}
+	m_quit = false;
+	for (size_t i = 0; i <= num_workers; ++i) {
+		m_deques.emplace_back(std::make_unique<task_deque>());
+	}
+	s_thread_scheduler = this;
+	s_thread_index = 0;
+	m_workers.reserve(num_workers);
+	for (size_t i = 1; i <= num_workers; ++i) {
+		m_workers.emplace_back(&TaskScheduler::_run_worker, this, (int)i);
+	}
+}
+
+void TaskScheduler::shutdown()
+{
+	if (m_deques.empty()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(m_sleep_lock);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (auto& each : m_workers) {
+		each.join();
+	}
+	m_workers.clear();
+	// nothing steals any more, whatever is left runs here
+	for (task* t = _try_get(0); t != nullptr; t = _try_get(0)) {
+		_execute(t);
+	}
+	m_deques.clear();
+	if (s_thread_scheduler == this) {
+		s_thread_scheduler = nullptr;
+		s_thread_index = -1;
+	}
+}
+
+int TaskScheduler::get_thread_index() const
+{
+	return s_thread_scheduler == this ? s_thread_index : -1;
+}
+
+void TaskScheduler::_arm(task_counter* counter)
+{
+	if (counter == nullptr) {
+		return;
+	}
+	if (counter->m_state.fetch_add(2, std::memory_order_relaxed) == 0) {
+		// done before, its continuations were handed out
+		counter->m_continuations.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+void TaskScheduler::_submit(task* t)
+{
+	const int index = get_thread_index();
+	if (index < 0 || !m_deques[index]->push(t)) {
+		m_injected.Push(t);
+		m_num_injected.fetch_add(1);
+	}
+	// pairs with a worker counting itself sleeping before it looks for work once more
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_num_sleeping.load() > 0) {
+		std::lock_guard<std::mutex> guard(m_sleep_lock);
+		m_wake.notify_one();
+	}
+}
+
+void TaskScheduler::_chain(task_counter& after, task* t)
+{
+	task* head = after.m_continuations.load(std::memory_order_acquire);
+	for (;;) {
+		if (head == CLOSED_CONTINUATIONS || after.m_state.load(std::memory_order_acquire) == 0) {
+			_submit(t);
+			return;
+		}
+		t->m_next = head;
+		if (after.m_continuations.compare_exchange_weak(head, t, std::memory_order_acq_rel)) {
+			return;
+		}
+	}
+}
+
+void TaskScheduler::_execute(task* t)
+{
+	t->m_run(t);
+	task_counter* counter = t->m_counter;
+	t->~task();
+	cached_free(t);
+	if (counter == nullptr) {
+		return;
+	}
+	size_t state = counter->m_state.load(std::memory_order_relaxed);
+	for (;;) {
+		if (state != 2) {
+			if (counter->m_state.compare_exchange_weak(state, state - 2, std::memory_order_acq_rel)) {
+				return;
+			}
+			continue;
+		}
+		if (counter->m_state.compare_exchange_weak(state, 1, std::memory_order_acq_rel)) {
+			break;
+		}
+	}
+	// the last one out hands out the continuations. Storing 0 is the last touch of the counter,
+	// its owner may free it right after
+	task* next = counter->m_continuations.exchange(CLOSED_CONTINUATIONS, std::memory_order_acq_rel);
+	counter->m_state.store(0, std::memory_order_release);
+	while (next != nullptr) {
+		task* each = next;
+		next = next->m_next;
+		each->m_next = nullptr;
+		_submit(each);
+	}
+}
+
+task* TaskScheduler::_try_get(int index)
+{
+	task* t = nullptr;
+	if (index >= 0) {
+		t = m_deques[index]->pop();
+		if (t != nullptr) {
+			return t;
+		}
+	}
+	if (m_num_injected.load(std::memory_order_relaxed) > 0 && m_injected.Pop(&t)) {
+		m_num_injected.fetch_sub(1);
+		return t;
+	}
+	const size_t num_deques = m_deques.size();
+	if (num_deques == 0) {
+		return nullptr;
+	}
+	const size_t first = _next_random() % num_deques;
+	for (size_t i = 0; i < num_deques; ++i) {
+		const size_t victim = (first + i) % num_deques;
+		if ((int)victim == index) {
+			continue;
+		}
+		t = m_deques[victim]->steal();
+		if (t != nullptr) {
+			m_num_steals.fetch_add(1, std::memory_order_relaxed);
+			return t;
+		}
+	}
+	return nullptr;
+}
+
+bool TaskScheduler::_has_work() const
+{
+	if (m_num_injected.load() > 0) {
+		return true;
+	}
+	for (const auto& each : m_deques) {
+		if (!each->is_empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TaskScheduler::_wants_split() const
+{
+	const int index = get_thread_index();
+	if (index < 0) {
+		return m_num_injected.load(std::memory_order_relaxed) == 0;
+	}
+	return m_deques[index]->is_empty();
+}
+
+void TaskScheduler::wait(task_counter& counter)
+{
+	const int index = get_thread_index();
+	int idle = 0;
+	while (!counter.is_done()) {
+		task* t = _try_get(index);
+		if (t != nullptr) {
+			_execute(t);
+			idle = 0;
+		} else if (++idle > IDLE_SPINS) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void TaskScheduler::_run_worker(int index)
+{
+	s_thread_scheduler = this;
+	s_thread_index = index;
+	char name[32];
+	snprintf(name, sizeof(name), "task worker %d", index);
+	trace_set_thread_name(name);
+
+	int idle = 0;
+	while (!m_quit.load(std::memory_order_relaxed)) {
+		task* t = _try_get(index);
+		if (t != nullptr) {
+			_execute(t);
+			idle = 0;
+			continue;
+		}
+		if (++idle < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleep_lock);
+		m_num_sleeping.fetch_add(1);
+		if (!m_quit.load() && !_has_work()) {
+			m_wake.wait_for(lock, IDLE_SLEEP);
+		}
+		m_num_sleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
@@ -0,0 +1,265 @@
+#pragma once
+#include "Game/LockFreeQueue.hpp"
+#include "Game/ThreadCachedAlloc.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Work-stealing task scheduler for the game's parallel work. Every worker owns a deque it pushes
+// and pops at the bottom while idle workers steal from the top; threads outside the scheduler
+// hand their tasks over through an injection queue. Waiting on a counter runs other tasks until
+// it drains, so the main thread works instead of blocking and tasks may wait on their own tasks.
+
+class TaskScheduler;
+class task_counter;
+extern TaskScheduler* g_theTasks;
+
+struct task
+{
+	// runs the callable, then destroys it
+	void (*m_run)(task* self);
+	task_counter* m_counter;
+	task* m_next; // in a continuation list
+	static constexpr size_t STORAGE = 96;
+	alignas(std::max_align_t) unsigned char m_storage[STORAGE];
+};
+
+// The tasks started against it that have not finished yet, and what runs once they have.
+// Start tasks on a counter only from its own tasks or once waiting on it returned, and keep it
+// alive until it is done
+class task_counter
+{
+public:
+	task_counter() = default;
+	task_counter(const task_counter&) = delete;
+	task_counter& operator=(const task_counter&) = delete;
+
+	bool is_done() const { return m_state.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class TaskScheduler;
+	// twice the pending tasks, plus one while the continuations are handed out
+	std::atomic<size_t> m_state{0};
+	std::atomic<task*> m_continuations{nullptr};
+};
+
+class TaskScheduler
+{
+public:
+	static constexpr size_t DEQUE_CAPACITY = 8 * 1024;
+	// a parallel_for aims for this many chunks per thread when it picks the grain
+	static constexpr size_t CHUNKS_PER_THREAD = 16;
+public:
+	~TaskScheduler();
+	// num_workers == 0 means hardware_concurrency - 1, at least one. The calling thread joins as
+	// thread 0, it runs tasks whenever it waits
+	void startup(size_t num_workers=0);
+	// tasks still queued run on the calling thread first
+	void shutdown();
+
+	template<typename Fn>
+	void run(task_counter* counter, Fn&& fn);
+	// fn runs once every task started on after has finished, counter counts it from now on
+	template<typename Fn>
+	void run_after(task_counter& after, task_counter* counter, Fn&& fn);
+	void wait(task_counter& counter);
+
+	// fn(chunk_begin, chunk_end) over [begin, end). The range is split in half only while this
+	// thread's deque is empty, so it is cut finer when others steal and stays in grain sized
+	// chunks on one thread when nobody does. grain == 0 picks one from the thread count
+	template<typename Fn>
+	void parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn);
+	// fn(worker) for every worker in [0, num), each on its own task, worker 0 on the calling thread
+	template<typename Fn>
+	void run_on_workers(size_t num, Fn&& fn);
+
+	size_t get_num_threads() const { return m_deques.size(); }
+	// 0 for the thread that started the scheduler, 1.. for the workers, -1 for any other thread
+	int get_thread_index() const;
+	size_t get_num_steals() const { return m_num_steals.load(std::memory_order_relaxed); }
+
+private:
+	// Chase-Lev: the owner pushes and pops the bottom, thieves take the top with a CAS
+	struct task_deque
+	{
+		alignas(64) std::atomic<int64_t> m_top{0};
+		alignas(64) std::atomic<int64_t> m_bottom{0};
+		std::atomic<task*> m_tasks[DEQUE_CAPACITY] = {};
+
+		bool push(task* t);
+		task* pop();
+		task* steal();
+		bool is_empty() const;
+	};
+
+	template<typename Fn>
+	static task* _make_task(task_counter* counter, Fn&& fn);
+	static void _arm(task_counter* counter);
+	template<typename Fn>
+	void _parallel_range(task_counter& counter, size_t begin, size_t end, size_t grain, Fn& fn);
+
+	void _submit(task* t);
+	void _chain(task_counter& after, task* t);
+	void _execute(task* t);
+	task* _try_get(int index);
+	bool _has_work() const;
+	// whether a parallel_for on this thread should split off more work
+	bool _wants_split() const;
+	void _run_worker(int index);
+
+private:
+	std::vector<std::unique_ptr<task_deque>> m_deques; // one per thread, the starting thread first
+	std::vector<std::thread> m_workers;
+	SegmentedQueue<task*> m_injected;
+	std::atomic<size_t> m_num_injected{0};
+	std::atomic<size_t> m_num_steals{0};
+	std::atomic<bool> m_quit{false};
+
+	std::mutex m_sleep_lock;
+	std::condition_variable m_wake;
+	std::atomic<int> m_num_sleeping{0};
+};
+
+//////////////////////////////////////////////////////////////////////////
+template<typename Fn>
+task* TaskScheduler::_make_task(task_counter* counter, Fn&& fn)
+{
+	using fn_type = std::decay_t<Fn>;
+	task* t = new (cached_alloc(sizeof(task))) task;
+	t->m_counter = counter;
+	t->m_next = nullptr;
+	if constexpr (sizeof(fn_type) <= task::STORAGE && alignof(fn_type) <= alignof(std::max_align_t)) {
+		new (t->m_storage) fn_type(std::forward<Fn>(fn));
+		t->m_run = [](task* self) {
+			fn_type& each = *std::launder(reinterpret_cast<fn_type*>(self->m_storage));
+			each();
+			each.~fn_type();
+		};
+	} else {
+		// too big to keep inline
+		fn_type* boxed = new fn_type(std::forward<Fn>(fn));
+		memcpy(t->m_storage, &boxed, sizeof(boxed));
+		t->m_run = [](task* self) {
+			fn_type* each;
+			memcpy(&each, self->m_storage, sizeof(each));
+			(*each)();
+			delete each;
+		};
+	}
+	_arm(counter);
+	return t;
+}
+
+template<typename Fn>
+void TaskScheduler::run(task_counter* counter, Fn&& fn)
+{
+	_submit(_make_task(counter, std::forward<Fn>(fn)));
+}
+
+template<typename Fn>
+void TaskScheduler::run_after(task_counter& after, task_counter* counter, Fn&& fn)
+{
+	_chain(after, _make_task(counter, std::forward<Fn>(fn)));
+}
+
+template<typename Fn>
+void TaskScheduler::_parallel_range(task_counter& counter, size_t begin, size_t end, size_t grain, Fn& fn)
+{
+	while (begin < end) {
+		if (end - begin > grain && _wants_split()) {
+			const size_t mid = begin + (end - begin) / 2;
+			run(&counter, [this, &counter, mid, end, grain, &fn]() {
+				_parallel_range(counter, mid, end, grain, fn);
+			});
+			end = mid;
+			continue;
+		}
+		const size_t chunk_end = std::min(end, begin + grain);
+		fn(begin, chunk_end);
+		begin = chunk_end;
+	}
+}
+
+template<typename Fn>
+void TaskScheduler::parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn)
+{
+	if (begin >= end) {
+		return;
+	}
+	if (grain == 0) {
+		grain = std::max((size_t)1, (end - begin) / (std::max((size_t)1, get_num_threads()) * CHUNKS_PER_THREAD));
+	}
+	task_counter counter;
+	_parallel_range(counter, begin, end, grain, fn);
+	wait(counter);
+}
+
+template<typename Fn>
+void TaskScheduler::run_on_workers(size_t num, Fn&& fn)
+{
+	task_counter counter;
+	for (size_t i = 1; i < num; ++i) {
+		run(&counter, [&fn, i]() { fn(i); });
+	}
+	if (num > 0) {
+		fn((size_t)0);
+	}
+	wait(counter);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// These run on the calling thread when there is no scheduler, as in tools and early tests
+
+inline size_t get_num_task_threads()
+{
+	return g_theTasks != nullptr ? g_theTasks->get_num_threads() : 1;
+}
+
+template<typename Fn>
+void run_task(task_counter* counter, Fn&& fn)
+{
+	if (g_theTasks != nullptr) {
+		g_theTasks->run(counter, std::forward<Fn>(fn));
+	} else {
+		fn();
+	}
+}
+
+inline void wait_tasks(task_counter& counter)
+{
+	if (g_theTasks != nullptr) {
+		g_theTasks->wait(counter);
+	}
+}
+
+template<typename Fn>
+void parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn)
+{
+	if (g_theTasks != nullptr) {
+		g_theTasks->parallel_for(begin, end, grain, std::forward<Fn>(fn));
+	} else if (begin < end) {
+		fn(begin, end);
+	}
+}
+
+template<typename Fn>
+void run_on_workers(size_t num, Fn&& fn)
+{
+	if (g_theTasks != nullptr) {
+		g_theTasks->run_on_workers(num, std::forward<Fn>(fn));
+		return;
+	}
+	for (size_t i = 0; i < num; ++i) {
+		fn(i);
+	}
+}
@@ -0,0 +1,82 @@
+#include "Game/GameTest.hpp"
+#include "Game/TaskScheduler.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+GAME_TEST(taskParallelForCoversRange, "tasks", 1)
+{
+	// every index exactly once, for grains that do and do not divide the range
+	std::vector<std::atomic<int>> hits(10007);
+	for (size_t grain : {(size_t)0, (size_t)1, (size_t)7, (size_t)4096}) {
+		for (auto& each : hits) {
+			each.store(0);
+		}
+		parallel_for(0, hits.size(), grain, [&hits](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				++hits[i];
+			}
+		});
+		for (const auto& each : hits) {
+			if (each.load() != 1) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+GAME_TEST(taskContinuationsRunAfter, "tasks", 1)
+{
+	if (g_theTasks == nullptr) {
+		return false;
+	}
+	std::mutex lock;
+	std::vector<int> order;
+	auto record = [&lock, &order](int step) {
+		std::lock_guard<std::mutex> guard(lock);
+		order.push_back(step);
+	};
+	task_counter first;
+	task_counter second;
+	task_counter third;
+	for (int i = 0; i < 100; ++i) {
+		g_theTasks->run(&first, [&record]() { record(1); });
+	}
+	g_theTasks->run_after(first, &second, [&record]() { record(2); });
+	g_theTasks->run_after(second, &third, [&record]() { record(3); });
+	g_theTasks->wait(third);
+	g_theTasks->wait(first);
+	g_theTasks->wait(second);
+	if (order.size() != 102 || order[100] != 2 || order[101] != 3) {
+		return false;
+	}
+	// chained on a counter that is already done, it runs right away
+	task_counter late;
+	g_theTasks->run_after(first, &late, [&record]() { record(4); });
+	g_theTasks->wait(late);
+	return order.size() == 103 && order.back() == 4;
+}
+
+GAME_TEST(taskNestedWaits, "tasks", 1)
+{
+	if (g_theTasks == nullptr) {
+		return false;
+	}
+	// tasks waiting on their own tasks run others meanwhile instead of blocking a thread
+	std::atomic<int> num_leaves = 0;
+	task_counter outer;
+	for (int i = 0; i < 16; ++i) {
+		g_theTasks->run(&outer, [&num_leaves]() {
+			task_counter inner;
+			for (int j = 0; j < 64; ++j) {
+				g_theTasks->run(&inner, [&num_leaves]() { ++num_leaves; });
+			}
+			g_theTasks->wait(inner);
+		});
+	}
+	g_theTasks->wait(outer);
+	std::atomic<size_t> num_workers = 0;
+	run_on_workers(4, [&num_workers](size_t worker) { num_workers += worker + 1; });
+	return num_leaves == 16 * 64 && num_workers == 1 + 2 + 3 + 4;
+}
@@ -0,0 +1,625 @@
+#include "Game/ThreadCachedAlloc.hpp"
+#include "Game/EngineBuildPreferences.hpp"
+#include "Engine/Develop/Memory.hpp"
+#include "Game/AsyncLog.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN		// Always #define this before #including <windows.h>
+#include <windows.h>
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define HAS_EXECINFO_BACKTRACE
+#endif
+
+// size classes 16, 32, 64 ... CACHED_ALLOC_MAX_SIZE
+constexpr unsigned int NUM_SIZE_CLASSES = 8;
+static_assert((16u << (NUM_SIZE_CLASSES - 1)) == CACHED_ALLOC_MAX_SIZE, "size classes must end at CACHED_ALLOC_MAX_SIZE");
+// blocks moved between a thread cache and the shared list at a time
+constexpr unsigned int TRANSFER_BATCH = 64;
+// a thread keeps at most this many free blocks of a class
+constexpr unsigned int MAX_CACHED_BLOCKS = TRANSFER_BATCH * 2;
+constexpr size_t SLAB_SIZE = 64 * 1024;
+// with sampling off, threads look at the rate again after this many allocations
+constexpr unsigned int SAMPLE_RECHECK = 64 * 1024;
+constexpr unsigned int MAX_SAMPLE_FRAMES = 16;
+// sample events a thread holds before it drains them itself
+constexpr unsigned int SAMPLE_RING_SIZE = 128;
+constexpr unsigned int MAX_LOGGED_CALLSTACKS = 16;
+
+namespace {
+struct alloc_sample
+{
+	size_t m_byte_size = 0;
+	unsigned int m_rate = 0; // what it stands for
+	unsigned int m_num_frames = 0;
+	void* m_frames[MAX_SAMPLE_FRAMES] = {};
+};
+
+// a sampled allocation, or the free of one
+struct sample_event
+{
+	uint64_t m_id = 0;
+	bool m_is_free = false;
+	alloc_sample m_sample; // allocations only
+};
+
+// Written by the owning thread, drained under s_samples_lock by a report or by the owner once full
+struct sample_ring
+{
+	sample_event m_events[SAMPLE_RING_SIZE];
+	std::atomic<size_t> m_head{0}; // owner only
+	std::atomic<size_t> m_tail{0}; // drainer only
+};
+
+struct alignas(16) alloc_header
+{
+	uint64_t m_sample_id; // 0 unless sampled
+	size_t m_byte_size; // as asked for, picks the size class back on free
+};
+
+struct free_block
+{
+	free_block* m_next;
+};
+
+struct free_list
+{
+	free_block* m_head = nullptr;
+	unsigned int m_count = 0;
+};
+
+struct central_list
+{
+	std::mutex m_lock;
+	free_list m_list;
+	std::vector<uintptr_t> m_slabs; // sorted, every slab carved for this class
+};
+
+// One per thread at a time. A thread that exits hands its blocks back and leaves the counters for
+// the next thread to claim it, so there are only ever as many as threads alive at once
+struct thread_cache
+{
+	free_list m_lists[NUM_SIZE_CLASSES];
+	// written by the owner only, read by whoever sums them
+	std::atomic<size_t> m_num_allocs{0};
+	std::atomic<size_t> m_num_frees{0};
+	std::atomic<size_t> m_alloc_bytes{0};
+	std::atomic<size_t> m_free_bytes{0};
+	// the part of the counts that went straight to TrackedAlloc
+	std::atomic<size_t> m_num_large_allocs{0};
+	std::atomic<size_t> m_num_large_frees{0};
+	sample_ring m_samples;
+	unsigned int m_sample_countdown = 0;
+	thread_cache* m_next = nullptr; // never unlinked
+	bool m_in_use = false; // under s_registry_lock
+};
+
+struct thread_cache_owner
+{
+	~thread_cache_owner();
+};
+}
+
+static central_list s_central[NUM_SIZE_CLASSES];
+static std::atomic<size_t> s_num_slabs{0};
+
+static std::mutex s_registry_lock;
+static thread_cache* s_caches = nullptr;
+// counts of whatever threads do after their cache is gone
+static std::atomic<size_t> s_orphan_allocs{0};
+static std::atomic<size_t> s_orphan_frees{0};
+static std::atomic<size_t> s_orphan_alloc_bytes{0};
+static std::atomic<size_t> s_orphan_free_bytes{0};
+static std::atomic<size_t> s_orphan_large_allocs{0};
+static std::atomic<size_t> s_orphan_large_frees{0};
+
+static std::atomic<unsigned int> s_sample_rate{DEFAULT_ALLOC_SAMPLE_RATE};
+static std::atomic<uint64_t> s_next_sample_id{1};
+// what the drained rings add up to, never freed so threads exiting late can still drain
+static std::mutex s_samples_lock;
+static std::unordered_map<uint64_t, alloc_sample>* s_live_samples = nullptr;
+// frees drained before their allocation, which sits in another thread's ring
+static std::unordered_set<uint64_t>* s_early_frees = nullptr;
+
+static thread_local thread_cache* s_cache = nullptr;
+static thread_local bool s_cache_gone = false;
+
+static unsigned int _get_size_class(size_t byte_size)
+{
+	unsigned int size_class = 0;
+	for (size_t size = 16; size < byte_size; size <<= 1) {
+		++size_class;
+	}
+	return size_class;
+}
+
+static size_t _get_block_size(unsigned int size_class)
+{
+	return sizeof(alloc_header) + ((size_t)16 << size_class);
+}
+
+static unsigned int _get_sample_countdown()
+{
+	const unsigned int rate = s_sample_rate.load(std::memory_order_relaxed);
+	return rate == 0 ? SAMPLE_RECHECK : rate;
+}
+
+// only the owner writes, so no read-modify-write
+static void _bump(std::atomic<size_t>& counter, size_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static thread_cache* _get_cache()
+{
+	if (s_cache != nullptr || s_cache_gone) {
+		return s_cache;
+	}
+	{
+		std::lock_guard<std::mutex> lock(s_registry_lock);
+		thread_cache* claimed = s_caches;
+		while (claimed != nullptr && claimed->m_in_use) {
+			claimed = claimed->m_next;
+		}
+		if (claimed == nullptr) {
+			claimed = new thread_cache();
+			claimed->m_next = s_caches;
+			s_caches = claimed;
+		}
+		claimed->m_in_use = true;
+		claimed->m_sample_countdown = _get_sample_countdown();
+		s_cache = claimed;
+	}
+	// hands the cache back when the thread exits
+	static thread_local thread_cache_owner s_owner;
+	(void)s_owner;
+	return s_cache;
+}
+
+static void _push_central(unsigned int size_class, free_block* first, free_block* last, unsigned int count)
+{
+	central_list& central = s_central[size_class];
+	std::lock_guard<std::mutex> lock(central.m_lock);
+	last->m_next = central.m_list.m_head;
+	central.m_list.m_head = first;
+	central.m_list.m_count += count;
+}
+
+// at least one block into list
+static void _refill(free_list& list, unsigned int size_class)
+{
+	{
+		central_list& central = s_central[size_class];
+		std::lock_guard<std::mutex> lock(central.m_lock);
+		while (central.m_list.m_head != nullptr && list.m_count < TRANSFER_BATCH) {
+			free_block* block = central.m_list.m_head;
+			central.m_list.m_head = block->m_next;
+			--central.m_list.m_count;
+			block->m_next = list.m_head;
+			list.m_head = block;
+			++list.m_count;
+		}
+	}
+	if (list.m_count != 0) {
+		return;
+	}
+	// blocks keep circulating, a slab is only freed once a thread exit finds all of it free
+	unsigned char* slab = (unsigned char*)TrackedAlloc(SLAB_SIZE);
+	++s_num_slabs;
+	{
+		central_list& central = s_central[size_class];
+		std::lock_guard<std::mutex> lock(central.m_lock);
+		central.m_slabs.insert(std::upper_bound(central.m_slabs.begin(), central.m_slabs.end(), (uintptr_t)slab), (uintptr_t)slab);
+	}
+	const size_t block_size = _get_block_size(size_class);
+	for (size_t offset = 0; offset + block_size <= SLAB_SIZE; offset += block_size) {
+		free_block* block = (free_block*)(slab + offset);
+		block->m_next = list.m_head;
+		list.m_head = block;
+		++list.m_count;
+	}
+}
+
+static void* _pop_block(thread_cache* cache, unsigned int size_class)
+{
+	if (cache == nullptr) {
+		free_list one;
+		_refill(one, size_class);
+		if (one.m_count > 1) {
+			free_block* last = one.m_head->m_next;
+			while (last->m_next != nullptr) {
+				last = last->m_next;
+			}
+			_push_central(size_class, one.m_head->m_next, last, one.m_count - 1);
+		}
+		return one.m_head;
+	}
+	free_list& list = cache->m_lists[size_class];
+	if (list.m_head == nullptr) {
+		_refill(list, size_class);
+	}
+	free_block* block = list.m_head;
+	list.m_head = block->m_next;
+	--list.m_count;
+	return block;
+}
+
+static void _push_block(thread_cache* cache, unsigned int size_class, void* ptr)
+{
+	free_block* block = (free_block*)ptr;
+	if (cache == nullptr) {
+		_push_central(size_class, block, block, 1);
+		return;
+	}
+	free_list& list = cache->m_lists[size_class];
+	block->m_next = list.m_head;
+	list.m_head = block;
+	++list.m_count;
+	if (list.m_count > MAX_CACHED_BLOCKS) {
+		// the ones just freed stay, they are the warm ones
+		free_block* last = list.m_head;
+		for (unsigned int i = 1; i < MAX_CACHED_BLOCKS - TRANSFER_BATCH; ++i) {
+			last = last->m_next;
+		}
+		free_block* spilled = last->m_next;
+		last->m_next = nullptr;
+		free_block* spilled_last = spilled;
+		while (spilled_last->m_next != nullptr) {
+			spilled_last = spilled_last->m_next;
+		}
+		list.m_count = MAX_CACHED_BLOCKS - TRANSFER_BATCH;
+		_push_central(size_class, spilled, spilled_last, TRANSFER_BATCH + 1);
+	}
+}
+
+// Under the class's lock. A slab whose every block is back in the shared list goes back to
+// TrackedFree; blocks still held by a thread cache or a caller keep theirs
+static void _release_empty_slabs(central_list& central, unsigned int size_class)
+{
+	const unsigned int blocks_per_slab = (unsigned int)(SLAB_SIZE / _get_block_size(size_class));
+	if (central.m_list.m_count < blocks_per_slab) {
+		return;
+	}
+	auto find_slab = [&central](const free_block* block) {
+		return (size_t)(std::upper_bound(central.m_slabs.begin(), central.m_slabs.end(), (uintptr_t)block) - central.m_slabs.begin()) - 1;
+	};
+	std::vector<unsigned int> num_free(central.m_slabs.size(), 0);
+	for (const free_block* block = central.m_list.m_head; block != nullptr; block = block->m_next) {
+		++num_free[find_slab(block)];
+	}
+	free_block** link = &central.m_list.m_head;
+	while (*link != nullptr) {
+		if (num_free[find_slab(*link)] == blocks_per_slab) {
+			*link = (*link)->m_next;
+			--central.m_list.m_count;
+		} else {
+			link = &(*link)->m_next;
+		}
+	}
+	size_t num_kept = 0;
+	for (size_t i = 0; i < central.m_slabs.size(); ++i) {
+		if (num_free[i] == blocks_per_slab) {
+			TrackedFree((void*)central.m_slabs[i]);
+			--s_num_slabs;
+		} else {
+			central.m_slabs[num_kept++] = central.m_slabs[i];
+		}
+	}
+	central.m_slabs.resize(num_kept);
+}
+
+// under s_samples_lock
+static void _apply_sample_event(const sample_event& event)
+{
+	if (s_live_samples == nullptr) {
+		s_live_samples = new std::unordered_map<uint64_t, alloc_sample>();
+		s_early_frees = new std::unordered_set<uint64_t>();
+	}
+	if (event.m_is_free) {
+		if (s_live_samples->erase(event.m_id) == 0) {
+			s_early_frees->insert(event.m_id);
+		}
+	} else if (s_early_frees->erase(event.m_id) == 0) {
+		(*s_live_samples)[event.m_id] = event.m_sample;
+	}
+}
+
+// under s_samples_lock
+static void _drain_samples(sample_ring& ring)
+{
+	const size_t head = ring.m_head.load(std::memory_order_acquire);
+	size_t tail = ring.m_tail.load(std::memory_order_relaxed);
+	for (; tail != head; ++tail) {
+		_apply_sample_event(ring.m_events[tail % SAMPLE_RING_SIZE]);
+	}
+	ring.m_tail.store(tail, std::memory_order_release);
+}
+
+// every thread's ring, for a report; the caller holds s_samples_lock
+static void _drain_all_samples()
+{
+	std::lock_guard<std::mutex> lock(s_registry_lock);
+	for (thread_cache* each = s_caches; each != nullptr; each = each->m_next) {
+		_drain_samples(each->m_samples);
+	}
+}
+
+static void _record_sample_event(thread_cache* cache, const sample_event& event)
+{
+	if (cache == nullptr) {
+		std::lock_guard<std::mutex> lock(s_samples_lock);
+		_apply_sample_event(event);
+		return;
+	}
+	sample_ring& ring = cache->m_samples;
+	const size_t head = ring.m_head.load(std::memory_order_relaxed);
+	if (head - ring.m_tail.load(std::memory_order_acquire) == SAMPLE_RING_SIZE) {
+		// nobody took a report in a while, make room
+		std::lock_guard<std::mutex> lock(s_samples_lock);
+		_drain_samples(ring);
+	}
+	ring.m_events[head % SAMPLE_RING_SIZE] = event;
+	ring.m_head.store(head + 1, std::memory_order_release);
+}
+
+thread_cache_owner::~thread_cache_owner()
+{
+	thread_cache* cache = s_cache;
+	for (unsigned int c = 0; c < NUM_SIZE_CLASSES; ++c) {
+		free_list& list = cache->m_lists[c];
+		if (list.m_head == nullptr) {
+			continue;
+		}
+		free_block* last = list.m_head;
+		while (last->m_next != nullptr) {
+			last = last->m_next;
+		}
+		_push_central(c, list.m_head, last, list.m_count);
+		list = free_list();
+		central_list& central = s_central[c];
+		std::lock_guard<std::mutex> lock(central.m_lock);
+		_release_empty_slabs(central, c);
+	}
+	{
+		std::lock_guard<std::mutex> lock(s_samples_lock);
+		_drain_samples(cache->m_samples);
+	}
+	s_cache = nullptr;
+	s_cache_gone = true;
+	std::lock_guard<std::mutex> lock(s_registry_lock);
+	cache->m_in_use = false;
+}
+
+static unsigned int _capture_callstack(void** frames, unsigned int max_frames)
+{
+	// skips this and _take_sample
+	constexpr unsigned int NUM_SKIPPED = 2;
+#if defined(_WIN32)
+	return (unsigned int)CaptureStackBackTrace(NUM_SKIPPED, max_frames, frames, nullptr);
+#elif defined(HAS_EXECINFO_BACKTRACE)
+	void* all[MAX_SAMPLE_FRAMES + NUM_SKIPPED];
+	const int num_all = backtrace(all, (int)(std::min(max_frames, MAX_SAMPLE_FRAMES) + NUM_SKIPPED));
+	if (num_all <= (int)NUM_SKIPPED) {
+		return 0;
+	}
+	std::copy(all + NUM_SKIPPED, all + num_all, frames);
+	return (unsigned int)num_all - NUM_SKIPPED;
+#else
+	// no unwinder to ask, the sample still counts
+	(void)frames;
+	(void)max_frames;
+	return 0;
+#endif
+}
+
+static uint64_t _take_sample(thread_cache* cache, size_t byte_size, unsigned int rate)
+{
+	sample_event event;
+	event.m_id = s_next_sample_id++;
+	event.m_sample.m_byte_size = byte_size;
+	event.m_sample.m_rate = rate;
+	event.m_sample.m_num_frames = _capture_callstack(event.m_sample.m_frames, MAX_SAMPLE_FRAMES);
+	_record_sample_event(cache, event);
+	return event.m_id;
+}
+
+void* cached_alloc(size_t byte_size)
+{
+	thread_cache* cache = _get_cache();
+	alloc_header* header;
+	const bool large = byte_size > CACHED_ALLOC_MAX_SIZE;
+	if (large) {
+		header = (alloc_header*)TrackedAlloc(sizeof(alloc_header) + byte_size);
+	} else {
+		header = (alloc_header*)_pop_block(cache, _get_size_class(byte_size));
+	}
+	header->m_sample_id = 0;
+	header->m_byte_size = byte_size;
+
+	if (cache != nullptr) {
+		if (--cache->m_sample_countdown == 0) {
+			const unsigned int rate = s_sample_rate.load(std::memory_order_relaxed);
+			if (rate != 0) {
+				header->m_sample_id = _take_sample(cache, byte_size, rate);
+			}
+			cache->m_sample_countdown = _get_sample_countdown();
+		}
+		_bump(cache->m_num_allocs, 1);
+		_bump(cache->m_alloc_bytes, byte_size);
+		if (large) {
+			_bump(cache->m_num_large_allocs, 1);
+		}
+	} else {
+		++s_orphan_allocs;
+		s_orphan_alloc_bytes += byte_size;
+		if (large) {
+			++s_orphan_large_allocs;
+		}
+	}
+	return header + 1;
+}
+
+void cached_free(void* ptr)
+{
+	if (ptr == nullptr) {
+		return;
+	}
+	alloc_header* header = (alloc_header*)ptr - 1;
+	const size_t byte_size = header->m_byte_size;
+	const bool large = byte_size > CACHED_ALLOC_MAX_SIZE;
+	thread_cache* cache = _get_cache();
+	if (header->m_sample_id != 0) {
+		sample_event event;
+		event.m_id = header->m_sample_id;
+		event.m_is_free = true;
+		_record_sample_event(cache, event);
+	}
+	if (cache != nullptr) {
+		_bump(cache->m_num_frees, 1);
+		_bump(cache->m_free_bytes, byte_size);
+		if (large) {
+			_bump(cache->m_num_large_frees, 1);
+		}
+	} else {
+		++s_orphan_frees;
+		s_orphan_free_bytes += byte_size;
+		if (large) {
+			++s_orphan_large_frees;
+		}
+	}
+	if (large) {
+		TrackedFree(header);
+	} else {
+		_push_block(cache, _get_size_class(byte_size), header);
+	}
+}
+
+size_t get_cached_live_allocation_count()
+{
+	// a block freed on another thread than the one that made it counts down over there,
+	// only the sum means anything
+	size_t num_allocs = s_orphan_allocs.load();
+	size_t num_frees = s_orphan_frees.load();
+	std::lock_guard<std::mutex> lock(s_registry_lock);
+	for (const thread_cache* each = s_caches; each != nullptr; each = each->m_next) {
+		num_allocs += each->m_num_allocs.load(std::memory_order_relaxed);
+		num_frees += each->m_num_frees.load(std::memory_order_relaxed);
+	}
+	return num_allocs - num_frees;
+}
+
+size_t get_cached_live_bytes()
+{
+	size_t alloc_bytes = s_orphan_alloc_bytes.load();
+	size_t free_bytes = s_orphan_free_bytes.load();
+	std::lock_guard<std::mutex> lock(s_registry_lock);
+	for (const thread_cache* each = s_caches; each != nullptr; each = each->m_next) {
+		alloc_bytes += each->m_alloc_bytes.load(std::memory_order_relaxed);
+		free_bytes += each->m_free_bytes.load(std::memory_order_relaxed);
+	}
+	return alloc_bytes - free_bytes;
+}
+
+size_t get_num_cached_slabs()
+{
+	return s_num_slabs.load();
+}
+
+// cached blocks carved from slabs, the rest are TrackedAlloc'd on their own
+static size_t _get_live_slab_block_count()
+{
+	size_t num_allocs = s_orphan_allocs.load() - s_orphan_large_allocs.load();
+	size_t num_frees = s_orphan_frees.load() - s_orphan_large_frees.load();
+	std::lock_guard<std::mutex> lock(s_registry_lock);
+	for (const thread_cache* each = s_caches; each != nullptr; each = each->m_next) {
+		num_allocs += each->m_num_allocs.load(std::memory_order_relaxed) - each->m_num_large_allocs.load(std::memory_order_relaxed);
+		num_frees += each->m_num_frees.load(std::memory_order_relaxed) - each->m_num_large_frees.load(std::memory_order_relaxed);
+	}
+	return num_allocs - num_frees;
+}
+
+size_t get_live_allocation_count()
+{
+#if MEM_TRACKING != MEM_TRACKING_DISABLE
+	// large cached blocks are TrackedAlloc'd one by one and already in there
+	return GetLiveAllocationCount() - s_num_slabs.load() + _get_live_slab_block_count();
+#else
+	return get_cached_live_allocation_count();
+#endif
+}
+
+void set_alloc_sample_rate(unsigned int every_n)
+{
+	s_sample_rate.store(every_n);
+}
+
+unsigned int get_alloc_sample_rate()
+{
+	return s_sample_rate.load();
+}
+
+size_t get_num_live_samples()
+{
+	std::lock_guard<std::mutex> lock(s_samples_lock);
+	_drain_all_samples();
+	return s_live_samples != nullptr ? s_live_samples->size() : 0;
+}
+
+void log_live_allocations()
+{
+	LogLiveAllocations();
+	AsyncLog("memory", "live allocations: %u, %u of them cached (%u B) in %u slab(s) of %u B, sampling 1 in %u",
+		(unsigned int)get_live_allocation_count(), (unsigned int)get_cached_live_allocation_count(),
+		(unsigned int)get_cached_live_bytes(), (unsigned int)s_num_slabs.load(), (unsigned int)SLAB_SIZE,
+		get_alloc_sample_rate());
+
+	struct callstack_total
+	{
+		const alloc_sample* m_first;
+		size_t m_num_samples = 0;
+		double m_estimated_count = 0;
+		double m_estimated_bytes = 0;
+	};
+	std::vector<callstack_total> totals;
+	std::lock_guard<std::mutex> lock(s_samples_lock);
+	_drain_all_samples();
+	if (s_live_samples == nullptr) {
+		return;
+	}
+	for (const auto& [id, each] : *s_live_samples) {
+		auto found = std::find_if(totals.begin(), totals.end(), [&each = each](const callstack_total& total) {
+			return total.m_first->m_num_frames == each.m_num_frames
+				&& std::equal(each.m_frames, each.m_frames + each.m_num_frames, total.m_first->m_frames);
+		});
+		if (found == totals.end()) {
+			totals.push_back(callstack_total{ &each });
+			found = totals.end() - 1;
+		}
+		++found->m_num_samples;
+		found->m_estimated_count += each.m_rate;
+		found->m_estimated_bytes += (double)each.m_rate * (double)each.m_byte_size;
+	}
+	std::sort(totals.begin(), totals.end(), [](const callstack_total& a, const callstack_total& b) {
+		return a.m_estimated_bytes > b.m_estimated_bytes;
+	});
+	for (size_t i = 0; i < totals.size() && i < MAX_LOGGED_CALLSTACKS; ++i) {
+		std::string frames;
+		char address[24];
+		for (unsigned int f = 0; f < totals[i].m_first->m_num_frames; ++f) {
+			snprintf(address, sizeof(address), " %p", totals[i].m_first->m_frames[f]);
+			frames += address;
+		}
+		AsyncLog("memory", "%u sample(s), ~%.0f allocation(s), ~%.0f B from%s",
+			(unsigned int)totals[i].m_num_samples, totals[i].m_estimated_count, totals[i].m_estimated_bytes,
+			frames.empty() ? " (no callstack)" : frames.c_str());
+	}
+}
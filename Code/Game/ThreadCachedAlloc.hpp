@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+
+// Small-block allocator in front of TrackedAlloc. Blocks up to CACHED_ALLOC_MAX_SIZE come from
+// per-thread free lists by size class, refilled from and spilled to shared lists in batches, and
+// the shared lists carve TrackedAlloc'd slabs. Bigger blocks go straight to TrackedAlloc.
+// A thread that exits hands its blocks back, and slabs left with no block in use are freed then.
+// Counting is per thread and only summed when someone asks, so the hot path takes no lock and
+// touches no shared cache line. Every cached_alloc is counted; one in every sample rate also
+// keeps the callstack it came from. Samples and their frees go into a ring owned by the thread,
+// drained when a report is taken, which is what log_live_allocations prints.
+// Callstacks come from CaptureStackBackTrace on Windows and backtrace() with glibc or on Apple
+// platforms; anywhere else samples keep no frames and are logged as "(no callstack)"
+
+constexpr size_t CACHED_ALLOC_MAX_SIZE = 2048;
+// cheap enough to leave on in release
+constexpr unsigned int DEFAULT_ALLOC_SAMPLE_RATE = 4096;
+
+void* cached_alloc(size_t byte_size);
+// any thread may free, the block goes to that thread's cache
+void cached_free(void* ptr);
+
+// exact once the threads allocating are quiet
+size_t get_cached_live_allocation_count();
+size_t get_cached_live_bytes();
+size_t get_num_cached_slabs();
+
+// GetLiveAllocationCount with every slab swapped for the cached blocks live in it, so it counts
+// what callers hold. Without MEM_TRACKING only the cached blocks are counted
+size_t get_live_allocation_count();
+
+// 0 stops sampling, 1 samples every allocation. Threads pick a new rate up at their next sample
+void set_alloc_sample_rate(unsigned int every_n);
+unsigned int get_alloc_sample_rate();
+// live sampled allocations still held
+size_t get_num_live_samples();
+
+// LogLiveAllocations, the merged totals, then the sampled callstacks grouped and sorted by bytes
+void log_live_allocations();
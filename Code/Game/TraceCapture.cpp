@@ -0,0 +1,357 @@
+#include "Game/TraceCapture.hpp"
+#include "Game/AsyncLog.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// a buffer's state packs the capture it belongs to above its event count
+constexpr int TRACE_COUNT_BITS = 40;
+constexpr uint64_t TRACE_COUNT_MASK = ((uint64_t)1 << TRACE_COUNT_BITS) - 1;
+constexpr size_t MAX_TRACE_THREAD_NAME = 32;
+
+namespace {
+enum trace_event_type : unsigned char
+{
+	TRACE_BEGIN,
+	TRACE_END,
+	TRACE_INSTANT,
+	TRACE_COUNTER,
+};
+
+struct trace_event
+{
+	uint64_t m_tsc;
+	const char* m_name; // null for ends
+	trace_event_type m_type;
+	unsigned int m_value; // TRACE_COUNTER only
+};
+
+// written by its thread only, read by the export after the capture
+struct thread_trace
+{
+	std::atomic<uint64_t> m_state{0};
+	std::atomic<trace_event*> m_chunks[MAX_TRACE_CHUNKS] = {};
+	unsigned int m_tid = 0;
+	char m_name[MAX_TRACE_THREAD_NAME] = {}; // under s_threads_lock
+	bool m_exited = false; // under s_threads_lock
+	thread_trace* m_next = nullptr;
+};
+
+struct thread_trace_owner
+{
+	~thread_trace_owner();
+};
+}
+
+static std::atomic<bool> s_capturing{false};
+static std::atomic<unsigned int> s_capture{0}; // counts captures up from 1
+
+static std::mutex s_threads_lock;
+static thread_trace* s_threads = nullptr;
+static unsigned int s_next_tid = 1;
+static thread_local thread_trace* s_thread = nullptr;
+static thread_local bool s_thread_gone = false;
+
+// main thread only
+static int s_pending_frames = 0;
+static int s_frames_left = 0;
+static std::string s_path;
+static uint64_t s_begin_tsc = 0;
+static uint64_t s_end_tsc = 0;
+static double s_begin_seconds = 0.0;
+static double s_end_seconds = 0.0;
+
+static uint64_t _read_tsc()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+static double _get_seconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static thread_trace* _get_thread_trace()
+{
+	if (s_thread != nullptr || s_thread_gone) {
+		return s_thread;
+	}
+	{
+		std::lock_guard<std::mutex> lock(s_threads_lock);
+		s_thread = new thread_trace();
+		s_thread->m_tid = s_next_tid++;
+		s_thread->m_next = s_threads;
+		s_threads = s_thread;
+	}
+	// marks the buffer for freeing when the thread exits
+	static thread_local thread_trace_owner s_owner;
+	(void)s_owner;
+	return s_thread;
+}
+
+thread_trace_owner::~thread_trace_owner()
+{
+	std::lock_guard<std::mutex> lock(s_threads_lock);
+	s_thread->m_exited = true;
+	s_thread = nullptr;
+	s_thread_gone = true;
+}
+
+static void _record(trace_event_type type, const char* name, unsigned int value=0)
+{
+	thread_trace* trace = _get_thread_trace();
+	if (trace == nullptr) {
+		return;
+	}
+	const uint64_t capture = s_capture.load(std::memory_order_relaxed);
+	const uint64_t state = trace->m_state.load(std::memory_order_relaxed);
+	const size_t count = (state >> TRACE_COUNT_BITS) == capture ? (size_t)(state & TRACE_COUNT_MASK) : 0;
+	if (count == TRACE_CHUNK_EVENTS * MAX_TRACE_CHUNKS) {
+		return;
+	}
+	std::atomic<trace_event*>& slot = trace->m_chunks[count / TRACE_CHUNK_EVENTS];
+	trace_event* chunk = slot.load(std::memory_order_relaxed);
+	if (chunk == nullptr) {
+		// kept for later captures
+		chunk = new trace_event[TRACE_CHUNK_EVENTS];
+		slot.store(chunk, std::memory_order_release);
+	}
+	chunk[count % TRACE_CHUNK_EVENTS] = trace_event{ _read_tsc(), name, type, value };
+	trace->m_state.store((capture << TRACE_COUNT_BITS) | (count + 1), std::memory_order_release);
+}
+
+bool trace_begin(const char* name)
+{
+	// acquire, so the capture number read next is the one that started it
+	if (!s_capturing.load(std::memory_order_acquire)) {
+		return false;
+	}
+	_record(TRACE_BEGIN, name);
+	return true;
+}
+
+void trace_end()
+{
+	// even when the capture stopped in between, the export closes what is left open
+	_record(TRACE_END, nullptr);
+}
+
+void trace_instant(const char* name)
+{
+	if (s_capturing.load(std::memory_order_acquire)) {
+		_record(TRACE_INSTANT, name);
+	}
+}
+
+void trace_counter(const char* name, unsigned int value)
+{
+	if (s_capturing.load(std::memory_order_acquire)) {
+		_record(TRACE_COUNTER, name, value);
+	}
+}
+
+void trace_set_thread_name(const char* name)
+{
+	thread_trace* trace = _get_thread_trace();
+	if (trace == nullptr) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(s_threads_lock);
+	snprintf(trace->m_name, sizeof(trace->m_name), "%s", name);
+}
+
+////////////////////////////////
+bool start_trace_capture(int num_frames, const std::string& path)
+{
+	if (num_frames <= 0 || s_pending_frames > 0 || s_capturing.load()) {
+		return false;
+	}
+	// buffers of threads gone since the last capture are not needed any more
+	std::lock_guard<std::mutex> lock(s_threads_lock);
+	for (thread_trace** link = &s_threads; *link != nullptr;) {
+		thread_trace* each = *link;
+		if (!each->m_exited) {
+			link = &each->m_next;
+			continue;
+		}
+		*link = each->m_next;
+		for (auto& chunk : each->m_chunks) {
+			delete[] chunk.load();
+		}
+		delete each;
+	}
+	s_pending_frames = num_frames;
+	s_path = path;
+	return true;
+}
+
+bool is_trace_capturing()
+{
+	return s_capturing.load();
+}
+
+bool trace_frame()
+{
+	if (s_capturing.load(std::memory_order_relaxed)) {
+		trace_instant("frame");
+		if (--s_frames_left > 0) {
+			return false;
+		}
+		s_capturing.store(false);
+		s_end_tsc = _read_tsc();
+		s_end_seconds = _get_seconds();
+		if (export_trace(s_path)) {
+			AsyncLog("Game", "trace: captured frames written to %s", s_path.c_str());
+		} else {
+			AsyncLog("Game", "trace: could not write %s", s_path.c_str());
+		}
+		return true;
+	}
+	if (s_pending_frames > 0) {
+		s_begin_tsc = _read_tsc();
+		s_begin_seconds = _get_seconds();
+		s_frames_left = s_pending_frames;
+		s_pending_frames = 0;
+		s_capture.fetch_add(1);
+		s_capturing.store(true);
+		trace_instant("frame");
+	}
+	return false;
+}
+
+static void _write_json_string(FILE* fp, const char* text)
+{
+	fputc('"', fp);
+	for (const char* c = text; *c != '\0'; ++c) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', fp);
+			fputc(*c, fp);
+		} else if ((unsigned char)*c < 0x20) {
+			fprintf(fp, "\\u%04x", (unsigned int)(unsigned char)*c);
+		} else {
+			fputc(*c, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+// how many events of the capture there are in a buffer, 0 when it has none of it
+static size_t _get_num_events(const thread_trace* trace, unsigned int capture)
+{
+	const uint64_t state = trace->m_state.load(std::memory_order_acquire);
+	return (state >> TRACE_COUNT_BITS) == capture ? (size_t)(state & TRACE_COUNT_MASK) : 0;
+}
+
+static const trace_event& _get_event(const thread_trace* trace, size_t i)
+{
+	return trace->m_chunks[i / TRACE_CHUNK_EVENTS].load(std::memory_order_acquire)[i % TRACE_CHUNK_EVENTS];
+}
+
+bool export_trace(const std::string& path)
+{
+	const unsigned int capture = s_capture.load();
+	if (capture == 0) {
+		return false;
+	}
+	const bool running = s_capturing.load();
+	const uint64_t end_tsc = running ? _read_tsc() : s_end_tsc;
+	const double end_seconds = running ? _get_seconds() : s_end_seconds;
+	double ticks_per_us = (double)(end_tsc - s_begin_tsc) / ((end_seconds - s_begin_seconds) * 1e6);
+	if (!(ticks_per_us > 0.0)) {
+		ticks_per_us = 1.0;
+	}
+	auto to_us = [ticks_per_us](uint64_t tsc) { return tsc > s_begin_tsc ? (double)(tsc - s_begin_tsc) / ticks_per_us : 0.0; };
+
+	FILE* fp = std::fopen(path.c_str(), "wb");
+	if (fp == nullptr) {
+		return false;
+	}
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", fp);
+	bool first = true;
+	auto next_event = [&first, fp]() {
+		fputs(first ? "" : ",\n", fp);
+		first = false;
+	};
+
+	std::lock_guard<std::mutex> lock(s_threads_lock);
+	for (const thread_trace* trace = s_threads; trace != nullptr; trace = trace->m_next) {
+		const size_t num_events = _get_num_events(trace, capture);
+		if (num_events == 0) {
+			continue;
+		}
+		char name[MAX_TRACE_THREAD_NAME + 16];
+		snprintf(name, sizeof(name), "%s", trace->m_name[0] != '\0' ? trace->m_name : "");
+		if (name[0] == '\0') {
+			snprintf(name, sizeof(name), "thread %u", trace->m_tid);
+		}
+		next_event();
+		fprintf(fp, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", trace->m_tid);
+		_write_json_string(fp, name);
+		fputs("}}", fp);
+
+		int depth = 0;
+		for (size_t i = 0; i < num_events; ++i) {
+			const trace_event& event = _get_event(trace, i);
+			if (event.m_type == TRACE_END) {
+				// begun before this capture
+				if (depth == 0) {
+					continue;
+				}
+				--depth;
+				next_event();
+				fprintf(fp, "{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", trace->m_tid, to_us(event.m_tsc));
+				continue;
+			}
+			next_event();
+			if (event.m_type == TRACE_BEGIN) {
+				++depth;
+				fprintf(fp, "{\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", trace->m_tid, to_us(event.m_tsc));
+			} else if (event.m_type == TRACE_COUNTER) {
+				fprintf(fp, "{\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%u},\"name\":", trace->m_tid,
+					to_us(event.m_tsc), event.m_value);
+			} else {
+				fprintf(fp, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", trace->m_tid, to_us(event.m_tsc));
+			}
+			_write_json_string(fp, event.m_name);
+			fputc('}', fp);
+		}
+		// still open when the capture ended
+		for (; depth > 0; --depth) {
+			next_event();
+			fprintf(fp, "{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", trace->m_tid, to_us(end_tsc));
+		}
+	}
+	fputs("\n]}\n", fp);
+	fclose(fp);
+	return true;
+}
+
+size_t count_trace_events(const char* name)
+{
+	const unsigned int capture = s_capture.load();
+	size_t total = 0;
+	std::lock_guard<std::mutex> lock(s_threads_lock);
+	for (const thread_trace* trace = s_threads; trace != nullptr; trace = trace->m_next) {
+		const size_t num_events = _get_num_events(trace, capture);
+		for (size_t i = 0; i < num_events; ++i) {
+			const trace_event& event = _get_event(trace, i);
+			if (event.m_name != nullptr && strcmp(event.m_name, name) == 0) {
+				++total;
+			}
+		}
+	}
+	return total;
+}
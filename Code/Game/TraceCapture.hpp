@@ -0,0 +1,50 @@
+#pragma once
+#include "Engine/Develop/Profile.hpp"
+#include <string>
+
+// Timeline capture for chrome://tracing and Perfetto. While a capture runs, TRACE_SCOPE records a
+// begin and an end event stamped with the TSC into the calling thread's own buffer, no locks and
+// no shared writes; outside a capture it is one atomic load. The capture spans whole frames and
+// is written as Chrome trace JSON once the last one ends.
+// Names are kept by pointer, pass string literals or __FUNCTION__
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) trace_scope TRACE_CONCAT(_trace_scope_, __COUNTER__)(name)
+// the in-game profiler tree and the trace both
+#define PROFILE_TRACE_SCOPE(name) PROFILE_SCOPE(name); TRACE_SCOPE(name)
+
+constexpr size_t TRACE_CHUNK_EVENTS = 16 * 1024;
+// past this many chunks a thread's events are dropped until the next capture
+constexpr size_t MAX_TRACE_CHUNKS = 64;
+
+// false when no capture runs, there is then nothing to end
+bool trace_begin(const char* name);
+void trace_end();
+void trace_instant(const char* name);
+// a value over time, one track per name
+void trace_counter(const char* name, unsigned int value);
+// shown as the thread's track name, copied
+void trace_set_thread_name(const char* name);
+
+class trace_scope
+{
+public:
+	explicit trace_scope(const char* name) : m_open(trace_begin(name)) {}
+	~trace_scope() { if (m_open) trace_end(); }
+	trace_scope(const trace_scope&) = delete;
+	trace_scope& operator=(const trace_scope&) = delete;
+
+private:
+	bool m_open;
+};
+
+// starts at the next trace_frame and runs for num_frames, false if one is already pending or running
+bool start_trace_capture(int num_frames, const std::string& path);
+bool is_trace_capturing();
+// main thread, once per frame. True on the frame the capture was written
+bool trace_frame();
+// writes the last capture, or what the running one has so far
+bool export_trace(const std::string& path);
+// events recorded with this name by the last capture
+size_t count_trace_events(const char* name);
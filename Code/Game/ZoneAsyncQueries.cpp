@@ -0,0 +1,223 @@
+#include "Game/ZoneAsyncQueries.hpp"
+#include "Game/ZoneScene.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+
+bool async_raycast_awaitable::await_ready() const
+{
+	return m_queries->is_ready(m_handle);
+}
+
+void async_raycast_awaitable::await_suspend(std::coroutine_handle<> waiter)
+{
+	m_queries->_add_waiter(m_handle, waiter);
+}
+
+ConvexImpactResult async_raycast_awaitable::await_resume()
+{
+	ConvexImpactResult result;
+	m_queries->get_raycast(m_handle, result);
+	m_queries->release(m_handle);
+	return result;
+}
+
+ZoneAsyncQueries::~ZoneAsyncQueries()
+{
+	shutdown();
+}
+
+void ZoneAsyncQueries::startup(ZoneScene& scene, size_t max_tasks)
+{
+	if (!m_readers.empty()) {
+		return;
+	}
+	m_scene = &scene;
+	if (max_tasks == 0) {
+		max_tasks = std::max(get_num_task_threads(), (size_t)2) - 1;
+	}
+	for (size_t i = 0; i < max_tasks; ++i) {
+		const int reader = m_scene->register_reader();
+		if (reader < 0) {
+			break;
+		}
+		m_readers.push_back(reader);
+	}
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_free_readers = m_readers;
+}
+
+void ZoneAsyncQueries::shutdown()
+{
+	if (m_readers.empty()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_jobs.clear();
+		m_next_job = 0;
+	}
+	wait_tasks(m_tasks);
+	for (int reader : m_readers) {
+		m_scene->unregister_reader(reader);
+	}
+	m_readers.clear();
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_free_readers.clear();
+}
+
+ZoneAsyncQueries::query_slot* ZoneAsyncQueries::_get_slot(const async_query_handle& handle)
+{
+	if (handle.m_slot >= m_slots.size() || m_slots[handle.m_slot].m_generation != handle.m_generation) {
+		return nullptr;
+	}
+	return &m_slots[handle.m_slot];
+}
+
+const ZoneAsyncQueries::query_slot* ZoneAsyncQueries::_get_slot(const async_query_handle& handle) const
+{
+	return const_cast<ZoneAsyncQueries*>(this)->_get_slot(handle);
+}
+
+async_query_handle ZoneAsyncQueries::submit_raycast(const Vec2& start, const Vec2& end)
+{
+	async_query_handle handle;
+	if (m_free_slots.empty()) {
+		handle.m_slot = (unsigned int)m_slots.size();
+		m_slots.emplace_back();
+	} else {
+		handle.m_slot = m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+	query_slot& slot = m_slots[handle.m_slot];
+	slot.m_state = QUERY_PENDING;
+	slot.m_result = ConvexImpactResult();
+	handle.m_generation = slot.m_generation;
+	++m_num_in_flight;
+
+	raycast_job job;
+	job.m_slot = handle.m_slot;
+	job.m_generation = handle.m_generation;
+	job.m_start = start;
+	job.m_end = end;
+	int reader = -1;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_jobs.push_back(job);
+		// the running tasks pick it up otherwise
+		if (!m_free_readers.empty()) {
+			reader = m_free_readers.back();
+			m_free_readers.pop_back();
+		}
+	}
+	if (reader >= 0) {
+		run_task(&m_tasks, [this, reader]() { _drain(reader); });
+	}
+	return handle;
+}
+
+bool ZoneAsyncQueries::is_ready(const async_query_handle& handle) const
+{
+	const query_slot* slot = _get_slot(handle);
+	return slot != nullptr && slot->m_state == QUERY_READY;
+}
+
+bool ZoneAsyncQueries::get_raycast(const async_query_handle& handle, ConvexImpactResult& out) const
+{
+	if (!is_ready(handle)) {
+		return false;
+	}
+	out = m_slots[handle.m_slot].m_result;
+	return true;
+}
+
+void ZoneAsyncQueries::release(const async_query_handle& handle)
+{
+	query_slot* slot = _get_slot(handle);
+	if (slot == nullptr) {
+		return;
+	}
+	if (slot->m_state == QUERY_PENDING) {
+		--m_num_in_flight;
+	}
+	slot->m_state = QUERY_FREE;
+	if (++slot->m_generation == 0) {
+		slot->m_generation = 1;
+	}
+	m_free_slots.push_back(handle.m_slot);
+}
+
+void ZoneAsyncQueries::_add_waiter(const async_query_handle& handle, std::coroutine_handle<> waiter)
+{
+	m_waiters.emplace_back(handle, waiter);
+}
+
+void ZoneAsyncQueries::_drain(int reader)
+{
+	std::vector<raycast_job> batch;
+	std::vector<raycast_done> results;
+	std::unique_lock<std::mutex> lock(m_lock);
+	for (;;) {
+		if (m_next_job == m_jobs.size()) {
+			m_free_readers.push_back(reader);
+			return;
+		}
+		const size_t count = std::min(TASK_BATCH, m_jobs.size() - m_next_job);
+		batch.assign(m_jobs.begin() + m_next_job, m_jobs.begin() + m_next_job + count);
+		m_next_job += count;
+		if (m_next_job == m_jobs.size()) {
+			m_jobs.clear();
+			m_next_job = 0;
+		}
+		lock.unlock();
+
+		results.clear();
+		{
+			TRACE_SCOPE("raycast batch");
+			// misses before the first publish
+			zone_scene_pin version(*m_scene, reader);
+			for (const raycast_job& job : batch) {
+				raycast_done done;
+				done.m_slot = job.m_slot;
+				done.m_generation = job.m_generation;
+				if (version.get() != nullptr) {
+					done.m_result = version->raycast_by(Ray2::FromPoint(job.m_start, job.m_end));
+				}
+				results.push_back(done);
+			}
+		}
+
+		lock.lock();
+		m_done.insert(m_done.end(), results.begin(), results.end());
+	}
+}
+
+void ZoneAsyncQueries::begin_frame()
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		std::swap(m_done, m_publishing);
+	}
+	for (const raycast_done& done : m_publishing) {
+		query_slot& slot = m_slots[done.m_slot];
+		// released since, or released and submitted again
+		if (slot.m_generation != done.m_generation || slot.m_state != QUERY_PENDING) {
+			continue;
+		}
+		slot.m_state = QUERY_READY;
+		slot.m_result = done.m_result;
+		--m_num_in_flight;
+	}
+	m_publishing.clear();
+
+	// a resumed coroutine may await again, those waiters wait for the next frame
+	m_resuming.swap(m_waiters);
+	for (const auto& each : m_resuming) {
+		if (is_ready(each.first) || _get_slot(each.first) == nullptr) {
+			each.second.resume();
+		} else {
+			m_waiters.push_back(each);
+		}
+	}
+	m_resuming.clear();
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "Engine/Math/Convex.hpp"
+#include "Engine/Math/Vec2.hpp"
+#include "Game/TaskScheduler.hpp"
+#include <coroutine>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class ZoneScene;
+class ZoneAsyncQueries;
+
+// Names one query submitted to ZoneAsyncQueries. Stale once released, the slot's generation moves on
+struct async_query_handle
+{
+	unsigned int m_slot = 0xFFFFFFFFu;
+	unsigned int m_generation = 0;
+
+	bool is_valid() const { return m_slot != 0xFFFFFFFFu; }
+};
+
+// co_await queries.await_raycast(start, end) inside a coroutine: resumes on the main thread in the
+// BeginFrame after the ray ran, the handle is released by then
+struct async_raycast_awaitable
+{
+	ZoneAsyncQueries* m_queries;
+	async_query_handle m_handle;
+
+	bool await_ready() const;
+	void await_suspend(std::coroutine_handle<> waiter);
+	ConvexImpactResult await_resume();
+};
+
+// Zone queries that run as TaskScheduler tasks against the ZoneScene version current when a task
+// picks them up, pinned for the batch. Queries start as soon as they are submitted, their results
+// show up at the sync point in BeginFrame, so gameplay can submit early in Update and read the
+// answers a frame later. Every call is main thread only
+class ZoneAsyncQueries
+{
+public:
+	// a task takes this many queued queries per lock
+	static constexpr size_t TASK_BATCH = 16;
+public:
+	~ZoneAsyncQueries();
+	// at most max_tasks tasks drain the queue at once, 0 means one less than the scheduler has
+	// threads and at least one. Each holds one of that many reader slots of scene, which has to
+	// outlive shutdown
+	void startup(ZoneScene& scene, size_t max_tasks=0);
+	// waits for the running tasks, queries still queued are dropped
+	void shutdown();
+
+	async_query_handle submit_raycast(const Vec2& start, const Vec2& end);
+	async_raycast_awaitable await_raycast(const Vec2& start, const Vec2& end)
+	{
+		return async_raycast_awaitable{ this, submit_raycast(start, end) };
+	}
+	// false until the BeginFrame after the query finished
+	bool is_ready(const async_query_handle& handle) const;
+	// false when the handle is stale or not ready yet
+	bool get_raycast(const async_query_handle& handle, ConvexImpactResult& out) const;
+	// the slot is reused, a pending query still runs but its result is dropped
+	void release(const async_query_handle& handle);
+
+	// publishes what the tasks finished and resumes the coroutines waiting on it
+	void begin_frame();
+	size_t get_num_in_flight() const { return m_num_in_flight; }
+	// resumes an awaiting coroutine at the next begin_frame that finds the handle ready
+	void _add_waiter(const async_query_handle& handle, std::coroutine_handle<> waiter);
+
+private:
+	enum query_state : unsigned char
+	{
+		QUERY_FREE,
+		QUERY_PENDING,
+		QUERY_READY,
+	};
+	struct query_slot
+	{
+		unsigned int m_generation = 1;
+		query_state m_state = QUERY_FREE;
+		ConvexImpactResult m_result;
+	};
+	struct raycast_job
+	{
+		unsigned int m_slot;
+		unsigned int m_generation;
+		Vec2 m_start;
+		Vec2 m_end;
+	};
+	struct raycast_done
+	{
+		unsigned int m_slot;
+		unsigned int m_generation;
+		ConvexImpactResult m_result;
+	};
+
+	// runs queued queries until there are none, then gives the reader slot back
+	void _drain(int reader);
+	query_slot* _get_slot(const async_query_handle& handle);
+	const query_slot* _get_slot(const async_query_handle& handle) const;
+
+private:
+	ZoneScene* m_scene = nullptr;
+	std::vector<query_slot> m_slots;
+	std::vector<unsigned int> m_free_slots;
+	std::vector<std::pair<async_query_handle, std::coroutine_handle<>>> m_waiters;
+	std::vector<std::pair<async_query_handle, std::coroutine_handle<>>> m_resuming;
+	size_t m_num_in_flight = 0; // submitted and not yet published
+
+	std::vector<int> m_readers; // registered by startup
+	task_counter m_tasks;
+
+	// shared with the tasks, under m_lock
+	std::mutex m_lock;
+	std::vector<int> m_free_readers; // a task starts only with one of these
+	std::vector<raycast_job> m_jobs;
+	size_t m_next_job = 0;
+	std::vector<raycast_done> m_done;
+	std::vector<raycast_done> m_publishing; // swapped with m_done by begin_frame
+};
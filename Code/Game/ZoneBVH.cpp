@@ -0,0 +1,263 @@
+#include "Game/ZoneBVH.hpp"
+#include "Game/RVSGame.hpp"
+#include "Game/ZoneGeometry.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+
+static AABB2 _get_union(const AABB2& a, const AABB2& b)
+{
+	return AABB2(std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y));
+}
+
+static float _get_perimeter(const AABB2& box)
+{
+	return 2.f * ((box.Max.x - box.Min.x) + (box.Max.y - box.Min.y));
+}
+
+void ZoneBVH::build(const std::vector<Zone>& zones)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	m_zone_base = zones.data();
+	m_nodes.clear();
+	m_nodes.reserve(zones.empty() ? 0 : zones.size() * 2 - 1);
+	m_leaf_of_zone.assign(zones.size(), -1);
+	m_centers.resize(zones.size());
+	m_items.resize(zones.size());
+	for (unsigned int i = 0; i < (unsigned int)zones.size(); ++i) {
+		m_centers[i] = get_points_bounds(zones[i].m_poly.m_points).GetCenter();
+		m_items[i] = i;
+	}
+	m_root = zones.empty() ? -1 : _build_range(m_items.data(), (unsigned int)zones.size(), -1);
+	_update_refit_order();
+	refit(zones);
+	m_built_cost = get_cost();
+}
+
+// median split of the centers on the longer axis, nodes are laid out in preorder
+int ZoneBVH::_build_range(unsigned int* items, unsigned int num_items, int parent)
+{
+	const int n = (int)m_nodes.size();
+	m_nodes.emplace_back();
+	m_nodes[n].m_parent = parent;
+	if (num_items == 1) {
+		m_nodes[n].m_zone = items[0];
+		m_leaf_of_zone[items[0]] = n;
+		return n;
+	}
+	Vec2 lo = m_centers[items[0]];
+	Vec2 hi = lo;
+	for (unsigned int i = 1; i < num_items; ++i) {
+		const Vec2& c = m_centers[items[i]];
+		lo.x = std::min(lo.x, c.x);
+		lo.y = std::min(lo.y, c.y);
+		hi.x = std::max(hi.x, c.x);
+		hi.y = std::max(hi.y, c.y);
+	}
+	const bool split_x = hi.x - lo.x >= hi.y - lo.y;
+	const unsigned int half = num_items / 2;
+	std::nth_element(items, items + half, items + num_items, [this, split_x](unsigned int a, unsigned int b) {
+		const float ka = split_x ? m_centers[a].x : m_centers[a].y;
+		const float kb = split_x ? m_centers[b].x : m_centers[b].y;
+		return ka < kb || (ka == kb && a < b);
+	});
+	const int left = _build_range(items, half, n);
+	const int right = _build_range(items + half, num_items - half, n);
+	m_nodes[n].m_child[0] = left;
+	m_nodes[n].m_child[1] = right;
+	return n;
+}
+
+void ZoneBVH::refit(const std::vector<Zone>& zones)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	m_zone_base = zones.data();
+	for (unsigned int i = 0; i < (unsigned int)zones.size(); ++i) {
+		m_nodes[m_leaf_of_zone[i]].m_box = get_points_bounds(zones[i].m_poly.m_points);
+	}
+	for (int n : m_refit_order) {
+		bvh_node& node = m_nodes[n];
+		node.m_box = _get_union(m_nodes[node.m_child[0]].m_box, m_nodes[node.m_child[1]].m_box);
+	}
+}
+
+// Swaps a child with one of its sibling's children when that shrinks the sibling.
+// The node itself still holds the same zones, so nothing above it changes
+bool ZoneBVH::_rotate(int n)
+{
+	bvh_node& node = m_nodes[n];
+	float best_gain = 0.f;
+	int best_side = -1;
+	int best_grand = -1;
+	for (int side = 0; side < 2; ++side) {
+		const int inner = node.m_child[side];
+		if (is_leaf(inner)) {
+			continue;
+		}
+		const AABB2& other_box = m_nodes[node.m_child[1 - side]].m_box;
+		const float inner_perimeter = _get_perimeter(m_nodes[inner].m_box);
+		for (int g = 0; g < 2; ++g) {
+			// other takes the place of grandchild g, inner keeps the remaining grandchild
+			const AABB2& kept = m_nodes[m_nodes[inner].m_child[1 - g]].m_box;
+			const float gain = inner_perimeter - _get_perimeter(_get_union(kept, other_box));
+			if (gain > best_gain) {
+				best_gain = gain;
+				best_side = side;
+				best_grand = g;
+			}
+		}
+	}
+	if (best_side < 0) {
+		return false;
+	}
+	const int inner = node.m_child[best_side];
+	const int other = node.m_child[1 - best_side];
+	const int grand = m_nodes[inner].m_child[best_grand];
+	node.m_child[1 - best_side] = grand;
+	m_nodes[grand].m_parent = n;
+	m_nodes[inner].m_child[best_grand] = other;
+	m_nodes[other].m_parent = inner;
+	m_nodes[inner].m_box = _get_union(m_nodes[m_nodes[inner].m_child[0]].m_box, m_nodes[m_nodes[inner].m_child[1]].m_box);
+	return true;
+}
+
+size_t ZoneBVH::_rebalance()
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	size_t num_rotations = 0;
+	// bottom-up, so every node sees the already improved boxes of its children
+	for (int n : m_refit_order) {
+		if (_rotate(n)) {
+			++num_rotations;
+		}
+	}
+	if (num_rotations > 0) {
+		_update_refit_order();
+	}
+	return num_rotations;
+}
+
+ZoneBVH::update_result ZoneBVH::update(const std::vector<Zone>& zones)
+{
+	if (zones.size() != m_leaf_of_zone.size()) {
+		build(zones);
+		return BVH_REBUILT;
+	}
+	refit(zones);
+	if (get_cost() <= m_built_cost * REBALANCE_RATIO) {
+		return BVH_REFITTED;
+	}
+	_rebalance();
+	if (get_cost() <= m_built_cost * REBUILD_RATIO && m_depth <= MAX_DEPTH) {
+		return BVH_REBALANCED;
+	}
+	build(zones);
+	return BVH_REBUILT;
+}
+
+float ZoneBVH::get_cost() const
+{
+	if (m_root < 0) {
+		return 0.f;
+	}
+	float sum = 0.f;
+	for (int n : m_refit_order) {
+		sum += _get_perimeter(m_nodes[n].m_box);
+	}
+	const float root = _get_perimeter(m_nodes[m_root].m_box);
+	return root > 0.f ? sum / root : 0.f;
+}
+
+// preorder walk reversed, so children always come before their parent
+void ZoneBVH::_update_refit_order()
+{
+	m_refit_order.clear();
+	m_depth = 0;
+	if (m_root < 0) {
+		return;
+	}
+	std::vector<std::pair<int, int>> stack;
+	stack.emplace_back(m_root, 1);
+	while (!stack.empty()) {
+		const auto [n, depth] = stack.back();
+		stack.pop_back();
+		m_depth = std::max(m_depth, depth);
+		if (is_leaf(n)) {
+			continue;
+		}
+		m_refit_order.push_back(n);
+		stack.emplace_back(m_nodes[n].m_child[0], depth + 1);
+		stack.emplace_back(m_nodes[n].m_child[1], depth + 1);
+	}
+	std::reverse(m_refit_order.begin(), m_refit_order.end());
+}
+
+ConvexImpactResult ZoneBVH::raycast_by(const Ray2& ray) const
+{
+	ConvexImpactResult result;
+	if (m_root < 0) {
+		return result;
+	}
+	const Vec2 start = ray.GetPointAt(0.f);
+	int stack[MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = m_root;
+	while (top > 0) {
+		const bvh_node& node = m_nodes[stack[--top]];
+		const float entry = get_ray_box_entry(ray, start, node.m_box);
+		// boxes entered beyond the closest hit so far cannot hold a closer one
+		if (entry < 0 || (result.hit && entry > result.k)) {
+			continue;
+		}
+		if (node.m_child[0] < 0) {
+			ConvexImpactResult zoner = m_zone_base[node.m_zone].m_hull.raycast_by(ray);
+			if (zoner.hit && zoner.k < result.k) {
+				result = zoner;
+			}
+			continue;
+		}
+		stack[top++] = node.m_child[1];
+		stack[top++] = node.m_child[0];
+	}
+	return result;
+}
+
+void ZoneBVH::query_box(const AABB2& box, std::vector<unsigned int>& out) const
+{
+	if (m_root < 0) {
+		return;
+	}
+	int stack[MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = m_root;
+	while (top > 0) {
+		const bvh_node& node = m_nodes[stack[--top]];
+		if (!is_overlapping(node.m_box, box)) {
+			continue;
+		}
+		if (node.m_child[0] < 0) {
+			out.push_back(node.m_zone);
+			continue;
+		}
+		stack[top++] = node.m_child[1];
+		stack[top++] = node.m_child[0];
+	}
+}
+
+void ZoneBVH::gather_visible(const AABB2& view, float pixel_size, zone_visible_set& out) const
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	out.m_outlined.clear();
+	out.m_points.clear();
+	query_box(view, out.m_outlined);
+	const float min_size = ZONE_LOD_POINT_PIXELS * pixel_size;
+	size_t num_outlined = 0;
+	for (unsigned int zone : out.m_outlined) {
+		const AABB2& b = get_zone_bounds(zone);
+		if (b.Max.x - b.Min.x < min_size && b.Max.y - b.Min.y < min_size) {
+			out.m_points.push_back(zone);
+		} else {
+			out.m_outlined[num_outlined++] = zone;
+		}
+	}
+	out.m_outlined.resize(num_outlined);
+}
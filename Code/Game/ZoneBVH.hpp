@@ -0,0 +1,72 @@
+#pragma once
+#include "Engine/Math/Convex.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Math/AABB2.hpp"
+#include <vector>
+
+class Zone;
+struct zone_visible_set;
+
+struct bvh_node
+{
+	AABB2 m_box;
+	int m_parent = -1;
+	int m_child[2] = {-1, -1}; // both -1 for a leaf
+	unsigned int m_zone = 0; // leaves only
+};
+
+// Binary BVH with one zone per leaf, for zones that move every frame.
+// update() refits the boxes bottom-up and only restructures when the tree gets
+// too loose: first with local rotations, and as a last resort with a full build.
+class ZoneBVH
+{
+public:
+	// the quality metric may drift this far above the freshly built value before rotations run
+	static constexpr float REBALANCE_RATIO = 1.1f;
+	// and this far after them before the tree is rebuilt
+	static constexpr float REBUILD_RATIO = 1.5f;
+	// traversal stack, a deeper tree is rebuilt
+	static constexpr int MAX_DEPTH = 62;
+	enum update_result
+	{
+		BVH_REFITTED,
+		BVH_REBALANCED,
+		BVH_REBUILT,
+	};
+public:
+	void build(const std::vector<Zone>& zones);
+	// new bounds for every leaf, then every internal node from the bottom up. The shape does not change
+	void refit(const std::vector<Zone>& zones);
+	update_result update(const std::vector<Zone>& zones);
+	// summed perimeter of internal nodes over the root perimeter, the 2D surface area heuristic
+	float get_cost() const;
+	float get_built_cost() const { return m_built_cost; }
+	int get_depth() const { return m_depth; }
+
+	ConvexImpactResult raycast_by(const Ray2& ray) const;
+	// each zone sits in one leaf, so no dedupe is needed
+	void query_box(const AABB2& box, std::vector<unsigned int>& out) const;
+	void gather_visible(const AABB2& view, float pixel_size, zone_visible_set& out) const;
+	const AABB2& get_zone_bounds(unsigned int zone) const { return m_nodes[m_leaf_of_zone[zone]].m_box; }
+	bool is_leaf(int node) const { return m_nodes[node].m_child[0] < 0; }
+
+	std::vector<bvh_node> m_nodes;
+	int m_root = -1;
+
+private:
+	// one bottom-up pass of child/grandchild swaps that shrink a node, returns how many were applied.
+	// Swaps can deepen the tree, update() rebuilds it past MAX_DEPTH
+	size_t _rebalance();
+	int _build_range(unsigned int* items, unsigned int num_items, int parent);
+	bool _rotate(int node);
+	void _update_refit_order();
+
+private:
+	const Zone* m_zone_base = nullptr;
+	std::vector<int> m_leaf_of_zone;
+	std::vector<int> m_refit_order; // internal nodes, children before parents
+	std::vector<Vec2> m_centers; // build scratch
+	std::vector<unsigned int> m_items; // build scratch
+	float m_built_cost = 0.f;
+	int m_depth = 0;
+};
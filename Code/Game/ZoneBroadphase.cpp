@@ -0,0 +1,128 @@
+#include "Game/ZoneBroadphase.hpp"
+#include "Game/RVSGame.hpp"
+#include "Game/ZoneGeometry.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+
+void ZoneSweepAndPrune::build(const std::vector<Zone>& zones)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	m_bounds.resize(zones.size());
+	m_sorted.resize(zones.size());
+	for (unsigned int i = 0; i < (unsigned int)zones.size(); ++i) {
+		const AABB2 b = get_points_bounds(zones[i].m_poly.m_points);
+		m_bounds[i] = b;
+		m_sorted[i] = {b.Min.x, b.Max.x, b.Min.y, b.Max.y, i};
+	}
+	std::sort(m_sorted.begin(), m_sorted.end(), [](const sap_entry& a, const sap_entry& b) {
+		return a.m_min_x < b.m_min_x;
+	});
+	m_last_num_swaps = 0;
+}
+
+void ZoneSweepAndPrune::update(const std::vector<Zone>& zones)
+{
+	if (zones.size() != m_bounds.size()) {
+		build(zones);
+		return;
+	}
+	for (unsigned int i = 0; i < (unsigned int)zones.size(); ++i) {
+		m_bounds[i] = get_points_bounds(zones[i].m_poly.m_points);
+	}
+	_resort();
+}
+
+void ZoneSweepAndPrune::update(const std::vector<Zone>& zones, const unsigned int* moved, size_t num_moved)
+{
+	if (zones.size() != m_bounds.size()) {
+		build(zones);
+		return;
+	}
+	for (size_t i = 0; i < num_moved; ++i) {
+		m_bounds[moved[i]] = get_points_bounds(zones[moved[i]].m_poly.m_points);
+	}
+	_resort();
+}
+
+void ZoneSweepAndPrune::_resort()
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	for (sap_entry& each : m_sorted) {
+		const AABB2& b = m_bounds[each.m_zone];
+		each = {b.Min.x, b.Max.x, b.Min.y, b.Max.y, each.m_zone};
+	}
+	// insertion sort, cheap while zones only drift past a few neighbours per frame
+	const size_t max_swaps = MAX_SWAPS_PER_ZONE * m_sorted.size();
+	size_t num_swaps = 0;
+	for (size_t i = 1; i < m_sorted.size() && num_swaps <= max_swaps; ++i) {
+		const sap_entry moving = m_sorted[i];
+		size_t j = i;
+		for (; j > 0 && m_sorted[j - 1].m_min_x > moving.m_min_x; --j) {
+			m_sorted[j] = m_sorted[j - 1];
+		}
+		m_sorted[j] = moving;
+		num_swaps += i - j;
+	}
+	if (num_swaps > max_swaps) {
+		// too much changed at once, the partial insertion sort left a valid permutation
+		std::sort(m_sorted.begin(), m_sorted.end(), [](const sap_entry& a, const sap_entry& b) {
+			return a.m_min_x < b.m_min_x;
+		});
+	}
+	m_last_num_swaps = num_swaps;
+}
+
+void ZoneSweepAndPrune::find_pairs(std::vector<zone_pair>& out) const
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	const size_t count = m_sorted.size();
+	for (size_t i = 0; i < count; ++i) {
+		const sap_entry& a = m_sorted[i];
+		// later entries start further right, stop at the first one past a's right edge
+		for (size_t j = i + 1; j < count && m_sorted[j].m_min_x <= a.m_max_x; ++j) {
+			const sap_entry& b = m_sorted[j];
+			if (a.m_min_y <= b.m_max_y && a.m_max_y >= b.m_min_y) {
+				out.push_back({std::min(a.m_zone, b.m_zone), std::max(a.m_zone, b.m_zone)});
+			}
+		}
+	}
+}
+
+static void _project(const std::vector<Vec2>& points, const Vec2& axis, float& lo, float& hi)
+{
+	lo = hi = dot2(points[0], axis);
+	for (size_t i = 1; i < points.size(); ++i) {
+		const float d = dot2(points[i], axis);
+		lo = std::min(lo, d);
+		hi = std::max(hi, d);
+	}
+}
+
+// true when one of a's hull planes separates the two polygons
+static bool _has_separating_plane(const Zone& a, const Zone& b)
+{
+	for (const Plane2& plane : a.m_hull.m_edges) {
+		float a_lo, a_hi, b_lo, b_hi;
+		_project(a.m_poly.m_points, plane.Normal, a_lo, a_hi);
+		_project(b.m_poly.m_points, plane.Normal, b_lo, b_hi);
+		if (a_hi < b_lo || b_hi < a_lo) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool is_zone_overlapping(const Zone& a, const Zone& b)
+{
+	return !_has_separating_plane(a, b) && !_has_separating_plane(b, a);
+}
+
+void filter_overlapping_pairs(const std::vector<Zone>& zones, const std::vector<zone_pair>& candidates, std::vector<zone_pair>& out)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	for (const zone_pair& pair : candidates) {
+		if (is_zone_overlapping(zones[pair.m_a], zones[pair.m_b])) {
+			out.push_back(pair);
+		}
+	}
+}
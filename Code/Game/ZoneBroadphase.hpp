@@ -0,0 +1,52 @@
+#pragma once
+#include "Engine/Math/AABB2.hpp"
+#include "Engine/Core/EngineCommon.hpp"
+#include <vector>
+
+class Zone;
+
+struct zone_pair
+{
+	unsigned int m_a = 0; // always the lower zone index
+	unsigned int m_b = 0;
+};
+
+// Sweep and prune over zone bounds along x. Bounds are kept sorted by their left edge,
+// so after zones move a little an insertion sort puts them back in order in close to linear time.
+class ZoneSweepAndPrune
+{
+public:
+	// an update that needs more swaps than this per zone falls back to a full sort
+	static constexpr size_t MAX_SWAPS_PER_ZONE = 16;
+public:
+	void build(const std::vector<Zone>& zones);
+	// every zone may have moved
+	void update(const std::vector<Zone>& zones);
+	// only the listed zones moved since the last update
+	void update(const std::vector<Zone>& zones, const unsigned int* moved, size_t num_moved);
+	// pairs of zones whose bounds overlap, each reported once
+	void find_pairs(std::vector<zone_pair>& out) const;
+	size_t get_last_num_swaps() const { return m_last_num_swaps; }
+	const AABB2& get_zone_bounds(unsigned int zone) const { return m_bounds[zone]; }
+
+private:
+	void _resort();
+
+private:
+	struct sap_entry
+	{
+		float m_min_x;
+		float m_max_x;
+		float m_min_y;
+		float m_max_y;
+		unsigned int m_zone;
+	};
+	std::vector<AABB2> m_bounds; // per zone
+	std::vector<sap_entry> m_sorted; // by m_min_x
+	size_t m_last_num_swaps = 0;
+};
+
+// separating axis test over the edge normals of both hulls
+bool is_zone_overlapping(const Zone& a, const Zone& b);
+// keeps the candidates whose polygons really overlap
+void filter_overlapping_pairs(const std::vector<Zone>& zones, const std::vector<zone_pair>& candidates, std::vector<zone_pair>& out);
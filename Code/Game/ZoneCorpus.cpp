@@ -0,0 +1,305 @@
+#include "Game/ZoneCorpus.hpp"
+#include "Game/ghcs.hpp"
+#include "Game/AsyncLog.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+// PCG32, the same numbers from every standard library
+struct corpus_rng
+{
+	uint64_t m_state = 0;
+
+	corpus_rng(uint32_t seed, uint32_t stream)
+	{
+		// splitmix64 so nearby seeds and streams start far apart
+		uint64_t z = ((uint64_t)stream << 32 | seed) + 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		m_state = z ^ (z >> 31);
+	}
+	uint32_t next()
+	{
+		const uint64_t old = m_state;
+		m_state = old * 6364136223846793005ull + 1442695040888963407ull;
+		const uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		const uint32_t rotation = (uint32_t)(old >> 59);
+		return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+	}
+	// [0,1)
+	float get_float() { return (float)(next() >> 8) * (1.f / 16777216.f); }
+	float get_float(float min, float max) { return min + (max - min) * get_float(); }
+	// [min,max]
+	int get_int(int min, int max) { return min + (int)(next() % (uint32_t)(max - min + 1)); }
+	float get_gaussian()
+	{
+		const float u = std::max(get_float(), 1e-7f);
+		return std::sqrt(-2.f * std::log(u)) * std::cos(6.2831853f * get_float());
+	}
+	// x first, whatever order a compiler evaluates arguments in
+	Vec2 get_point(float min, float max)
+	{
+		const float x = get_float(min, max);
+		return Vec2(x, get_float(min, max));
+	}
+	Vec2 get_gaussian_point()
+	{
+		const float x = get_gaussian();
+		return Vec2(x, get_gaussian());
+	}
+};
+
+struct zone_corpus_info
+{
+	const char* m_name;
+	size_t m_default_count;
+};
+}
+
+static const zone_corpus_info s_families[NUM_ZONE_CORPUS_FAMILIES] = {
+	{"uniform", 20480},
+	{"clustered", 20480},
+	{"mixed", 20480},
+	{"slivers", 20480},
+	{"walls", 20480},
+	{"million", 1'000'000},
+};
+
+// the density every family is tuned for
+static constexpr float REFERENCE_COUNT = 20480.f;
+
+// workload streams, apart from the family ones
+static constexpr uint32_t RAY_STREAM = 0x100;
+static constexpr uint32_t POINT_STREAM = 0x101;
+
+const char* get_zone_corpus_name(zone_corpus_family family)
+{
+	return family < NUM_ZONE_CORPUS_FAMILIES ? s_families[family].m_name : "";
+}
+
+bool find_zone_corpus_family(const std::string& name, zone_corpus_family& family)
+{
+	for (int i = 0; i < NUM_ZONE_CORPUS_FAMILIES; ++i) {
+		if (name == s_families[i].m_name) {
+			family = (zone_corpus_family)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t get_zone_corpus_default_count(zone_corpus_family family)
+{
+	return family < NUM_ZONE_CORPUS_FAMILIES ? s_families[family].m_default_count : 0;
+}
+
+static void _finish_zone(Zone& zone)
+{
+	zone.m_position = Vec2::ZERO;
+	for (const Vec2& point : zone.m_poly.m_points) {
+		zone.m_position += point;
+	}
+	zone.m_position *= 1.f / (float)zone.m_poly.m_points.size();
+	zone.m_hull = ConvexHull2(zone.m_poly);
+}
+
+// a convex polygon on the ellipse with radii rx, ry turned by angle, counter clockwise,
+// moved so it stays in [-1,1]
+static Zone _make_ellipse_zone(corpus_rng& rng, Vec2 center, float rx, float ry, float angle)
+{
+	const int num_points = rng.get_int(3, 8);
+	const float extent = std::min(std::max(rx, ry), 1.f);
+	center.x = std::min(std::max(center.x, -1.f + extent), 1.f - extent);
+	center.y = std::min(std::max(center.y, -1.f + extent), 1.f - extent);
+	const float c = std::cos(angle);
+	const float s = std::sin(angle);
+	// evenly spaced and jittered, so no two points meet
+	const float phase = rng.get_float(0.f, 6.2831853f);
+	Zone zone;
+	zone.m_poly.m_points.reserve(num_points);
+	for (int i = 0; i < num_points; ++i) {
+		const float a = phase + 6.2831853f * ((float)i + rng.get_float(0.f, 0.8f)) / (float)num_points;
+		const float x = rx * std::cos(a);
+		const float y = ry * std::sin(a);
+		zone.m_poly.m_points.emplace_back(center.x + x * c - y * s, center.y + x * s + y * c);
+	}
+	_finish_zone(zone);
+	return zone;
+}
+
+static Zone _make_box_zone(const Vec2& min, const Vec2& max)
+{
+	Zone zone;
+	zone.m_poly.m_points = {min, Vec2(max.x, min.y), max, Vec2(min.x, max.y)};
+	_finish_zone(zone);
+	return zone;
+}
+
+void generate_zone_corpus(zone_corpus_family family, uint32_t seed, size_t num_zones, std::vector<Zone>& zones)
+{
+	zones.clear();
+	if (family >= NUM_ZONE_CORPUS_FAMILIES) {
+		return;
+	}
+	if (num_zones == 0) {
+		num_zones = s_families[family].m_default_count;
+	}
+	corpus_rng rng(seed, (uint32_t)family);
+	const float shrink = std::min(1.f, std::sqrt(REFERENCE_COUNT / (float)num_zones));
+	zones.reserve(num_zones);
+	switch (family) {
+	case ZONE_CORPUS_UNIFORM:
+	case ZONE_CORPUS_MILLION:
+		for (size_t i = 0; i < num_zones; ++i) {
+			const float radius = rng.get_float(0.05f, 0.1f) * shrink;
+			zones.push_back(_make_ellipse_zone(rng, rng.get_point(-1.f, 1.f), radius, radius, 0.f));
+		}
+		break;
+	case ZONE_CORPUS_CLUSTERED: {
+		constexpr int num_blobs = 24;
+		Vec2 blobs[num_blobs];
+		float sigmas[num_blobs];
+		for (int b = 0; b < num_blobs; ++b) {
+			blobs[b] = rng.get_point(-0.8f, 0.8f);
+			sigmas[b] = rng.get_float(0.04f, 0.15f);
+		}
+		for (size_t i = 0; i < num_zones; ++i) {
+			const int b = rng.get_int(0, num_blobs - 1);
+			const Vec2 center = blobs[b] + rng.get_gaussian_point() * sigmas[b];
+			const float radius = rng.get_float(0.02f, 0.05f) * shrink;
+			zones.push_back(_make_ellipse_zone(rng, center, radius, radius, 0.f));
+		}
+		break;
+	}
+	case ZONE_CORPUS_MIXED:
+		for (size_t i = 0; i < num_zones; ++i) {
+			// one in fifty is huge
+			const bool huge = rng.get_int(0, 49) == 0;
+			const float radius = (huge ? rng.get_float(0.15f, 0.35f) : rng.get_float(0.005f, 0.02f)) * shrink;
+			zones.push_back(_make_ellipse_zone(rng, rng.get_point(-1.f, 1.f), radius, radius, 0.f));
+		}
+		break;
+	case ZONE_CORPUS_SLIVERS:
+		for (size_t i = 0; i < num_zones; ++i) {
+			const float length = rng.get_float(0.05f, 0.2f) * shrink;
+			const float aspect = rng.get_float(8.f, 40.f);
+			const float angle = rng.get_float(0.f, 3.1415927f);
+			zones.push_back(_make_ellipse_zone(rng, rng.get_point(-1.f, 1.f), length, length / aspect, angle));
+		}
+		break;
+	case ZONE_CORPUS_WALLS: {
+		// walls run along the lines of a grid and span whole cells, crossing walls overlap
+		const int num_lines = std::max(4, (int)(64.f / shrink));
+		const float spacing = 2.f / (float)num_lines;
+		const float half_thickness = 0.0015f * shrink;
+		for (size_t i = 0; i < num_zones; ++i) {
+			const bool horizontal = rng.get_int(0, 1) == 0;
+			const float line = -1.f + spacing * (float)rng.get_int(1, num_lines - 1);
+			const int first = rng.get_int(0, num_lines - 1);
+			const int last = std::min(num_lines, first + rng.get_int(1, 6));
+			const float from = -1.f + spacing * (float)first;
+			const float to = -1.f + spacing * (float)last;
+			if (horizontal) {
+				zones.push_back(_make_box_zone(Vec2(from, line - half_thickness), Vec2(to, line + half_thickness)));
+			} else {
+				zones.push_back(_make_box_zone(Vec2(line - half_thickness, from), Vec2(line + half_thickness, to)));
+			}
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void generate_ray_workload(uint32_t seed, size_t num_rays, float max_length, std::vector<Vec2>& ends)
+{
+	corpus_rng rng(seed, RAY_STREAM);
+	ends.resize(num_rays * 2);
+	for (size_t i = 0; i < num_rays; ++i) {
+		ends[i * 2] = rng.get_point(-1.f, 1.f);
+		if (max_length <= 0.f) {
+			ends[i * 2 + 1] = rng.get_point(-1.f, 1.f);
+			continue;
+		}
+		const float angle = rng.get_float(0.f, 6.2831853f);
+		const float length = rng.get_float(0.f, max_length);
+		ends[i * 2 + 1] = ends[i * 2] + Vec2(std::cos(angle), std::sin(angle)) * length;
+	}
+}
+
+void generate_point_workload(uint32_t seed, const std::vector<Zone>& zones, size_t num_points, float near_fraction,
+	std::vector<Vec2>& points)
+{
+	corpus_rng rng(seed, POINT_STREAM);
+	points.resize(num_points);
+	for (size_t i = 0; i < num_points; ++i) {
+		if (zones.empty() || rng.get_float() >= near_fraction) {
+			points[i] = rng.get_point(-1.f, 1.f);
+			continue;
+		}
+		// somewhere between the zone's vertex average and one of its points is inside it
+		const Zone& zone = zones[rng.next() % zones.size()];
+		const std::vector<Vec2>& corners = zone.m_poly.m_points;
+		const Vec2& corner = corners[rng.next() % corners.size()];
+		const float t = rng.get_float(0.f, 0.95f);
+		points[i] = zone.m_position + (corner - zone.m_position) * t;
+	}
+}
+
+bool save_zone_workload(const std::string& path, zone_workload_kind kind, uint32_t seed, const std::vector<Vec2>& points)
+{
+	zone_workload_header header;
+	header.m_kind = kind;
+	header.m_count = (uint32_t)(kind == ZONE_WORKLOAD_RAYS ? points.size() / 2 : points.size());
+	header.m_seed = seed;
+	FILE* fp = std::fopen(path.c_str(), "wb");
+	if (fp == nullptr) {
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (written && !points.empty()) {
+		written = fwrite(points.data(), sizeof(Vec2), points.size(), fp) == points.size();
+	}
+	fclose(fp);
+	return written;
+}
+
+bool load_zone_workload(const std::string& path, zone_workload_kind kind, std::vector<Vec2>& points)
+{
+	FILE* fp = std::fopen(path.c_str(), "rb");
+	if (fp == nullptr) {
+		return false;
+	}
+	zone_workload_header header;
+	bool read = fread(&header, sizeof(header), 1, fp) == 1 && header.m_magic == ZONE_WORKLOAD_MAGIC && header.m_kind == kind;
+	if (read) {
+		points.resize(kind == ZONE_WORKLOAD_RAYS ? (size_t)header.m_count * 2 : (size_t)header.m_count);
+		read = points.empty() || fread(points.data(), sizeof(Vec2), points.size(), fp) == points.size();
+	}
+	fclose(fp);
+	return read;
+}
+
+bool save_zone_corpus(const std::string& dir, zone_corpus_family family, uint32_t seed, size_t num_zones,
+	size_t num_rays, size_t num_points)
+{
+	const std::string base = dir + "/" + get_zone_corpus_name(family) + "_" + std::to_string(seed);
+	std::vector<Zone> zones;
+	generate_zone_corpus(family, seed, num_zones, zones);
+	std::vector<Vec2> rays;
+	generate_ray_workload(seed, num_rays, 0.f, rays);
+	// half of them in zones, or most would miss the sparse families
+	std::vector<Vec2> points;
+	generate_point_workload(seed, zones, num_points, 0.5f, points);
+	if (!save_ghcs_zones(base + ".ghcs", zones) || !save_zone_workload(base + "_rays.bin", ZONE_WORKLOAD_RAYS, seed, rays)
+		|| !save_zone_workload(base + "_points.bin", ZONE_WORKLOAD_POINTS, seed, points)) {
+		AsyncLog("Game", "cannot write the %s corpus to %s", get_zone_corpus_name(family), dir.c_str());
+		return false;
+	}
+	AsyncLog("Game", "corpus %s seed %u: %u zones, %u rays, %u points in %s", get_zone_corpus_name(family), seed,
+		(unsigned int)zones.size(), (unsigned int)num_rays, (unsigned int)num_points, base.c_str());
+	return true;
+}
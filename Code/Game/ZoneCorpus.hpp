@@ -0,0 +1,60 @@
+#pragma once
+#include "Game/RVSGame.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Seeded scenes and query workloads for benchmarks and tests. Nothing here touches g_rng: the
+// same family, seed and count give the same zones on every run, and every zone lies in
+// [-1,1]. Gaussians and rotations go through the C math library, so share the written .ghcs
+// rather than the seed when comparing machines with different compilers
+
+enum zone_corpus_family
+{
+	ZONE_CORPUS_UNIFORM, // random polygons spread evenly
+	ZONE_CORPUS_CLUSTERED, // gaussian blobs with empty space between them
+	ZONE_CORPUS_MIXED, // mostly tiny polygons and a few huge ones
+	ZONE_CORPUS_SLIVERS, // long thin polygons at any angle
+	ZONE_CORPUS_WALLS, // thin axis aligned walls along a grid
+	ZONE_CORPUS_MILLION, // uniform at 1M zones
+	NUM_ZONE_CORPUS_FAMILIES
+};
+
+const char* get_zone_corpus_name(zone_corpus_family family);
+// false for a name that is not a family
+bool find_zone_corpus_family(const std::string& name, zone_corpus_family& family);
+size_t get_zone_corpus_default_count(zone_corpus_family family);
+// num_zones 0 for the family's default; sizes shrink with the count so the density stays put
+void generate_zone_corpus(zone_corpus_family family, uint32_t seed, size_t num_zones, std::vector<Zone>& zones);
+
+// start and end of each ray. Starts are uniform in [-1,1]; ends too with max_length 0,
+// otherwise up to max_length away in any direction
+void generate_ray_workload(uint32_t seed, size_t num_rays, float max_length, std::vector<Vec2>& ends);
+// near_fraction of the points inside a random zone of zones, the rest uniform in [-1,1]
+void generate_point_workload(uint32_t seed, const std::vector<Zone>& zones, size_t num_points, float near_fraction,
+	std::vector<Vec2>& points);
+
+constexpr uint32_t ZONE_WORKLOAD_MAGIC = 0x4C57525Au; // "ZRWL"
+
+enum zone_workload_kind : uint32_t
+{
+	ZONE_WORKLOAD_RAYS = 1, // m_count rays, start x y end x y each
+	ZONE_WORKLOAD_POINTS = 2, // m_count points, x y each
+};
+
+// a workload file is this, then the floats in native byte order
+struct zone_workload_header
+{
+	uint32_t m_magic = ZONE_WORKLOAD_MAGIC;
+	uint32_t m_kind = 0;
+	uint32_t m_count = 0;
+	uint32_t m_seed = 0;
+};
+
+bool save_zone_workload(const std::string& path, zone_workload_kind kind, uint32_t seed, const std::vector<Vec2>& points);
+bool load_zone_workload(const std::string& path, zone_workload_kind kind, std::vector<Vec2>& points);
+
+// <dir>/<family>_<seed>.ghcs with the scene, and _rays.bin and _points.bin next to it; the
+// workloads are seeded from seed too. num_zones 0 for the family's default
+bool save_zone_corpus(const std::string& dir, zone_corpus_family family, uint32_t seed, size_t num_zones,
+	size_t num_rays, size_t num_points);
@@ -0,0 +1,160 @@
+#include "Game/ZoneGeometry.hpp"
+#include <algorithm>
+#include <cmath>
+
+// outward unit normal of edge a->b, sign picks the winding (+1 counter clockwise)
+static Vec2 _get_edge_normal(const Vec2& a, const Vec2& b, float winding)
+{
+	const Vec2 edge = b - a;
+	const float length = std::sqrt(dot2(edge, edge));
+	if (length <= 0.f) {
+		return Vec2::ZERO;
+	}
+	return Vec2(edge.y, -edge.x) * (winding / length);
+}
+
+float get_winding(const std::vector<Vec2>& points)
+{
+	float area = 0.f;
+	for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+		area += cross2(points[j], points[i]);
+	}
+	return area >= 0.f ? 1.f : -1.f;
+}
+
+// closest point on the boundary, and whether p is inside
+static Vec2 _get_closest_on_boundary(const std::vector<Vec2>& points, const Vec2& p, bool& inside)
+{
+	const float winding = get_winding(points);
+	inside = true;
+	Vec2 best;
+	float best_distance2 = INFINITY;
+	for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+		const Vec2& a = points[j];
+		const Vec2& b = points[i];
+		if (dot2(p - a, _get_edge_normal(a, b, winding)) > 0.f) {
+			inside = false;
+		}
+		const Vec2 edge = b - a;
+		const float length2 = dot2(edge, edge);
+		const float s = length2 > 0.f ? std::clamp(dot2(p - a, edge) / length2, 0.f, 1.f) : 0.f;
+		const Vec2 on_edge = a + edge * s;
+		const float distance2 = dot2(p - on_edge, p - on_edge);
+		if (distance2 < best_distance2) {
+			best_distance2 = distance2;
+			best = on_edge;
+		}
+	}
+	return best;
+}
+
+bool sweep_disc_vs_poly(const std::vector<Vec2>& points, const Vec2& start, const Vec2& move, float radius, disc_sweep_hit& hit)
+{
+	if (points.empty()) {
+		return false;
+	}
+	bool inside = false;
+	const Vec2 closest = _get_closest_on_boundary(points, start, inside);
+	const Vec2 away = start - closest;
+	const float distance2 = dot2(away, away);
+	if (inside || distance2 <= radius * radius) {
+		hit.t = 0.f;
+		const float distance = std::sqrt(distance2);
+		if (distance > 0.f) {
+			hit.normal = away * ((inside ? -1.f : 1.f) / distance);
+		} else {
+			hit.normal = move * (-1.f / std::max(std::sqrt(dot2(move, move)), 1e-20f));
+		}
+		return true;
+	}
+
+	// the disc hits the polygon grown by radius: offset edges and rounded corners
+	const float winding = get_winding(points);
+	bool found = false;
+	float best = 1.f;
+	Vec2 best_normal;
+	const float move2 = dot2(move, move);
+	for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+		const Vec2& a = points[j];
+		const Vec2& b = points[i];
+		const Vec2 normal = _get_edge_normal(a, b, winding);
+		const float approach = dot2(move, normal);
+		if (approach < 0.f) {
+			const float t = dot2(a + normal * radius - start, normal) / approach;
+			if (t >= 0.f && t <= best) {
+				const Vec2 edge = b - a;
+				const float s = dot2(start + move * t - a, edge);
+				if (s >= 0.f && s <= dot2(edge, edge)) {
+					best = t;
+					best_normal = normal;
+					found = true;
+				}
+			}
+		}
+		// corner at b
+		if (move2 > 0.f && radius > 0.f) {
+			const Vec2 m = start - b;
+			const float half_b = dot2(m, move);
+			const float c = dot2(m, m) - radius * radius;
+			const float discriminant = half_b * half_b - move2 * c;
+			if (half_b < 0.f && discriminant >= 0.f) {
+				const float t = (-half_b - std::sqrt(discriminant)) / move2;
+				if (t >= 0.f && t <= best) {
+					best = t;
+					best_normal = (start + move * t - b) * (1.f / radius);
+					found = true;
+				}
+			}
+		}
+	}
+	if (found) {
+		hit.t = best;
+		hit.normal = best_normal;
+	}
+	return found;
+}
+
+float get_poly_distance(const std::vector<Vec2>& points, const Vec2& p, Vec2& closest)
+{
+	bool inside = false;
+	closest = _get_closest_on_boundary(points, p, inside);
+	if (inside) {
+		closest = p;
+		return 0.f;
+	}
+	return std::sqrt(dot2(p - closest, p - closest));
+}
+
+float get_box_distance(const AABB2& box, const Vec2& p)
+{
+	const float dx = std::max(std::max(box.Min.x - p.x, p.x - box.Max.x), 0.f);
+	const float dy = std::max(std::max(box.Min.y - p.y, p.y - box.Max.y), 0.f);
+	return std::sqrt(dx * dx + dy * dy);
+}
+
+float get_ray_box_entry(const Ray2& ray, const Vec2& start, const AABB2& box)
+{
+	if (start.x >= box.Min.x && start.x <= box.Max.x && start.y >= box.Min.y && start.y <= box.Max.y) {
+		return 0.f;
+	}
+	return ray.RaycastToAABB2(box);
+}
+
+AABB2 get_points_bounds(const std::vector<Vec2>& points)
+{
+	AABB2 r(points[0], points[0]);
+	for (auto& each : points) {
+		r.Min.x = std::min(r.Min.x, each.x);
+		r.Min.y = std::min(r.Min.y, each.y);
+		r.Max.x = std::max(r.Max.x, each.x);
+		r.Max.y = std::max(r.Max.y, each.y);
+	}
+	return r;
+}
+
+AABB2 get_swept_disc_bounds(const Vec2& start, const Vec2& move, float radius)
+{
+	const Vec2 end = start + move;
+	return AABB2(std::min(start.x, end.x) - radius, std::min(start.y, end.y) - radius,
+		std::max(start.x, end.x) + radius, std::max(start.y, end.y) + radius);
+}
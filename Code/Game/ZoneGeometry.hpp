@@ -0,0 +1,55 @@
+#pragma once
+#include "Engine/Math/Vec2.hpp"
+#include "Engine/Math/AABB2.hpp"
+#include "Engine/Math/Convex.hpp"
+#include <vector>
+
+// Narrow phase tests on a convex polygon given as its points in either winding.
+
+struct disc_sweep_hit
+{
+	float t = 1.f; // fraction of the move at first contact
+	Vec2 normal; // points from the polygon towards the disc
+};
+
+// a disc moving from m_start to m_start + m_move
+struct disc_move
+{
+	Vec2 m_start;
+	Vec2 m_move;
+	float m_radius = 0.f;
+};
+
+struct disc_cast_result
+{
+	bool m_hit = false;
+	float m_t = 1.f; // fraction of the move at first contact, 1 when nothing is hit
+	Vec2 m_position; // disc center at first contact
+	Vec2 m_normal;
+	unsigned int m_zone = 0xFFFFFFFFu;
+};
+
+// Disc of radius moving from start by move. Starting in contact reports t = 0
+bool sweep_disc_vs_poly(const std::vector<Vec2>& points, const Vec2& start, const Vec2& move, float radius, disc_sweep_hit& hit);
+// +1 for counter clockwise points, -1 for clockwise
+float get_winding(const std::vector<Vec2>& points);
+// distance from p to the polygon and the closest point on it, 0 and p itself when p is inside
+float get_poly_distance(const std::vector<Vec2>& points, const Vec2& p, Vec2& closest);
+float get_box_distance(const AABB2& box, const Vec2& p);
+// where the ray enters the box, 0 when start (the ray at 0) is inside and negative on a miss
+float get_ray_box_entry(const Ray2& ray, const Vec2& start, const AABB2& box);
+AABB2 get_points_bounds(const std::vector<Vec2>& points);
+AABB2 get_swept_disc_bounds(const Vec2& start, const Vec2& move, float radius);
+
+inline float dot2(const Vec2& a, const Vec2& b) { return a.x * b.x + a.y * b.y; }
+inline float cross2(const Vec2& a, const Vec2& b) { return a.x * b.y - a.y * b.x; }
+
+inline bool is_overlapping(const AABB2& a, const AABB2& b)
+{
+	return a.Min.x <= b.Max.x && a.Max.x >= b.Min.x && a.Min.y <= b.Max.y && a.Max.y >= b.Min.y;
+}
+
+inline bool is_inside(const AABB2& inner, const AABB2& outer)
+{
+	return inner.Min.x >= outer.Min.x && inner.Max.x <= outer.Max.x && inner.Min.y >= outer.Min.y && inner.Max.y <= outer.Max.y;
+}
@@ -0,0 +1,73 @@
+#include "Game/ZoneOutlineMesh.hpp"
+#include "Game/RVSGame.hpp"
+#include "Engine/Core/VertexUtils.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+
+static void _add_zone_outline(std::vector<Vertex_PCU>& verts, const Zone& zone)
+{
+	auto& points = zone.m_poly.m_points;
+	for (size_t i = 1; i < points.size(); ++i) {
+		AddVerticesOfLine2D(verts, points[i - 1], points[i], ZONE_OUTLINE_THICKNESS, Rgba::TEAL);
+	}
+	AddVerticesOfLine2D(verts, points[points.size() - 1], points[0], ZONE_OUTLINE_THICKNESS, Rgba::TEAL);
+}
+
+void ZoneOutlineMesh::rebuild(const std::vector<Zone>& zones)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	m_vertices.clear();
+	m_first_vertex.clear();
+	m_first_vertex.reserve(zones.size() + 1);
+	for (auto& each : zones) {
+		m_first_vertex.push_back(m_vertices.size());
+		_add_zone_outline(m_vertices, each);
+	}
+	m_first_vertex.push_back(m_vertices.size());
+	m_dirty_zones.clear();
+	m_is_dirty.assign(zones.size(), false);
+	m_changed_begin = 0;
+	m_changed_end = m_vertices.size();
+}
+
+void ZoneOutlineMesh::mark_dirty(size_t zone_index)
+{
+	if (!m_is_dirty[zone_index]) {
+		m_is_dirty[zone_index] = true;
+		m_dirty_zones.push_back(zone_index);
+	}
+}
+
+size_t ZoneOutlineMesh::update(const std::vector<Zone>& zones)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	m_changed_begin = m_changed_end = 0;
+	if (m_dirty_zones.empty()) {
+		return 0;
+	}
+	if (zones.size() + 1 != m_first_vertex.size()) {
+		rebuild(zones);
+		return zones.size();
+	}
+	size_t changed_begin = m_vertices.size();
+	size_t changed_end = 0;
+	for (size_t zone_index : m_dirty_zones) {
+		m_zone_scratch.clear();
+		_add_zone_outline(m_zone_scratch, zones[zone_index]);
+		if (m_zone_scratch.size() != get_num_vertices(zone_index)) {
+			// the outline changed shape, ranges after it would shift
+			rebuild(zones);
+			return zones.size();
+		}
+		const size_t first = m_first_vertex[zone_index];
+		std::copy(m_zone_scratch.begin(), m_zone_scratch.end(), m_vertices.begin() + first);
+		changed_begin = std::min(changed_begin, first);
+		changed_end = std::max(changed_end, first + m_zone_scratch.size());
+		m_is_dirty[zone_index] = false;
+	}
+	const size_t num_updated = m_dirty_zones.size();
+	m_dirty_zones.clear();
+	m_changed_begin = changed_begin;
+	m_changed_end = changed_end;
+	return num_updated;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/Vertex_PCU.hpp"
+
+class Zone;
+
+constexpr float ZONE_OUTLINE_THICKNESS = 0.003f;
+
+// Outline vertices for every zone, built once and kept. Each zone owns a fixed range of
+// the vertex array, so editing a zone only regenerates that range. Needs no renderer.
+class ZoneOutlineMesh
+{
+public:
+	void rebuild(const std::vector<Zone>& zones);
+	void mark_dirty(size_t zone_index);
+	// regenerates the dirty zones, returns how many were regenerated
+	size_t update(const std::vector<Zone>& zones);
+
+	const std::vector<Vertex_PCU>& get_vertices() const { return m_vertices; }
+	size_t get_first_vertex(size_t zone_index) const { return m_first_vertex[zone_index]; }
+	size_t get_num_vertices(size_t zone_index) const { return m_first_vertex[zone_index + 1] - m_first_vertex[zone_index]; }
+	bool is_dirty() const { return !m_dirty_zones.empty(); }
+	// vertex range [begin, end) touched by the last update or rebuild, empty if nothing changed
+	size_t get_changed_begin() const { return m_changed_begin; }
+	size_t get_changed_end() const { return m_changed_end; }
+
+private:
+	std::vector<Vertex_PCU> m_vertices;
+	std::vector<size_t> m_first_vertex; // one per zone plus the end
+	std::vector<size_t> m_dirty_zones;
+	std::vector<bool> m_is_dirty;
+	std::vector<Vertex_PCU> m_zone_scratch;
+	size_t m_changed_begin = 0;
+	size_t m_changed_end = 0;
+};
@@ -0,0 +1,196 @@
+#include "Game/ZoneQueryClient.hpp"
+#include <cstring>
+
+bool ZoneQueryClient::connect(const char* socket_path)
+{
+	disconnect();
+	return m_socket.connect(socket_path);
+}
+
+void ZoneQueryClient::disconnect()
+{
+	m_socket.close();
+	m_ring.close();
+	m_ring_data_bytes = 0;
+	m_ring_batches.clear();
+	m_num_sent_batches = 0;
+}
+
+bool ZoneQueryClient::_send(zone_query_header& header, const void* payload)
+{
+	header.m_magic = ZONE_QUERY_MAGIC;
+	header.m_id = m_next_id++;
+	return m_socket.send_all(&header, sizeof(header))
+		&& (header.m_bytes == 0 || m_socket.send_all(payload, header.m_bytes));
+}
+
+bool ZoneQueryClient::_receive(const zone_query_header& request, zone_query_header& reply)
+{
+	if (!m_socket.receive_all(&reply, sizeof(reply))
+		|| reply.m_magic != ZONE_QUERY_MAGIC || reply.m_bytes > ZONE_QUERY_MAX_BYTES) {
+		m_socket.close();
+		return false;
+	}
+	m_reply.resize(reply.m_bytes);
+	if (reply.m_bytes > 0 && !m_socket.receive_all(m_reply.data(), reply.m_bytes)) {
+		m_socket.close();
+		return false;
+	}
+	return reply.m_id == request.m_id && reply.m_status == ZQ_OK;
+}
+
+bool ZoneQueryClient::_call(zone_query_header& header, const void* payload)
+{
+	// ring batches in flight answer first
+	if (m_num_sent_batches > 0 || !_send(header, payload)) {
+		return false;
+	}
+	zone_query_header reply;
+	return _receive(header, reply);
+}
+
+bool ZoneQueryClient::raycast(const Vec2* ends, size_t num_rays, zone_ray_hit* hits)
+{
+	zone_query_header header;
+	header.m_type = ZQ_RAYCAST;
+	header.m_count = (uint32_t)num_rays;
+	header.m_bytes = (uint32_t)(num_rays * 4 * sizeof(float));
+	if (!_call(header, ends) || m_reply.size() != num_rays * sizeof(zone_ray_hit)) {
+		return false;
+	}
+	if (num_rays > 0) {
+		memcpy(hits, m_reply.data(), m_reply.size());
+	}
+	return true;
+}
+
+bool ZoneQueryClient::find_zones(const Vec2* points, size_t num_points, float max_distance, zone_point_hit* hits)
+{
+	zone_query_header header;
+	header.m_type = ZQ_POINT;
+	header.m_count = (uint32_t)num_points;
+	header.m_bytes = (uint32_t)(num_points * 2 * sizeof(float));
+	header.m_param = max_distance;
+	if (!_call(header, points) || m_reply.size() != num_points * sizeof(zone_point_hit)) {
+		return false;
+	}
+	if (num_points > 0) {
+		memcpy(hits, m_reply.data(), m_reply.size());
+	}
+	return true;
+}
+
+bool ZoneQueryClient::overlap(const AABB2* boxes, size_t num_boxes, std::vector<uint32_t>& counts, std::vector<uint32_t>& zones)
+{
+	zone_query_header header;
+	header.m_type = ZQ_OVERLAP;
+	header.m_count = (uint32_t)num_boxes;
+	header.m_bytes = (uint32_t)(num_boxes * 4 * sizeof(float));
+	if (!_call(header, boxes) || m_reply.size() < num_boxes * sizeof(uint32_t) || m_reply.size() % sizeof(uint32_t) != 0) {
+		return false;
+	}
+	const uint32_t* reply = (const uint32_t*)m_reply.data();
+	counts.assign(reply, reply + num_boxes);
+	zones.assign(reply + num_boxes, reply + m_reply.size() / sizeof(uint32_t));
+	return true;
+}
+
+bool ZoneQueryClient::attach_ring(const char* name, size_t bytes)
+{
+	if (m_num_sent_batches > 0 || bytes <= sizeof(zone_query_ring_header) || bytes > 0xFFFFFFFFu) {
+		return false;
+	}
+	m_ring.close();
+	m_ring_batches.clear();
+	if (!m_ring.create(name, bytes)) {
+		return false;
+	}
+	zone_query_ring_header ring;
+	ring.m_data_bytes = (uint32_t)(bytes - sizeof(ring));
+	memcpy(m_ring.get_data(), &ring, sizeof(ring));
+	m_ring_data_bytes = ring.m_data_bytes;
+
+	zone_query_header header;
+	header.m_type = ZQ_ATTACH_RING;
+	header.m_count = (uint32_t)bytes;
+	header.m_bytes = (uint32_t)strlen(name);
+	if (!_call(header, name)) {
+		m_ring.close();
+		m_ring_data_bytes = 0;
+		return false;
+	}
+	return true;
+}
+
+bool ZoneQueryClient::reserve_ring_batch(size_t num_rays, zone_ring_batch& batch)
+{
+	// the hits right after the rays, both 8 byte aligned
+	const size_t rays_bytes = num_rays * 2 * sizeof(Vec2);
+	const size_t bytes = (rays_bytes + num_rays * sizeof(zone_ray_hit) + 7) & ~(size_t)7;
+	if (m_ring.get_data() == nullptr || num_rays == 0 || bytes > m_ring_data_bytes) {
+		return false;
+	}
+	size_t begin = 0;
+	if (!m_ring_batches.empty()) {
+		const size_t head = m_ring_batches.back().m_end;
+		const size_t tail = m_ring_batches.front().m_begin;
+		if (head > tail) {
+			// free space at the end, then from the start up to the oldest
+			if (head + bytes <= m_ring_data_bytes) {
+				begin = head;
+			} else if (bytes <= tail) {
+				begin = 0;
+			} else {
+				return false;
+			}
+		} else if (head + bytes <= tail) {
+			begin = head;
+		} else {
+			return false;
+		}
+	}
+	unsigned char* data = m_ring.get_data() + sizeof(zone_query_ring_header);
+	batch.m_id = 0;
+	batch.m_rays = (Vec2*)(data + begin);
+	batch.m_hits = (zone_ray_hit*)(data + begin + rays_bytes);
+	batch.m_num_rays = num_rays;
+	batch.m_begin = begin;
+	batch.m_end = begin + bytes;
+	m_ring_batches.push_back(batch);
+	return true;
+}
+
+bool ZoneQueryClient::send_ring_batch(const zone_ring_batch& batch)
+{
+	// in the order they were reserved
+	if (m_num_sent_batches >= m_ring_batches.size() || m_ring_batches[m_num_sent_batches].m_begin != batch.m_begin) {
+		return false;
+	}
+	zone_ring_batch& sent = m_ring_batches[m_num_sent_batches];
+	zone_query_header header;
+	header.m_type = ZQ_RAYCAST_RING;
+	header.m_count = (uint32_t)sent.m_num_rays;
+	header.m_offset = (uint32_t)sent.m_begin;
+	header.m_out_offset = (uint32_t)((unsigned char*)sent.m_hits - (unsigned char*)sent.m_rays + sent.m_begin);
+	if (!_send(header, nullptr)) {
+		return false;
+	}
+	sent.m_id = header.m_id;
+	++m_num_sent_batches;
+	return true;
+}
+
+bool ZoneQueryClient::receive_ring_batch(zone_ring_batch& batch)
+{
+	if (m_num_sent_batches == 0) {
+		return false;
+	}
+	batch = m_ring_batches.front();
+	m_ring_batches.pop_front();
+	--m_num_sent_batches;
+	zone_query_header request;
+	request.m_id = batch.m_id;
+	zone_query_header reply;
+	// the span is the caller's to read until the next reserve
+	return _receive(request, reply);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "Game/ZoneQueryProtocol.hpp"
+#include "Game/LocalIpc.hpp"
+#include "Engine/Math/Vec2.hpp"
+#include "Engine/Math/AABB2.hpp"
+#include <deque>
+#include <string>
+#include <vector>
+
+// a span of the ring handed out by reserve_ring_batch, m_rays to fill before send_ring_batch and
+// m_hits to read after receive_ring_batch
+struct zone_ring_batch
+{
+	uint32_t m_id = 0;
+	Vec2* m_rays = nullptr; // start and end of each ray
+	zone_ray_hit* m_hits = nullptr;
+	size_t m_num_rays = 0;
+	size_t m_begin = 0; // bytes into the ring data
+	size_t m_end = 0;
+};
+
+// Blocking client of a ZoneQueryServer. The plain calls send one request and wait for its reply.
+// Ray batches can also go through a shared memory ring: reserve a batch, fill it, send it and
+// keep several in flight; they come back in the order they were sent. One thread at a time
+class ZoneQueryClient
+{
+public:
+	~ZoneQueryClient() { disconnect(); }
+
+	bool connect(const char* socket_path);
+	void disconnect();
+	bool is_connected() const { return m_socket.is_open(); }
+
+	// ends holds start and end of num_rays rays
+	bool raycast(const Vec2* ends, size_t num_rays, zone_ray_hit* hits);
+	// the nearest zone within max_distance of each point, 0 for the zone a point is in
+	bool find_zones(const Vec2* points, size_t num_points, float max_distance, zone_point_hit* hits);
+	// counts[i] zones overlap boxes[i], zones has them one box after another
+	bool overlap(const AABB2* boxes, size_t num_boxes, std::vector<uint32_t>& counts, std::vector<uint32_t>& zones);
+
+	// name has to be unique on the machine, bytes include the ring header
+	bool attach_ring(const char* name, size_t bytes);
+	// false when the ring has no room until the oldest batch in flight is received
+	bool reserve_ring_batch(size_t num_rays, zone_ring_batch& batch);
+	bool send_ring_batch(const zone_ring_batch& batch);
+	// waits for the oldest batch sent and frees its span
+	bool receive_ring_batch(zone_ring_batch& batch);
+	size_t get_num_ring_batches() const { return m_ring_batches.size(); }
+
+private:
+	bool _send(zone_query_header& header, const void* payload);
+	// the reply to the request with header.m_id, payload in m_reply
+	bool _receive(const zone_query_header& request, zone_query_header& reply);
+	bool _call(zone_query_header& header, const void* payload);
+
+private:
+	LocalSocket m_socket;
+	uint32_t m_next_id = 1;
+	std::vector<unsigned char> m_reply;
+	SharedMemory m_ring;
+	size_t m_ring_data_bytes = 0;
+	// spans handed out and not yet received, oldest first; a reserved batch is only sent last
+	std::deque<zone_ring_batch> m_ring_batches;
+	size_t m_num_sent_batches = 0;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+
+// Wire format of the zone query server, shared with its clients. Native byte order, both sides run
+// on one machine. Every request is a header and m_bytes of payload; the reply is a header with the
+// same m_id and m_type, m_status ZQ_OK or why not, and the payload listed with each type.
+// Requests on one connection are answered in order, so a client may send several before reading.
+// Coordinates are floats; zones are scene indices, the order of the loaded .ghcs
+
+constexpr uint32_t ZONE_QUERY_MAGIC = 0x5A514331u; // "ZQC1"
+constexpr uint32_t ZONE_QUERY_MAX_BYTES = 64u << 20;
+constexpr uint32_t ZONE_QUERY_RING_MAGIC = 0x5A515231u; // "ZQR1"
+
+enum zone_query_type : uint16_t
+{
+	// m_count rays, payload start x y end x y each -> m_count zone_ray_hit
+	ZQ_RAYCAST = 1,
+	// m_count points, payload x y each, m_param the max distance -> m_count zone_point_hit.
+	// m_param 0 finds the zone a point is in
+	ZQ_POINT = 2,
+	// m_count boxes, payload min x y max x y each -> m_count uint32 zone counts, then the zones
+	// overlapping each box one after another
+	ZQ_OVERLAP = 3,
+	// payload the shared memory name the client created, m_count its size in bytes -> nothing.
+	// It starts with a zone_query_ring_header
+	ZQ_ATTACH_RING = 4,
+	// m_count rays read from the ring at m_offset, zone_ray_hits written to it at m_out_offset,
+	// offsets from the ring's data start -> nothing, the hits are in the ring when the reply comes
+	ZQ_RAYCAST_RING = 5,
+};
+
+enum zone_query_status : uint16_t
+{
+	ZQ_OK = 0,
+	ZQ_BAD_REQUEST = 1, // unknown type or a payload that does not match m_count
+	ZQ_NO_RING = 2, // ZQ_RAYCAST_RING before a ZQ_ATTACH_RING that worked
+	ZQ_OUT_OF_RING = 3, // offsets past the ring
+};
+
+struct zone_query_header
+{
+	uint32_t m_magic = ZONE_QUERY_MAGIC;
+	uint16_t m_type = 0;
+	uint16_t m_status = ZQ_OK;
+	uint32_t m_id = 0; // the client's, echoed
+	uint32_t m_count = 0;
+	uint32_t m_bytes = 0; // payload after the header
+	float m_param = 0.f;
+	uint32_t m_offset = 0;
+	uint32_t m_out_offset = 0;
+};
+static_assert(sizeof(zone_query_header) == 32, "fixed on the wire");
+
+struct zone_ray_hit
+{
+	uint32_t m_hit = 0;
+	float m_k = 0.f;
+	float m_position[2] = {};
+	float m_normal[2] = {};
+};
+static_assert(sizeof(zone_ray_hit) == 24, "fixed on the wire");
+
+struct zone_point_hit
+{
+	int32_t m_zone = -1; // -1 when no zone is within the distance
+	float m_distance = 0.f;
+};
+
+// at the start of a ZQ_ATTACH_RING block, the data follows
+struct zone_query_ring_header
+{
+	uint32_t m_magic = ZONE_QUERY_RING_MAGIC;
+	uint32_t m_data_bytes = 0;
+	uint32_t m_padding[2] = {};
+};
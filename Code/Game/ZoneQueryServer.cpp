@@ -0,0 +1,277 @@
+#include "Game/ZoneQueryServer.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+// rays and points are read in place as these
+static_assert(sizeof(Vec2) == 2 * sizeof(float), "rays and points are read as Vec2");
+static_assert(sizeof(AABB2) == 4 * sizeof(float), "boxes are read as AABB2");
+
+ZoneQueryServer::~ZoneQueryServer()
+{
+	shutdown();
+}
+
+bool ZoneQueryServer::startup(ZoneScene& scene, const char* socket_path)
+{
+	// clients pin from the first request on
+	if (m_running || scene.get_latest() == nullptr) {
+		return false;
+	}
+	m_scene = &scene;
+	if (!m_listener.listen(socket_path)) {
+		return false;
+	}
+	m_socket_path = socket_path;
+	m_running = true;
+	m_accept_thread = std::thread([this]() { _accept_clients(); });
+	return true;
+}
+
+void ZoneQueryServer::shutdown()
+{
+	if (!m_running) {
+		return;
+	}
+	m_running = false;
+	// not every platform wakes a blocked accept on shutdown, a connection always does
+	m_listener.shutdown();
+	{
+		LocalSocket wake;
+		wake.connect(m_socket_path.c_str());
+	}
+	m_accept_thread.join();
+	m_listener.close();
+	std::lock_guard<std::mutex> guard(m_lock);
+	for (auto& each : m_clients) {
+		each->m_socket.shutdown();
+	}
+	for (auto& each : m_clients) {
+		each->m_thread.join();
+		m_scene->unregister_reader(each->m_reader);
+	}
+	m_clients.clear();
+}
+
+zone_query_server_stats ZoneQueryServer::get_stats() const
+{
+	zone_query_server_stats stats;
+	stats.m_requests = m_num_requests;
+	stats.m_queries = m_num_queries;
+	stats.m_connections = m_num_connections;
+	std::lock_guard<std::mutex> guard(m_lock);
+	for (const auto& each : m_clients) {
+		stats.m_clients += each->m_done ? 0 : 1;
+	}
+	return stats;
+}
+
+void ZoneQueryServer::_accept_clients()
+{
+	trace_set_thread_name("zone server accept");
+	while (m_running) {
+		auto incoming = std::make_unique<client>();
+		if (!m_listener.accept(incoming->m_socket)) {
+			// out of handles or the like, try again in a bit
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+		_reap_clients();
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (!m_running || m_clients.size() >= MAX_CLIENTS) {
+			continue;
+		}
+		incoming->m_reader = m_scene->register_reader();
+		if (incoming->m_reader < 0) {
+			continue;
+		}
+		client* each = incoming.get();
+		each->m_thread = std::thread([this, each]() { _serve(*each); });
+		m_clients.push_back(std::move(incoming));
+		++m_num_connections;
+	}
+}
+
+void ZoneQueryServer::_reap_clients()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	for (size_t i = 0; i < m_clients.size();) {
+		client& each = *m_clients[i];
+		if (!each.m_done) {
+			++i;
+			continue;
+		}
+		each.m_thread.join();
+		m_scene->unregister_reader(each.m_reader);
+		m_clients[i] = std::move(m_clients.back());
+		m_clients.pop_back();
+	}
+}
+
+void ZoneQueryServer::_serve(client& each)
+{
+	trace_set_thread_name("zone server client");
+	zone_query_header header;
+	while (each.m_socket.receive_all(&header, sizeof(header))) {
+		// not speaking the protocol, hang up
+		if (header.m_magic != ZONE_QUERY_MAGIC || header.m_bytes > ZONE_QUERY_MAX_BYTES) {
+			break;
+		}
+		each.m_request.resize(header.m_bytes);
+		if (header.m_bytes > 0 && !each.m_socket.receive_all(each.m_request.data(), header.m_bytes)) {
+			break;
+		}
+		each.m_reply.clear();
+		header.m_status = ZQ_OK;
+		{
+			zone_scene_pin version(*m_scene, each.m_reader);
+			_answer(each, *version.get(), header);
+		}
+		header.m_bytes = (uint32_t)each.m_reply.size();
+		if (!each.m_socket.send_all(&header, sizeof(header))
+			|| (!each.m_reply.empty() && !each.m_socket.send_all(each.m_reply.data(), each.m_reply.size()))) {
+			break;
+		}
+		++m_num_requests;
+	}
+	// hang up now, the socket is closed when the thread is reaped
+	each.m_socket.shutdown();
+	each.m_ring.close();
+	each.m_done = true;
+}
+
+// fn(begin, end) over count queries, on the TaskScheduler when there are enough of them
+template<typename Fn>
+static void _for_queries(size_t count, Fn&& fn)
+{
+	if (count < ZoneQueryServer::PARALLEL_MIN_QUERIES) {
+		fn((size_t)0, count);
+		return;
+	}
+	parallel_for(0, count, 0, fn);
+}
+
+static void _raycast(const zone_scene_version& version, const Vec2* ends, size_t count, zone_ray_hit* hits)
+{
+	_for_queries(count, [&version, ends, hits](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const ConvexImpactResult impact = version.raycast_by(Ray2::FromPoint(ends[i * 2], ends[i * 2 + 1]));
+			zone_ray_hit& hit = hits[i];
+			hit.m_hit = impact.hit ? 1 : 0;
+			hit.m_k = impact.k;
+			hit.m_position[0] = impact.pos.x;
+			hit.m_position[1] = impact.pos.y;
+			hit.m_normal[0] = impact.normal.x;
+			hit.m_normal[1] = impact.normal.y;
+		}
+	});
+}
+
+void ZoneQueryServer::_answer(client& each, const zone_scene_version& version, zone_query_header& header)
+{
+	const size_t count = header.m_count;
+	// in 64 bits, so a huge count cannot wrap around to the payload size
+	const unsigned long long wide_count = header.m_count;
+	const unsigned char* payload = each.m_request.data();
+	const size_t bytes = each.m_request.size();
+	switch (header.m_type) {
+	case ZQ_RAYCAST: {
+		if (bytes != wide_count * 4 * sizeof(float)) {
+			header.m_status = ZQ_BAD_REQUEST;
+			return;
+		}
+		each.m_reply.resize(count * sizeof(zone_ray_hit));
+		_raycast(version, (const Vec2*)payload, count, (zone_ray_hit*)each.m_reply.data());
+		break;
+	}
+	case ZQ_POINT: {
+		if (bytes != wide_count * 2 * sizeof(float)) {
+			header.m_status = ZQ_BAD_REQUEST;
+			return;
+		}
+		each.m_reply.resize(count * sizeof(zone_point_hit));
+		const Vec2* points = (const Vec2*)payload;
+		zone_point_hit* hits = (zone_point_hit*)each.m_reply.data();
+		const float max_distance = header.m_param;
+		_for_queries(count, [&version, points, hits, max_distance](size_t begin, size_t end) {
+			zone_nearest_scratch scratch;
+			std::vector<zone_distance> found;
+			for (size_t i = begin; i < end; ++i) {
+				const zone_distance nearest = version.find_nearest(points[i], max_distance, scratch, found);
+				hits[i].m_zone = nearest.m_zone == 0xFFFFFFFFu ? -1 : (int32_t)nearest.m_zone;
+				hits[i].m_distance = nearest.m_distance;
+			}
+		});
+		break;
+	}
+	case ZQ_OVERLAP: {
+		if (bytes != wide_count * 4 * sizeof(float)) {
+			header.m_status = ZQ_BAD_REQUEST;
+			return;
+		}
+		if (each.m_overlaps.size() < count) {
+			each.m_overlaps.resize(count);
+		}
+		const AABB2* boxes = (const AABB2*)payload;
+		std::vector<unsigned int>* overlaps = each.m_overlaps.data();
+		_for_queries(count, [&version, boxes, overlaps](size_t begin, size_t end) {
+			zone_query_marks marks;
+			std::vector<unsigned int> scratch;
+			for (size_t i = begin; i < end; ++i) {
+				overlaps[i].clear();
+				version.query_box(boxes[i], marks, scratch, overlaps[i]);
+			}
+		});
+		size_t num_zones = 0;
+		for (size_t i = 0; i < count; ++i) {
+			num_zones += overlaps[i].size();
+		}
+		each.m_reply.resize((count + num_zones) * sizeof(uint32_t));
+		uint32_t* counts = (uint32_t*)each.m_reply.data();
+		uint32_t* zones = counts + count;
+		for (size_t i = 0; i < count; ++i) {
+			counts[i] = (uint32_t)overlaps[i].size();
+			zones = std::copy(overlaps[i].begin(), overlaps[i].end(), zones);
+		}
+		break;
+	}
+	case ZQ_ATTACH_RING: {
+		each.m_ring.close();
+		const std::string name((const char*)payload, bytes);
+		if (count <= sizeof(zone_query_ring_header) || !each.m_ring.open(name.c_str(), count)) {
+			header.m_status = ZQ_BAD_REQUEST;
+			return;
+		}
+		const zone_query_ring_header* ring = (const zone_query_ring_header*)each.m_ring.get_data();
+		if (ring->m_magic != ZONE_QUERY_RING_MAGIC || ring->m_data_bytes > count - sizeof(zone_query_ring_header)) {
+			each.m_ring.close();
+			header.m_status = ZQ_BAD_REQUEST;
+		}
+		return;
+	}
+	case ZQ_RAYCAST_RING: {
+		if (each.m_ring.get_data() == nullptr) {
+			header.m_status = ZQ_NO_RING;
+			return;
+		}
+		// what was mapped, the header in the ring is the client's to scribble on
+		const unsigned long long data_bytes = each.m_ring.get_size() - sizeof(zone_query_ring_header);
+		const unsigned long long in_end = header.m_offset + wide_count * 4 * sizeof(float);
+		const unsigned long long out_end = header.m_out_offset + wide_count * sizeof(zone_ray_hit);
+		if (in_end > data_bytes || out_end > data_bytes || header.m_offset % 4 != 0 || header.m_out_offset % 4 != 0) {
+			header.m_status = ZQ_OUT_OF_RING;
+			return;
+		}
+		unsigned char* data = each.m_ring.get_data() + sizeof(zone_query_ring_header);
+		_raycast(version, (const Vec2*)(data + header.m_offset), count, (zone_ray_hit*)(data + header.m_out_offset));
+		break;
+	}
+	default:
+		header.m_status = ZQ_BAD_REQUEST;
+		return;
+	}
+	m_num_queries += count;
+}
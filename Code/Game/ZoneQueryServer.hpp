@@ -0,0 +1,70 @@
+#pragma once
+#include "Game/ZoneScene.hpp"
+#include "Game/ZoneQueryProtocol.hpp"
+#include "Game/LocalIpc.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct zone_query_server_stats
+{
+	unsigned long long m_requests = 0;
+	unsigned long long m_queries = 0; // rays, points and boxes
+	unsigned int m_clients = 0; // connected now
+	unsigned long long m_connections = 0; // ever
+};
+
+// Serves ZoneQueryProtocol requests against a ZoneScene over a local socket. Each client gets its
+// own thread and reader slot, and answers against the version it pins per request, so the scene
+// may be edited and republished while it serves. Batches of PARALLEL_MIN_QUERIES or more are
+// split over the TaskScheduler. startup and shutdown are for the thread that owns the server
+class ZoneQueryServer
+{
+public:
+	// clients past this are turned away, every one holds a reader slot of the scene
+	static constexpr size_t MAX_CLIENTS = 32;
+	static constexpr size_t PARALLEL_MIN_QUERIES = 256;
+public:
+	~ZoneQueryServer();
+	// scene has to outlive shutdown
+	bool startup(ZoneScene& scene, const char* socket_path);
+	// disconnects every client and waits for their threads
+	void shutdown();
+	zone_query_server_stats get_stats() const;
+
+private:
+	struct client
+	{
+		LocalSocket m_socket;
+		std::thread m_thread;
+		int m_reader = -1;
+		std::atomic<bool> m_done = false;
+		SharedMemory m_ring;
+		// reused from request to request
+		std::vector<unsigned char> m_request;
+		std::vector<unsigned char> m_reply;
+		std::vector<std::vector<unsigned int>> m_overlaps; // per box
+	};
+
+	void _accept_clients();
+	// joins the clients that hung up
+	void _reap_clients();
+	void _serve(client& each);
+	void _answer(client& each, const zone_scene_version& version, zone_query_header& header);
+
+private:
+	ZoneScene* m_scene = nullptr;
+	LocalSocket m_listener;
+	std::string m_socket_path;
+	std::thread m_accept_thread;
+	std::atomic<bool> m_running = false;
+	mutable std::mutex m_lock;
+	std::vector<std::unique_ptr<client>> m_clients;
+
+	std::atomic<unsigned long long> m_num_requests = 0;
+	std::atomic<unsigned long long> m_num_queries = 0;
+	std::atomic<unsigned long long> m_num_connections = 0;
+};
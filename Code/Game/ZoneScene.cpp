@@ -0,0 +1,286 @@
+#include "Game/ZoneScene.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+
+ConvexImpactResult zone_scene_version::raycast_by(const Ray2& ray) const
+{
+	ConvexImpactResult result;
+	for (const auto& cell : m_cells) {
+		if (cell == nullptr) {
+			continue;
+		}
+		const ConvexImpactResult found = cell->m_tree.raycast_by(ray);
+		if (found.hit && found.k < result.k) {
+			result = found;
+		}
+	}
+	return result;
+}
+
+zone_distance zone_scene_version::find_nearest(const Vec2& point, float max_distance, zone_nearest_scratch& scratch,
+	std::vector<zone_distance>& found) const
+{
+	zone_distance result;
+	for (const auto& cell : m_cells) {
+		if (cell == nullptr) {
+			continue;
+		}
+		// a cell only has to beat the best so far
+		const float bound = result.m_zone == 0xFFFFFFFFu ? max_distance : result.m_distance;
+		cell->m_tree.find_nearest(point, 1, bound, scratch, found);
+		if (found.empty()) {
+			continue;
+		}
+		const unsigned int id = cell->m_ids[found[0].m_zone];
+		if (result.m_zone == 0xFFFFFFFFu || found[0].m_distance < result.m_distance
+			|| (found[0].m_distance == result.m_distance && id < result.m_zone)) {
+			result = found[0];
+			result.m_zone = id;
+		}
+	}
+	return result;
+}
+
+void zone_scene_version::query_box(const AABB2& box, zone_query_marks& marks, std::vector<unsigned int>& scratch,
+	std::vector<unsigned int>& out) const
+{
+	for (const auto& cell : m_cells) {
+		if (cell == nullptr) {
+			continue;
+		}
+		scratch.clear();
+		cell->m_tree.query_box(box, marks, scratch);
+		for (unsigned int zone : scratch) {
+			// the tree only knows the bounds
+			if (cell->m_zones[zone].m_poly.is_overlapping_box(box)) {
+				out.push_back(cell->m_ids[zone]);
+			}
+		}
+	}
+}
+
+ZoneScene::~ZoneScene()
+{
+	// every reader is gone by now
+	for (const zone_scene_version* each : m_retired) {
+		delete each;
+	}
+	delete m_latest;
+}
+
+int ZoneScene::register_reader()
+{
+	for (size_t i = 0; i < MAX_READERS; ++i) {
+		bool expected = false;
+		if (m_readers[i].compare_exchange_strong(expected, true)) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+void ZoneScene::unregister_reader(int reader)
+{
+	m_hazards[reader].store(nullptr);
+	m_readers[reader].store(false);
+}
+
+const zone_scene_version* ZoneScene::pin(int reader)
+{
+	// once the slot holds the version and it is still current, the writer sees the slot
+	// before it could retire that version
+	const zone_scene_version* version = m_current.load();
+	for (;;) {
+		m_hazards[reader].store(version);
+		const zone_scene_version* again = m_current.load();
+		if (again == version) {
+			return version;
+		}
+		version = again;
+	}
+}
+
+void ZoneScene::unpin(int reader)
+{
+	m_hazards[reader].store(nullptr);
+}
+
+void ZoneScene::reset(const std::vector<Zone>& zones)
+{
+	m_reset_zones = zones;
+	m_reset = true;
+	m_edits.clear();
+}
+
+void ZoneScene::set_zone(unsigned int index, const Zone& zone)
+{
+	if (m_reset) {
+		m_reset_zones[index] = zone;
+	} else {
+		m_edits.emplace_back(index, zone);
+	}
+}
+
+int ZoneScene::_get_cell(const Zone& zone) const
+{
+	const Vec2 center = get_points_bounds(zone.m_poly.m_points).GetCenter();
+	const Vec2 size = m_box.Max - m_box.Min;
+	const int x = std::clamp((int)((center.x - m_box.Min.x) / size.x * ZONE_SCENE_GRID), 0, ZONE_SCENE_GRID - 1);
+	const int y = std::clamp((int)((center.y - m_box.Min.y) / size.y * ZONE_SCENE_GRID), 0, ZONE_SCENE_GRID - 1);
+	return y * ZONE_SCENE_GRID + x;
+}
+
+std::shared_ptr<const zone_scene_cell> ZoneScene::_build_cell(std::vector<Zone>& zones, std::vector<unsigned int>& ids)
+{
+	if (zones.empty()) {
+		return nullptr;
+	}
+	auto cell = std::make_shared<zone_scene_cell>();
+	cell->m_zones.swap(zones);
+	cell->m_ids.swap(ids);
+	AABB2 box = get_points_bounds(cell->m_zones[0].m_poly.m_points);
+	for (const Zone& each : cell->m_zones) {
+		const AABB2 b = get_points_bounds(each.m_poly.m_points);
+		box.Min = Vec2(std::min(box.Min.x, b.Min.x), std::min(box.Min.y, b.Min.y));
+		box.Max = Vec2(std::max(box.Max.x, b.Max.x), std::max(box.Max.y, b.Max.y));
+	}
+	cell->m_tree.m_box = box;
+	// cells are small, the build workers would cost more than they save
+	cell->m_tree.build_tree(cell->m_zones, m_build_scratch, 1);
+	return cell;
+}
+
+size_t ZoneScene::get_memory_bytes() const
+{
+	size_t r = m_build_scratch.get_memory_bytes();
+	if (m_latest != nullptr) {
+		for (const auto& cell : m_latest->m_cells) {
+			if (cell != nullptr) {
+				r += cell->m_tree.get_memory_bytes();
+			}
+		}
+	}
+	return r;
+}
+
+void ZoneScene::publish()
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	if (!has_edits()) {
+		return;
+	}
+	if (m_latest == nullptr && !m_reset) {
+		// nothing to edit before the first reset
+		m_edits.clear();
+		return;
+	}
+	zone_scene_version* next = new zone_scene_version();
+	next->m_number = m_latest != nullptr ? m_latest->m_number + 1 : 1;
+	std::vector<Zone> cell_zones[ZONE_SCENE_CELLS];
+	std::vector<unsigned int> cell_ids[ZONE_SCENE_CELLS];
+	m_num_rebuilt = 0;
+
+	if (m_reset) {
+		m_zone_cells.resize(m_reset_zones.size());
+		for (unsigned int i = 0; i < (unsigned int)m_reset_zones.size(); ++i) {
+			const int c = _get_cell(m_reset_zones[i]);
+			m_zone_cells[i] = (unsigned char)c;
+			cell_zones[c].push_back(std::move(m_reset_zones[i]));
+			cell_ids[c].push_back(i);
+		}
+		for (int c = 0; c < ZONE_SCENE_CELLS; ++c) {
+			next->m_cells[c] = _build_cell(cell_zones[c], cell_ids[c]);
+		}
+		next->m_num_zones = (unsigned int)m_reset_zones.size();
+		m_num_rebuilt = ZONE_SCENE_CELLS;
+		m_reset_zones.clear();
+		m_reset = false;
+	} else {
+		// keep the last edit of each zone
+		std::stable_sort(m_edits.begin(), m_edits.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+		size_t num_edits = 0;
+		for (size_t i = 0; i < m_edits.size(); ++i) {
+			if (i + 1 < m_edits.size() && m_edits[i + 1].first == m_edits[i].first) {
+				continue;
+			}
+			if (m_edits[i].first >= m_zone_cells.size()) {
+				continue;
+			}
+			if (num_edits != i) {
+				m_edits[num_edits] = std::move(m_edits[i]);
+			}
+			++num_edits;
+		}
+		m_edits.resize(num_edits);
+
+		bool dirty[ZONE_SCENE_CELLS] = {};
+		std::vector<int> new_cells(num_edits);
+		for (size_t i = 0; i < num_edits; ++i) {
+			new_cells[i] = _get_cell(m_edits[i].second);
+			dirty[m_zone_cells[m_edits[i].first]] = true;
+			dirty[new_cells[i]] = true;
+		}
+		auto is_edited = [this](unsigned int id) {
+			auto found = std::lower_bound(m_edits.begin(), m_edits.end(), id,
+				[](const std::pair<unsigned int, Zone>& edit, unsigned int value) { return edit.first < value; });
+			return found != m_edits.end() && found->first == id;
+		};
+		// what stays of the dirty cells, then the edited zones where they are now
+		for (int c = 0; c < ZONE_SCENE_CELLS; ++c) {
+			const zone_scene_cell* old_cell = m_latest->m_cells[c].get();
+			if (!dirty[c] || old_cell == nullptr) {
+				continue;
+			}
+			for (size_t i = 0; i < old_cell->m_ids.size(); ++i) {
+				if (!is_edited(old_cell->m_ids[i])) {
+					cell_zones[c].push_back(old_cell->m_zones[i]);
+					cell_ids[c].push_back(old_cell->m_ids[i]);
+				}
+			}
+		}
+		for (size_t i = 0; i < num_edits; ++i) {
+			cell_zones[new_cells[i]].push_back(std::move(m_edits[i].second));
+			cell_ids[new_cells[i]].push_back(m_edits[i].first);
+			m_zone_cells[m_edits[i].first] = (unsigned char)new_cells[i];
+		}
+		for (int c = 0; c < ZONE_SCENE_CELLS; ++c) {
+			if (dirty[c]) {
+				next->m_cells[c] = _build_cell(cell_zones[c], cell_ids[c]);
+				++m_num_rebuilt;
+			} else {
+				next->m_cells[c] = m_latest->m_cells[c];
+			}
+		}
+		next->m_num_zones = m_latest->m_num_zones;
+		m_edits.clear();
+	}
+
+	m_current.store(next);
+	if (m_latest != nullptr) {
+		m_retired.push_back(m_latest);
+	}
+	m_latest = next;
+	reclaim();
+}
+
+size_t ZoneScene::reclaim()
+{
+	const zone_scene_version* pinned[MAX_READERS];
+	size_t num_pinned = 0;
+	for (size_t i = 0; i < MAX_READERS; ++i) {
+		const zone_scene_version* each = m_hazards[i].load();
+		if (each != nullptr) {
+			pinned[num_pinned++] = each;
+		}
+	}
+	size_t num_kept = 0;
+	for (const zone_scene_version* each : m_retired) {
+		if (std::find(pinned, pinned + num_pinned, each) != pinned + num_pinned) {
+			m_retired[num_kept++] = each;
+		} else {
+			delete each;
+		}
+	}
+	m_retired.resize(num_kept);
+	return num_kept;
+}
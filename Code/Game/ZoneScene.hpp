@@ -0,0 +1,113 @@
+#pragma once
+#include "Game/RVSGame.hpp"
+#include <atomic>
+#include <memory>
+
+// the scene box is split into this many cells a side, each indexed on its own
+constexpr int ZONE_SCENE_GRID = 4;
+constexpr int ZONE_SCENE_CELLS = ZONE_SCENE_GRID * ZONE_SCENE_GRID;
+
+// Zones whose bounds center falls in one grid cell and a QuadTree over just them, boxed by
+// their bounds so zones sticking out of the cell are still indexed whole. Never changed once
+// published, versions that did not edit the cell share it
+struct zone_scene_cell
+{
+	std::vector<Zone> m_zones;
+	std::vector<unsigned int> m_ids; // scene index of each zone
+	QuadTree m_tree;
+};
+
+// One published scene. Everything reachable from it is immutable, readers use it without locks
+// for as long as they keep it pinned
+struct zone_scene_version
+{
+	unsigned int m_number = 0; // counts up from 1 with every publish
+	unsigned int m_num_zones = 0;
+	std::shared_ptr<const zone_scene_cell> m_cells[ZONE_SCENE_CELLS]; // null when empty
+
+	ConvexImpactResult raycast_by(const Ray2& ray) const;
+	// the closest zone within max_distance over every cell, m_zone is its scene index
+	zone_distance find_nearest(const Vec2& point, float max_distance, zone_nearest_scratch& scratch,
+		std::vector<zone_distance>& found) const;
+	// appends the scene index of every zone whose polygon overlaps box, cell by cell
+	void query_box(const AABB2& box, zone_query_marks& marks, std::vector<unsigned int>& scratch,
+		std::vector<unsigned int>& out) const;
+};
+
+// Scene state published as immutable versions, RCU style. The writer stages edits and publish()
+// swaps in a new version that rebuilds only the cells the edits touched. Readers pin the current
+// version through a hazard slot, two atomic loads and a store, never a lock. A replaced version is
+// retired and freed by a later publish or reclaim once no slot holds it.
+// One writer thread; every reader thread registers for its own slot
+class ZoneScene
+{
+public:
+	static constexpr size_t MAX_READERS = 64;
+public:
+	ZoneScene(const AABB2& box=AABB2(-1,-1,1,1)) : m_box(box) {}
+	~ZoneScene();
+	ZoneScene(const ZoneScene&) = delete;
+	ZoneScene& operator=(const ZoneScene&) = delete;
+
+	// Reader side. A slot pins one version at a time, pinning again moves it on
+	// -1 when every slot is taken
+	int register_reader();
+	void unregister_reader(int reader);
+	// null before the first publish
+	const zone_scene_version* pin(int reader);
+	void unpin(int reader);
+
+	// Writer side
+	// replaces every zone, the next publish rebuilds every cell
+	void reset(const std::vector<Zone>& zones);
+	// the zone's new state, it may move to another cell
+	void set_zone(unsigned int index, const Zone& zone);
+	bool has_edits() const { return m_reset || !m_edits.empty(); }
+	// no-op without edits
+	void publish();
+	// frees the retired versions no reader pins, returns how many are still held
+	size_t reclaim();
+	// the version the writer last published
+	const zone_scene_version* get_latest() const { return m_latest; }
+	// cells rebuilt by the last publish
+	unsigned int get_num_rebuilt_cells() const { return m_num_rebuilt; }
+	// bytes held by the latest version's cell trees and by the build scratch the writer keeps
+	size_t get_memory_bytes() const;
+
+private:
+	int _get_cell(const Zone& zone) const;
+	std::shared_ptr<const zone_scene_cell> _build_cell(std::vector<Zone>& zones, std::vector<unsigned int>& ids);
+
+private:
+	AABB2 m_box;
+	std::atomic<const zone_scene_version*> m_current{nullptr};
+	std::atomic<const zone_scene_version*> m_hazards[MAX_READERS] = {};
+	std::atomic<bool> m_readers[MAX_READERS] = {};
+
+	// writer only
+	const zone_scene_version* m_latest = nullptr;
+	std::vector<const zone_scene_version*> m_retired;
+	std::vector<unsigned char> m_zone_cells; // per zone, the cell it sits in in m_latest
+	std::vector<std::pair<unsigned int, Zone>> m_edits; // the last edit of a zone wins
+	std::vector<Zone> m_reset_zones;
+	bool m_reset = false;
+	unsigned int m_num_rebuilt = 0;
+	quad_build_scratch m_build_scratch; // every cell tree is built with it, published cells never hold scratch
+};
+
+// pins for a scope
+class zone_scene_pin
+{
+public:
+	zone_scene_pin(ZoneScene& scene, int reader) : m_scene(scene), m_reader(reader), m_version(scene.pin(reader)) {}
+	~zone_scene_pin() { m_scene.unpin(m_reader); }
+	zone_scene_pin(const zone_scene_pin&) = delete;
+	zone_scene_pin& operator=(const zone_scene_pin&) = delete;
+	const zone_scene_version* get() const { return m_version; }
+	const zone_scene_version* operator->() const { return m_version; }
+
+private:
+	ZoneScene& m_scene;
+	int m_reader;
+	const zone_scene_version* m_version;
+};
@@ -0,0 +1,510 @@
+#include "Game/ZoneScripting.hpp"
+#include "Game/ZoneScene.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Game/AsyncLog.hpp"
+#include "Engine/Script/Py3.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// arrays are read and written in place as these
+static_assert(sizeof(Vec2) == 2 * sizeof(float), "rays and points are read as Vec2");
+static_assert(sizeof(AABB2) == 4 * sizeof(float), "bounds are exposed as 4 floats");
+
+static ZoneScene* s_scene = nullptr;
+static std::atomic<bool> s_scene_read = false;
+static bool s_added = false;
+
+// Each Python thread pins through its own reader slot, taken on its first call. A pin is held
+// with the GIL released, so a shared slot could be moved on by another thread mid query
+struct script_reader
+{
+	int m_reader = -1;
+	unsigned int m_generation = 0;
+	~script_reader();
+};
+static std::mutex s_readers_lock;
+static std::vector<int> s_readers; // slots taken since startup, shutdown gives back what is left
+static unsigned int s_generation = 0; // bumped by startup and shutdown, older slots are gone
+static thread_local script_reader t_reader;
+
+script_reader::~script_reader()
+{
+	std::lock_guard<std::mutex> guard(s_readers_lock);
+	if (m_reader < 0 || m_generation != s_generation || s_scene == nullptr) {
+		return;
+	}
+	s_scene->unregister_reader(m_reader);
+	s_readers.erase(std::find(s_readers.begin(), s_readers.end(), m_reader));
+}
+
+constexpr size_t RAY_GRAIN = 64;
+constexpr size_t POINT_GRAIN = 64;
+constexpr unsigned int NO_ZONE = 0xFFFFFFFFu;
+
+//////////////////////////////////////////////////////////////////////////
+// read-only buffer over memory of one scene cell, keeping the cell alive
+struct zone_view_object
+{
+	PyObject_HEAD
+	std::shared_ptr<const zone_scene_cell>* m_cell;
+	const void* m_data;
+	Py_ssize_t m_shape[2];
+	Py_ssize_t m_strides[2];
+	int m_ndim;
+	char m_format[2];
+};
+
+static int _zone_view_getbuffer(PyObject* self, Py_buffer* view, int flags)
+{
+	if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+		PyErr_SetString(PyExc_BufferError, "zone views are read-only");
+		view->obj = nullptr;
+		return -1;
+	}
+	zone_view_object* zone_view = (zone_view_object*)self;
+	Py_INCREF(self);
+	view->obj = self;
+	view->buf = const_cast<void*>(zone_view->m_data);
+	view->itemsize = 4;
+	view->len = zone_view->m_shape[0] * (zone_view->m_ndim == 2 ? zone_view->m_shape[1] : 1) * 4;
+	view->readonly = 1;
+	view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? zone_view->m_format : nullptr;
+	view->ndim = zone_view->m_ndim;
+	view->shape = (flags & PyBUF_ND) == PyBUF_ND ? zone_view->m_shape : nullptr;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? zone_view->m_strides : nullptr;
+	view->suboffsets = nullptr;
+	view->internal = nullptr;
+	return 0;
+}
+
+static void _zone_view_dealloc(PyObject* self)
+{
+	delete ((zone_view_object*)self)->m_cell;
+	PyTypeObject* type = Py_TYPE(self);
+	type->tp_free(self);
+	Py_DECREF(type);
+}
+
+static PyType_Slot s_zone_view_slots[] = {
+	{ Py_tp_dealloc, (void*)_zone_view_dealloc },
+	{ Py_bf_getbuffer, (void*)_zone_view_getbuffer },
+	{ 0, nullptr },
+};
+static PyType_Spec s_zone_view_spec = {
+	"flare.zone_view", sizeof(zone_view_object), 0, Py_TPFLAGS_DEFAULT, s_zone_view_slots
+};
+static PyTypeObject* s_zone_view_type = nullptr;
+
+// a memoryview of rows x columns 4 byte items of format at data, columns 1 for a flat one
+static PyObject* _new_zone_view(const std::shared_ptr<const zone_scene_cell>& cell, const void* data,
+	size_t rows, size_t columns, char format)
+{
+	zone_view_object* zone_view = PyObject_New(zone_view_object, s_zone_view_type);
+	if (zone_view == nullptr) {
+		return nullptr;
+	}
+	zone_view->m_cell = new std::shared_ptr<const zone_scene_cell>(cell);
+	zone_view->m_data = data;
+	zone_view->m_ndim = columns == 1 ? 1 : 2;
+	zone_view->m_shape[0] = (Py_ssize_t)rows;
+	zone_view->m_shape[1] = (Py_ssize_t)columns;
+	zone_view->m_strides[0] = (Py_ssize_t)(columns * 4);
+	zone_view->m_strides[1] = 4;
+	zone_view->m_format[0] = format;
+	zone_view->m_format[1] = '\0';
+	PyObject* memory = PyMemoryView_FromObject((PyObject*)zone_view);
+	Py_DECREF(zone_view);
+	return memory;
+}
+
+//////////////////////////////////////////////////////////////////////////
+namespace {
+struct buffer_guard
+{
+	Py_buffer m_view{};
+	bool m_held = false;
+	~buffer_guard()
+	{
+		if (m_held) {
+			PyBuffer_Release(&m_view);
+		}
+	}
+};
+}
+
+static bool _is_format(const char* format, char type)
+{
+	// native, standard or little endian sizes all mean the same on the targets we build
+	if (format[0] == '@' || format[0] == '=' || format[0] == '<') {
+		++format;
+	}
+	if (type == 'i' && sizeof(long) == 4 && format[0] == 'l' && format[1] == '\0') {
+		return true;
+	}
+	return format[0] == type && format[1] == '\0';
+}
+
+// obj as a C contiguous array of float32 ('f') or int32 ('i') rows of columns
+static bool _get_array(PyObject* obj, char type, size_t columns, bool writable, const char* name,
+	buffer_guard& buffer, size_t& num_rows)
+{
+	const int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+	if (PyObject_GetBuffer(obj, &buffer.m_view, flags) != 0) {
+		return false;
+	}
+	buffer.m_held = true;
+	const Py_buffer& view = buffer.m_view;
+	const size_t row_bytes = 4 * columns;
+	if (view.itemsize != 4 || !_is_format(view.format != nullptr ? view.format : "B", type)
+		|| (size_t)view.len % row_bytes != 0) {
+		PyErr_Format(PyExc_TypeError, "%s has to be a C contiguous %s array of %zu columns", name,
+			type == 'f' ? "float32" : "int32", columns);
+		return false;
+	}
+	num_rows = (size_t)view.len / row_bytes;
+	return true;
+}
+
+// the caller's out array when there is one, otherwise a new memoryview of rows x columns
+static PyObject* _get_out_array(PyObject* out, char type, size_t rows, size_t columns, const char* name,
+	buffer_guard& buffer, void*& data)
+{
+	if (out != nullptr && out != Py_None) {
+		size_t num_rows = 0;
+		if (!_get_array(out, type, columns, true, name, buffer, num_rows)) {
+			return nullptr;
+		}
+		if (num_rows != rows) {
+			PyErr_Format(PyExc_ValueError, "%s has %zu rows, %zu are needed", name, num_rows, rows);
+			return nullptr;
+		}
+		data = buffer.m_view.buf;
+		Py_INCREF(out);
+		return out;
+	}
+	PyObject* bytes = PyByteArray_FromStringAndSize(nullptr, (Py_ssize_t)(rows * columns * 4));
+	if (bytes == nullptr) {
+		return nullptr;
+	}
+	data = PyByteArray_AS_STRING(bytes);
+	PyObject* memory = PyMemoryView_FromObject(bytes);
+	Py_DECREF(bytes);
+	if (memory == nullptr) {
+		return nullptr;
+	}
+	const char format[2] = { type, '\0' };
+	// memoryview cannot cast to a shape with a zero in it
+	PyObject* shaped = columns == 1 || rows == 0
+		? PyObject_CallMethod(memory, "cast", "s", format)
+		: PyObject_CallMethod(memory, "cast", "s(nn)", format, (Py_ssize_t)rows, (Py_ssize_t)columns);
+	Py_DECREF(memory);
+	return shaped;
+}
+
+static bool _check_scene()
+{
+	if (s_scene == nullptr) {
+		PyErr_SetString(PyExc_RuntimeError, "no zone scene is running");
+		return false;
+	}
+	return true;
+}
+
+// null with the Python error set when nothing is published yet
+static const zone_scene_version* _get_version(const zone_scene_pin& pin)
+{
+	if (pin.get() == nullptr) {
+		PyErr_SetString(PyExc_RuntimeError, "the zone scene has not been published yet");
+		return nullptr;
+	}
+	s_scene_read = true;
+	return pin.get();
+}
+
+// -1 with the Python error set when every slot is taken
+static int _get_reader()
+{
+	std::lock_guard<std::mutex> guard(s_readers_lock);
+	if (t_reader.m_reader >= 0 && t_reader.m_generation == s_generation) {
+		return t_reader.m_reader;
+	}
+	const int reader = s_scene->register_reader();
+	if (reader < 0) {
+		PyErr_SetString(PyExc_RuntimeError, "no zone scene reader slot left for this thread");
+		return -1;
+	}
+	s_readers.push_back(reader);
+	t_reader.m_reader = reader;
+	t_reader.m_generation = s_generation;
+	return reader;
+}
+
+//////////////////////////////////////////////////////////////////////////
+static PyObject* _flare_raycast(PyObject*, PyObject* args, PyObject* kwargs)
+{
+	static const char* keywords[] = { "rays", "out", nullptr };
+	PyObject* rays_object = nullptr;
+	PyObject* out_object = nullptr;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:raycast", const_cast<char**>(keywords), &rays_object, &out_object)
+		|| !_check_scene()) {
+		return nullptr;
+	}
+	buffer_guard rays;
+	size_t num_rays = 0;
+	if (!_get_array(rays_object, 'f', 4, false, "rays", rays, num_rays)) {
+		return nullptr;
+	}
+	const int reader = _get_reader();
+	if (reader < 0) {
+		return nullptr;
+	}
+	zone_scene_pin pin(*s_scene, reader);
+	const zone_scene_version* version = _get_version(pin);
+	if (version == nullptr) {
+		return nullptr;
+	}
+	buffer_guard out_buffer;
+	void* out_data = nullptr;
+	PyObject* result = _get_out_array(out_object, 'f', num_rays, 6, "out", out_buffer, out_data);
+	if (result == nullptr) {
+		return nullptr;
+	}
+
+	const Vec2* ends = (const Vec2*)rays.m_view.buf;
+	float* out = (float*)out_data;
+	Py_BEGIN_ALLOW_THREADS
+	parallel_for(0, num_rays, RAY_GRAIN, [version, ends, out](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const ConvexImpactResult impact = version->raycast_by(Ray2::FromPoint(ends[i * 2], ends[i * 2 + 1]));
+			float* row = out + i * 6;
+			row[0] = impact.hit ? 1.f : 0.f;
+			row[1] = impact.k;
+			row[2] = impact.pos.x;
+			row[3] = impact.pos.y;
+			row[4] = impact.normal.x;
+			row[5] = impact.normal.y;
+		}
+	});
+	Py_END_ALLOW_THREADS
+	return result;
+}
+
+static PyObject* _flare_nearest(PyObject*, PyObject* args, PyObject* kwargs)
+{
+	static const char* keywords[] = { "points", "max_distance", "zones", "distances", nullptr };
+	PyObject* points_object = nullptr;
+	float max_distance = 1e30f;
+	PyObject* zones_object = nullptr;
+	PyObject* distances_object = nullptr;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|fOO:nearest", const_cast<char**>(keywords), &points_object,
+		&max_distance, &zones_object, &distances_object) || !_check_scene()) {
+		return nullptr;
+	}
+	buffer_guard points;
+	size_t num_points = 0;
+	if (!_get_array(points_object, 'f', 2, false, "points", points, num_points)) {
+		return nullptr;
+	}
+	const int reader = _get_reader();
+	if (reader < 0) {
+		return nullptr;
+	}
+	zone_scene_pin pin(*s_scene, reader);
+	const zone_scene_version* version = _get_version(pin);
+	if (version == nullptr) {
+		return nullptr;
+	}
+	buffer_guard zones_buffer;
+	buffer_guard distances_buffer;
+	void* zones_data = nullptr;
+	void* distances_data = nullptr;
+	PyObject* zones = _get_out_array(zones_object, 'i', num_points, 1, "zones", zones_buffer, zones_data);
+	if (zones == nullptr) {
+		return nullptr;
+	}
+	PyObject* distances = _get_out_array(distances_object, 'f', num_points, 1, "distances", distances_buffer, distances_data);
+	if (distances == nullptr) {
+		Py_DECREF(zones);
+		return nullptr;
+	}
+
+	const Vec2* at = (const Vec2*)points.m_view.buf;
+	int* out_zones = (int*)zones_data;
+	float* out_distances = (float*)distances_data;
+	Py_BEGIN_ALLOW_THREADS
+	parallel_for(0, num_points, POINT_GRAIN, [version, at, max_distance, out_zones, out_distances](size_t begin, size_t end) {
+		zone_nearest_scratch scratch;
+		std::vector<zone_distance> found;
+		for (size_t i = begin; i < end; ++i) {
+			const zone_distance nearest = version->find_nearest(at[i], max_distance, scratch, found);
+			out_zones[i] = nearest.m_zone == NO_ZONE ? -1 : (int)nearest.m_zone;
+			out_distances[i] = nearest.m_zone == NO_ZONE ? max_distance : nearest.m_distance;
+		}
+	});
+	Py_END_ALLOW_THREADS
+	return Py_BuildValue("(NN)", zones, distances);
+}
+
+static PyObject* _flare_zone_bounds(PyObject*, PyObject*)
+{
+	if (!_check_scene()) {
+		return nullptr;
+	}
+	const int reader = _get_reader();
+	if (reader < 0) {
+		return nullptr;
+	}
+	zone_scene_pin pin(*s_scene, reader);
+	const zone_scene_version* version = _get_version(pin);
+	if (version == nullptr) {
+		return nullptr;
+	}
+	PyObject* cells = PyList_New(0);
+	if (cells == nullptr) {
+		return nullptr;
+	}
+	for (const auto& cell : version->m_cells) {
+		if (cell == nullptr) {
+			continue;
+		}
+		PyObject* ids = _new_zone_view(cell, cell->m_ids.data(), cell->m_ids.size(), 1, 'I');
+		PyObject* bounds = _new_zone_view(cell, cell->m_tree.m_zone_bounds, cell->m_tree.m_num_zones, 4, 'f');
+		if (ids == nullptr || bounds == nullptr) {
+			Py_XDECREF(ids);
+			Py_XDECREF(bounds);
+			Py_DECREF(cells);
+			return nullptr;
+		}
+		// takes both references
+		PyObject* pair = Py_BuildValue("(NN)", ids, bounds);
+		if (pair == nullptr) {
+			Py_DECREF(cells);
+			return nullptr;
+		}
+		const int appended = PyList_Append(cells, pair);
+		Py_DECREF(pair);
+		if (appended != 0) {
+			Py_DECREF(cells);
+			return nullptr;
+		}
+	}
+	return cells;
+}
+
+static PyObject* _flare_zone_points(PyObject*, PyObject* args)
+{
+	unsigned int zone = 0;
+	if (!PyArg_ParseTuple(args, "I:zone_points", &zone) || !_check_scene()) {
+		return nullptr;
+	}
+	const int reader = _get_reader();
+	if (reader < 0) {
+		return nullptr;
+	}
+	zone_scene_pin pin(*s_scene, reader);
+	const zone_scene_version* version = _get_version(pin);
+	if (version == nullptr) {
+		return nullptr;
+	}
+	for (const auto& cell : version->m_cells) {
+		if (cell == nullptr) {
+			continue;
+		}
+		for (size_t i = 0; i < cell->m_ids.size(); ++i) {
+			if (cell->m_ids[i] == zone) {
+				const std::vector<Vec2>& points = cell->m_zones[i].m_poly.m_points;
+				return _new_zone_view(cell, points.data(), points.size(), 2, 'f');
+			}
+		}
+	}
+	PyErr_Format(PyExc_IndexError, "no zone %u in a scene of %u", zone, version->m_num_zones);
+	return nullptr;
+}
+
+static PyObject* _flare_scene_version(PyObject*, PyObject*)
+{
+	if (!_check_scene()) {
+		return nullptr;
+	}
+	const int reader = _get_reader();
+	if (reader < 0) {
+		return nullptr;
+	}
+	zone_scene_pin pin(*s_scene, reader);
+	const zone_scene_version* version = _get_version(pin);
+	return version == nullptr ? nullptr : PyLong_FromUnsignedLong(version->m_number);
+}
+
+static PyMethodDef s_zone_methods[] = {
+	{ "raycast", (PyCFunction)(void (*)(void))_flare_raycast, METH_VARARGS | METH_KEYWORDS,
+		"raycast(rays[, out]): rays (n,4) float32 start and end points, (n,6) hit k pos normal per ray" },
+	{ "nearest", (PyCFunction)(void (*)(void))_flare_nearest, METH_VARARGS | METH_KEYWORDS,
+		"nearest(points[, max_distance, zones, distances]): closest zone index and distance per (n,2) point" },
+	{ "zone_bounds", _flare_zone_bounds, METH_NOARGS,
+		"zone_bounds(): read-only (ids, bounds) views per scene cell" },
+	{ "zone_points", _flare_zone_points, METH_VARARGS,
+		"zone_points(zone): read-only (p,2) view of one zone's outline" },
+	{ "scene_version", _flare_scene_version, METH_NOARGS,
+		"scene_version(): number of the published zone scene" },
+	{ nullptr, nullptr, 0, nullptr },
+};
+
+//////////////////////////////////////////////////////////////////////////
+static bool _add_to_flare()
+{
+	PyObject* flare = PyImport_ImportModule("flare");
+	bool ok = flare != nullptr;
+	if (ok && s_zone_view_type == nullptr) {
+		s_zone_view_type = (PyTypeObject*)PyType_FromSpec(&s_zone_view_spec);
+		ok = s_zone_view_type != nullptr;
+	}
+	ok = ok && PyModule_AddFunctions(flare, s_zone_methods) == 0;
+	Py_XDECREF(flare);
+	if (!ok) {
+		PyErr_Clear();
+	}
+	return ok;
+}
+
+bool zone_scripting_startup(ZoneScene& scene)
+{
+	if (!Py_IsInitialized()) {
+		AsyncLog("Game", "zone scripting: Python is not running");
+		return false;
+	}
+	if (!s_added) {
+		const PyGILState_STATE gil = PyGILState_Ensure();
+		s_added = _add_to_flare();
+		PyGILState_Release(gil);
+		if (!s_added) {
+			AsyncLog("Game", "zone scripting: cannot add to the flare module");
+			return false;
+		}
+	}
+	std::lock_guard<std::mutex> guard(s_readers_lock);
+	++s_generation;
+	s_scene = &scene;
+	return true;
+}
+
+void zone_scripting_shutdown()
+{
+	if (s_scene == nullptr) {
+		return;
+	}
+	std::lock_guard<std::mutex> guard(s_readers_lock);
+	for (int reader : s_readers) {
+		s_scene->unregister_reader(reader);
+	}
+	s_readers.clear();
+	++s_generation;
+	s_scene = nullptr;
+}
+
+bool take_zone_script_reads()
+{
+	return s_scene_read.exchange(false);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+class ZoneScene;
+
+// Bulk zone queries for Python, added to the engine's flare module. Arrays go in and out through
+// the buffer protocol as C contiguous float32 (numpy, array.array, memoryview), read in place and
+// answered with one batched query over the pinned ZoneScene version, the GIL released meanwhile:
+//   flare.raycast(rays[, out])         rays (n,4) start x y end x y -> (n,6) hit k pos x y normal x y
+//   flare.nearest(points[, max_distance, zones, distances])
+//                                      points (n,2) -> zones int32 (n,) -1 for none, distances float32 (n,)
+//   flare.zone_bounds()                [(ids uint32 (m,), bounds float32 (m,4) min x y max x y)] per cell
+//   flare.zone_points(zone)            float32 (p,2) outline of one zone
+//   flare.scene_version()              bumps whenever the views above would change
+// Without out arrays the results are new memoryviews. Geometry views are read-only and keep the
+// scene cells they point into alive, so they stay valid, if old, after the scene moves on.
+// Any Python thread may call them; each takes its own scene reader slot on its first call and
+// gives it back when it exits or at shutdown. Startup and shutdown are main thread only
+
+// false when Python is not running or has no flare module
+bool zone_scripting_startup(ZoneScene& scene);
+// the functions stay in flare and raise until the next startup
+void zone_scripting_shutdown();
+// true once per frame in which a script read the scene, so a stale scene gets republished
+bool take_zone_script_reads();
@@ -0,0 +1,1050 @@
+#include "Game/GameTest.hpp"
+#include "Game/RVSGame.hpp"
+#include "Game/ZoneVisibility.hpp"
+#include "Game/ZoneAsyncQueries.hpp"
+#include "Game/ZoneScene.hpp"
+#include "Game/ZoneQueryServer.hpp"
+#include "Game/ZoneQueryClient.hpp"
+#include "Game/ZoneCorpus.hpp"
+#include "Game/ghcs.hpp"
+#include "Engine/Core/VertexUtils.hpp"
+#include "Engine/Core/RNG.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+static bool _is_same_tree(const QuadTree& a, const QuadTree& b)
+{
+	if (a.m_num_nodes != b.m_num_nodes || a.m_num_leaf_zones != b.m_num_leaf_zones) {
+		return false;
+	}
+	if (!std::equal(a.m_leaf_zones, a.m_leaf_zones + a.m_num_leaf_zones, b.m_leaf_zones)) {
+		return false;
+	}
+	for (unsigned int i = 0; i < a.m_num_nodes; ++i) {
+		const quad_node& na = a.m_nodes[i];
+		const quad_node& nb = b.m_nodes[i];
+		if (na.m_sub != nb.m_sub || na.m_first_zone != nb.m_first_zone || na.m_num_zones != nb.m_num_zones) {
+			return false;
+		}
+	}
+	return true;
+}
+
+GAME_TEST_SERIAL(quadTreeBuildDeterminism, "spatial", 5)
+{
+	// enough zones that the top levels get split into worker tasks
+	std::vector<Zone> zones;
+	generate_random_zones(zones, QuadTree::PARALLEL_MIN_ZONES * 8, 0.01f, 0.03f);
+
+	QuadTree serial(AABB2(-1,-1,1,1));
+	serial.build_tree(zones, 1);
+	QuadTree parallel(AABB2(-1,-1,1,1));
+	parallel.build_tree(zones, 7);
+	QuadTree again(AABB2(-1,-1,1,1));
+	again.build_tree(zones, 3);
+
+	return _is_same_tree(serial, parallel) && _is_same_tree(serial, again);
+}
+
+GAME_TEST_SERIAL(quadTreeRebuildReusesArena, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, QuadTree::PARALLEL_MIN_ZONES * 4, 0.01f, 0.03f);
+	// single thread so every build puts the same work in the same scratch arena
+	QuadTree tree(AABB2(-1,-1,1,1));
+	quad_build_scratch scratch;
+	tree.build_tree(zones, scratch, 1);
+	// the first rebuild folds the spilled blocks, after that the arenas must not grow
+	tree.build_tree(zones, scratch, 1);
+	const size_t tree_bytes = tree.get_memory_bytes();
+	const size_t scratch_bytes = scratch.get_memory_bytes();
+	tree.build_tree(zones, scratch, 1);
+	return tree.get_memory_bytes() == tree_bytes && scratch.get_memory_bytes() == scratch_bytes;
+}
+
+GAME_TEST_SERIAL(zoneOutlineDirtyUpdate, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 64, 0.05f, 0.1f);
+	ZoneOutlineMesh mesh;
+	mesh.rebuild(zones);
+	const std::vector<Vertex_PCU> before = mesh.get_vertices();
+
+	const size_t edited = 17;
+	zones[edited].rotate(10.f, zones[edited].m_position);
+	mesh.mark_dirty(edited);
+	mesh.mark_dirty(edited);
+	if (mesh.update(zones) != 1 || mesh.is_dirty()) {
+		return false;
+	}
+	// only the edited zone's range may change, and it must match a full rebuild
+	const size_t first = mesh.get_first_vertex(edited);
+	const size_t last = first + mesh.get_num_vertices(edited);
+	if (mesh.get_changed_begin() != first || mesh.get_changed_end() != last) {
+		return false;
+	}
+	ZoneOutlineMesh fresh;
+	fresh.rebuild(zones);
+	const std::vector<Vertex_PCU>& after = mesh.get_vertices();
+	for (size_t i = 0; i < after.size(); ++i) {
+		const Vertex_PCU& expected = (i >= first && i < last) ? fresh.get_vertices()[i] : before[i];
+		if (memcmp(&after[i], &expected, sizeof(Vertex_PCU)) != 0) {
+			return false;
+		}
+	}
+	return mesh.update(zones) == 0;
+}
+
+GAME_TEST_SERIAL(quadTreeDebugVertices, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 256, 0.05f, 0.1f);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones, 1);
+
+	std::vector<Vertex_PCU> outline;
+	const Vec2 corners[4] = {Vec2(-1,1), Vec2(1,1), Vec2(1,-1), Vec2(-1,-1)};
+	for (int i = 0; i < 4; ++i) {
+		AddVerticesOfLine2D(outline, corners[i], corners[(i + 1) % 4], 0.005f, Rgba::GRAY);
+	}
+	std::vector<Vertex_PCU> fill;
+	AddVerticesOfAABB2D(fill, tree.m_box, Rgba::GRAY);
+
+	std::vector<Vertex_PCU> verts;
+	tree.add_debug_vertices(verts, true);
+	if (!verts.empty()) {
+		return false;
+	}
+	tree.raycast_by(Ray2::FromPoint(Vec2(-0.9f, -0.8f), Vec2(0.7f, 0.9f)), true);
+	size_t num_visited = 0;
+	size_t num_checked = 0;
+	for (unsigned int n = 0; n < tree.m_num_nodes; ++n) {
+		num_visited += tree.m_visited[n];
+		num_checked += tree.m_checked[n];
+	}
+	tree.add_debug_vertices(verts, true);
+	if (num_visited == 0 || verts.size() != num_visited * outline.size() + num_checked * fill.size()) {
+		return false;
+	}
+	verts.clear();
+	tree.add_debug_vertices(verts, false);
+	return verts.size() == tree.m_num_nodes * outline.size() + num_checked * fill.size();
+}
+
+GAME_TEST_SERIAL(quadTreeBoxQuery, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 2048, 0.01f, 0.05f);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+
+	zone_query_marks marks;
+	const AABB2 views[3] = {AABB2(-1,-1,1,1), AABB2(-0.3f,-0.2f,0.4f,0.1f), AABB2(0.5f,0.5f,0.52f,0.51f)};
+	for (auto& view : views) {
+		std::vector<unsigned int> found;
+		tree.query_box(view, marks, found);
+		std::sort(found.begin(), found.end());
+		std::vector<unsigned int> expected;
+		for (unsigned int i = 0; i < tree.m_num_zones; ++i) {
+			const AABB2& b = tree.m_zone_bounds[i];
+			if (b.Min.x <= view.Max.x && b.Max.x >= view.Min.x && b.Min.y <= view.Max.y && b.Max.y >= view.Min.y) {
+				expected.push_back(i);
+			}
+		}
+		// everything found has overlapping bounds, and every polygon that reaches into the view is found
+		if (!std::includes(expected.begin(), expected.end(), found.begin(), found.end())) {
+			return false;
+		}
+		for (unsigned int zone : expected) {
+			if (!std::binary_search(found.begin(), found.end(), zone) && zones[zone].m_poly.is_overlapping_box(view)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+GAME_TEST(discSweepKnownContact, "spatial", 5)
+{
+	const std::vector<Vec2> square = {Vec2(0,0), Vec2(1,0), Vec2(1,1), Vec2(0,1)};
+	disc_sweep_hit hit;
+	// face contact when the center reaches x = -0.5
+	if (!sweep_disc_vs_poly(square, Vec2(-2.f, 0.5f), Vec2(4.f, 0.f), 0.5f, hit)
+		|| fabsf(hit.t - 0.375f) > 1e-5f || fabsf(hit.normal.x + 1.f) > 1e-5f || fabsf(hit.normal.y) > 1e-5f) {
+		return false;
+	}
+	// corner contact at (1,1) along the diagonal
+	if (!sweep_disc_vs_poly(square, Vec2(3.f, 3.f), Vec2(-2.f, -2.f), 1.f, hit)
+		|| fabsf(hit.t - (1.f - 0.5f * 0.70710678f)) > 1e-4f || fabsf(hit.normal.x - hit.normal.y) > 1e-5f) {
+		return false;
+	}
+	// passing by, and starting in contact
+	if (sweep_disc_vs_poly(square, Vec2(-1.f, 2.f), Vec2(3.f, 0.f), 0.5f, hit)) {
+		return false;
+	}
+	return sweep_disc_vs_poly(square, Vec2(0.5f, 0.5f), Vec2(1.f, 0.f), 0.1f, hit) && hit.t == 0.f;
+}
+
+GAME_TEST_SERIAL(quadTreeDiscSweepMatchesBruteForce, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 2048, 0.01f, 0.05f);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+
+	// kept well inside the tree box so every contact lies in some leaf
+	std::vector<disc_move> moves(QuadTree::PARALLEL_MIN_MOVES * 4);
+	for (auto& move : moves) {
+		move.m_start = Vec2(g_rng.GetFloatInRange(-0.7f, 0.7f), g_rng.GetFloatInRange(-0.7f, 0.7f));
+		move.m_move = Vec2(g_rng.GetFloatInRange(-0.1f, 0.1f), g_rng.GetFloatInRange(-0.1f, 0.1f));
+		move.m_radius = g_rng.GetFloatInRange(0.f, 0.02f);
+	}
+	std::vector<disc_cast_result> serial(moves.size());
+	std::vector<disc_cast_result> parallel(moves.size());
+	disc_sweep_scratch scratch;
+	tree.sweep_discs(moves.data(), moves.size(), serial.data(), scratch, 1);
+	tree.sweep_discs(moves.data(), moves.size(), parallel.data(), scratch, 4);
+
+	zone_query_marks marks;
+	for (size_t m = 0; m < moves.size(); ++m) {
+		const disc_move& move = moves[m];
+		float best_t = 2.f;
+		unsigned int best_zone = 0xFFFFFFFFu;
+		for (unsigned int z = 0; z < (unsigned int)zones.size(); ++z) {
+			disc_sweep_hit hit;
+			if (sweep_disc_vs_poly(zones[z].m_poly.m_points, move.m_start, move.m_move, move.m_radius, hit) && hit.t < best_t) {
+				best_t = hit.t;
+				best_zone = z;
+			}
+		}
+		const disc_cast_result single = tree.sweep_disc(move, marks);
+		const disc_cast_result* results[3] = {&single, &serial[m], &parallel[m]};
+		for (const disc_cast_result* r : results) {
+			if (r->m_zone != best_zone || (r->m_hit && r->m_t != best_t)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+GAME_TEST_SERIAL(zoneBVHRefitTracksAnimation, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 2048, 0.01f, 0.05f);
+	std::vector<zone_animation> animations;
+	generate_random_animations(animations, zones.size(), zones.size() / 2);
+	ZoneBVH bvh;
+	bvh.build(zones);
+	for (int frame = 0; frame < 120; ++frame) {
+		animate_zones(zones, animations, 1.f / 30.f);
+		bvh.update(zones);
+	}
+	if (bvh.get_depth() > ZoneBVH::MAX_DEPTH || bvh.get_cost() > bvh.get_built_cost() * ZoneBVH::REBUILD_RATIO) {
+		return false;
+	}
+
+	// every zone reachable exactly once, every box the union of its children
+	std::vector<int> seen(zones.size(), 0);
+	std::vector<int> stack = {bvh.m_root};
+	while (!stack.empty()) {
+		const int n = stack.back();
+		stack.pop_back();
+		const bvh_node& node = bvh.m_nodes[n];
+		if (bvh.is_leaf(n)) {
+			const AABB2 bounds = get_points_bounds(zones[node.m_zone].m_poly.m_points);
+			if (memcmp(&bounds, &node.m_box, sizeof(AABB2)) != 0) {
+				return false;
+			}
+			++seen[node.m_zone];
+			continue;
+		}
+		for (int child : node.m_child) {
+			const AABB2& c = bvh.m_nodes[child].m_box;
+			if (bvh.m_nodes[child].m_parent != n || !is_inside(c, node.m_box)) {
+				return false;
+			}
+			stack.push_back(child);
+		}
+	}
+	if (std::count(seen.begin(), seen.end(), 1) != (ptrdiff_t)zones.size()) {
+		return false;
+	}
+
+	for (int i = 0; i < 64; ++i) {
+		const Vec2 start(g_rng.GetFloatInRange(-1, 1), g_rng.GetFloatInRange(-1, 1));
+		const Vec2 end(g_rng.GetFloatInRange(-1, 1), g_rng.GetFloatInRange(-1, 1));
+		const Ray2 ray = Ray2::FromPoint(start, end);
+		ConvexImpactResult expected;
+		for (auto& each : zones) {
+			ConvexImpactResult impact = each.m_hull.raycast_by(ray);
+			if (impact.hit && impact.k < expected.k) {
+				expected = impact;
+			}
+		}
+		const ConvexImpactResult found = bvh.raycast_by(ray);
+		if (found.hit != expected.hit || (found.hit && found.k != expected.k)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static Zone _make_zone(const std::vector<Vec2>& points)
+{
+	Zone zone;
+	zone.m_poly.m_points = points;
+	zone.m_hull = ConvexHull2(zone.m_poly);
+	return zone;
+}
+
+GAME_TEST(zoneSatOverlap, "spatial", 5)
+{
+	const Zone a = _make_zone({Vec2(0,0), Vec2(1,0), Vec2(0,1)});
+	// bounds overlap a's, but the hypotenuse separates them
+	const Zone apart = _make_zone({Vec2(0.6f,1), Vec2(1,0.6f), Vec2(1,1)});
+	const Zone touching = _make_zone({Vec2(0.4f,0.4f), Vec2(1,0.4f), Vec2(0.4f,1)});
+	return !is_zone_overlapping(a, apart) && !is_zone_overlapping(apart, a)
+		&& is_zone_overlapping(a, touching) && is_zone_overlapping(touching, a);
+}
+
+static bool _is_same_pairs(std::vector<zone_pair> found, const std::vector<Zone>& zones)
+{
+	std::vector<AABB2> bounds;
+	for (auto& each : zones) {
+		bounds.push_back(get_points_bounds(each.m_poly.m_points));
+	}
+	std::vector<zone_pair> expected;
+	for (unsigned int i = 0; i < (unsigned int)zones.size(); ++i) {
+		for (unsigned int j = i + 1; j < (unsigned int)zones.size(); ++j) {
+			if (is_overlapping(bounds[i], bounds[j])) {
+				expected.push_back({i, j});
+			}
+		}
+	}
+	auto less = [](const zone_pair& x, const zone_pair& y) { return x.m_a < y.m_a || (x.m_a == y.m_a && x.m_b < y.m_b); };
+	std::sort(found.begin(), found.end(), less);
+	return found.size() == expected.size() && std::equal(found.begin(), found.end(), expected.begin(),
+		[](const zone_pair& x, const zone_pair& y) { return x.m_a == y.m_a && x.m_b == y.m_b; });
+}
+
+GAME_TEST_SERIAL(zoneSweepAndPruneIncremental, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 1024, 0.01f, 0.05f);
+	std::vector<zone_animation> animations;
+	generate_random_animations(animations, zones.size(), 256);
+	ZoneSweepAndPrune sap;
+	sap.build(zones);
+	std::vector<zone_pair> pairs;
+	sap.find_pairs(pairs);
+	if (!_is_same_pairs(pairs, zones)) {
+		return false;
+	}
+	// the first 256 zones are the animated ones
+	std::vector<unsigned int> moved(256);
+	for (unsigned int i = 0; i < 256; ++i) {
+		moved[i] = i;
+	}
+	for (int frame = 0; frame < 30; ++frame) {
+		animate_zones(zones, animations, 1.f / 30.f);
+		if (frame % 2 == 0) {
+			sap.update(zones, moved.data(), moved.size());
+		} else {
+			sap.update(zones);
+		}
+	}
+	pairs.clear();
+	sap.find_pairs(pairs);
+	return _is_same_pairs(pairs, zones);
+}
+
+GAME_TEST_SERIAL(quadTreeNearestMatchesBruteForce, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 2048, 0.01f, 0.05f);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+
+	constexpr size_t k = 4;
+	// inside the tree box, so the nearest zones are reached through their leaves
+	std::vector<Vec2> points(QuadTree::PARALLEL_MIN_POINTS * 2);
+	for (auto& each : points) {
+		each = Vec2(g_rng.GetFloatInRange(-0.8f, 0.8f), g_rng.GetFloatInRange(-0.8f, 0.8f));
+	}
+	const float max_distances[2] = {1e30f, 0.02f};
+	for (float max_distance : max_distances) {
+		std::vector<zone_distance> batch(points.size() * k);
+		tree.find_nearest_batch(points.data(), points.size(), k, max_distance, batch.data(), 4);
+		zone_nearest_scratch scratch;
+		std::vector<zone_distance> found;
+		for (size_t p = 0; p < points.size(); ++p) {
+			std::vector<std::pair<float, unsigned int>> expected;
+			for (unsigned int z = 0; z < (unsigned int)zones.size(); ++z) {
+				Vec2 closest;
+				const float d = get_poly_distance(zones[z].m_poly.m_points, points[p], closest);
+				if (d <= max_distance) {
+					expected.emplace_back(d, z);
+				}
+			}
+			std::sort(expected.begin(), expected.end());
+			expected.resize(std::min(expected.size(), k));
+
+			tree.find_nearest(points[p], k, max_distance, scratch, found);
+			if (found.size() != expected.size()) {
+				return false;
+			}
+			for (size_t i = 0; i < k; ++i) {
+				const zone_distance& b = batch[p * k + i];
+				if (i < expected.size()) {
+					if (found[i].m_zone != expected[i].second || found[i].m_distance != expected[i].first
+						|| b.m_zone != found[i].m_zone) {
+						return false;
+					}
+				} else if (b.m_zone != 0xFFFFFFFFu) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+static bool _is_inside_outline(const std::vector<Vec2>& outline, const Vec2& p)
+{
+	bool inside = false;
+	for (size_t i = 0, j = outline.size() - 1; i < outline.size(); j = i++) {
+		const Vec2& a = outline[i];
+		const Vec2& b = outline[j];
+		if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) {
+			inside = !inside;
+		}
+	}
+	return inside;
+}
+
+GAME_TEST_SERIAL(visibilityMatchesSegmentTests, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 512, 0.01f, 0.06f);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+	visibility_scratch scratch;
+	std::vector<Vec2> outline;
+	constexpr float radius = 0.4f;
+	for (int trial = 0; trial < 20; ++trial) {
+		const Vec2 eye(g_rng.GetFloatInRange(-0.6f, 0.6f), g_rng.GetFloatInRange(-0.6f, 0.6f));
+		compute_visibility(tree, eye, radius, scratch, outline);
+		if (outline.empty()) {
+			continue;
+		}
+		// a point is visible exactly when the segment from the eye reaches it unblocked;
+		// samples stay inside the sides that stand in for the circle
+		for (int i = 0; i < 200; ++i) {
+			const Vec2 dir(g_rng.GetFloatInRange(-1.f, 1.f), g_rng.GetFloatInRange(-1.f, 1.f));
+			const float length = std::sqrt(dot2(dir, dir));
+			if (length < 1e-3f || length > 1.f) {
+				continue;
+			}
+			const Vec2 p = eye + dir * (radius * 0.99f);
+			bool blocked = false;
+			for (auto& each : zones) {
+				disc_sweep_hit hit;
+				if (sweep_disc_vs_poly(each.m_poly.m_points, eye, p - eye, 0.f, hit) && hit.t < 1.f) {
+					blocked = true;
+					break;
+				}
+			}
+			if (_is_inside_outline(outline, p) == blocked) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+GAME_TEST_SERIAL(quadTreeRayCacheMatchesRaycast, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 2048, 0.01f, 0.05f);
+	QuadTree tree(AABB2(-1,-1,1,1));
+	tree.build_tree(zones);
+	ray_query_cache cache;
+	auto matches = [&tree, &cache](const Vec2& start, const Vec2& end) {
+		const ConvexImpactResult expected = tree.raycast_by(Ray2::FromPoint(start, end));
+		const ConvexImpactResult found = tree.raycast_cached(start, end, cache);
+		return found.hit == expected.hit && (!found.hit || found.k == expected.k);
+	};
+
+	// a line being dragged: mostly unchanged, sometimes nudged
+	Vec2 start(-0.9f, -0.3f);
+	Vec2 end(0.8f, 0.4f);
+	for (int frame = 0; frame < 200; ++frame) {
+		if (frame % 3 == 0) {
+			end += Vec2(g_rng.GetFloatInRange(-0.01f, 0.01f), g_rng.GetFloatInRange(-0.01f, 0.01f));
+		}
+		if (!matches(start, end)) {
+			return false;
+		}
+	}
+	const ray_cache_stats stats = tree.m_cache_stats;
+	if (stats.m_skipped == 0 || stats.m_seeded == 0) {
+		return false;
+	}
+	// a rebuilt tree must not answer from the old scene
+	zones[0].scale(0.5f, zones[0].m_position);
+	tree.build_tree(zones);
+	if (!matches(start, end) || tree.m_cache_stats.m_skipped != stats.m_skipped) {
+		return false;
+	}
+	return true;
+}
+
+static void _record_query(void* user, unsigned int index)
+{
+	((std::vector<unsigned int>*)user)->push_back(index);
+}
+
+GAME_TEST(querySchedulerBudgetAndDeadlines, "spatial", 5)
+{
+	QueryScheduler scheduler;
+	std::vector<unsigned int> ran;
+	for (unsigned int i = 0; i < 10; ++i) {
+		scheduler.submit(_record_query, &ran, 100 + i, 0, 5);
+		scheduler.submit(_record_query, &ran, 200 + i, 1, 5);
+	}
+	scheduler.submit(_record_query, &ran, 1, -5, 0);
+	scheduler.submit(_record_query, &ran, 2, -5, 0);
+
+	// no budget: only the queries due this frame run, in submit order
+	const query_frame_stats& first = scheduler.run_frame(0.0);
+	if (first.m_run != 2 || first.m_carried != 20 || ran != std::vector<unsigned int>{1, 2}) {
+		return false;
+	}
+	// with time to spare the carried ones run by priority, oldest first
+	ran.clear();
+	scheduler.run_frame(10.0);
+	for (unsigned int i = 0; i < 20; ++i) {
+		if (ran[i] != (i < 10 ? 200 + i : 100 + i - 10)) {
+			return false;
+		}
+	}
+	// a deadline two frames out waits for it when there is no budget
+	ran.clear();
+	scheduler.submit(_record_query, &ran, 7, 0, 2);
+	scheduler.run_frame(0.0);
+	scheduler.run_frame(0.0);
+	if (!ran.empty() || scheduler.run_frame(0.0).m_run != 1 || scheduler.get_num_pending() != 0) {
+		return false;
+	}
+	return scheduler.get_frames_waited()[2] == 1 && scheduler.get_latency().m_count == 23;
+}
+
+// closest hit over every zone, no index
+static ConvexImpactResult _raycast_zones(const Zone* zones, size_t num_zones, const Ray2& ray)
+{
+	ConvexImpactResult result;
+	for (size_t i = 0; i < num_zones; ++i) {
+		const ConvexImpactResult found = zones[i].m_hull.raycast_by(ray);
+		if (found.hit && found.k < result.k) {
+			result = found;
+		}
+	}
+	return result;
+}
+
+static bool _is_same_hit(const ConvexImpactResult& a, const ConvexImpactResult& b)
+{
+	return a.hit == b.hit && (!a.hit || a.k == b.k);
+}
+
+// frames until nothing is in flight, false if the workers never got there
+static bool _run_async_frames(ZoneAsyncQueries& queries)
+{
+	for (int i = 0; i < 10000 && queries.get_num_in_flight() > 0; ++i) {
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+		queries.begin_frame();
+	}
+	return queries.get_num_in_flight() == 0;
+}
+
+GAME_TEST_SERIAL(asyncRaycastMatchesScene, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 1024, 0.01f, 0.05f);
+	ZoneScene scene;
+	scene.reset(zones);
+	scene.publish();
+	ZoneAsyncQueries queries;
+	queries.startup(scene, 2);
+
+	constexpr int NUM_RAYS = 256;
+	Vec2 starts[NUM_RAYS];
+	Vec2 ends[NUM_RAYS];
+	async_query_handle handles[NUM_RAYS];
+	for (int i = 0; i < NUM_RAYS; ++i) {
+		starts[i] = Vec2(g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1));
+		ends[i] = Vec2(g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1));
+		handles[i] = queries.submit_raycast(starts[i], ends[i]);
+	}
+	// staged edits are not seen until they are published
+	std::vector<Zone> scaled = zones;
+	for (unsigned int i = 0; i < (unsigned int)scaled.size(); ++i) {
+		scaled[i].scale(-0.5f, scaled[i].m_position);
+		scene.set_zone(i, scaled[i]);
+	}
+	if (queries.is_ready(handles[0]) || !_run_async_frames(queries)) {
+		return false;
+	}
+	for (int i = 0; i < NUM_RAYS; ++i) {
+		ConvexImpactResult found;
+		const Ray2 ray = Ray2::FromPoint(starts[i], ends[i]);
+		if (!queries.get_raycast(handles[i], found) || !_is_same_hit(found, _raycast_zones(zones.data(), zones.size(), ray))) {
+			return false;
+		}
+		queries.release(handles[i]);
+	}
+
+	scene.publish();
+	const async_query_handle reused = queries.submit_raycast(starts[0], ends[0]);
+	ConvexImpactResult found;
+	// released handles are stale even once their slot is reused
+	if (reused.m_slot != handles[NUM_RAYS - 1].m_slot || queries.get_raycast(handles[NUM_RAYS - 1], found)) {
+		return false;
+	}
+	const Ray2 ray = Ray2::FromPoint(starts[0], ends[0]);
+	return _run_async_frames(queries) && queries.get_raycast(reused, found)
+		&& _is_same_hit(found, _raycast_zones(scaled.data(), scaled.size(), ray));
+}
+
+// starts right away and frees itself when it returns, the caller polls what it writes
+struct _detached_coroutine
+{
+	struct promise_type
+	{
+		_detached_coroutine get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+// the second await is submitted from inside begin_frame, while it resumes the first
+static _detached_coroutine _await_two_raycasts(ZoneAsyncQueries& queries, const Vec2* ends, ConvexImpactResult* out, int& num_resumed)
+{
+	out[0] = co_await queries.await_raycast(ends[0], ends[1]);
+	++num_resumed;
+	out[1] = co_await queries.await_raycast(ends[2], ends[3]);
+	++num_resumed;
+}
+
+GAME_TEST_SERIAL(asyncRaycastAwaitResumesAtBeginFrame, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 256, 0.02f, 0.08f);
+	ZoneScene scene;
+	scene.reset(zones);
+	scene.publish();
+	ZoneAsyncQueries queries;
+	queries.startup(scene, 2);
+
+	Vec2 ends[4];
+	for (Vec2& each : ends) {
+		each = Vec2(g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1));
+	}
+	ConvexImpactResult found[2];
+	int num_resumed = 0;
+	_await_two_raycasts(queries, ends, found, num_resumed);
+	// nothing resumes before a begin_frame, however fast the workers are
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	if (num_resumed != 0 || queries.get_num_in_flight() != 1) {
+		return false;
+	}
+	if (!_run_async_frames(queries) || num_resumed != 2) {
+		return false;
+	}
+	return _is_same_hit(found[0], _raycast_zones(zones.data(), zones.size(), Ray2::FromPoint(ends[0], ends[1])))
+		&& _is_same_hit(found[1], _raycast_zones(zones.data(), zones.size(), Ray2::FromPoint(ends[2], ends[3])));
+}
+
+GAME_TEST_SERIAL(zoneSceneCellRebuildsKeepArenasFlat, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 2048, 0.01f, 0.05f);
+	ZoneScene scene;
+	scene.reset(zones);
+	scene.publish();
+	size_t bytes = 0;
+	for (unsigned int i = 0; i < 64; ++i) {
+		// the same zone again, so every rebuilt cell comes out the same size
+		const unsigned int index = (i * 61u) % (unsigned int)zones.size();
+		scene.set_zone(index, zones[index]);
+		scene.publish();
+		scene.reclaim();
+		if (i == 1) {
+			bytes = scene.get_memory_bytes();
+		} else if (i > 1 && scene.get_memory_bytes() != bytes) {
+			return false;
+		}
+	}
+	// ~128 zones a cell: a cell tree is its arrays in one default block, the build scratch stays with the writer
+	for (const auto& cell : scene.get_latest()->m_cells) {
+		if (cell != nullptr && cell->m_tree.get_memory_bytes() > MonotonicArena::DEFAULT_BLOCK_SIZE) {
+			return false;
+		}
+	}
+	return true;
+}
+
+GAME_TEST_SERIAL(zoneSceneReadersDuringEdits, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 2048, 0.01f, 0.05f);
+	ZoneScene scene;
+	scene.reset(zones);
+	scene.publish();
+
+	// readers check every version they pin is whole: its cells hold every zone once and
+	// its trees agree with a scan of its own zones
+	constexpr int NUM_READERS = 3;
+	std::atomic<bool> stop = false;
+	std::atomic<int> num_bad = 0;
+	std::atomic<int> num_reads = 0;
+	auto read = [&scene, &stop, &num_bad, &num_reads](int seed) {
+		const int reader = scene.register_reader();
+		unsigned int last_number = 0;
+		unsigned int random = 0x9E3779B9u * (unsigned int)(seed + 1);
+		auto next_float = [&random]() {
+			random = random * 1664525u + 1013904223u;
+			return (float)(random >> 8) / (float)(1u << 24) * 2.f - 1.f;
+		};
+		std::vector<unsigned char> seen;
+		while (!stop) {
+			zone_scene_pin version(scene, reader);
+			if (version->m_number < last_number) {
+				++num_bad;
+			}
+			last_number = version->m_number;
+			seen.assign(version->m_num_zones, 0);
+			const Ray2 ray = Ray2::FromPoint(Vec2(next_float(), next_float()), Vec2(next_float(), next_float()));
+			ConvexImpactResult expected;
+			for (const auto& cell : version->m_cells) {
+				if (cell == nullptr) {
+					continue;
+				}
+				for (unsigned int id : cell->m_ids) {
+					num_bad += id >= seen.size() || seen[id]++ != 0 ? 1 : 0;
+				}
+				const ConvexImpactResult found = _raycast_zones(cell->m_zones.data(), cell->m_zones.size(), ray);
+				if (found.hit && found.k < expected.k) {
+					expected = found;
+				}
+			}
+			num_bad += std::count(seen.begin(), seen.end(), 0) != 0 ? 1 : 0;
+			num_bad += _is_same_hit(version->raycast_by(ray), expected) ? 0 : 1;
+			++num_reads;
+		}
+		scene.unregister_reader(reader);
+	};
+	std::vector<std::thread> readers;
+	for (int i = 0; i < NUM_READERS; ++i) {
+		readers.emplace_back(read, i);
+	}
+
+	// one writer: a few zones at a time, some pushed into other cells
+	bool shared = true;
+	for (int edit = 0; edit < 300; ++edit) {
+		// publish may free the version it replaces, keep its cells instead
+		std::shared_ptr<const zone_scene_cell> before[ZONE_SCENE_CELLS];
+		std::copy(scene.get_latest()->m_cells, scene.get_latest()->m_cells + ZONE_SCENE_CELLS, before);
+		const unsigned int index = std::min((unsigned int)g_rng.GetFloatInRange(0.f, (float)zones.size()), (unsigned int)zones.size() - 1);
+		Zone& zone = zones[index];
+		const Vec2 offset = edit % 4 == 0 ? Vec2(g_rng.GetFloatInRange(-0.5f, 0.5f), g_rng.GetFloatInRange(-0.5f, 0.5f)) : Vec2::ZERO;
+		zone.transform(offset, 10.f, 0.f);
+		scene.set_zone(index, zone);
+		scene.publish();
+		const zone_scene_version* after = scene.get_latest();
+		size_t num_same = 0;
+		for (int c = 0; c < ZONE_SCENE_CELLS; ++c) {
+			num_same += before[c] == after->m_cells[c] ? 1 : 0;
+		}
+		shared = shared && scene.get_num_rebuilt_cells() <= 2 && num_same + scene.get_num_rebuilt_cells() == ZONE_SCENE_CELLS;
+	}
+	while (num_reads < 100) {
+		std::this_thread::yield();
+	}
+	stop = true;
+	for (auto& each : readers) {
+		each.join();
+	}
+	if (num_bad != 0 || !shared || scene.reclaim() != 0) {
+		return false;
+	}
+	// the last version holds what the writer has
+	for (const auto& cell : scene.get_latest()->m_cells) {
+		if (cell == nullptr) {
+			continue;
+		}
+		for (size_t i = 0; i < cell->m_ids.size(); ++i) {
+			const Vec2& position = zones[cell->m_ids[i]].m_position;
+			if (cell->m_zones[i].m_position.x != position.x || cell->m_zones[i].m_position.y != position.y) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// the closest zone over every cell of a published scene, by scene index
+GAME_TEST_SERIAL(zoneSceneNearestMatchesBruteForce, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 1024, 0.01f, 0.05f);
+	ZoneScene scene;
+	scene.reset(zones);
+	scene.publish();
+	const zone_scene_version* version = scene.get_latest();
+	zone_nearest_scratch scratch;
+	std::vector<zone_distance> found;
+	const float max_distances[2] = {1e30f, 0.02f};
+	for (float max_distance : max_distances) {
+		for (int p = 0; p < 256; ++p) {
+			const Vec2 point(g_rng.GetFloatInRange(-1.f, 1.f), g_rng.GetFloatInRange(-1.f, 1.f));
+			zone_distance expected;
+			for (unsigned int z = 0; z < (unsigned int)zones.size(); ++z) {
+				Vec2 closest;
+				const float d = get_poly_distance(zones[z].m_poly.m_points, point, closest);
+				if (d <= max_distance && (expected.m_zone == 0xFFFFFFFFu || d < expected.m_distance)) {
+					expected.m_zone = z;
+					expected.m_distance = d;
+				}
+			}
+			const zone_distance nearest = version->find_nearest(point, max_distance, scratch, found);
+			if (nearest.m_zone != expected.m_zone || (nearest.m_zone != 0xFFFFFFFFu && nearest.m_distance != expected.m_distance)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool _is_same_ray_hit(const zone_ray_hit& hit, const ConvexImpactResult& expected)
+{
+	return (hit.m_hit != 0) == expected.hit && (!expected.hit || hit.m_k == expected.k);
+}
+
+// every request type through a socket and the ring answers what the scene answers directly
+GAME_TEST_SERIAL(zoneQueryServerRoundTrip, "spatial", 5)
+{
+	std::vector<Zone> zones;
+	generate_random_zones(zones, 1024, 0.01f, 0.05f);
+	ZoneScene scene;
+	scene.reset(zones);
+	scene.publish();
+	ZoneQueryServer server;
+	ZoneQueryClient client;
+	if (!server.startup(scene, "zone_query_test.sock") || !client.connect("zone_query_test.sock")) {
+		return false;
+	}
+	const zone_scene_version* version = scene.get_latest();
+
+	// past PARALLEL_MIN_QUERIES, so the batch is split
+	constexpr size_t NUM_QUERIES = ZoneQueryServer::PARALLEL_MIN_QUERIES + 44;
+	std::vector<Vec2> ends(NUM_QUERIES * 2);
+	std::vector<AABB2> boxes(NUM_QUERIES);
+	for (size_t i = 0; i < NUM_QUERIES; ++i) {
+		ends[i * 2] = Vec2(g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1));
+		ends[i * 2 + 1] = Vec2(g_rng.GetFloatInRange(-1,1), g_rng.GetFloatInRange(-1,1));
+		boxes[i].Min = ends[i * 2];
+		boxes[i].Max = ends[i * 2] + Vec2(0.05f, 0.05f);
+	}
+	std::vector<zone_ray_hit> ray_hits(NUM_QUERIES);
+	if (!client.raycast(ends.data(), NUM_QUERIES, ray_hits.data())) {
+		return false;
+	}
+	for (size_t i = 0; i < NUM_QUERIES; ++i) {
+		if (!_is_same_ray_hit(ray_hits[i], version->raycast_by(Ray2::FromPoint(ends[i * 2], ends[i * 2 + 1])))) {
+			return false;
+		}
+	}
+
+	std::vector<zone_point_hit> point_hits(NUM_QUERIES);
+	if (!client.find_zones(ends.data(), NUM_QUERIES, 0.02f, point_hits.data())) {
+		return false;
+	}
+	zone_nearest_scratch scratch;
+	std::vector<zone_distance> found;
+	for (size_t i = 0; i < NUM_QUERIES; ++i) {
+		const zone_distance nearest = version->find_nearest(ends[i], 0.02f, scratch, found);
+		const int zone = nearest.m_zone == 0xFFFFFFFFu ? -1 : (int)nearest.m_zone;
+		if (point_hits[i].m_zone != zone || (zone >= 0 && point_hits[i].m_distance != nearest.m_distance)) {
+			return false;
+		}
+	}
+
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> overlaps;
+	if (!client.overlap(boxes.data(), NUM_QUERIES, counts, overlaps)) {
+		return false;
+	}
+	zone_query_marks marks;
+	std::vector<unsigned int> tree_scratch;
+	std::vector<unsigned int> expected;
+	size_t at = 0;
+	for (size_t i = 0; i < NUM_QUERIES; ++i) {
+		expected.clear();
+		version->query_box(boxes[i], marks, tree_scratch, expected);
+		if (counts[i] != expected.size() || at + counts[i] > overlaps.size()
+			|| !std::equal(expected.begin(), expected.end(), overlaps.begin() + at)) {
+			return false;
+		}
+		at += counts[i];
+	}
+
+	// three batches in flight, the third has to wrap around to where the first was
+	const size_t batch_rays = 100;
+	const size_t batch_bytes = batch_rays * (2 * sizeof(Vec2) + sizeof(zone_ray_hit));
+	if (!client.attach_ring("rvs_zone_query_test", sizeof(zone_query_ring_header) + batch_bytes * 2)) {
+		return false;
+	}
+	zone_ring_batch batches[3];
+	if (!client.reserve_ring_batch(batch_rays, batches[0]) || !client.reserve_ring_batch(batch_rays, batches[1])
+		|| client.reserve_ring_batch(batch_rays, batches[2])) {
+		return false;
+	}
+	for (int b = 0; b < 2; ++b) {
+		std::copy(ends.begin() + b * batch_rays * 2, ends.begin() + (b + 1) * batch_rays * 2, batches[b].m_rays);
+		if (!client.send_ring_batch(batches[b])) {
+			return false;
+		}
+	}
+	for (int b = 0; b < 2; ++b) {
+		zone_ring_batch done;
+		if (!client.receive_ring_batch(done) || done.m_begin != batches[b].m_begin) {
+			return false;
+		}
+		for (size_t i = 0; i < batch_rays; ++i) {
+			if (!_is_same_ray_hit(done.m_hits[i], version->raycast_by(Ray2::FromPoint(done.m_rays[i * 2], done.m_rays[i * 2 + 1])))) {
+				return false;
+			}
+		}
+		if (b == 0 && (!client.reserve_ring_batch(batch_rays, batches[2]) || batches[2].m_begin != 0)) {
+			return false;
+		}
+	}
+
+	// a republished scene is seen from the next request on
+	std::vector<Zone> scaled = zones;
+	for (unsigned int i = 0; i < (unsigned int)scaled.size(); ++i) {
+		scaled[i].scale(-0.5f, scaled[i].m_position);
+		scene.set_zone(i, scaled[i]);
+	}
+	scene.publish();
+	if (!client.raycast(ends.data(), NUM_QUERIES, ray_hits.data())) {
+		return false;
+	}
+	for (size_t i = 0; i < NUM_QUERIES; ++i) {
+		const Ray2 ray = Ray2::FromPoint(ends[i * 2], ends[i * 2 + 1]);
+		if (!_is_same_ray_hit(ray_hits[i], _raycast_zones(scaled.data(), scaled.size(), ray))) {
+			return false;
+		}
+	}
+	client.disconnect();
+	server.shutdown();
+	return server.get_stats().m_connections == 1;
+}
+
+static bool _is_same_points(const std::vector<Zone>& a, const std::vector<Zone>& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); ++i) {
+		const std::vector<Vec2>& pa = a[i].m_poly.m_points;
+		const std::vector<Vec2>& pb = b[i].m_poly.m_points;
+		if (pa.size() != pb.size() || !std::equal(pa.begin(), pa.end(), pb.begin(),
+			[](const Vec2& x, const Vec2& y) { return x.x == y.x && x.y == y.y; })) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// every family is the same for a seed, in [-1,1], counter clockwise, and comes back from a .ghcs as it was
+GAME_TEST(zoneCorpusDeterministicRoundTrip, "spatial", 5)
+{
+	for (int f = 0; f < NUM_ZONE_CORPUS_FAMILIES; ++f) {
+		const zone_corpus_family family = (zone_corpus_family)f;
+		std::vector<Zone> zones;
+		std::vector<Zone> again;
+		std::vector<Zone> other;
+		generate_zone_corpus(family, 7, 2000, zones);
+		generate_zone_corpus(family, 7, 2000, again);
+		generate_zone_corpus(family, 8, 2000, other);
+		if (zones.size() != 2000 || !_is_same_points(zones, again) || _is_same_points(zones, other)) {
+			return false;
+		}
+		for (const Zone& zone : zones) {
+			for (const Vec2& point : zone.m_poly.m_points) {
+				if (point.x < -1.f || point.x > 1.f || point.y < -1.f || point.y > 1.f) {
+					return false;
+				}
+			}
+			if (get_winding(zone.m_poly.m_points) <= 0.f) {
+				return false;
+			}
+		}
+		std::vector<Zone> loaded;
+		if (!save_ghcs_zones("zone_corpus_test.ghcs", zones) || !load_ghcs_zones("zone_corpus_test.ghcs", loaded)
+			|| !_is_same_points(zones, loaded)) {
+			return false;
+		}
+		for (size_t i = 0; i < zones.size(); ++i) {
+			if (loaded[i].m_position.x != zones[i].m_position.x || loaded[i].m_position.y != zones[i].m_position.y) {
+				return false;
+			}
+		}
+	}
+	remove("zone_corpus_test.ghcs");
+
+	std::vector<Zone> zones;
+	generate_zone_corpus(ZONE_CORPUS_CLUSTERED, 3, 500, zones);
+	std::vector<Vec2> rays;
+	std::vector<Vec2> points;
+	std::vector<Vec2> loaded;
+	generate_ray_workload(3, 1000, 0.1f, rays);
+	generate_point_workload(3, zones, 200, 1.f, points);
+	if (rays.size() != 2000 || !save_zone_workload("zone_corpus_test_rays.bin", ZONE_WORKLOAD_RAYS, 3, rays)
+		|| !load_zone_workload("zone_corpus_test_rays.bin", ZONE_WORKLOAD_RAYS, loaded) || loaded.size() != rays.size()
+		|| memcmp(loaded.data(), rays.data(), rays.size() * sizeof(Vec2)) != 0
+		|| load_zone_workload("zone_corpus_test_rays.bin", ZONE_WORKLOAD_POINTS, loaded)) {
+		return false;
+	}
+	remove("zone_corpus_test_rays.bin");
+	for (size_t i = 0; i < 1000; ++i) {
+		const Vec2 ray = rays[i * 2 + 1] - rays[i * 2];
+		if (ray.x * ray.x + ray.y * ray.y > 0.1f * 0.1f * 1.0001f) {
+			return false;
+		}
+	}
+	// near_fraction 1 puts every point in a zone
+	for (const Vec2& point : points) {
+		bool inside = false;
+		for (size_t z = 0; z < zones.size() && !inside; ++z) {
+			Vec2 closest;
+			inside = get_poly_distance(zones[z].m_poly.m_points, point, closest) == 0.f;
+		}
+		if (!inside) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,139 @@
+#include "Game/ZoneVisibility.hpp"
+#include "Game/TraceCapture.hpp"
+#include <algorithm>
+#include <cmath>
+
+static constexpr float PI = 3.14159265358979f;
+
+static float _get_angle(const Vec2& eye, const Vec2& p)
+{
+	return atan2f(p.y - eye.y, p.x - eye.x);
+}
+
+// where the ray from eye at angle meets the line through the segment
+static Vec2 _get_hit(const Vec2& eye, float angle, const visibility_scratch::segment& seg)
+{
+	const Vec2 dir(cosf(angle), sinf(angle));
+	const Vec2 edge = seg.m_to - seg.m_from;
+	const float denominator = cross2(dir, edge);
+	if (denominator == 0.f) {
+		return seg.m_from;
+	}
+	return eye + dir * (cross2(seg.m_from - eye, edge) / denominator);
+}
+
+static float _get_hit_distance(const Vec2& eye, const Vec2& dir, const visibility_scratch::segment& seg)
+{
+	const Vec2 edge = seg.m_to - seg.m_from;
+	const float denominator = cross2(dir, edge);
+	return denominator != 0.f ? cross2(seg.m_from - eye, edge) / denominator : 1e30f;
+}
+
+// a segment crossing the -pi/pi cut is split on it, so every angular span is increasing
+static void _add_segment(const Vec2& eye, Vec2 from, Vec2 to, std::vector<visibility_scratch::segment>& out)
+{
+	if (cross2(from - eye, to - eye) < 0.f) {
+		std::swap(from, to);
+	}
+	const float from_angle = _get_angle(eye, from);
+	const float to_angle = _get_angle(eye, to);
+	if (from_angle <= to_angle) {
+		if (to_angle - from_angle > 1e-7f) {
+			out.push_back({from, to, from_angle, to_angle});
+		}
+		return;
+	}
+	visibility_scratch::segment seg = {from, to, from_angle, to_angle};
+	const Vec2 cut = _get_hit(eye, PI, seg);
+	if (PI - from_angle > 1e-7f) {
+		out.push_back({from, cut, from_angle, PI});
+	}
+	if (to_angle + PI > 1e-7f) {
+		out.push_back({cut, to, -PI, to_angle});
+	}
+}
+
+void compute_visibility(const QuadTree& tree, const Vec2& eye, float radius, visibility_scratch& scratch,
+	std::vector<Vec2>& out)
+{
+	PROFILE_TRACE_SCOPE(__FUNCTION__);
+	out.clear();
+	scratch.m_zones.clear();
+	scratch.m_segments.clear();
+	tree.query_box(AABB2(eye.x - radius, eye.y - radius, eye.x + radius, eye.y + radius), scratch.m_marks, scratch.m_zones);
+
+	// only edges facing the eye can be seen, the back of a convex zone is always behind its front
+	for (unsigned int zone : scratch.m_zones) {
+		const std::vector<Vec2>& points = tree.m_zone_base[zone].m_poly.m_points;
+		const float winding = get_winding(points);
+		bool inside = true;
+		for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+			if (cross2(points[i] - points[j], eye - points[j]) * winding < 0.f) {
+				inside = false;
+				_add_segment(eye, points[j], points[i], scratch.m_segments);
+			}
+		}
+		if (inside) {
+			return;
+		}
+	}
+	for (int i = 0; i < VISIBILITY_CIRCLE_SIDES; ++i) {
+		const float a0 = -PI + 2.f * PI * (float)i / (float)VISIBILITY_CIRCLE_SIDES;
+		const float a1 = -PI + 2.f * PI * (float)(i + 1) / (float)VISIBILITY_CIRCLE_SIDES;
+		_add_segment(eye, eye + Vec2(cosf(a0), sinf(a0)) * radius, eye + Vec2(cosf(a1), sinf(a1)) * radius, scratch.m_segments);
+	}
+
+	scratch.m_events.clear();
+	for (int s = 0; s < (int)scratch.m_segments.size(); ++s) {
+		scratch.m_events.push_back({scratch.m_segments[s].m_from_angle, s});
+		scratch.m_events.push_back({scratch.m_segments[s].m_to_angle, ~s});
+	}
+	std::sort(scratch.m_events.begin(), scratch.m_events.end(), [](const visibility_scratch::event& a, const visibility_scratch::event& b) {
+		return a.m_angle < b.m_angle;
+	});
+
+	// between two event angles the closest active segment is the visible one
+	scratch.m_active.clear();
+	size_t e = 0;
+	while (e < scratch.m_events.size()) {
+		const float angle = scratch.m_events[e].m_angle;
+		for (; e < scratch.m_events.size() && scratch.m_events[e].m_angle == angle; ++e) {
+			const int s = scratch.m_events[e].m_segment;
+			if (s >= 0) {
+				scratch.m_active.push_back(s);
+			} else {
+				auto found = std::find(scratch.m_active.begin(), scratch.m_active.end(), ~s);
+				*found = scratch.m_active.back();
+				scratch.m_active.pop_back();
+			}
+		}
+		if (e == scratch.m_events.size()) {
+			break;
+		}
+		const float next_angle = scratch.m_events[e].m_angle;
+		const float mid = (angle + next_angle) * 0.5f;
+		const Vec2 dir(cosf(mid), sinf(mid));
+		int nearest = -1;
+		float nearest_distance = 1e30f;
+		for (int s : scratch.m_active) {
+			const float d = _get_hit_distance(eye, dir, scratch.m_segments[s]);
+			if (d < nearest_distance) {
+				nearest_distance = d;
+				nearest = s;
+			}
+		}
+		if (nearest < 0) {
+			continue;
+		}
+		const visibility_scratch::segment& seg = scratch.m_segments[nearest];
+		const Vec2 first = _get_hit(eye, angle, seg);
+		const Vec2 last = _get_hit(eye, next_angle, seg);
+		if (out.empty() || dot2(out.back() - first, out.back() - first) > 1e-14f) {
+			out.push_back(first);
+		}
+		out.push_back(last);
+	}
+	if (out.size() > 1 && dot2(out.back() - out.front(), out.back() - out.front()) <= 1e-14f) {
+		out.pop_back();
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Game/RVSGame.hpp"
+
+// the view radius is the circle through this many evenly spaced points
+constexpr int VISIBILITY_CIRCLE_SIDES = 64;
+
+// Kept by the caller of compute_visibility, one per thread
+struct visibility_scratch
+{
+	struct segment
+	{
+		Vec2 m_from; // counter clockwise around the eye from m_from to m_to
+		Vec2 m_to;
+		float m_from_angle;
+		float m_to_angle;
+	};
+	struct event
+	{
+		float m_angle;
+		int m_segment; // ~segment for the end of one
+	};
+	zone_query_marks m_marks;
+	std::vector<unsigned int> m_zones;
+	std::vector<segment> m_segments;
+	std::vector<event> m_events;
+	std::vector<int> m_active;
+};
+
+// Counter clockwise outline of everything the eye sees within radius. One angular sweep over the
+// edges facing the eye, in zones the tree returns around it. Empty when the eye is inside a zone
+void compute_visibility(const QuadTree& tree, const Vec2& eye, float radius, visibility_scratch& scratch,
+	std::vector<Vec2>& out);
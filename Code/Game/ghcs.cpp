@@ -1,6 +1,8 @@
 #pragma once
 #include "Game/ghcs.hpp"
 #include "Engine/Core/StringUtils.hpp"
+#include <cstdio>
+#include <filesystem>
 
 ghcs_header parse_ghcs_header(buffer_reader& bufferReader)
 {
@@ -56,12 +58,59 @@ std::vector<Zone> parse_convex_poly_chunk(buffer_reader& reader)
 			newZone.m_poly.m_points.push_back(position);
 		}
 		newZone.m_hull = ConvexHull2(newZone.m_poly);
+		// the file has no positions, the vertex average is what edits scale and rotate around
 		newZone.m_position = Vec2::ZERO;
+		for (const Vec2& point : newZone.m_poly.m_points) {
+			newZone.m_position += point;
+		}
+		if (nPoint > 0) {
+			newZone.m_position *= 1.f / (float)nPoint;
+		}
 		r.push_back(newZone);
 	}
 	return r;
 }
 
+bool load_ghcs_zones(const std::string& path, std::vector<Zone>& zones)
+{
+	// as big as the file, a 1M zone scene is tens of MB
+	std::error_code error;
+	const uintmax_t file_size = std::filesystem::file_size(path, error);
+	if (error || file_size < 12) {
+		return false;
+	}
+	const size_t buffer_size = (size_t)file_size;
+	std::vector<byte> buffer(buffer_size);
+	LoadFileToBuffer(buffer.data(), buffer_size, path.c_str());
+	buffer_reader reader(buffer.data(), buffer_size);
+	ghcs_header header = parse_ghcs_header(reader);
+	if (header.is_big_endian) {
+		reader.m_reverse = true;
+	}
+
+	char fcc[4];
+	while (true) {
+		if (!reader.next_n_byte((byte*)fcc, 4)){
+			break;
+		}
+		if (fcc[1] == 'T') {
+			//toc
+			break;
+		}
+		if (fcc[1] == 'C') {
+			byte type = reader.next_basic<byte>();
+			reader.next_basic<byte>(); // chunk endianness, the header's is used
+			uint32 size = reader.next_basic<uint32>();
+			if (type == ghcs_ConvexPolysChunk) {
+				zones = parse_convex_poly_chunk(reader);
+				return true;
+			}
+			reader.m_ptr += size;
+		}
+	}
+	return false;
+}
+
 uint32 write_ghcs_header(buffer_writer& writer, ghcs_header* header)
 {
 	writer.append_c_str("GHCS");
@@ -73,7 +122,7 @@ uint32 write_ghcs_header(buffer_writer& writer, ghcs_header* header)
 	return 12;
 }
 
-uint32 write_convex_poly_chunk(buffer_writer& writer, std::vector<Zone>& zones)
+uint32 write_convex_poly_chunk(buffer_writer& writer, const std::vector<Zone>& zones)
 {
 	//head
 	//4cc
@@ -88,7 +137,7 @@ uint32 write_convex_poly_chunk(buffer_writer& writer, std::vector<Zone>& zones)
 	const uint32 nConvex = zones.size();
 	writer.append_multi_byte(nConvex);
 	for (uint32 i = 0; i < nConvex; ++i) {
-		auto& points = zones[i].m_poly.m_points;
+		const auto& points = zones[i].m_poly.m_points;
 		const unsigned short nPoints = points.size();
 		writer.append_multi_byte(nPoints);
 		for (auto j = 0; j < nPoints; ++j) {
@@ -99,4 +148,23 @@ uint32 write_convex_poly_chunk(buffer_writer& writer, std::vector<Zone>& zones)
 	const int diff = offset_of_data_end - offset_of_data_begin;
 	writer.overwrite_bytes(offset_of_chunk_data_size, diff);
 	return offset_of_data_end - begin_offset;
-}
\ No newline at end of file
+}
+
+bool save_ghcs_zones(const std::string& path, const std::vector<Zone>& zones)
+{
+	buffer_writer writer;
+	ghcs_header h;
+	h.is_big_endian = false;
+	h.major_version  = 1;
+	h.minor_version = 0;
+	h.toc_offset = 0;
+	write_ghcs_header(writer, &h);
+	write_convex_poly_chunk(writer, zones);
+	FILE* fp = std::fopen(path.c_str(), "wb");
+	if (fp == nullptr) {
+		return false;
+	}
+	const bool written = fwrite(writer.m_bytes.data(), 1, writer.m_bytes.size(), fp) == writer.m_bytes.size();
+	fclose(fp);
+	return written;
+}
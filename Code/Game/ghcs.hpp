@@ -48,10 +48,14 @@ struct ghcs_toc_chunk
 ghcs_header parse_ghcs_header(buffer_reader& bufferReader);
 std::vector<ghcs_toc_chunk> parse_ghcs_toc(buffer_reader& bufferReader);
 std::vector<Zone> parse_convex_poly_chunk(buffer_reader& reader);
+// the zones of the first convex poly chunk of a .ghcs file, false when it has none
+bool load_ghcs_zones(const std::string& path, std::vector<Zone>& zones);
 
 
 uint32 write_ghcs_header(buffer_writer& writer, ghcs_header* header);
-uint32 write_convex_poly_chunk(buffer_writer& writer, std::vector<Zone>& zones);
+uint32 write_convex_poly_chunk(buffer_writer& writer, const std::vector<Zone>& zones);
+// a header and one convex poly chunk, what load_ghcs_zones reads back
+bool save_ghcs_zones(const std::string& path, const std::vector<Zone>& zones);
 
 
 
@@ -0,0 +1,65 @@
+#include "Engine/Develop/Log.hpp"
+#include "Engine/Develop/UnitTest.hpp"
+#include "Game/GameCommon.hpp"
+#include "Game/GameTest.hpp"
+#include "Game/AsyncLog.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Game/GameEvents.hpp"
+#include "Game/TraceCapture.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+// Headless test runner, no window, renderer or game. Runs the engine's UNIT_TESTs and then every
+// GAME_TEST in parallel, writes the results as JSON and exits with 1 if anything failed.
+//   RVsTests [category=<name>] [level=<n>] [threads=<n>] [json=<path or - for stdout>]
+
+static const char* _get_arg(int argc, char** argv, const char* key, const char* default_value)
+{
+	const size_t key_length = strlen(key);
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], key, key_length) == 0 && argv[i][key_length] == '=') {
+			return argv[i] + key_length + 1;
+		}
+	}
+	return default_value;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string category = _get_arg(argc, argv, "category", "");
+	const int level = atoi(_get_arg(argc, argv, "level", std::to_string(UNIT_TEST_LEVEL).c_str()));
+	const int threads = atoi(_get_arg(argc, argv, "threads", "0"));
+	const std::string json = _get_arg(argc, argv, "json", "-");
+
+	if (!std::filesystem::exists("logs")) {
+		std::filesystem::create_directory("logs");
+	}
+	AsyncLogStart("logs/tests.log");
+	trace_set_thread_name("main");
+	LogStart("logs/tests_engine.log");
+	// what the tests expect of a running game
+	g_theTasks = new TaskScheduler();
+	g_theTasks->startup();
+	g_theEvents = new EventDispatcher();
+
+	::RunUnitTest(category.empty() ? ALL_UNIT_TEST : category.c_str(), level);
+	const game_test_run run = run_game_tests(category.c_str(), level, threads > 0 ? (size_t)threads : 0);
+	log_game_test_results(run);
+	if (json == "-") {
+		write_game_test_results(stdout, run);
+	} else if (!write_game_test_results(json.c_str(), run)) {
+		fprintf(stderr, "cannot write %s\n", json.c_str());
+	}
+
+	delete g_theEvents;
+	g_theEvents = nullptr;
+	g_theTasks->shutdown();
+	delete g_theTasks;
+	g_theTasks = nullptr;
+	AsyncLogStop();
+	LogStop();
+	return run.m_num_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,346 @@
+#include "Game/GameCommon.hpp"
+#include "Game/AsyncLog.hpp"
+#include "Game/TaskScheduler.hpp"
+#include "Game/TraceCapture.hpp"
+#include "Game/RVSGame.hpp"
+#include "Game/ZoneCorpus.hpp"
+#include "Game/ZoneGeometry.hpp"
+#include "Game/ZoneScene.hpp"
+#include "Game/ZoneQueryServer.hpp"
+#include "Game/ZoneQueryClient.hpp"
+#include "Game/ghcs.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless zone query server, no window, renderer or game, and the load generator to drive it.
+//   RVsZoneServer serve [ghcs=<path>] [corpus=<family>] [zones=<n>] [seed=<n>] [socket=<path>]
+//     serves the zones of a .ghcs, or a seeded corpus scene when there is no path, until ctrl-c
+//   RVsZoneServer load [socket=<path>] [clients=<n>] [seconds=<n>] [batch=<n>] [kind=ray|ring|point|overlap] [depth=<n>]
+//     n clients send batches as fast as they are answered, then prints throughput and latency.
+//     ring sends rays through shared memory with up to depth batches in flight
+//   RVsZoneServer corpus [family=<name>|all] [seed=<n>] [zones=<n>] [rays=<n>] [points=<n>] [dir=<path>]
+//     writes seeded scenes as .ghcs and their ray and point workloads next to them
+
+static const char* _get_arg(int argc, char** argv, const char* key, const char* default_value)
+{
+	const size_t key_length = strlen(key);
+	for (int i = 2; i < argc; ++i) {
+		if (strncmp(argv[i], key, key_length) == 0 && argv[i][key_length] == '=') {
+			return argv[i] + key_length + 1;
+		}
+	}
+	return default_value;
+}
+
+static volatile std::sig_atomic_t s_quit = 0;
+
+static void _on_signal(int)
+{
+	s_quit = 1;
+}
+
+static int _serve(int argc, char** argv)
+{
+	const std::string ghcs = _get_arg(argc, argv, "ghcs", "");
+	const std::string socket_path = _get_arg(argc, argv, "socket", "zone_query.sock");
+	std::vector<Zone> zones;
+	if (!ghcs.empty()) {
+		if (!load_ghcs_zones(ghcs, zones)) {
+			fprintf(stderr, "no zones in %s\n", ghcs.c_str());
+			return 1;
+		}
+	} else {
+		const std::string name = _get_arg(argc, argv, "corpus", "uniform");
+		zone_corpus_family family;
+		if (!find_zone_corpus_family(name, family)) {
+			fprintf(stderr, "no corpus family %s\n", name.c_str());
+			return 1;
+		}
+		generate_zone_corpus(family, (uint32_t)atoi(_get_arg(argc, argv, "seed", "1")), (size_t)atoi(_get_arg(argc, argv, "zones", "0")), zones);
+	}
+	if (zones.empty()) {
+		fprintf(stderr, "no zones to serve\n");
+		return 1;
+	}
+	// the cells split the bounds of everything loaded
+	AABB2 box = get_points_bounds(zones[0].m_poly.m_points);
+	for (const Zone& each : zones) {
+		const AABB2 bounds = get_points_bounds(each.m_poly.m_points);
+		box.Min = Vec2(std::min(box.Min.x, bounds.Min.x), std::min(box.Min.y, bounds.Min.y));
+		box.Max = Vec2(std::max(box.Max.x, bounds.Max.x), std::max(box.Max.y, bounds.Max.y));
+	}
+	ZoneScene scene(box);
+	scene.reset(zones);
+	scene.publish();
+
+	ZoneQueryServer server;
+	if (!server.startup(scene, socket_path.c_str())) {
+		fprintf(stderr, "cannot listen on %s\n", socket_path.c_str());
+		return 1;
+	}
+	printf("serving %u zones on %s\n", (unsigned int)zones.size(), socket_path.c_str());
+	std::signal(SIGINT, _on_signal);
+	std::signal(SIGTERM, _on_signal);
+	auto last = std::chrono::steady_clock::now();
+	zone_query_server_stats last_stats;
+	while (!s_quit) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		const auto now = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(now - last).count();
+		if (seconds < 5.0) {
+			continue;
+		}
+		const zone_query_server_stats stats = server.get_stats();
+		printf("%u clients, %.0f requests/s, %.0f queries/s\n", stats.m_clients,
+			(double)(stats.m_requests - last_stats.m_requests) / seconds, (double)(stats.m_queries - last_stats.m_queries) / seconds);
+		fflush(stdout);
+		last = now;
+		last_stats = stats;
+	}
+	server.shutdown();
+	const zone_query_server_stats stats = server.get_stats();
+	printf("served %llu requests, %llu queries, %llu connections\n", stats.m_requests, stats.m_queries, stats.m_connections);
+	return 0;
+}
+
+enum load_kind
+{
+	LOAD_RAY,
+	LOAD_RING,
+	LOAD_POINT,
+	LOAD_OVERLAP,
+};
+
+struct load_client_result
+{
+	bool m_ok = true;
+	unsigned long long m_queries = 0;
+	std::vector<float> m_latencies; // microseconds per request
+};
+
+static float _get_microseconds(std::chrono::steady_clock::time_point since)
+{
+	return std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - since).count();
+}
+
+static void _run_load_client(const std::string& socket_path, const std::string& ring_name, load_kind kind, size_t batch,
+	size_t depth, std::chrono::steady_clock::time_point until, unsigned int seed, load_client_result& result)
+{
+	std::minstd_rand rng(seed);
+	std::uniform_real_distribution<float> coordinate(-1.f, 1.f);
+	std::uniform_real_distribution<float> extent(0.f, 0.05f);
+	ZoneQueryClient client;
+	if (!client.connect(socket_path.c_str())) {
+		result.m_ok = false;
+		return;
+	}
+
+	std::vector<Vec2> points(batch * 2);
+	std::vector<AABB2> boxes(batch);
+	std::vector<zone_ray_hit> ray_hits(batch);
+	std::vector<zone_point_hit> point_hits(batch);
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> zones;
+	auto fill_points = [&](Vec2* out, size_t count) {
+		for (size_t i = 0; i < count; ++i) {
+			out[i] = Vec2(coordinate(rng), coordinate(rng));
+		}
+	};
+
+	if (kind == LOAD_RING) {
+		const size_t ring_bytes = sizeof(zone_query_ring_header) + depth * batch * (2 * sizeof(Vec2) + sizeof(zone_ray_hit) + 8);
+		if (!client.attach_ring(ring_name.c_str(), ring_bytes)) {
+			result.m_ok = false;
+			return;
+		}
+		std::deque<std::chrono::steady_clock::time_point> sent;
+		zone_ring_batch each;
+		while (result.m_ok && (std::chrono::steady_clock::now() < until || !sent.empty())) {
+			// keep depth batches in flight, then wait on the oldest
+			while (sent.size() < depth && std::chrono::steady_clock::now() < until && client.reserve_ring_batch(batch, each)) {
+				fill_points(each.m_rays, batch * 2);
+				sent.push_back(std::chrono::steady_clock::now());
+				if (!client.send_ring_batch(each)) {
+					result.m_ok = false;
+					break;
+				}
+			}
+			if (sent.empty()) {
+				break;
+			}
+			if (!client.receive_ring_batch(each)) {
+				result.m_ok = false;
+				break;
+			}
+			result.m_latencies.push_back(_get_microseconds(sent.front()));
+			result.m_queries += each.m_num_rays;
+			sent.pop_front();
+		}
+		return;
+	}
+
+	while (result.m_ok && std::chrono::steady_clock::now() < until) {
+		switch (kind) {
+		case LOAD_RAY:
+			fill_points(points.data(), batch * 2);
+			break;
+		case LOAD_POINT:
+			fill_points(points.data(), batch);
+			break;
+		default:
+			for (AABB2& box : boxes) {
+				box.Min = Vec2(coordinate(rng), coordinate(rng));
+				box.Max = box.Min + Vec2(extent(rng), extent(rng));
+			}
+			break;
+		}
+		const auto start = std::chrono::steady_clock::now();
+		switch (kind) {
+		case LOAD_RAY:
+			result.m_ok = client.raycast(points.data(), batch, ray_hits.data());
+			break;
+		case LOAD_POINT:
+			result.m_ok = client.find_zones(points.data(), batch, 0.05f, point_hits.data());
+			break;
+		default:
+			result.m_ok = client.overlap(boxes.data(), batch, counts, zones);
+			break;
+		}
+		if (result.m_ok) {
+			result.m_latencies.push_back(_get_microseconds(start));
+			result.m_queries += batch;
+		}
+	}
+}
+
+static int _load(int argc, char** argv)
+{
+	const std::string socket_path = _get_arg(argc, argv, "socket", "zone_query.sock");
+	const size_t num_clients = std::max(1, atoi(_get_arg(argc, argv, "clients", "4")));
+	const double seconds = atof(_get_arg(argc, argv, "seconds", "10"));
+	const size_t batch = std::max(1, atoi(_get_arg(argc, argv, "batch", "1024")));
+	const size_t depth = std::max(1, atoi(_get_arg(argc, argv, "depth", "4")));
+	const std::string kind_name = _get_arg(argc, argv, "kind", "ray");
+	load_kind kind = LOAD_RAY;
+	if (kind_name == "ring") {
+		kind = LOAD_RING;
+	} else if (kind_name == "point") {
+		kind = LOAD_POINT;
+	} else if (kind_name == "overlap") {
+		kind = LOAD_OVERLAP;
+	} else if (kind_name != "ray") {
+		fprintf(stderr, "unknown kind %s\n", kind_name.c_str());
+		return 1;
+	}
+
+	std::random_device device;
+	const unsigned int run = device();
+	std::vector<load_client_result> results(num_clients);
+	std::vector<std::thread> threads;
+	const auto start = std::chrono::steady_clock::now();
+	const auto until = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+	for (size_t i = 0; i < num_clients; ++i) {
+		const std::string ring_name = "rvs_zone_ring_" + std::to_string(run) + "_" + std::to_string(i);
+		threads.emplace_back(_run_load_client, socket_path, ring_name, kind, batch, depth, until, run + (unsigned int)i, std::ref(results[i]));
+	}
+	for (std::thread& each : threads) {
+		each.join();
+	}
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	unsigned long long queries = 0;
+	std::vector<float> latencies;
+	size_t num_failed = 0;
+	for (const load_client_result& each : results) {
+		num_failed += each.m_ok ? 0 : 1;
+		queries += each.m_queries;
+		latencies.insert(latencies.end(), each.m_latencies.begin(), each.m_latencies.end());
+	}
+	if (latencies.empty()) {
+		fprintf(stderr, "no request was answered by %s\n", socket_path.c_str());
+		return 1;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&latencies](double p) { return latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))]; };
+	printf("%s: %u clients, batch %u, %.2f s\n", kind_name.c_str(), (unsigned int)num_clients, (unsigned int)batch, elapsed);
+	printf("  %.0f requests/s, %.0f queries/s\n", latencies.size() / elapsed, queries / elapsed);
+	printf("  latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", percentile(0.5), percentile(0.9), percentile(0.99), latencies.back());
+	if (num_failed > 0) {
+		printf("  %u clients failed\n", (unsigned int)num_failed);
+	}
+	return num_failed == 0 ? 0 : 1;
+}
+
+static int _corpus(int argc, char** argv)
+{
+	const std::string name = _get_arg(argc, argv, "family", "all");
+	const std::string dir = _get_arg(argc, argv, "dir", "Data/Corpus");
+	const uint32_t seed = (uint32_t)atoi(_get_arg(argc, argv, "seed", "1"));
+	const size_t num_zones = (size_t)atoi(_get_arg(argc, argv, "zones", "0"));
+	const size_t num_rays = (size_t)atoi(_get_arg(argc, argv, "rays", "100000"));
+	const size_t num_points = (size_t)atoi(_get_arg(argc, argv, "points", "100000"));
+	std::error_code error;
+	std::filesystem::create_directories(dir, error);
+	int num_written = 0;
+	for (int i = 0; i < NUM_ZONE_CORPUS_FAMILIES; ++i) {
+		const zone_corpus_family family = (zone_corpus_family)i;
+		if (name != "all" && name != get_zone_corpus_name(family)) {
+			continue;
+		}
+		if (!save_zone_corpus(dir, family, seed, num_zones, num_rays, num_points)) {
+			fprintf(stderr, "cannot write the %s corpus to %s\n", get_zone_corpus_name(family), dir.c_str());
+			return 1;
+		}
+		printf("%s/%s_%u.ghcs\n", dir.c_str(), get_zone_corpus_name(family), seed);
+		++num_written;
+	}
+	if (num_written == 0) {
+		fprintf(stderr, "no corpus family %s\n", name.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string mode = argc > 1 ? argv[1] : "";
+	if (mode != "serve" && mode != "load" && mode != "corpus") {
+		fprintf(stderr, "RVsZoneServer serve [ghcs=<path>] [corpus=<family>] [zones=<n>] [seed=<n>] [socket=<path>]\n");
+		fprintf(stderr, "RVsZoneServer load [socket=<path>] [clients=<n>] [seconds=<n>] [batch=<n>] [kind=ray|ring|point|overlap] [depth=<n>]\n");
+		fprintf(stderr, "RVsZoneServer corpus [family=<name>|all] [seed=<n>] [zones=<n>] [rays=<n>] [points=<n>] [dir=<path>]\n");
+		return 1;
+	}
+	if (!std::filesystem::exists("logs")) {
+		std::filesystem::create_directory("logs");
+	}
+	AsyncLogStart(("logs/zone_" + mode + ".log").c_str());
+	trace_set_thread_name("main");
+	g_theTasks = new TaskScheduler();
+	g_theTasks->startup();
+
+	int exit_code = 0;
+	if (mode == "serve") {
+		exit_code = _serve(argc, argv);
+	} else if (mode == "load") {
+		exit_code = _load(argc, argv);
+	} else {
+		exit_code = _corpus(argc, argv);
+	}
+
+	g_theTasks->shutdown();
+	delete g_theTasks;
+	g_theTasks = nullptr;
+	AsyncLogStop();
+	return exit_code;
+}